@@ -0,0 +1,242 @@
+//********************************************************************************************
+/**
+ * @file        tcc_bs_sanitize.c
+ * @brief		H.264 Annex-B access unit check before it is handed to the VPU.
+ * 				This interface contain : Sanitize access unit, Reset/Get counters.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+
+#include "tcc_bs_sanitize.h"
+
+//#define	DEBUG_MODE
+#ifdef	DEBUG_MODE
+	#define	DebugPrint( fmt, ... )	printf( "[TCC_BS_SANITIZE](D):"fmt"\n", ##__VA_ARGS__ )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_BS_SANITIZE](E):"fmt"\n", ##__VA_ARGS__ )
+#else
+	#define	DebugPrint( fmt, ... )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_BS_SANITIZE](E):"fmt"\n", ##__VA_ARGS__ )
+#endif
+
+#define NAL_END_OF_SEQ		10
+#define NAL_END_OF_STREAM	11
+
+static BsSanitizeStat g_Stat;
+
+static const unsigned char g_StartCode[4] = { 0x00, 0x00, 0x00, 0x01 };
+
+/* offset of the next 00 00 01 from 'from', -1 : none.
+ * *bad : first 00 00 00 / 00 00 02 before it (not allowed inside a NAL), -1 : none */
+static int next_start_code(const unsigned char *p, int from, int len, int *bad)
+{
+	int i = from;
+
+	*bad = -1;
+	while( i + 2 < len )
+	{
+		// none of 00 00 0x (x <= 2) can start at i, i+1 or i+2
+		if( p[i+2] > 2 )
+		{
+			i += 3;
+			continue;
+		}
+		if( p[i] == 0 && p[i+1] == 0 )
+		{
+			if( p[i+2] == 1 )
+				return i;
+			if( *bad < 0 )
+				*bad = i;
+		}
+		i++;
+	}
+	return -1;
+}
+
+/* 1 : keep the NAL p[0..n) */
+static int nal_check(const unsigned char *p, int n)
+{
+	int type;
+
+	if( n <= 0 )
+	{
+		g_Stat.nal_empty++;
+		return 0;
+	}
+	type = p[0] & 0x1F;
+	if( (p[0] & 0x80) || type == 0 )
+	{
+		g_Stat.nal_forbidden++;
+		return 0;
+	}
+	// only end of sequence / end of stream come without payload
+	if( n < 2 && type != NAL_END_OF_SEQ && type != NAL_END_OF_STREAM )
+	{
+		g_Stat.nal_short++;
+		return 0;
+	}
+	return 1;
+}
+
+static int append(unsigned char *scratch, int scratch_size, int *used, const unsigned char *p, int n)
+{
+	if( *used + n > scratch_size )
+		return -1;
+	memcpy( scratch + *used, p, n );
+	*used += n;
+	return 0;
+}
+
+static int reject(void)
+{
+	g_Stat.aus_rejected++;
+	return -1;
+}
+
+int tcc_bs_sanitize(const unsigned char *in, int len, int max_len,
+					unsigned char *scratch, int scratch_size,
+					const unsigned char **out, int *out_len)
+{
+	int i, k, sc, hdr, next, bad, end, cut;
+	int kept = 0;
+	int fixed = 0;		// something was dropped or cut
+	int head_cut = 0;	// something before the first kept NAL was dropped
+	int hole = 0;		// something after the last kept NAL was dropped
+	int range_start = 0, range_end = 0;		// kept part of 'in' while not rewriting
+	int used = -1;		// bytes in scratch, -1 : not rewriting
+
+	g_Stat.aus++;
+	if( in == NULL || len <= 0 )
+		return reject();
+	if( len > max_len )
+	{
+		ErrorPrint( "access unit of %d bytes exceeds %d, dropped", len, max_len );
+		g_Stat.aus_oversize++;
+		return reject();
+	}
+
+	i = next_start_code( in, 0, len, &bad );
+	if( i < 0 )
+	{
+		DebugPrint( "no start code in %d bytes", len );
+		return reject();
+	}
+	sc = (i > 0 && in[i-1] == 0) ? i - 1 : i;
+
+	// zero bytes in front are allowed (leading_zero_8bits), anything else is junk
+	for( k = 0; k < sc && in[k] == 0; k++ )
+		;
+	if( k < sc )
+	{
+		g_Stat.bytes_skipped += sc;
+		fixed = head_cut = 1;
+	}
+
+	while( i >= 0 )
+	{
+		hdr = i + 3;
+		next = next_start_code( in, hdr, len, &bad );
+		end = (next < 0) ? len : next;
+
+		cut = 0;
+		// trailing zero bytes belong to no NAL
+		while( end > hdr && in[end-1] == 0 )
+			end--;
+		if( bad >= 0 && bad < end )
+		{
+			// the rest up to the next start code can't be part of a valid NAL
+			end = bad;
+			while( end > hdr && in[end-1] == 0 )
+				end--;
+			g_Stat.nal_truncated++;
+			fixed = cut = 1;
+		}
+
+		if( !nal_check( in + hdr, end - hdr ) )
+		{
+			fixed = 1;
+			if( kept )
+				hole = 1;
+			else
+				head_cut = 1;
+		}
+		else
+		{
+			if( kept == 0 )
+			{
+				range_start = sc;
+				// the VPU wants the access unit to open with a 4 byte start code
+				if( head_cut && hdr - sc == 3 )
+					used = 0;
+			}
+			else if( hole && used < 0 )
+			{
+				// a NAL in the middle was dropped : rebuild what was kept so far
+				used = 0;
+				if( append( scratch, scratch_size, &used, in + range_start, range_end - range_start ) < 0 )
+					break;
+			}
+
+			if( used >= 0 )
+			{
+				if( append( scratch, scratch_size, &used, g_StartCode, sizeof(g_StartCode) ) < 0
+					|| append( scratch, scratch_size, &used, in + hdr, end - hdr ) < 0 )
+					break;
+			}
+			else
+			{
+				range_end = end;
+			}
+			kept++;
+			hole = cut;
+		}
+
+		i = next;
+		if( i >= 0 )
+			sc = (in[i-1] == 0) ? i - 1 : i;
+	}
+
+	if( i >= 0 )
+	{
+		// left the loop on a full scratch
+		ErrorPrint( "rewrite of %d bytes exceeds %d, dropped", len, scratch_size );
+		g_Stat.aus_oversize++;
+		return reject();
+	}
+	if( kept == 0 )
+	{
+		DebugPrint( "no valid NAL in %d bytes", len );
+		return reject();
+	}
+
+	if( used >= 0 )
+	{
+		*out = scratch;
+		*out_len = used;
+		g_Stat.aus_rewritten++;
+	}
+	else
+	{
+		*out = in + range_start;
+		*out_len = range_end - range_start;
+		if( fixed )
+			g_Stat.aus_trimmed++;
+		else
+			g_Stat.aus_clean++;
+	}
+	return 0;
+}
+
+void tcc_bs_sanitize_reset(void)
+{
+	memset( &g_Stat, 0x00, sizeof(BsSanitizeStat) );
+}
+
+void tcc_bs_sanitize_get_stat(BsSanitizeStat *stat)
+{
+	memcpy( stat, &g_Stat, sizeof(BsSanitizeStat) );
+}
@@ -0,0 +1,39 @@
+//********************************************************************************************
+/**
+ * @file        tcc_bs_sanitize.h
+ * @brief		H.264 Annex-B access unit check before it is handed to the VPU.
+ * 				This interface contain : Sanitize access unit, Reset/Get counters.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+#ifndef	__TCC_BS_SANITIZE_H__
+#define	__TCC_BS_SANITIZE_H__
+
+typedef struct _BsSanitizeStat {
+	unsigned int	aus;			//access units checked
+	unsigned int	aus_clean;		//passed as they came
+	unsigned int	aus_trimmed;	//passed from the caller's buffer with the head or tail cut off
+	unsigned int	aus_rewritten;	//rebuilt in the sanitizer buffer
+	unsigned int	aus_rejected;	//not passed to the VPU : no start code, nothing valid left, or too large
+	unsigned int	aus_oversize;	//of aus_rejected : larger than the VPU bitstream buffer or the rewrite buffer
+	unsigned int	nal_empty;		//start codes with nothing behind them (00 00 00 01 00 00 01)
+	unsigned int	nal_forbidden;	//forbidden_zero_bit set or nal_unit_type 0, dropped
+	unsigned int	nal_truncated;	//cut at an illegal 00 00 00 / 00 00 02 inside the NAL
+	unsigned int	nal_short;		//too short for its nal_unit_type, dropped
+	unsigned int	bytes_skipped;	//junk before the first start code
+} BsSanitizeStat;
+
+/* checks one access unit and returns the part of it the VPU should see, caller memory is never written.
+ * Most access units come back unchanged or as a sub range of 'in' (no copy). Only when NALs in the middle
+ * are dropped or cut, or the first start code has to be rebuilt, the access unit is rewritten into 'scratch'.
+ * 0 : *out / *out_len are set, -1 : drop the access unit */
+int tcc_bs_sanitize(const unsigned char *in, int len, int max_len,
+					unsigned char *scratch, int scratch_size,
+					const unsigned char **out, int *out_len);
+
+void tcc_bs_sanitize_reset(void);
+void tcc_bs_sanitize_get_stat(BsSanitizeStat *stat);
+
+#endif	// __TCC_BS_SANITIZE_H__
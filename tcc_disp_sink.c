@@ -0,0 +1,302 @@
+//********************************************************************************************
+/**
+ * @file        tcc_disp_sink.c
+ * @brief		Display sinks the decoded frames are presented to.
+ * 				This interface contain : Overlay, frame buffer, raw file and null sinks.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+
+#include <mach/tcc_overlay_ioctl.h>
+#include <mach/vioc_global.h>
+
+#include "tcc_fb_render.h"
+#include "tcc_disp_sink.h"
+#ifdef VDEC_FAULT_INJECT
+#include "tcc_vpu_fault.h"
+#endif
+
+//#define	DEBUG_MODE
+#ifdef	DEBUG_MODE
+	#define	DebugPrint( fmt, ... )	printf( "[TCC_DISP_SINK](D):"fmt"\n", ##__VA_ARGS__ )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_DISP_SINK](E):"fmt"\n", ##__VA_ARGS__ )
+#else
+	#define	DebugPrint( fmt, ... )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_DISP_SINK](E):"fmt"\n", ##__VA_ARGS__ )
+#endif
+
+// Overlay Driver
+#define	OVERLAY_DRIVER	"/dev/overlay"
+#define TCC_LCDC_SET_WMIXER_OVP         0x0045
+#define OVERLAY_SET_CROP_INFO 0x1234
+#define OVERLAY_SET_SCALER_INFO 0x2345
+
+// FB Driver
+#define FB_DEV "/dev/fb0"
+
+#define OVP_VIDEO_ON_TOP	8		//WMIXER layer order while the video is shown
+#define OVP_DEFAULT			24
+
+#define NV12_FORMAT		((unsigned int)'N' | (unsigned int)'V'<<8 | (unsigned int)'1'<<16 | (unsigned int)'2'<<24)
+
+/*--------------------------------------------------------------------------------------------
+ * overlay
+ */
+static int g_OverlayDrv = -1;
+static int g_IsSetConfigure = 0;	// 0:未設定, 1:設定済
+static unsigned int ignore = 1;
+
+static void overlay_set_ovp(int ovp)
+{
+	int fbdev;
+
+	fbdev = open(FB_DEV, O_RDWR);
+	if( fbdev < 0 )
+	{
+		ErrorPrint("Error opening %s.", FB_DEV);
+		return;
+	}
+	if( ioctl(fbdev, TCC_LCDC_SET_WMIXER_OVP, &ovp) < 0 )
+		ErrorPrint("FB Driver IOCTL ERROR");
+	close(fbdev);
+}
+
+static int overlay_open(void)
+{
+	g_IsSetConfigure = 0;
+#ifdef VDEC_FAULT_INJECT
+	if( tcc_vpu_fault_hit( FAULT_OVERLAY_OPEN ) )
+	{
+		ErrorPrint( "Error : Overlay Driver Open Fail (injected)" );
+		return -1;
+	}
+#endif
+	g_OverlayDrv = open( OVERLAY_DRIVER, O_RDWR );
+	if( g_OverlayDrv < 0 )
+	{
+		ErrorPrint( "Error : Overlay Driver Open Fail" );
+		return -1;
+	}
+	overlay_set_ovp(OVP_VIDEO_ON_TOP);
+	return 0;
+}
+
+static void overlay_close(void)
+{
+	if( g_OverlayDrv >= 0 )
+	{
+		close( g_OverlayDrv );
+		overlay_set_ovp(OVP_DEFAULT);
+	}
+	g_OverlayDrv = -1;
+	g_IsSetConfigure = 0;	// 2015.04.23 : N.Tanaka
+}
+
+static void overlay_configure(const DispWindow *win)
+{
+	overlay_config_t cfg;
+
+	// 表示開始時に一度だけ設定する。位置とサイズはフレームごとにpresentで設定する
+	if( g_OverlayDrv < 0 || g_IsSetConfigure )
+		return;
+
+	cfg.sx = 0;
+	cfg.sy = 0;
+	cfg.width = 800;
+	cfg.height = 480;
+	cfg.format = NV12_FORMAT;
+	cfg.transform = 0;
+	ioctl( g_OverlayDrv, OVERLAY_SET_IGNORE_PRIORITY, &ignore );
+	ioctl( g_OverlayDrv, OVERLAY_SET_CONFIGURE, &cfg );
+	g_IsSetConfigure = 1;
+}
+
+static void overlay_present(const DispFrame *frame, const DispWindow *win)
+{
+	overlay_video_buffer_t info;
+	unsigned int crop_info[4]={0};
+	unsigned int scaler_info[2]={0};
+	float target_w = (float)win->width;
+	float target_h = (float)win->height;
+
+	if( g_OverlayDrv < 0 )
+		return;
+
+	info.cfg.width = frame->width;
+	info.cfg.height = frame->height;
+	info.cfg.format = NV12_FORMAT;
+	info.cfg.transform = 0;		// 使われてないようなので無視
+	info.addr = frame->phy[0];		// Y Address;
+	info.addr1 = frame->phy[1];
+	info.addr2 = frame->phy[2];
+	//for crop
+	crop_info[0] = 0;
+	crop_info[1] = 0;
+	crop_info[2] = frame->width - frame->crop_right;
+	crop_info[3] = frame->height - frame->crop_bottom;
+
+	///for scaler
+	float target_ratio = (target_w/target_h);
+	float ratio0 = (float)info.cfg.width/(float)info.cfg.height;
+	float ratio1 = (float)info.cfg.height/(float)info.cfg.width;
+	if((ratio0 >= target_ratio) || (ratio1 >= target_ratio)) //ratio is 16:9
+	{
+		if(info.cfg.width > info.cfg.height)
+		{
+			scaler_info[0] = target_w;
+			scaler_info[1] = (target_w*(float)crop_info[3])/(float)crop_info[2];
+		}else{
+			scaler_info[0] = (target_h*(float)crop_info[2])/(float)crop_info[3];
+			scaler_info[1] = target_h;
+		}
+	}else{//ratio is 4:3
+		if(info.cfg.width > info.cfg.height)
+		{
+			scaler_info[0] = (win->height*4)/3;
+			scaler_info[1] = win->height;
+		}else{
+			scaler_info[0] = (win->height*3)/4;
+			scaler_info[1] = win->height;
+		}
+	}
+	info.cfg.sx = win->x + (win->width-scaler_info[0])/2;
+	info.cfg.sy = win->y + (win->height-scaler_info[1])/2;
+	printf("[libH264] crop_width=%d, crop_height=%d\n",crop_info[2],crop_info[3]);
+	printf("[libH264] Scaler: src (%d x %d) -- dst (%d x %d) \n", info.cfg.width, info.cfg.height, scaler_info[0], scaler_info[1]);
+	printf("[libH264] (%d,%d) - (%d x %d)... \n",info.cfg.sx, info.cfg.sy, scaler_info[0], scaler_info[1]);
+
+	ioctl( g_OverlayDrv, OVERLAY_SET_CROP_INFO, &crop_info);
+	ioctl( g_OverlayDrv, OVERLAY_SET_SCALER_INFO, &scaler_info);
+
+	// Start時にフラグが立っておらずSetConfigureされていない場合にはここでSetConfiguresする
+	if( g_IsSetConfigure == 0 )
+		overlay_configure(win);
+	ioctl( g_OverlayDrv, OVERLAY_SET_CONFIGURE, &info.cfg );
+	ioctl( g_OverlayDrv, OVERLAY_PUSH_VIDEO_BUFFER, &info );
+}
+
+static const DispSink g_SinkOverlay = {
+	"overlay", 1, overlay_open, overlay_close, overlay_configure, overlay_present, NULL, NULL
+};
+
+const DispSink* tcc_disp_sink_overlay(void)
+{
+	return &g_SinkOverlay;
+}
+
+/*--------------------------------------------------------------------------------------------
+ * frame buffer
+ */
+static void fb_present(const DispFrame *frame, const DispWindow *win)
+{
+	int src_x = frame->crop_left;
+	int src_y = frame->crop_top;
+	int src_w = frame->width - frame->crop_left - frame->crop_right;
+	int src_h = frame->height - frame->crop_top - frame->crop_bottom;
+	int dst_w = win->width;
+	int dst_h = win->height;
+
+	// letterbox : keep the aspect ratio inside the display window
+	if( src_w > 0 && src_h > 0 )
+	{
+		if( src_w * win->height > src_h * win->width )
+			dst_h = (win->width * src_h) / src_w;
+		else
+			dst_w = (win->height * src_w) / src_h;
+	}
+
+	tcc_fb_render_frame( frame->y, frame->uv, frame->stride,
+						src_x, src_y, src_w, src_h,
+						win->x + (win->width - dst_w)/2, win->y + (win->height - dst_h)/2, dst_w, dst_h );
+}
+
+static const DispSink g_SinkFb = {
+	"fb", 0, tcc_fb_render_open, tcc_fb_render_close, NULL, fb_present, NULL, NULL
+};
+
+const DispSink* tcc_disp_sink_fb(void)
+{
+	return &g_SinkFb;
+}
+
+/*--------------------------------------------------------------------------------------------
+ * raw file
+ */
+static char g_FilePath[256];
+static FILE *g_File = NULL;
+
+static int file_open(void)
+{
+	g_File = fopen( g_FilePath, "wb" );
+	if( g_File == NULL )
+	{
+		ErrorPrint( "can't create %s", g_FilePath );
+		return -1;
+	}
+	return 0;
+}
+
+static void file_close(void)
+{
+	if( g_File != NULL )
+		fclose( g_File );
+	g_File = NULL;
+}
+
+static void file_present(const DispFrame *frame, const DispWindow *win)
+{
+	int w = frame->width - frame->crop_left - frame->crop_right;
+	int h = frame->height - frame->crop_top - frame->crop_bottom;
+	const unsigned char *p;
+	int i;
+
+	if( g_File == NULL || w <= 0 || h <= 0 )
+		return;
+
+	// visible area only, luma then interleaved chroma
+	p = frame->y + frame->crop_top * frame->stride + frame->crop_left;
+	for( i = 0; i < h; i++, p += frame->stride )
+		fwrite( p, 1, w, g_File );
+	p = frame->uv + (frame->crop_top / 2) * frame->stride + (frame->crop_left & ~1);
+	for( i = 0; i < h / 2; i++, p += frame->stride )
+		fwrite( p, 1, w & ~1, g_File );
+}
+
+static void file_flush(void)
+{
+	if( g_File != NULL )
+		fflush( g_File );
+}
+
+static const DispSink g_SinkFile = {
+	"file", 0, file_open, file_close, NULL, file_present, NULL, file_flush
+};
+
+const DispSink* tcc_disp_sink_file(const char *path)
+{
+	if( path == NULL || strlen(path) >= sizeof(g_FilePath) )
+		return NULL;
+	strcpy( g_FilePath, path );
+	return &g_SinkFile;
+}
+
+/*--------------------------------------------------------------------------------------------
+ * null
+ */
+static const DispSink g_SinkNull = {
+	"null", 0, NULL, NULL, NULL, NULL, NULL, NULL
+};
+
+const DispSink* tcc_disp_sink_null(void)
+{
+	return &g_SinkNull;
+}
@@ -0,0 +1,62 @@
+//********************************************************************************************
+/**
+ * @file        tcc_disp_sink.h
+ * @brief		Display sinks the decoded frames are presented to.
+ * 				This interface contain : Overlay, frame buffer, raw file and null sinks.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+#ifndef	__TCC_DISP_SINK_H__
+#define	__TCC_DISP_SINK_H__
+
+/* one decoded NV12 frame, the buffers belong to the VPU */
+typedef struct _DispFrame {
+	unsigned int	phy[3];			//Y, U, V physical addresses
+	unsigned char	*y;				//virtual addresses
+	unsigned char	*uv;
+	int				width;			//full frame size, crop not removed
+	int				height;
+	int				stride;
+	int				crop_left;
+	int				crop_top;
+	int				crop_right;
+	int				crop_bottom;
+	unsigned int	pts_ms;
+	int				disp_idx;		//VPU display index
+} DispFrame;
+
+/* display window on the screen */
+typedef struct _DispWindow {
+	int		x;
+	int		y;
+	int		width;
+	int		height;
+} DispWindow;
+
+/* every callback is optional (NULL : nothing to do) and is called with the decoder lock held */
+typedef struct _DispSink {
+	const char	*name;
+	int			zero_copy;		//1 : frames are scanned out of the VPU buffer and released on vsync, 0 : done with the frame once present returns
+	int			(*open)(void);		//0 : ok, -1 : the sink is not available
+	void		(*close)(void);
+	void		(*configure)(const DispWindow *win);					//the view became visible or the window changed
+	void		(*present)(const DispFrame *frame, const DispWindow *win);	//NULL : decode only, frames are never shown
+	void		(*release)(int disp_idx);							//zero_copy : the frame went back to the VPU
+	void		(*flush)(void);		//the frame buffers are about to be re-allocated or freed
+} DispSink;
+
+/* /dev/overlay, scans out of the VPU frame buffers */
+const DispSink* tcc_disp_sink_overlay(void);
+
+/* software render to /dev/fb0 (tcc_fb_render.h) */
+const DispSink* tcc_disp_sink_fb(void);
+
+/* appends the visible area of every frame as packed NV12 to 'path' */
+const DispSink* tcc_disp_sink_file(const char *path);
+
+/* decode only, no display work at all */
+const DispSink* tcc_disp_sink_null(void);
+
+#endif	// __TCC_DISP_SINK_H__
@@ -0,0 +1,547 @@
+//********************************************************************************************
+/**
+ * @file        tcc_fb_render.c
+ * @brief		Software render path to the frame buffer, used when the overlay driver is not available.
+ * 				This interface contain : Open FB, Convert NV12 frame to FB format with letterbox scaling and clipping, Close FB.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/fb.h>
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
+#include "tcc_fb_render.h"
+
+//#define	DEBUG_MODE
+#ifdef	DEBUG_MODE
+	#define	DebugPrint( fmt, ... )	printf( "[TCC_FB_RENDER](D):"fmt"\n", ##__VA_ARGS__ )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_FB_RENDER](E):"fmt"\n", ##__VA_ARGS__ )
+#else
+	#define	DebugPrint( fmt, ... )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_FB_RENDER](E):"fmt"\n", ##__VA_ARGS__ )
+#endif
+
+typedef struct _FbRender {
+	int							fd;
+	struct fb_var_screeninfo	var;
+	struct fb_fix_screeninfo	fix;
+	unsigned char				*mem;
+	unsigned int				memlen;
+	unsigned int				pages;			//1 : single buffer, 2 : double buffered with pan
+	unsigned int				page;			//page currently scanned out
+	int							layout[2][4];	//last destination window drawn into each page
+	// pixel layout from var.red/green/blue : bit position and width of each component in a pixel
+	int							r_off, g_off, b_off;
+	int							r_len, g_len, b_len;
+	unsigned int				opaque;			//32 bpp : every bit outside R, G and B (alpha or unused), set in each pixel
+	int							rgb565;			//16 bpp : 1 RGB565, 2 BGR565, 0 other layout (no NEON path)
+} FbRender;
+
+static FbRender g_Fb = { -1 };
+
+// Per-line resample tables and line buffers, rebuilt only when the scaling changes
+static unsigned short g_XMap[FB_RENDER_MAX_WIDTH];
+static int g_XMapKey[3] = { -1, -1, -1 };	//src_x, src_w, dst_w
+static unsigned char g_LineY[FB_RENDER_MAX_WIDTH];
+static unsigned char g_LineU[FB_RENDER_MAX_WIDTH];
+static unsigned char g_LineV[FB_RENDER_MAX_WIDTH];
+// Last converted line : destination lines that sample the same source line are copied, not converted again
+static unsigned int g_LineOut[FB_RENDER_MAX_WIDTH];
+
+/*
+ * BT.601 limited range, Q6 fixed point.
+ * 74 = 1.164*64, 102 = 1.596*64, 25 = 0.391*64, 52 = 0.813*64, 129 = 2.018*64
+ */
+static inline unsigned char clamp_u8(int v)
+{
+	return (v < 0) ? 0 : ((v > 255) ? 255 : (unsigned char)v);
+}
+
+/* one pixel, each component cut to its width (drop = 8 - length) and put at its offset. Called with constants
+ * for the usual layouts, so that the shifts fold into the code */
+static inline unsigned int yuv_to_pixel(int y, int u, int v, int r_off, int g_off, int b_off, int r_drop, int g_drop, int b_drop)
+{
+	int c = 74 * (y - 16);
+	int d = u - 128;
+	int e = v - 128;
+	unsigned int r = clamp_u8((c + 102 * e + 32) >> 6);
+	unsigned int g = clamp_u8((c - 25 * d - 52 * e + 32) >> 6);
+	unsigned int b = clamp_u8((c + 129 * d + 32) >> 6);
+
+	return ((r >> r_drop) << r_off) | ((g >> g_drop) << g_off) | ((b >> b_drop) << b_off);
+}
+
+static void yuv_to_rgb16_line(const unsigned char *y, const unsigned char *u, const unsigned char *v, unsigned short *dst, int n)
+{
+	// in registers : the stores through dst could alias g_Fb
+	const int r_drop = 8 - g_Fb.r_len, g_drop = 8 - g_Fb.g_len, b_drop = 8 - g_Fb.b_len;
+	const int r_off = g_Fb.r_off, g_off = g_Fb.g_off, b_off = g_Fb.b_off;
+	int i = 0;
+
+#ifdef __ARM_NEON__
+	const int rgb565 = g_Fb.rgb565;
+
+	for( ; rgb565 && i + 8 <= n; i += 8 )
+	{
+		int16x8_t c = vreinterpretq_s16_u16(vsubl_u8(vld1_u8(y + i), vdup_n_u8(16)));
+		int16x8_t d = vreinterpretq_s16_u16(vsubl_u8(vld1_u8(u + i), vdup_n_u8(128)));
+		int16x8_t e = vreinterpretq_s16_u16(vsubl_u8(vld1_u8(v + i), vdup_n_u8(128)));
+		int16x8_t yy = vmulq_n_s16(c, 74);
+		uint8x8_t r = vqrshrun_n_s16(vqaddq_s16(yy, vmulq_n_s16(e, 102)), 6);
+		uint8x8_t g = vqrshrun_n_s16(vqsubq_s16(yy, vaddq_s16(vmulq_n_s16(d, 25), vmulq_n_s16(e, 52))), 6);
+		uint8x8_t b = vqrshrun_n_s16(vqaddq_s16(yy, vmulq_n_s16(d, 129)), 6);
+		uint16x8_t rgb;
+
+		// the top 5 bits are red for RGB565, blue for BGR565
+		rgb = vshll_n_u8((rgb565 == 1) ? r : b, 8);
+		rgb = vsriq_n_u16(rgb, vshll_n_u8(g, 8), 5);
+		rgb = vsriq_n_u16(rgb, vshll_n_u8((rgb565 == 1) ? b : r, 8), 11);
+		vst1q_u16(dst + i, rgb);
+	}
+#endif
+
+	if( r_off == 11 && g_off == 5 && b_off == 0 && r_drop == 3 && g_drop == 2 && b_drop == 3 )
+	{
+		for( ; i < n; i++ )
+			dst[i] = (unsigned short)yuv_to_pixel( y[i], u[i], v[i], 11, 5, 0, 3, 2, 3 );
+	}
+	else
+	{
+		for( ; i < n; i++ )
+			dst[i] = (unsigned short)yuv_to_pixel( y[i], u[i], v[i], r_off, g_off, b_off, r_drop, g_drop, b_drop );
+	}
+}
+
+static void yuv_to_rgb32_line(const unsigned char *y, const unsigned char *u, const unsigned char *v, unsigned int *dst, int n)
+{
+	// in registers : the stores through dst could alias g_Fb
+	const int r_off = g_Fb.r_off, g_off = g_Fb.g_off, b_off = g_Fb.b_off;
+	const unsigned int opaque = g_Fb.opaque;
+	int i = 0;
+
+#ifdef __ARM_NEON__
+	// byte lanes of a (little endian) pixel : offset / 8, the one left over is alpha
+	int ri = r_off >> 3, gi = g_off >> 3, bi = b_off >> 3;
+
+	for( ; i + 8 <= n; i += 8 )
+	{
+		int16x8_t c = vreinterpretq_s16_u16(vsubl_u8(vld1_u8(y + i), vdup_n_u8(16)));
+		int16x8_t d = vreinterpretq_s16_u16(vsubl_u8(vld1_u8(u + i), vdup_n_u8(128)));
+		int16x8_t e = vreinterpretq_s16_u16(vsubl_u8(vld1_u8(v + i), vdup_n_u8(128)));
+		int16x8_t yy = vmulq_n_s16(c, 74);
+		uint8x8x4_t px;
+
+		px.val[ri] = vqrshrun_n_s16(vqaddq_s16(yy, vmulq_n_s16(e, 102)), 6);
+		px.val[gi] = vqrshrun_n_s16(vqsubq_s16(yy, vaddq_s16(vmulq_n_s16(d, 25), vmulq_n_s16(e, 52))), 6);
+		px.val[bi] = vqrshrun_n_s16(vqaddq_s16(yy, vmulq_n_s16(d, 129)), 6);
+		px.val[6 - ri - gi - bi] = vdup_n_u8(0xFF);
+		vst4_u8((unsigned char*)(dst + i), px);
+	}
+#endif
+
+	if( r_off == 16 && g_off == 8 && b_off == 0 )
+	{
+		for( ; i < n; i++ )
+			dst[i] = yuv_to_pixel( y[i], u[i], v[i], 16, 8, 0, 0, 0, 0 ) | opaque;
+	}
+	else
+	{
+		for( ; i < n; i++ )
+			dst[i] = yuv_to_pixel( y[i], u[i], v[i], r_off, g_off, b_off, 0, 0, 0 ) | opaque;
+	}
+}
+
+static void build_xmap(int src_x, int src_w, int dst_w)
+{
+	unsigned int step, pos;
+	int i;
+
+	if( g_XMapKey[0] == src_x && g_XMapKey[1] == src_w && g_XMapKey[2] == dst_w )
+		return;
+
+	step = ((unsigned int)src_w << 16) / (unsigned int)dst_w;
+	pos = step >> 1;
+	for( i = 0; i < dst_w; i++ )
+	{
+		g_XMap[i] = (unsigned short)(src_x + (pos >> 16));
+		pos += step;
+	}
+
+	g_XMapKey[0] = src_x;
+	g_XMapKey[1] = src_w;
+	g_XMapKey[2] = dst_w;
+}
+
+// src_w == dst_w : no resampling, the source line is split into the line buffers as it is
+static void split_line(const unsigned char *yrow, const unsigned char *uvrow, int cx, int n, int with_uv)
+{
+	int i = 0;
+
+	memcpy( g_LineY, yrow, n );
+	if( !with_uv )
+		return;
+
+	uvrow += cx & ~1;
+	if( cx & 1 )
+	{
+		// odd start : the first pixel shares the chroma pair of the one before it
+		g_LineU[0] = uvrow[0];
+		g_LineV[0] = uvrow[1];
+		uvrow += 2;
+		i = 1;
+	}
+
+#ifdef __ARM_NEON__
+	for( ; i + 16 <= n; i += 16 )
+	{
+		uint8x8x2_t c = vld2_u8(uvrow);
+		uint8x8x2_t u = { { c.val[0], c.val[0] } };
+		uint8x8x2_t v = { { c.val[1], c.val[1] } };
+
+		vst2_u8(g_LineU + i, u);
+		vst2_u8(g_LineV + i, v);
+		uvrow += 16;
+	}
+#endif
+
+	for( ; i + 2 <= n; i += 2 )
+	{
+		g_LineU[i] = g_LineU[i + 1] = uvrow[0];
+		g_LineV[i] = g_LineV[i + 1] = uvrow[1];
+		uvrow += 2;
+	}
+	if( i < n )
+	{
+		g_LineU[i] = uvrow[0];
+		g_LineV[i] = uvrow[1];
+	}
+}
+
+// src_w != dst_w : nearest neighbour through the column table
+static void sample_line(const unsigned char *yrow, const unsigned char *uvrow, int n, int with_uv)
+{
+	int dx;
+
+	for( dx = 0; dx < n; dx++ )
+		g_LineY[dx] = yrow[g_XMap[dx]];
+	if( !with_uv )
+		return;
+
+	for( dx = 0; dx < n; dx++ )
+	{
+		unsigned int cx = g_XMap[dx] & ~1u;
+
+		g_LineU[dx] = uvrow[cx];
+		g_LineV[dx] = uvrow[cx + 1];
+	}
+}
+
+static void fill_rect(unsigned char *base, int x, int y, int w, int h, int bytespp)
+{
+	int r;
+
+	if( w <= 0 || h <= 0 )
+		return;
+
+	for( r = 0; r < h; r++ )
+	{
+		unsigned char *p = base + (y + r) * g_Fb.fix.line_length + x * bytespp;
+
+		if( bytespp == 4 )
+		{
+			// opaque black : alpha (or the unused byte) set, R, G and B clear
+			unsigned int *q = (unsigned int*)p;
+			int n = w;
+			while( n-- )
+				*q++ = g_Fb.opaque;
+		}
+		else
+			memset( p, 0, w * bytespp );
+	}
+}
+
+/* pixel layout of the frame buffer from var.red/green/blue, -1 : a layout the converters cannot write */
+static int fb_format(void)
+{
+	struct fb_var_screeninfo *var = &g_Fb.var;
+	int bpp = (int)var->bits_per_pixel;
+
+	if( bpp != 16 && bpp != 32 )
+		return -1;
+
+	g_Fb.r_off = var->red.offset;
+	g_Fb.g_off = var->green.offset;
+	g_Fb.b_off = var->blue.offset;
+	g_Fb.r_len = var->red.length;
+	g_Fb.g_len = var->green.length;
+	g_Fb.b_len = var->blue.length;
+	if( g_Fb.r_len == 0 && g_Fb.g_len == 0 && g_Fb.b_len == 0 )
+	{
+		// the driver does not tell : RGB565 / ARGB8888, as this path always assumed
+		g_Fb.r_off = (bpp == 16) ? 11 : 16;
+		g_Fb.g_off = (bpp == 16) ? 5 : 8;
+		g_Fb.b_off = 0;
+		g_Fb.r_len = g_Fb.b_len = (bpp == 16) ? 5 : 8;
+		g_Fb.g_len = (bpp == 16) ? 6 : 8;
+	}
+
+	if( bpp == 32 )
+	{
+		// whole bytes only, three different ones
+		if( g_Fb.r_len != 8 || g_Fb.g_len != 8 || g_Fb.b_len != 8 || ((g_Fb.r_off | g_Fb.g_off | g_Fb.b_off) & 7)
+			|| g_Fb.r_off > 24 || g_Fb.g_off > 24 || g_Fb.b_off > 24
+			|| g_Fb.r_off == g_Fb.g_off || g_Fb.r_off == g_Fb.b_off || g_Fb.g_off == g_Fb.b_off )
+			return -1;
+		g_Fb.opaque = ~((0xFFu << g_Fb.r_off) | (0xFFu << g_Fb.g_off) | (0xFFu << g_Fb.b_off));
+	}
+	else
+	{
+		if( g_Fb.r_len < 1 || g_Fb.r_len > 8 || g_Fb.g_len < 1 || g_Fb.g_len > 8 || g_Fb.b_len < 1 || g_Fb.b_len > 8
+			|| g_Fb.r_off + g_Fb.r_len > 16 || g_Fb.g_off + g_Fb.g_len > 16 || g_Fb.b_off + g_Fb.b_len > 16 )
+			return -1;
+		g_Fb.opaque = 0;
+		g_Fb.rgb565 = 0;
+		if( g_Fb.r_len == 5 && g_Fb.g_len == 6 && g_Fb.b_len == 5 && g_Fb.g_off == 5 )
+		{
+			if( g_Fb.r_off == 11 && g_Fb.b_off == 0 )
+				g_Fb.rgb565 = 1;
+			else if( g_Fb.r_off == 0 && g_Fb.b_off == 11 )
+				g_Fb.rgb565 = 2;
+		}
+	}
+	return 0;
+}
+
+int tcc_fb_render_open(void)
+{
+	if( g_Fb.fd >= 0 )
+		return 0;
+
+	g_Fb.fd = open( FB_RENDER_DEV, O_RDWR );
+	if( g_Fb.fd < 0 )
+	{
+		ErrorPrint( "Error opening %s", FB_RENDER_DEV );
+		return -1;
+	}
+
+	if( ioctl( g_Fb.fd, FBIOGET_VSCREENINFO, &g_Fb.var ) < 0 || ioctl( g_Fb.fd, FBIOGET_FSCREENINFO, &g_Fb.fix ) < 0 )
+	{
+		ErrorPrint( "FB screeninfo IOCTL ERROR" );
+		goto fail;
+	}
+
+	if( fb_format() < 0 )
+	{
+		ErrorPrint( "unsupported FB format %d bpp, R %d/%d G %d/%d B %d/%d", g_Fb.var.bits_per_pixel,
+					g_Fb.var.red.offset, g_Fb.var.red.length, g_Fb.var.green.offset, g_Fb.var.green.length,
+					g_Fb.var.blue.offset, g_Fb.var.blue.length );
+		goto fail;
+	}
+
+	// try to get a second page for tear-free pan, fall back to single buffer
+	if( g_Fb.var.yres_virtual < g_Fb.var.yres * 2 )
+	{
+		struct fb_var_screeninfo var = g_Fb.var;
+
+		var.yres_virtual = var.yres * 2;
+		if( ioctl( g_Fb.fd, FBIOPUT_VSCREENINFO, &var ) == 0 )
+			ioctl( g_Fb.fd, FBIOGET_VSCREENINFO, &g_Fb.var );
+		ioctl( g_Fb.fd, FBIOGET_FSCREENINFO, &g_Fb.fix );
+	}
+	g_Fb.pages = ( g_Fb.var.yres_virtual >= g_Fb.var.yres * 2 && g_Fb.fix.smem_len >= g_Fb.fix.line_length * g_Fb.var.yres * 2 ) ? 2 : 1;
+	g_Fb.page = g_Fb.var.yoffset / (g_Fb.var.yres ? g_Fb.var.yres : 1);
+	if( g_Fb.page >= g_Fb.pages )
+		g_Fb.page = 0;
+
+	g_Fb.memlen = g_Fb.fix.line_length * g_Fb.var.yres * g_Fb.pages;
+	g_Fb.mem = (unsigned char*)mmap( NULL, g_Fb.memlen, PROT_READ | PROT_WRITE, MAP_SHARED, g_Fb.fd, 0 );
+	if( g_Fb.mem == MAP_FAILED )
+	{
+		ErrorPrint( "FB mmap fail" );
+		g_Fb.mem = NULL;
+		goto fail;
+	}
+
+	memset( g_Fb.layout, 0xFF, sizeof(g_Fb.layout) );
+	DebugPrint( "FB %dx%d %dbpp (R@%d G@%d B@%d), %d page(s)", g_Fb.var.xres, g_Fb.var.yres, g_Fb.var.bits_per_pixel,
+				g_Fb.r_off, g_Fb.g_off, g_Fb.b_off, g_Fb.pages );
+	return 0;
+
+fail:
+	close( g_Fb.fd );
+	g_Fb.fd = -1;
+	return -1;
+}
+
+void tcc_fb_render_close(void)
+{
+	if( g_Fb.mem != NULL )
+	{
+		munmap( g_Fb.mem, g_Fb.memlen );
+		g_Fb.mem = NULL;
+	}
+	if( g_Fb.fd >= 0 )
+	{
+		close( g_Fb.fd );
+		g_Fb.fd = -1;
+	}
+}
+
+int tcc_fb_render_is_open(void)
+{
+	return (g_Fb.fd >= 0);
+}
+
+/* cuts the part of a destination span outside [0, limit) and the share of the source span it would have shown.
+ * *dst_len = 0 : nothing left */
+static void clip_span(int *src_pos, int *src_len, int *dst_pos, int *dst_len, int limit)
+{
+	int lead = (*dst_pos < 0) ? -*dst_pos : 0;
+	int tail = (*dst_pos + *dst_len > limit) ? *dst_pos + *dst_len - limit : 0;
+	int s_lead, s_tail;
+
+	if( lead == 0 && tail == 0 )
+		return;
+	if( lead + tail >= *dst_len )
+	{
+		*dst_len = 0;
+		return;
+	}
+
+	s_lead = (int)(((long long)lead * *src_len + (*dst_len >> 1)) / *dst_len);
+	s_tail = (int)(((long long)tail * *src_len + (*dst_len >> 1)) / *dst_len);
+	// a visible destination pixel always has a source pixel
+	if( s_lead >= *src_len )
+		s_lead = *src_len - 1;
+	if( s_lead + s_tail >= *src_len )
+		s_tail = *src_len - s_lead - 1;
+
+	*src_pos += s_lead;
+	*src_len -= s_lead + s_tail;
+	*dst_pos += lead;
+	*dst_len -= lead + tail;
+}
+
+int tcc_fb_render_frame(const unsigned char *y, const unsigned char *uv, int stride,
+						int src_x, int src_y, int src_w, int src_h,
+						int dst_x, int dst_y, int dst_w, int dst_h)
+{
+	unsigned int back;
+	unsigned char *base;
+	int bytespp;
+	int dy;
+	int next_sy, prev_sy = -1, cache_sy = -1;
+	int with_uv;
+#ifdef DEBUG_MODE
+	struct timespec t0, t1;
+	clock_gettime( CLOCK_MONOTONIC, &t0 );
+#endif
+
+	if( g_Fb.fd < 0 || g_Fb.mem == NULL || y == NULL || uv == NULL )
+		return -1;
+	if( src_w <= 0 || src_h <= 0 || src_x < 0 || src_y < 0 )
+		return -1;
+
+	if( dst_w <= 0 || dst_h <= 0 )
+		return -1;
+
+	// clip the destination window to the screen and crop the source with it : a window partly off screen is cut, not squashed
+	clip_span( &src_x, &src_w, &dst_x, &dst_w, (int)g_Fb.var.xres );
+	clip_span( &src_y, &src_h, &dst_y, &dst_h, (int)g_Fb.var.yres );
+	if( dst_w > FB_RENDER_MAX_WIDTH )
+		clip_span( &src_x, &src_w, &dst_x, &dst_w, dst_x + FB_RENDER_MAX_WIDTH );
+	if( dst_w <= 0 || dst_h <= 0 )
+		return -1;
+
+	bytespp = g_Fb.var.bits_per_pixel >> 3;
+	back = (g_Fb.pages == 2) ? (g_Fb.page ^ 1) : g_Fb.page;
+	base = g_Fb.mem + back * g_Fb.var.yres * g_Fb.fix.line_length;
+
+	// letterbox : black out the borders once whenever the window moves, the picture covers the rest
+	if( g_Fb.layout[back][0] != dst_x || g_Fb.layout[back][1] != dst_y || g_Fb.layout[back][2] != dst_w || g_Fb.layout[back][3] != dst_h )
+	{
+		int xres = (int)g_Fb.var.xres;
+		int yres = (int)g_Fb.var.yres;
+
+		fill_rect( base, 0, 0, xres, dst_y, bytespp );
+		fill_rect( base, 0, dst_y + dst_h, xres, yres - dst_y - dst_h, bytespp );
+		fill_rect( base, 0, dst_y, dst_x, dst_h, bytespp );
+		fill_rect( base, dst_x + dst_w, dst_y, xres - dst_x - dst_w, dst_h, bytespp );
+		g_Fb.layout[back][0] = dst_x;
+		g_Fb.layout[back][1] = dst_y;
+		g_Fb.layout[back][2] = dst_w;
+		g_Fb.layout[back][3] = dst_h;
+	}
+
+	if( src_w != dst_w )
+		build_xmap( src_x, src_w, dst_w );
+
+	next_sy = src_y + (int)(((unsigned int)src_h >> 1) / (unsigned int)dst_h);
+	for( dy = 0; dy < dst_h; dy++ )
+	{
+		int sy = next_sy;
+		unsigned char *dst = base + (dst_y + dy) * g_Fb.fix.line_length + dst_x * bytespp;
+		unsigned char *out;
+
+		next_sy = src_y + (int)(((unsigned int)(dy + 1) * (unsigned int)src_h + ((unsigned int)src_h >> 1)) / (unsigned int)dst_h);
+
+		// upscaled : the line converted for the previous destination line is copied again
+		if( sy == cache_sy )
+		{
+			memcpy( dst, g_LineOut, dst_w * bytespp );
+			continue;
+		}
+
+		// two luma lines share one chroma line in NV12 : U/V are kept from the line before
+		with_uv = prev_sy < 0 || (sy >> 1) != (prev_sy >> 1);
+		if( src_w == dst_w )
+			split_line( y + sy * stride + src_x, uv + (sy >> 1) * stride, src_x, dst_w, with_uv );
+		else
+			sample_line( y + sy * stride, uv + (sy >> 1) * stride, dst_w, with_uv );
+		prev_sy = sy;
+
+		// convert straight into the frame buffer unless the next line repeats this one
+		out = (dy + 1 < dst_h && next_sy == sy) ? (unsigned char*)g_LineOut : dst;
+		if( bytespp == 2 )
+			yuv_to_rgb16_line( g_LineY, g_LineU, g_LineV, (unsigned short*)out, dst_w );
+		else
+			yuv_to_rgb32_line( g_LineY, g_LineU, g_LineV, (unsigned int*)out, dst_w );
+		if( out != dst )
+		{
+			memcpy( dst, g_LineOut, dst_w * bytespp );
+			cache_sy = sy;
+		}
+	}
+
+	if( g_Fb.pages == 2 )
+	{
+		g_Fb.var.xoffset = 0;
+		g_Fb.var.yoffset = back * g_Fb.var.yres;
+		if( ioctl( g_Fb.fd, FBIOPAN_DISPLAY, &g_Fb.var ) < 0 )
+		{
+			ErrorPrint( "FBIOPAN_DISPLAY fail" );
+			return -1;
+		}
+		g_Fb.page = back;
+	}
+
+#ifdef DEBUG_MODE
+	clock_gettime( CLOCK_MONOTONIC, &t1 );
+	DebugPrint( "render %dx%d -> %dx%d : %ld us", src_w, src_h, dst_w, dst_h,
+				(long)((t1.tv_sec - t0.tv_sec) * 1000000 + (t1.tv_nsec - t0.tv_nsec) / 1000) );
+#endif
+
+	return 0;
+}
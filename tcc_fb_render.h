@@ -0,0 +1,29 @@
+//********************************************************************************************
+/**
+ * @file        tcc_fb_render.h
+ * @brief		Software render path to the frame buffer, used when the overlay driver is not available.
+ * 				This interface contain : Open FB, Convert NV12 frame to FB format with letterbox scaling, Close FB.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+#ifndef	__TCC_FB_RENDER_H__
+#define	__TCC_FB_RENDER_H__
+
+#define FB_RENDER_DEV		"/dev/fb0"
+#define FB_RENDER_MAX_WIDTH	2048	/* longest destination line the line buffers can hold */
+
+int tcc_fb_render_open(void);
+void tcc_fb_render_close(void);
+int tcc_fb_render_is_open(void);
+
+/* y/uv      : virtual addresses of the NV12 planes
+ * stride    : luma stride in bytes, the chroma plane uses the same stride
+ * src_x/y/w/h : visible (cropped) area of the source frame
+ * dst_x/y/w/h : destination window on the frame buffer, the rest of the screen is blacked out */
+int tcc_fb_render_frame(const unsigned char *y, const unsigned char *uv, int stride,
+						int src_x, int src_y, int src_w, int src_h,
+						int dst_x, int dst_y, int dst_w, int dst_h);
+
+#endif	// __TCC_FB_RENDER_H__
@@ -0,0 +1,362 @@
+//********************************************************************************************
+/**
+ * @file        tcc_file_player.c
+ * @brief		Local H.264 Annex-B file player, decodes straight from a memory mapping of the file.
+ * 				This interface contain : Open file and build AU index, Play, Stop, Close.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tcc_file_player.h"
+#include "tcc_vdec_api.h"
+
+//#define	DEBUG_MODE
+#ifdef	DEBUG_MODE
+	#define	DebugPrint( fmt, ... )	printf( "[TCC_FILE_PLAYER](D):"fmt"\n", ##__VA_ARGS__ )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_FILE_PLAYER](E):"fmt"\n", ##__VA_ARGS__ )
+#else
+	#define	DebugPrint( fmt, ... )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_FILE_PLAYER](E):"fmt"\n", ##__VA_ARGS__ )
+#endif
+
+/* returns the position of the next "00 00 01", or end */
+static const unsigned char* find_start_code(const unsigned char *p, const unsigned char *end)
+{
+	// a start code can only end on a byte <= 1, so step by 3 while the third byte is bigger
+	while( p + 3 <= end )
+	{
+		if( p[2] > 1 )
+			p += 3;
+		else if( p[2] == 1 && p[1] == 0 && p[0] == 0 )
+			return p;
+		else
+			p++;
+	}
+	return end;
+}
+
+/* Exp-Golomb ue(v) over the first bytes of a slice header, emulation prevention bytes skipped */
+typedef struct _BitReader {
+	const unsigned char *p;
+	const unsigned char *end;
+	int zeros;
+	int bit;
+} BitReader;
+
+static int br_bit(BitReader *br)
+{
+	int v;
+
+	if( br->p >= br->end )
+		return 0;
+	if( br->bit == 0 && br->zeros >= 2 && *br->p == 0x03 )
+	{
+		br->p++;
+		br->zeros = 0;
+		if( br->p >= br->end )
+			return 0;
+	}
+	v = (*br->p >> (7 - br->bit)) & 1;
+	if( ++br->bit == 8 )
+	{
+		br->zeros = (*br->p == 0) ? br->zeros + 1 : 0;
+		br->bit = 0;
+		br->p++;
+	}
+	return v;
+}
+
+static unsigned int br_ue(BitReader *br)
+{
+	int lz = 0, i;
+	unsigned int v = 0;
+
+	while( lz < 31 && br_bit(br) == 0 )
+		lz++;
+	for( i = 0; i < lz; i++ )
+		v = (v << 1) | br_bit(br);
+	return ((1u << lz) - 1) + v;
+}
+
+static int build_index(FilePlayer *player)
+{
+	const unsigned char *base = player->map;
+	const unsigned char *end = player->map + player->size;
+	const unsigned char *p = find_start_code( base, end );
+	unsigned int cap = 0;
+	int seen_vcl = 0;
+	FilePlayerAU *cur = NULL;
+
+	while( p < end )
+	{
+		const unsigned char *nal = p + 3;
+		const unsigned char *next = find_start_code( nal, end );
+		const unsigned char *start = (p > base && p[-1] == 0) ? p - 1 : p;	// keep the 4 byte start code
+		int type, new_au = 0;
+
+		if( nal >= end )
+			break;
+		type = nal[0] & 0x1F;
+
+		if( type == 1 || type == 5 )
+		{
+			// first_mb_in_slice == 0 starts a new picture
+			if( seen_vcl && nal + 1 < end && (nal[1] & 0x80) )
+				new_au = 1;
+		}
+		else if( (type >= 6 && type <= 9) || (type >= 14 && type <= 18) )
+		{
+			if( seen_vcl )
+				new_au = 1;
+		}
+
+		if( cur == NULL || new_au )
+		{
+			if( player->au_cnt == cap )
+			{
+				unsigned int ncap = cap ? cap * 2 : 1024;
+				FilePlayerAU *au = (FilePlayerAU*)realloc( player->au, ncap * sizeof(FilePlayerAU) );
+				if( au == NULL )
+					return -1;
+				player->au = au;
+				cap = ncap;
+			}
+			cur = &player->au[player->au_cnt++];
+			cur->offset = (uint32_t)(start - base);
+			cur->flags = 0;
+			seen_vcl = 0;
+		}
+
+		if( type == 7 || type == 8 )
+			cur->flags |= FILE_PLAYER_AU_HEADER;
+		if( type == 1 || type == 5 )
+		{
+			if( !seen_vcl )
+			{
+				BitReader br;
+				unsigned int slice_type;
+
+				br.p = nal + 1;
+				br.end = next;
+				br.zeros = 0;
+				br.bit = 0;
+				br_ue( &br );				// first_mb_in_slice
+				slice_type = br_ue( &br ) % 5;
+				if( slice_type == 2 || slice_type == 4 )	// I / SI
+					cur->flags |= FILE_PLAYER_AU_INTRA;
+			}
+			if( type == 5 )
+				cur->flags |= FILE_PLAYER_AU_IDR | FILE_PLAYER_AU_INTRA;
+			seen_vcl = 1;
+		}
+
+		p = next;
+	}
+
+	// sizes from the next AU start
+	{
+		unsigned int i;
+
+		for( i = 0; i < player->au_cnt; i++ )
+		{
+			uint32_t stop = (i + 1 < player->au_cnt) ? player->au[i+1].offset : (uint32_t)player->size;
+			player->au[i].size = stop - player->au[i].offset;
+			if( player->au[i].flags & FILE_PLAYER_AU_INTRA )
+				player->intra_cnt++;
+		}
+	}
+
+	return 0;
+}
+
+FilePlayer* tcc_file_player_open(const char *path)
+{
+	FilePlayer *player;
+	struct stat st;
+
+	player = (FilePlayer*)calloc( 1, sizeof(FilePlayer) );
+	if( player == NULL )
+		return NULL;
+	player->speed = 1;
+
+	player->fd = open( path, O_RDONLY );
+	if( player->fd < 0 )
+	{
+		ErrorPrint( "Cannot open '%s'", path );
+		free( player );
+		return NULL;
+	}
+	if( fstat( player->fd, &st ) < 0 || st.st_size < 4 || (unsigned long long)st.st_size > 0xFFFFFFFFull )
+	{
+		ErrorPrint( "'%s' : bad size", path );
+		goto fail;
+	}
+	player->size = (size_t)st.st_size;
+
+	// read-only : the decoder never writes into the access units it is given
+	player->map = (unsigned char*)mmap( NULL, player->size, PROT_READ, MAP_PRIVATE, player->fd, 0 );
+	if( player->map == MAP_FAILED )
+	{
+		player->map = NULL;
+		ErrorPrint( "mmap fail" );
+		goto fail;
+	}
+	madvise( player->map, player->size, MADV_SEQUENTIAL );
+
+	if( build_index( player ) < 0 || player->au_cnt == 0 )
+	{
+		ErrorPrint( "'%s' : no access unit found", path );
+		goto fail;
+	}
+
+	DebugPrint( "'%s' : %d AUs, %d intra", path, player->au_cnt, player->intra_cnt );
+	return player;
+
+fail:
+	tcc_file_player_close( player );
+	return NULL;
+}
+
+void tcc_file_player_close(FilePlayer *player)
+{
+	if( player == NULL )
+		return;
+	if( player->map != NULL )
+		munmap( player->map, player->size );
+	if( player->fd >= 0 )
+		close( player->fd );
+	free( player->au );
+	free( player );
+}
+
+static void timespec_add_ns(struct timespec *t, long long ns)
+{
+	ns += t->tv_nsec;
+	t->tv_sec += (time_t)(ns / 1000000000LL);
+	t->tv_nsec = (long)(ns % 1000000000LL);
+}
+
+static long long elapsed_ns(const struct timespec *base)
+{
+	struct timespec now;
+
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	return (long long)(now.tv_sec - base->tv_sec) * 1000000000LL + (now.tv_nsec - base->tv_nsec);
+}
+
+static void sleep_until(const struct timespec *t)
+{
+	while( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, t, NULL ) == EINTR )
+		;
+}
+
+/* first AU from i on a decoder can start from : an I picture, or the parameter sets in front of one */
+static unsigned int next_intra(const FilePlayer *player, unsigned int i)
+{
+	while( i < player->au_cnt && !(player->au[i].flags & (FILE_PLAYER_AU_INTRA | FILE_PLAYER_AU_HEADER)) )
+		i++;
+	return i;
+}
+
+int tcc_file_player_play(FilePlayer *player, int fps)
+{
+	struct timespec next, base;
+	long period_ns = 0;
+	unsigned int i, base_au = 0, next_au = 0;
+	int speed = 1, trick_fps;
+	long long au_ns;
+	int count = 0;
+
+	if( player == NULL )
+		return -1;
+
+	player->stop = 0;
+	if( fps > 0 )
+	{
+		period_ns = 1000000000L / fps;
+		clock_gettime( CLOCK_MONOTONIC, &next );
+	}
+	// without pacing the AU count is the media clock of the trick play
+	trick_fps = (fps > 0) ? fps : VDEC_TRICK_NOMINAL_FPS;
+
+	for( i = 0; i < player->au_cnt && !player->stop; i++ )
+	{
+		if( player->speed != speed )
+		{
+			// back from trick play : the P pictures after the last I fed reference pictures that were skipped
+			if( speed > 1 && player->speed <= 1 )
+			{
+				i = next_intra( player, i );
+				if( i >= player->au_cnt )
+					break;
+			}
+			// both clocks restart from here at the new speed
+			speed = player->speed;
+			base_au = next_au = i;
+			clock_gettime( CLOCK_MONOTONIC, &base );
+			next = base;
+		}
+
+		if( speed > 1 )
+		{
+			// the AU the speed has reached by now, and not closer than the minimum interval to the last one
+			if( fps > 0 )
+			{
+				unsigned int now_au = base_au + (unsigned int)(elapsed_ns( &base ) * trick_fps * speed / 1000000000LL);
+				if( now_au > next_au )
+					next_au = now_au;
+			}
+			i = next_intra( player, (next_au > i) ? next_au : i );
+			if( i >= player->au_cnt )
+				break;
+
+			if( fps > 0 )
+			{
+				au_ns = (long long)(i - base_au) * 1000000000LL / ((long long)trick_fps * speed);
+				next = base;
+				timespec_add_ns( &next, au_ns );
+				sleep_until( &next );
+			}
+			tcc_vdec_process( player->map + player->au[i].offset, (int)player->au[i].size );
+			count++;
+			next_au = i + 1 + (unsigned int)(trick_fps * speed * VDEC_TRICK_MIN_INTERVAL_MS / 1000);
+			continue;
+		}
+
+		tcc_vdec_process( player->map + player->au[i].offset, (int)player->au[i].size );
+		count++;
+
+		if( period_ns )
+		{
+			// absolute deadlines : a slow frame does not shift the ones after it
+			timespec_add_ns( &next, period_ns );
+			sleep_until( &next );
+		}
+	}
+
+	return count;
+}
+
+void tcc_file_player_stop(FilePlayer *player)
+{
+	if( player != NULL )
+		player->stop = 1;
+}
+
+void tcc_file_player_set_speed(FilePlayer *player, int speed)
+{
+	if( player != NULL )
+		player->speed = speed;
+}
@@ -0,0 +1,51 @@
+//********************************************************************************************
+/**
+ * @file        tcc_file_player.h
+ * @brief		Local H.264 Annex-B file player, decodes straight from a memory mapping of the file.
+ * 				This interface contain : Open file and build AU index, Play, Stop, Close.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+#ifndef	__TCC_FILE_PLAYER_H__
+#define	__TCC_FILE_PLAYER_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* access unit flags */
+#define FILE_PLAYER_AU_IDR		(1<<0)	/* contains an IDR slice */
+#define FILE_PLAYER_AU_INTRA	(1<<1)	/* first slice is an I slice (IDR or not) */
+#define FILE_PLAYER_AU_HEADER	(1<<2)	/* contains SPS/PPS */
+
+typedef struct _FilePlayerAU {
+	uint32_t	offset;		//from the start of the file, start code included
+	uint32_t	size;
+	uint32_t	flags;		//FILE_PLAYER_AU_xxx
+} FilePlayerAU;
+
+typedef struct _FilePlayer {
+	int				fd;
+	unsigned char	*map;
+	size_t			size;
+	FilePlayerAU	*au;		//access unit index, built once at open
+	unsigned int	au_cnt;
+	unsigned int	intra_cnt;
+	volatile int	stop;
+	volatile int	speed;		//1 : normal, 2.. : trick play on I pictures only
+} FilePlayer;
+
+FilePlayer* tcc_file_player_open(const char *path);
+void tcc_file_player_close(FilePlayer *player);
+
+/* feed every AU to tcc_vdec_process(), blocks until the end of the file or tcc_file_player_stop().
+ * fps > 0 : paced in real time, fps = 0 : as fast as the decoder goes.
+ * returns the number of AUs fed */
+int tcc_file_player_play(FilePlayer *player, int fps);
+void tcc_file_player_stop(FilePlayer *player);
+
+/* any thread, takes effect with the next access unit (see tcc_vdec_SetTrickSpeed) */
+void tcc_file_player_set_speed(FilePlayer *player, int speed);
+
+#endif	// __TCC_FILE_PLAYER_H__
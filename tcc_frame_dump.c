@@ -0,0 +1,282 @@
+//********************************************************************************************
+/**
+ * @file        tcc_frame_dump.c
+ * @brief		Asynchronous dump of decoded frames to disk for field debugging.
+ * 				This interface contain : Start/Stop dump, Queue one decoded frame.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/uio.h>
+
+#include "tcc_frame_dump.h"
+
+//#define	DEBUG_MODE
+#ifdef	DEBUG_MODE
+	#define	DebugPrint( fmt, ... )	printf( "[TCC_FRAME_DUMP](D):"fmt"\n", ##__VA_ARGS__ )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_FRAME_DUMP](E):"fmt"\n", ##__VA_ARGS__ )
+#else
+	#define	DebugPrint( fmt, ... )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_FRAME_DUMP](E):"fmt"\n", ##__VA_ARGS__ )
+#endif
+
+typedef struct _DumpSlot {
+	unsigned char	*buf;
+	unsigned int	cap;
+	unsigned int	len;
+	int				width;
+	int				height;
+} DumpSlot;
+
+static DumpSlot g_Slot[FRAME_DUMP_SLOTS];
+static volatile unsigned int g_Head = 0;	//next slot the decoder fills
+static volatile unsigned int g_Tail = 0;	//next slot the writer stores
+static volatile int g_Running = 0;
+static volatile int g_Stopping = 0;	//signalled, writer not joined yet
+static sem_t g_Sem;
+static pthread_t g_Thread;
+static char g_Prefix[256];
+static FrameDumpStat g_Stat;
+
+static int write_all(int fd, struct iovec *iov, int cnt)
+{
+	while( cnt > 0 )
+	{
+		ssize_t ret = writev( fd, iov, cnt );
+
+		if( ret < 0 )
+		{
+			if( errno == EINTR )
+				continue;
+			return -1;
+		}
+		while( cnt > 0 && (size_t)ret >= iov->iov_len )
+		{
+			ret -= iov->iov_len;
+			iov++;
+			cnt--;
+		}
+		if( cnt > 0 )
+		{
+			iov->iov_base = (char*)iov->iov_base + ret;
+			iov->iov_len -= ret;
+		}
+	}
+	return 0;
+}
+
+static void* dump_thread(void *arg)
+{
+	int fd = -1;
+	int cur_w = 0, cur_h = 0;
+
+	while( 1 )
+	{
+		struct iovec iov[FRAME_DUMP_SLOTS];
+		unsigned int head, tail, n;
+		int cnt = 0;
+
+		if( !g_Running && g_Head == g_Tail )
+			break;
+
+		sem_wait( &g_Sem );
+
+		head = g_Head;
+		tail = g_Tail;
+		__sync_synchronize();
+
+		if( head == tail )
+			continue;
+
+		// one writev for every ready frame of the same size
+		for( n = tail; n != head; n++ )
+		{
+			DumpSlot *slot = &g_Slot[n % FRAME_DUMP_SLOTS];
+
+			if( fd < 0 || slot->width != cur_w || slot->height != cur_h )
+			{
+				char name[300];
+
+				if( cnt > 0 )
+					break;
+				if( fd >= 0 )
+					close( fd );
+				snprintf( name, sizeof(name), "%s_%dx%d.nv12", g_Prefix, slot->width, slot->height );
+				fd = open( name, O_WRONLY | O_CREAT | O_APPEND, 0644 );
+				if( fd < 0 )
+					ErrorPrint( "Cannot open '%s'", name );
+				cur_w = slot->width;
+				cur_h = slot->height;
+			}
+			iov[cnt].iov_base = slot->buf;
+			iov[cnt].iov_len = slot->len;
+			cnt++;
+		}
+
+		if( fd >= 0 && write_all( fd, iov, cnt ) == 0 )
+			__sync_fetch_and_add( &g_Stat.written, cnt );
+		else
+			__sync_fetch_and_add( &g_Stat.dropped, cnt );
+
+		__sync_synchronize();
+		g_Tail = tail + cnt;
+
+		// frames left behind by a size change are handled on the next round
+		if( tail + cnt != head )
+			sem_post( &g_Sem );
+	}
+
+	if( fd >= 0 )
+		close( fd );
+
+	return NULL;
+}
+
+int tcc_frame_dump_start(const char *prefix)
+{
+	if( g_Running )
+		return 0;
+	// the previous writer still drains the slots and owns g_Sem
+	if( g_Stopping )
+		return -1;
+	if( prefix == NULL || prefix[0] == 0 )
+		return -1;
+
+	strncpy( g_Prefix, prefix, sizeof(g_Prefix) - 1 );
+	g_Prefix[sizeof(g_Prefix) - 1] = 0;
+	memset( &g_Stat, 0, sizeof(g_Stat) );
+	g_Head = g_Tail = 0;
+
+	if( sem_init( &g_Sem, 0, 0 ) != 0 )
+		return -1;
+
+	g_Running = 1;
+	if( pthread_create( &g_Thread, NULL, dump_thread, NULL ) != 0 )
+	{
+		ErrorPrint( "dump thread create fail" );
+		g_Running = 0;
+		sem_destroy( &g_Sem );
+		return -1;
+	}
+
+	DebugPrint( "dump start : %s", g_Prefix );
+	return 0;
+}
+
+int tcc_frame_dump_stop_signal(pthread_t *thread)
+{
+	if( !g_Running )
+		return 0;
+
+	g_Running = 0;
+	g_Stopping = 1;
+	sem_post( &g_Sem );
+	*thread = g_Thread;
+	return 1;
+}
+
+void tcc_frame_dump_stop_join(pthread_t thread)
+{
+	int i;
+
+	pthread_join( thread, NULL );
+	sem_destroy( &g_Sem );
+
+	for( i = 0; i < FRAME_DUMP_SLOTS; i++ )
+	{
+		free( g_Slot[i].buf );
+		memset( &g_Slot[i], 0, sizeof(DumpSlot) );
+	}
+
+	__sync_synchronize();
+	g_Stopping = 0;
+
+	DebugPrint( "dump stop : queued %d, written %d, dropped %d", g_Stat.queued, g_Stat.written, g_Stat.dropped );
+}
+
+void tcc_frame_dump_stop(void)
+{
+	pthread_t thread;
+
+	if( tcc_frame_dump_stop_signal( &thread ) )
+		tcc_frame_dump_stop_join( thread );
+}
+
+int tcc_frame_dump_is_running(void)
+{
+	return g_Running;
+}
+
+void tcc_frame_dump_get_stat(FrameDumpStat *stat)
+{
+	memcpy( stat, &g_Stat, sizeof(FrameDumpStat) );
+}
+
+int tcc_frame_dump_push(const unsigned char *y, const unsigned char *uv, int stride,
+						int crop_x, int crop_y, int width, int height)
+{
+	DumpSlot *slot;
+	unsigned char *dst;
+	unsigned int need;
+	int chroma_w, r;
+
+	if( !g_Running || y == NULL || uv == NULL || width <= 0 || height <= 0 )
+		return -1;
+
+	if( g_Head - g_Tail >= FRAME_DUMP_SLOTS )
+	{
+		// writer is behind (slow disk) : drop instead of stalling the decoder
+		__sync_fetch_and_add( &g_Stat.dropped, 1 );
+		return -1;
+	}
+
+	chroma_w = (width + 1) & ~1;
+	need = width * height + chroma_w * ((height + 1) >> 1);
+
+	slot = &g_Slot[g_Head % FRAME_DUMP_SLOTS];
+	if( slot->cap < need )
+	{
+		unsigned char *buf = (unsigned char*)realloc( slot->buf, need );
+		if( buf == NULL )
+		{
+			__sync_fetch_and_add( &g_Stat.dropped, 1 );
+			return -1;
+		}
+		slot->buf = buf;
+		slot->cap = need;
+	}
+
+	// crop and pack : Y plane then interleaved CbCr plane, both with 'stride' in the source
+	dst = slot->buf;
+	for( r = 0; r < height; r++ )
+	{
+		memcpy( dst, y + (crop_y + r) * stride + crop_x, width );
+		dst += width;
+	}
+	for( r = 0; r < ((height + 1) >> 1); r++ )
+	{
+		memcpy( dst, uv + ((crop_y >> 1) + r) * stride + (crop_x & ~1), chroma_w );
+		dst += chroma_w;
+	}
+
+	slot->len = need;
+	slot->width = width;
+	slot->height = height;
+
+	__sync_synchronize();
+	g_Head++;
+	__sync_fetch_and_add( &g_Stat.queued, 1 );
+	sem_post( &g_Sem );
+
+	return 0;
+}
@@ -0,0 +1,40 @@
+//********************************************************************************************
+/**
+ * @file        tcc_frame_dump.h
+ * @brief		Asynchronous dump of decoded frames to disk for field debugging.
+ * 				This interface contain : Start/Stop dump, Queue one decoded frame.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+#ifndef	__TCC_FRAME_DUMP_H__
+#define	__TCC_FRAME_DUMP_H__
+
+#include <pthread.h>
+
+#define FRAME_DUMP_SLOTS		4		/* frames in flight between decode and the writer thread */
+
+typedef struct _FrameDumpStat {
+	unsigned int	queued;		//frames copied into the ring
+	unsigned int	written;	//frames written to disk
+	unsigned int	dropped;	//frames dropped because the writer was behind
+} FrameDumpStat;
+
+/* frames are written as packed NV12 to "<prefix>_<width>x<height>.nv12",
+ * a new file is started whenever the resolution changes */
+int tcc_frame_dump_start(const char *prefix);
+void tcc_frame_dump_stop(void);
+/* stop in two steps, so that the caller's lock is not held while the writer flushes :
+ * signal returns 1 and the writer in 'thread' when one runs, join waits for it outside the lock.
+ * start fails in between */
+int tcc_frame_dump_stop_signal(pthread_t *thread);
+void tcc_frame_dump_stop_join(pthread_t thread);
+int tcc_frame_dump_is_running(void);
+void tcc_frame_dump_get_stat(FrameDumpStat *stat);
+
+/* never blocks : the frame is dropped when no slot is free */
+int tcc_frame_dump_push(const unsigned char *y, const unsigned char *uv, int stride,
+						int crop_x, int crop_y, int width, int height);
+
+#endif	// __TCC_FRAME_DUMP_H__
@@ -0,0 +1,689 @@
+//********************************************************************************************
+/**
+ * @file        tcc_mp4_demux.c
+ * @brief		MP4 (ISO-BMFF) reader for H.264 tracks, feeds samples from a read-only window on the file.
+ * 				This interface contain : Open file and build sample index, Play, Stop, Close.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tcc_mp4_demux.h"
+#include "tcc_vdec_api.h"
+
+//#define	DEBUG_MODE
+#ifdef	DEBUG_MODE
+	#define	DebugPrint( fmt, ... )	printf( "[TCC_MP4_DEMUX](D):"fmt"\n", ##__VA_ARGS__ )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_MP4_DEMUX](E):"fmt"\n", ##__VA_ARGS__ )
+#else
+	#define	DebugPrint( fmt, ... )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_MP4_DEMUX](E):"fmt"\n", ##__VA_ARGS__ )
+#endif
+
+#define FOURCC(a,b,c,d)	(((uint32_t)(a) << 24) | ((uint32_t)(b) << 16) | ((uint32_t)(c) << 8) | (uint32_t)(d))
+
+#define AVC_SAMPLE_ENTRY_SIZE	78	/* VisualSampleEntry fields before the child boxes */
+
+typedef struct _Mp4Box {
+	const unsigned char	*p;		//payload, box header excluded
+	uint64_t			len;
+} Mp4Box;
+
+/* the sample table boxes of one track */
+typedef struct _Mp4Track {
+	uint32_t	handler;
+	uint32_t	timescale;
+	Mp4Box		stsd;
+	Mp4Box		stts;
+	Mp4Box		ctts;
+	Mp4Box		stss;
+	Mp4Box		stsz;
+	Mp4Box		stsc;
+	Mp4Box		stco;
+	int			co64;
+} Mp4Track;
+
+static uint32_t rd16(const unsigned char *p)
+{
+	return ((uint32_t)p[0] << 8) | p[1];
+}
+
+static uint32_t rd32(const unsigned char *p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint64_t rd64(const unsigned char *p)
+{
+	return ((uint64_t)rd32( p ) << 32) | rd32( p + 4 );
+}
+
+/* next box in [*cur, end), returns 0 at the end or on a box that does not fit */
+static int next_box(const unsigned char **cur, const unsigned char *end, uint32_t *type, Mp4Box *box)
+{
+	const unsigned char *p = *cur;
+	uint64_t size, hdr = 8;
+
+	if( end - p < 8 )
+		return 0;
+	size = rd32( p );
+	*type = rd32( p + 4 );
+	if( size == 1 )
+	{
+		if( end - p < 16 )
+			return 0;
+		size = rd64( p + 8 );
+		hdr = 16;
+	}
+	else if( size == 0 )
+	{
+		size = (uint64_t)(end - p);		// up to the end of the parent
+	}
+	if( size < hdr || size > (uint64_t)(end - p) )
+		return 0;
+
+	box->p = p + hdr;
+	box->len = size - hdr;
+	*cur = p + size;
+	return 1;
+}
+
+static void parse_trak(const unsigned char *p, const unsigned char *end, Mp4Track *trak)
+{
+	uint32_t type;
+	Mp4Box box;
+
+	while( next_box( &p, end, &type, &box ) )
+	{
+		switch( type )
+		{
+			case FOURCC('m','d','i','a'):
+			case FOURCC('m','i','n','f'):
+			case FOURCC('s','t','b','l'):
+				parse_trak( box.p, box.p + box.len, trak );
+				break;
+			case FOURCC('m','d','h','d'):
+				if( box.len >= 24 && box.p[0] == 1 )
+					trak->timescale = rd32( box.p + 20 );
+				else if( box.len >= 16 )
+					trak->timescale = rd32( box.p + 12 );
+				break;
+			case FOURCC('h','d','l','r'):
+				if( box.len >= 12 )
+					trak->handler = rd32( box.p + 8 );
+				break;
+			case FOURCC('s','t','s','d'):	trak->stsd = box;	break;
+			case FOURCC('s','t','t','s'):	trak->stts = box;	break;
+			case FOURCC('c','t','t','s'):	trak->ctts = box;	break;
+			case FOURCC('s','t','s','s'):	trak->stss = box;	break;
+			case FOURCC('s','t','s','z'):	trak->stsz = box;	break;
+			case FOURCC('s','t','s','c'):	trak->stsc = box;	break;
+			case FOURCC('s','t','c','o'):	trak->stco = box;	trak->co64 = 0;	break;
+			case FOURCC('c','o','6','4'):	trak->stco = box;	trak->co64 = 1;	break;
+			default:
+				break;
+		}
+	}
+}
+
+/* SPS/PPS lists of avcC as Annex-B, out = NULL only counts. returns the length, -1 if broken */
+static int avcc_to_annexb(const unsigned char *p, const unsigned char *end, unsigned char *out)
+{
+	int list, len = 0;
+
+	for( list = 0; list < 2; list++ )
+	{
+		int i, n;
+
+		if( p >= end )
+			return -1;
+		n = (list == 0) ? (*p++ & 0x1F) : *p++;
+		for( i = 0; i < n; i++ )
+		{
+			uint32_t l;
+
+			if( end - p < 2 )
+				return -1;
+			l = rd16( p );
+			p += 2;
+			if( (uint32_t)(end - p) < l )
+				return -1;
+			if( out != NULL )
+			{
+				out[len] = out[len+1] = out[len+2] = 0;
+				out[len+3] = 1;
+				memcpy( out + len + 4, p, l );
+			}
+			len += 4 + l;
+			p += l;
+		}
+	}
+	return len;
+}
+
+static int parse_stsd(Mp4Demux *mp4, const Mp4Box *stsd)
+{
+	const unsigned char *p, *end;
+	uint32_t type;
+	Mp4Box entry, box;
+
+	if( stsd->len < 8 )
+		return -1;
+	p = stsd->p + 8;	// version/flags, entry_count
+	end = stsd->p + stsd->len;
+
+	// first sample entry only : a track that changes its avcC mid-stream is not supported
+	if( !next_box( &p, end, &type, &entry ) )
+		return -1;
+	if( type != FOURCC('a','v','c','1') && type != FOURCC('a','v','c','3') )
+	{
+		ErrorPrint( "sample entry '%c%c%c%c' is not H.264", type >> 24, (type >> 16) & 0xFF, (type >> 8) & 0xFF, type & 0xFF );
+		return -1;
+	}
+	if( entry.len < AVC_SAMPLE_ENTRY_SIZE )
+		return -1;
+	mp4->width = (int)rd16( entry.p + 24 );
+	mp4->height = (int)rd16( entry.p + 26 );
+
+	p = entry.p + AVC_SAMPLE_ENTRY_SIZE;
+	end = entry.p + entry.len;
+	while( next_box( &p, end, &type, &box ) )
+	{
+		int len;
+
+		if( type != FOURCC('a','v','c','C') )
+			continue;
+		if( box.len < 7 || box.p[0] != 1 )
+			return -1;
+
+		mp4->nal_len_size = (box.p[4] & 0x03) + 1;
+		len = avcc_to_annexb( box.p + 5, box.p + box.len, NULL );
+		if( len <= 0 )
+			return -1;
+		mp4->header = (unsigned char*)malloc( len );
+		if( mp4->header == NULL )
+			return -1;
+		mp4->header_len = avcc_to_annexb( box.p + 5, box.p + box.len, mp4->header );
+		return 0;
+	}
+	return -1;
+}
+
+static int build_index(Mp4Demux *mp4, const Mp4Track *t)
+{
+	uint32_t fixed, cnt, chunk_cnt, stsc_cnt, e, s, max_size = 0;
+	int co_size = t->co64 ? 8 : 4;
+
+	if( t->stsz.len < 12 || t->stco.len < 8 || t->stsc.len < 8 || t->timescale == 0 )
+		return -1;
+
+	fixed = rd32( t->stsz.p + 4 );
+	cnt = rd32( t->stsz.p + 8 );
+	chunk_cnt = rd32( t->stco.p + 4 );
+	stsc_cnt = rd32( t->stsc.p + 4 );
+	if( (fixed == 0 && (t->stsz.len - 12) / 4 < cnt)
+	 || (t->stco.len - 8) / co_size < chunk_cnt
+	 || (t->stsc.len - 8) / 12 < stsc_cnt
+	 || cnt == 0 )
+		return -1;
+
+	mp4->sample = (Mp4Sample*)calloc( cnt, sizeof(Mp4Sample) );
+	if( mp4->sample == NULL )
+		return -1;
+
+	// file offsets : chunks from stco, samples per chunk from stsc, sizes from stsz
+	s = 0;
+	for( e = 0; e < stsc_cnt && s < cnt; e++ )
+	{
+		const unsigned char *ent = t->stsc.p + 8 + e * 12;
+		uint32_t first = rd32( ent );
+		uint32_t per = rd32( ent + 4 );
+		uint32_t last = (e + 1 < stsc_cnt) ? rd32( ent + 12 ) : chunk_cnt + 1;
+		uint32_t c, k;
+
+		for( c = first; c < last && c >= 1 && c <= chunk_cnt && s < cnt; c++ )
+		{
+			const unsigned char *co = t->stco.p + 8 + (c - 1) * co_size;
+			uint64_t off = t->co64 ? rd64( co ) : rd32( co );
+
+			for( k = 0; k < per && s < cnt; k++, s++ )
+			{
+				uint32_t size = fixed ? fixed : rd32( t->stsz.p + 12 + s * 4 );
+
+				// a recording cut short : keep what is really in the file
+				if( off + size > mp4->size )
+					goto truncated;
+				mp4->sample[s].offset = off;
+				mp4->sample[s].size = size;
+				if( size > max_size )
+					max_size = size;
+				off += size;
+			}
+		}
+	}
+truncated:
+	cnt = s;
+	if( cnt == 0 )
+		return -1;
+
+	// composition offsets, kept in pts_ms until the decode times are known
+	if( t->ctts.len >= 8 )
+	{
+		uint32_t n = rd32( t->ctts.p + 4 );
+
+		s = 0;
+		for( e = 0; e < n && (e + 1) * 8 <= t->ctts.len - 8 && s < cnt; e++ )
+		{
+			uint32_t run = rd32( t->ctts.p + 8 + e * 8 );
+			uint32_t offset = rd32( t->ctts.p + 12 + e * 8 );	// signed in version 1
+
+			while( run-- > 0 && s < cnt )
+				mp4->sample[s++].pts_ms = offset;
+		}
+	}
+
+	if( t->stts.len >= 8 )
+	{
+		uint32_t n = rd32( t->stts.p + 4 );
+		uint64_t dts = 0;
+
+		s = 0;
+		for( e = 0; e < n && (e + 1) * 8 <= t->stts.len - 8 && s < cnt; e++ )
+		{
+			uint32_t run = rd32( t->stts.p + 8 + e * 8 );
+			uint32_t delta = rd32( t->stts.p + 12 + e * 8 );
+
+			while( run-- > 0 && s < cnt )
+			{
+				int64_t pts = (int64_t)dts + (int32_t)mp4->sample[s].pts_ms;
+
+				if( pts < 0 )
+					pts = 0;
+				mp4->sample[s].dts_ms = (uint32_t)(dts * 1000 / t->timescale);
+				mp4->sample[s].pts_ms = (uint32_t)((uint64_t)pts * 1000 / t->timescale);
+				dts += delta;
+				s++;
+			}
+		}
+	}
+
+	if( t->stss.len >= 8 )
+	{
+		uint32_t n = rd32( t->stss.p + 4 );
+
+		for( e = 0; e < n && (e + 1) * 4 <= t->stss.len - 8; e++ )
+		{
+			uint32_t num = rd32( t->stss.p + 8 + e * 4 );	// 1 based
+			if( num >= 1 && num <= cnt )
+				mp4->sample[num - 1].flags |= MP4_SAMPLE_SYNC;
+		}
+	}
+	else
+	{
+		for( s = 0; s < cnt; s++ )
+			mp4->sample[s].flags |= MP4_SAMPLE_SYNC;
+	}
+	for( s = 0; s < cnt; s++ )
+	{
+		if( mp4->sample[s].flags & MP4_SAMPLE_SYNC )
+			mp4->sync_cnt++;
+	}
+
+	mp4->sample_cnt = cnt;
+
+	// one Annex-B buffer for the largest sample : 1 or 2 byte lengths grow to 4 byte start codes
+	{
+		uint32_t L = (uint32_t)mp4->nal_len_size;
+
+		mp4->au_cap = max_size + (max_size / (L + 1) + 1) * (4 - L);
+		mp4->au = (unsigned char*)malloc( mp4->au_cap );
+		if( mp4->au == NULL )
+			return -1;
+	}
+
+	return 0;
+}
+
+static int parse_moov(Mp4Demux *mp4, const Mp4Box *moov)
+{
+	const unsigned char *p = moov->p;
+	const unsigned char *end = moov->p + moov->len;
+	uint32_t type;
+	Mp4Box box;
+
+	while( next_box( &p, end, &type, &box ) )
+	{
+		Mp4Track trak;
+
+		if( type != FOURCC('t','r','a','k') )
+			continue;
+
+		memset( &trak, 0, sizeof(trak) );
+		parse_trak( box.p, box.p + box.len, &trak );
+		if( trak.handler != FOURCC('v','i','d','e') )
+			continue;
+
+		// first H.264 video track
+		if( parse_stsd( mp4, &trak.stsd ) < 0 )
+		{
+			free( mp4->header );
+			mp4->header = NULL;
+			continue;
+		}
+		if( mp4->nal_len_size == 3 )
+		{
+			ErrorPrint( "3 byte NAL length is not valid" );
+			return -1;
+		}
+		mp4->timescale = trak.timescale;
+		return build_index( mp4, &trak );
+	}
+	return -1;
+}
+
+static void unmap_window(Mp4Demux *mp4)
+{
+	if( mp4->win != NULL )
+		munmap( mp4->win, mp4->win_len );
+	mp4->win = NULL;
+	mp4->win_len = 0;
+}
+
+/* [off, off + len) of the file through the read-only window, moved and resized when it is not inside */
+static const unsigned char* map_window(Mp4Demux *mp4, uint64_t off, uint64_t len)
+{
+	uint64_t start, wlen;
+	long page = sysconf( _SC_PAGESIZE );
+
+	if( off + len > mp4->size )
+		return NULL;
+	if( mp4->win != NULL && off >= mp4->win_off && off + len <= mp4->win_off + mp4->win_len )
+		return mp4->win + (off - mp4->win_off);
+
+	unmap_window( mp4 );
+	start = off & ~(uint64_t)(page - 1);
+	wlen = off + len - start;
+	if( wlen < MP4_WINDOW_SIZE )
+		wlen = MP4_WINDOW_SIZE;
+	if( wlen > mp4->size - start )
+		wlen = mp4->size - start;
+
+	mp4->win = (unsigned char*)mmap( NULL, (size_t)wlen, PROT_READ, MAP_PRIVATE, mp4->fd, (off_t)start );
+	if( mp4->win == MAP_FAILED )
+	{
+		mp4->win = NULL;
+		ErrorPrint( "mmap fail at %llu", (unsigned long long)start );
+		return NULL;
+	}
+	mp4->win_off = start;
+	mp4->win_len = (size_t)wlen;
+	madvise( mp4->win, mp4->win_len, MADV_SEQUENTIAL );
+	return mp4->win + (off - start);
+}
+
+Mp4Demux* tcc_mp4_demux_open(const char *path)
+{
+	Mp4Demux *mp4;
+	struct stat st;
+	uint64_t pos;
+	uint32_t type;
+	Mp4Box box;
+	int found = 0;
+
+	mp4 = (Mp4Demux*)calloc( 1, sizeof(Mp4Demux) );
+	if( mp4 == NULL )
+		return NULL;
+	mp4->speed = 1;
+
+	mp4->fd = open( path, O_RDONLY );
+	if( mp4->fd < 0 )
+	{
+		ErrorPrint( "Cannot open '%s'", path );
+		free( mp4 );
+		return NULL;
+	}
+	if( fstat( mp4->fd, &st ) < 0 || st.st_size < 16 || (uint64_t)st.st_size > (uint64_t)(size_t)-1 )
+	{
+		ErrorPrint( "'%s' : bad size", path );
+		goto fail;
+	}
+	mp4->size = (size_t)st.st_size;
+
+	// moov can be in front of or behind mdat (dash-cams write it last) : walk the top level box headers,
+	// map moov alone for the index, mdat is mapped a window at a time while playing
+	pos = 0;
+	while( pos + 8 <= mp4->size )
+	{
+		unsigned char hdr[16];
+		uint64_t size, hlen = 8;
+		ssize_t n = pread( mp4->fd, hdr, 16, (off_t)pos );
+
+		if( n < 8 )
+			break;
+		size = rd32( hdr );
+		type = rd32( hdr + 4 );
+		if( size == 1 )
+		{
+			if( n < 16 )
+				break;
+			size = rd64( hdr + 8 );
+			hlen = 16;
+		}
+		else if( size == 0 )
+		{
+			size = mp4->size - pos;
+		}
+		if( size < hlen || size > mp4->size - pos )
+			break;
+
+		if( type == FOURCC('m','o','o','v') )
+		{
+			found = 1;
+			box.len = size - hlen;
+			box.p = map_window( mp4, pos + hlen, box.len );
+			if( box.p == NULL || parse_moov( mp4, &box ) < 0 )
+			{
+				ErrorPrint( "'%s' : no playable H.264 track", path );
+				goto fail;
+			}
+			unmap_window( mp4 );
+			break;
+		}
+		pos += size;
+	}
+	if( !found )
+	{
+		ErrorPrint( "'%s' : no moov box", path );
+		goto fail;
+	}
+
+	DebugPrint( "'%s' : %dx%d, %d samples, %d sync, timescale %d, NAL length %d",
+				path, mp4->width, mp4->height, mp4->sample_cnt, mp4->sync_cnt, mp4->timescale, mp4->nal_len_size );
+	return mp4;
+
+fail:
+	tcc_mp4_demux_close( mp4 );
+	return NULL;
+}
+
+void tcc_mp4_demux_close(Mp4Demux *mp4)
+{
+	if( mp4 == NULL )
+		return;
+	unmap_window( mp4 );
+	if( mp4->fd >= 0 )
+		close( mp4->fd );
+	free( mp4->sample );
+	free( mp4->header );
+	free( mp4->au );
+	free( mp4 );
+}
+
+unsigned char* tcc_mp4_demux_sample_data(Mp4Demux *mp4, unsigned int index, int *size)
+{
+	Mp4Sample *s;
+	const unsigned char *q, *end;
+	uint32_t n = 0;
+	int L;
+
+	if( mp4 == NULL || index >= mp4->sample_cnt )
+		return NULL;
+
+	s = &mp4->sample[index];
+	if( (q = map_window( mp4, s->offset, s->size )) == NULL )
+		return NULL;
+	end = q + s->size;
+	L = mp4->nal_len_size;
+
+	// the file stays read-only : the sample is copied out with start codes in place of the lengths
+	while( end - q >= L )
+	{
+		uint32_t l = (L == 4) ? rd32( q ) : ((L == 2) ? rd16( q ) : q[0]);
+
+		q += L;
+		if( l > (uint32_t)(end - q) )
+			l = (uint32_t)(end - q);
+		if( n + 4 + l > mp4->au_cap )
+			break;
+		mp4->au[n] = mp4->au[n+1] = mp4->au[n+2] = 0;
+		mp4->au[n+3] = 1;
+		memcpy( mp4->au + n + 4, q, l );
+		n += 4 + l;
+		q += l;
+	}
+	*size = (int)n;
+	return (n > 4) ? mp4->au : NULL;
+}
+
+static uint32_t elapsed_ms(const struct timespec *base)
+{
+	struct timespec now;
+
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	return (uint32_t)((now.tv_sec - base->tv_sec) * 1000 + (now.tv_nsec - base->tv_nsec) / 1000000);
+}
+
+/* absolute deadline t ms after base */
+static void sleep_until(const struct timespec *base, uint32_t t)
+{
+	struct timespec next;
+
+	next.tv_sec = base->tv_sec + t / 1000;
+	next.tv_nsec = base->tv_nsec + (long)(t % 1000) * 1000000L;
+	if( next.tv_nsec >= 1000000000L )
+	{
+		next.tv_nsec -= 1000000000L;
+		next.tv_sec++;
+	}
+	while( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL ) == EINTR )
+		;
+}
+
+int tcc_mp4_demux_play(Mp4Demux *mp4, int realtime)
+{
+	struct timespec base;
+	unsigned int i, first = 0;
+	uint32_t base_dts, next_dts = 0;
+	uint32_t pts_in, pts_out, last_in, last_out;
+	int speed;
+	int count = 0;
+
+	if( mp4 == NULL )
+		return -1;
+
+	mp4->stop = 0;
+
+	// the decoder can only start on a sync sample
+	while( first < mp4->sample_cnt && !(mp4->sample[first].flags & MP4_SAMPLE_SYNC) )
+		first++;
+	if( first == mp4->sample_cnt )
+		return -1;
+
+	tcc_vdec_process_annexb_header( mp4->header, mp4->header_len );
+
+	// pacing runs on the decode time stamps from base_dts, the PTS handed out is pts_out + (pts - pts_in) / speed
+	clock_gettime( CLOCK_MONOTONIC, &base );
+	base_dts = mp4->sample[first].dts_ms;
+	pts_in = pts_out = last_in = last_out = mp4->sample[first].pts_ms;
+	speed = mp4->speed;
+
+	for( i = first; i < mp4->sample_cnt && !mp4->stop; i++ )
+	{
+		unsigned char *data;
+		int size;
+		uint32_t pts;
+
+		if( mp4->speed != speed )
+		{
+			// back from trick play : the samples after the last sync sample fed reference skipped ones
+			if( speed > 1 && mp4->speed <= 1 )
+			{
+				while( i < mp4->sample_cnt && !(mp4->sample[i].flags & MP4_SAMPLE_SYNC) )
+					i++;
+				if( i >= mp4->sample_cnt )
+					break;
+			}
+			// rebase on the last sample fed : the time stamps keep going up across the change
+			speed = mp4->speed;
+			clock_gettime( CLOCK_MONOTONIC, &base );
+			base_dts = next_dts = mp4->sample[i].dts_ms;
+			pts_in = last_in;
+			pts_out = last_out;
+		}
+
+		if( speed > 1 )
+		{
+			// the sync sample the speed has reached by now, not closer than the minimum interval to the last one
+			if( realtime )
+			{
+				uint32_t now_dts = base_dts + elapsed_ms( &base ) * speed;
+				if( (int32_t)(now_dts - next_dts) > 0 )
+					next_dts = now_dts;
+			}
+			while( i < mp4->sample_cnt
+				&& (!(mp4->sample[i].flags & MP4_SAMPLE_SYNC) || (int32_t)(mp4->sample[i].dts_ms - next_dts) < 0) )
+				i++;
+			if( i >= mp4->sample_cnt )
+				break;
+			next_dts = mp4->sample[i].dts_ms + speed * VDEC_TRICK_MIN_INTERVAL_MS;
+		}
+
+		data = tcc_mp4_demux_sample_data( mp4, i, &size );
+		if( data == NULL )
+			continue;
+
+		if( realtime )
+			sleep_until( &base, (mp4->sample[i].dts_ms - base_dts) / speed );
+
+		pts = pts_out + (uint32_t)((int32_t)(mp4->sample[i].pts_ms - pts_in) / speed);
+		tcc_vdec_process_pts( data, size, pts );
+		last_in = mp4->sample[i].pts_ms;
+		last_out = pts;
+		count++;
+	}
+
+	return count;
+}
+
+void tcc_mp4_demux_stop(Mp4Demux *mp4)
+{
+	if( mp4 != NULL )
+		mp4->stop = 1;
+}
+
+void tcc_mp4_demux_set_speed(Mp4Demux *mp4, int speed)
+{
+	if( mp4 != NULL )
+		mp4->speed = speed;
+}
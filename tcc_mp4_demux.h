@@ -0,0 +1,67 @@
+//********************************************************************************************
+/**
+ * @file        tcc_mp4_demux.h
+ * @brief		MP4 (ISO-BMFF) reader for H.264 tracks, feeds samples from a read-only window on the file.
+ * 				This interface contain : Open file and build sample index, Play, Stop, Close.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+#ifndef	__TCC_MP4_DEMUX_H__
+#define	__TCC_MP4_DEMUX_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* sample flags */
+#define MP4_SAMPLE_SYNC			(1<<0)	/* listed in stss (or no stss : every sample) */
+
+#define MP4_WINDOW_SIZE			(4 * 1024 * 1024)	/* read-only mapping of the file moved along mdat */
+
+typedef struct _Mp4Sample {
+	uint64_t	offset;		//from the start of the file
+	uint32_t	size;
+	uint32_t	dts_ms;		//decode time
+	uint32_t	pts_ms;		//composition time (dts + ctts)
+	uint32_t	flags;		//MP4_SAMPLE_xxx
+} Mp4Sample;
+
+typedef struct _Mp4Demux {
+	int				fd;
+	size_t			size;
+	unsigned char	*win;		//read-only mapping of [win_off, win_off + win_len) of the file, NULL : none
+	uint64_t		win_off;
+	size_t			win_len;
+	Mp4Sample		*sample;	//sample index in decode order, built once at open
+	unsigned int	sample_cnt;
+	unsigned int	sync_cnt;
+	uint32_t		timescale;
+	int				width;
+	int				height;
+	int				nal_len_size;	//1, 2 or 4 bytes of NAL length in front of every NAL
+	unsigned char	*header;		//SPS/PPS from avcC, Annex-B
+	int				header_len;
+	unsigned char	*au;			//Annex-B copy of the sample being fed, sized for the largest sample at open
+	uint32_t		au_cap;
+	volatile int	stop;
+	volatile int	speed;		//1 : normal, 2.. : trick play on I pictures only
+} Mp4Demux;
+
+Mp4Demux* tcc_mp4_demux_open(const char *path);
+void tcc_mp4_demux_close(Mp4Demux *mp4);
+
+/* Annex-B data of one sample, valid until the next call. NULL on a broken sample */
+unsigned char* tcc_mp4_demux_sample_data(Mp4Demux *mp4, unsigned int index, int *size);
+
+/* send the SPS/PPS, then every sample from the first sync sample with its PTS through tcc_vdec_process_pts().
+ * blocks until the end of the track or tcc_mp4_demux_stop().
+ * realtime = 1 : samples are paced on their decode time stamps.
+ * returns the number of samples fed */
+int tcc_mp4_demux_play(Mp4Demux *mp4, int realtime);
+void tcc_mp4_demux_stop(Mp4Demux *mp4);
+
+/* any thread, takes effect with the next access unit (see tcc_vdec_SetTrickSpeed) */
+void tcc_mp4_demux_set_speed(Mp4Demux *mp4, int speed);
+
+#endif	// __TCC_MP4_DEMUX_H__
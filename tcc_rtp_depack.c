@@ -0,0 +1,310 @@
+//********************************************************************************************
+/**
+ * @file        tcc_rtp_depack.c
+ * @brief		RTP H.264 (RFC 6184) depacketizer with a small reordering jitter buffer.
+ * 				This interface contain : Create/Destroy, Push one RTP packet, Get statistics.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tcc_rtp_depack.h"
+#include "tcc_vdec_api.h"
+
+//#define	DEBUG_MODE
+#ifdef	DEBUG_MODE
+	#define	DebugPrint( fmt, ... )	printf( "[TCC_RTP_DEPACK](D):"fmt"\n", ##__VA_ARGS__ )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_RTP_DEPACK](E):"fmt"\n", ##__VA_ARGS__ )
+#else
+	#define	DebugPrint( fmt, ... )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_RTP_DEPACK](E):"fmt"\n", ##__VA_ARGS__ )
+#endif
+
+#define NAL_STAP_A		24
+#define NAL_FU_A		28
+
+static uint32_t rd32(const unsigned char *p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void au_append(RtpDepack *rtp, const unsigned char *hdr, int hdr_len, const unsigned char *p, uint32_t len)
+{
+	uint32_t need = rtp->au_len + hdr_len + len;
+
+	if( rtp->au_broken )
+		return;
+	if( need > rtp->au_cap )
+	{
+		uint32_t cap = rtp->au_cap * 2;
+		unsigned char *buf;
+
+		while( cap < need )
+			cap *= 2;
+		buf = (unsigned char*)realloc( rtp->au, cap );
+		if( buf == NULL )
+		{
+			rtp->au_broken = 1;
+			return;
+		}
+		rtp->au = buf;
+		rtp->au_cap = cap;
+	}
+	if( hdr_len > 0 )
+		memcpy( rtp->au + rtp->au_len, hdr, hdr_len );
+	memcpy( rtp->au + rtp->au_len + hdr_len, p, len );
+	rtp->au_len = need;
+}
+
+static void au_nal(RtpDepack *rtp, const unsigned char *nal, uint32_t len)
+{
+	static const unsigned char start[4] = { 0x00, 0x00, 0x00, 0x01 };
+
+	au_append( rtp, start, 4, nal, len );
+}
+
+static void au_flush(RtpDepack *rtp)
+{
+	if( rtp->au_len == 0 && !rtp->au_broken )
+		return;
+
+	if( rtp->au_broken )
+	{
+		// a picture with a hole would only spread errors : drop it and restart from the next I-frame
+		rtp->stat.au_dropped++;
+		tcc_vdec_NotifyStreamLoss();
+	}
+	else if( rtp->au_len > 4 )
+	{
+		int64_t ticks = rtp->ext_ts;
+
+		tcc_vdec_process_pts( rtp->au, (int)rtp->au_len, (unsigned int)(ticks / RTP_CLOCK_KHZ) );
+		rtp->stat.au++;
+	}
+	rtp->au_len = 0;
+	rtp->au_broken = 0;
+	rtp->fu_active = 0;
+}
+
+/* a sequence number was given up : the current picture cannot be complete */
+static void mark_loss(RtpDepack *rtp)
+{
+	rtp->stat.lost++;
+	rtp->au_broken = 1;
+	rtp->fu_active = 0;
+}
+
+static void depacketize(RtpDepack *rtp, const unsigned char *pkt, int size)
+{
+	const unsigned char *p, *end = pkt + size;
+	int cc = pkt[0] & 0x0F;
+	int marker = pkt[1] & 0x80;
+	uint32_t ts = rd32( pkt + 4 );
+	int type;
+
+	p = pkt + 12 + cc * 4;
+	if( pkt[0] & 0x10 )		// header extension
+	{
+		if( end - p < 4 )
+			return;
+		p += 4 + (((p[2] << 8) | p[3]) * 4);
+	}
+	if( pkt[0] & 0x20 )		// padding
+		end -= pkt[size - 1];
+	if( p >= end )
+		return;
+
+	// a new time stamp is a new picture, even if the marker of the last one was lost
+	if( !rtp->ts_valid )
+	{
+		rtp->ts_valid = 1;
+		rtp->last_ts = ts;
+		rtp->ext_ts = 0;
+	}
+	else if( ts != rtp->last_ts )
+	{
+		// a loss between two pictures may have been the first packet of this one : keep it broken
+		if( rtp->au_len > 0 )
+			au_flush( rtp );
+		rtp->ext_ts += (int32_t)(ts - rtp->last_ts);
+		if( rtp->ext_ts < 0 )
+			rtp->ext_ts = 0;
+		rtp->last_ts = ts;
+	}
+
+	type = p[0] & 0x1F;
+	if( type >= 1 && type <= 23 )
+	{
+		au_nal( rtp, p, (uint32_t)(end - p) );
+	}
+	else if( type == NAL_STAP_A )
+	{
+		for( p++; end - p >= 2; )
+		{
+			uint32_t len = (p[0] << 8) | p[1];
+
+			p += 2;
+			if( len == 0 || len > (uint32_t)(end - p) )
+				break;
+			au_nal( rtp, p, len );
+			p += len;
+		}
+	}
+	else if( type == NAL_FU_A )
+	{
+		if( end - p >= 2 )
+		{
+			unsigned char fu = p[1];
+
+			if( fu & 0x80 )		// start
+			{
+				unsigned char hdr[5] = { 0x00, 0x00, 0x00, 0x01, 0x00 };
+
+				hdr[4] = (p[0] & 0xE0) | (fu & 0x1F);
+				au_append( rtp, hdr, 5, p + 2, (uint32_t)(end - p - 2) );
+				rtp->fu_active = 1;
+			}
+			else if( rtp->fu_active )
+			{
+				au_append( rtp, NULL, 0, p + 2, (uint32_t)(end - p - 2) );
+			}
+			else
+			{
+				rtp->au_broken = 1;		// fragment without its start
+			}
+			if( fu & 0x40 )		// end
+				rtp->fu_active = 0;
+		}
+	}
+	else
+	{
+		rtp->stat.unsupported++;
+	}
+
+	if( marker )
+		au_flush( rtp );
+}
+
+/* hand over every packet that is in order, give up on holes once the buffer is deep enough */
+static void drain(RtpDepack *rtp)
+{
+	while( rtp->pending > 0 )
+	{
+		RtpSlot *slot = &rtp->slot[rtp->next_seq & (RTP_JITTER_SLOTS - 1)];
+
+		if( slot->valid )
+		{
+			depacketize( rtp, slot->data, slot->len );
+			slot->valid = 0;
+			rtp->pending--;
+		}
+		else if( rtp->pending >= rtp->depth )
+		{
+			mark_loss( rtp );
+		}
+		else
+		{
+			break;
+		}
+		rtp->next_seq++;
+	}
+}
+
+RtpDepack* tcc_rtp_depack_create(int depth)
+{
+	RtpDepack *rtp;
+
+	rtp = (RtpDepack*)calloc( 1, sizeof(RtpDepack) );
+	if( rtp == NULL )
+		return NULL;
+
+	rtp->slot = (RtpSlot*)calloc( RTP_JITTER_SLOTS, sizeof(RtpSlot) );
+	rtp->au = (unsigned char*)malloc( RTP_AU_BUF_SIZE );
+	if( rtp->slot == NULL || rtp->au == NULL )
+	{
+		tcc_rtp_depack_destroy( rtp );
+		return NULL;
+	}
+	rtp->au_cap = RTP_AU_BUF_SIZE;
+
+	if( depth <= 0 )
+		depth = RTP_JITTER_DEPTH;
+	if( depth > RTP_JITTER_SLOTS / 2 )
+		depth = RTP_JITTER_SLOTS / 2;
+	rtp->depth = depth;
+
+	return rtp;
+}
+
+void tcc_rtp_depack_destroy(RtpDepack *rtp)
+{
+	if( rtp == NULL )
+		return;
+	free( rtp->slot );
+	free( rtp->au );
+	free( rtp );
+}
+
+int tcc_rtp_depack_push(RtpDepack *rtp, const unsigned char *packet, int size)
+{
+	uint16_t seq;
+	int16_t diff;
+	RtpSlot *slot;
+
+	if( rtp == NULL || packet == NULL || size < 13 || size > RTP_MAX_PACKET )
+		return -1;
+	if( (packet[0] >> 6) != 2 )
+		return -1;
+
+	rtp->stat.packets++;
+	seq = (uint16_t)((packet[2] << 8) | packet[3]);
+
+	if( !rtp->started )
+	{
+		rtp->started = 1;
+		rtp->next_seq = seq;
+	}
+
+	diff = (int16_t)(seq - rtp->next_seq);
+	if( diff >= RTP_JITTER_SLOTS || diff < -RTP_JITTER_SLOTS )
+	{
+		// sender restarted (in either direction) or a long outage : resynchronize on this packet
+		unsigned int i;
+
+		DebugPrint( "sequence jump %d -> %d", rtp->next_seq, seq );
+		for( i = 0; i < RTP_JITTER_SLOTS; i++ )
+			rtp->slot[i].valid = 0;
+		rtp->pending = 0;
+		mark_loss( rtp );
+		rtp->next_seq = seq;
+	}
+	else if( diff < 0 )
+	{
+		rtp->stat.late++;
+		return 0;
+	}
+
+	slot = &rtp->slot[seq & (RTP_JITTER_SLOTS - 1)];
+	if( slot->valid )
+	{
+		rtp->stat.late++;	// duplicate
+		return 0;
+	}
+	memcpy( slot->data, packet, size );
+	slot->len = (uint16_t)size;
+	slot->valid = 1;
+	rtp->pending++;
+
+	drain( rtp );
+	return 0;
+}
+
+void tcc_rtp_depack_get_stat(RtpDepack *rtp, RtpDepackStat *stat)
+{
+	memcpy( stat, &rtp->stat, sizeof(RtpDepackStat) );
+}
@@ -0,0 +1,69 @@
+//********************************************************************************************
+/**
+ * @file        tcc_rtp_depack.h
+ * @brief		RTP H.264 (RFC 6184) depacketizer with a small reordering jitter buffer.
+ * 				This interface contain : Create/Destroy, Push one RTP packet, Get statistics.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+#ifndef	__TCC_RTP_DEPACK_H__
+#define	__TCC_RTP_DEPACK_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define RTP_JITTER_SLOTS		64			/* power of 2, upper limit of the reordering depth */
+#define RTP_JITTER_DEPTH		8			/* default : packets held back while waiting for a missing one */
+#define RTP_MAX_PACKET			1600		/* larger than any Ethernet MTU */
+#define RTP_AU_BUF_SIZE			(512 * 1024)	/* initial access unit buffer, grown only for larger pictures */
+#define RTP_CLOCK_KHZ			90			/* H.264 RTP clock */
+
+typedef struct _RtpDepackStat {
+	unsigned int	packets;
+	unsigned int	lost;			//sequence numbers never received
+	unsigned int	late;			//arrived after their slot was given up, or duplicated
+	unsigned int	au;				//access units passed to the decoder
+	unsigned int	au_dropped;		//access units dropped because of a loss
+	unsigned int	unsupported;	//STAP-B, MTAP, FU-B packets
+} RtpDepackStat;
+
+typedef struct _RtpSlot {
+	int				valid;
+	uint16_t		len;
+	unsigned char	data[RTP_MAX_PACKET];
+} RtpSlot;
+
+typedef struct _RtpDepack {
+	RtpSlot			*slot;			//RTP_JITTER_SLOTS, allocated at create
+	int				depth;
+	int				started;
+	uint16_t		next_seq;		//next sequence number handed to the depacketizer
+	int				pending;		//valid slots
+
+	unsigned char	*au;			//Annex-B access unit being assembled
+	uint32_t		au_len;
+	uint32_t		au_cap;
+	uint32_t		au_ts;
+	int				au_broken;
+	int				fu_active;
+
+	uint32_t		last_ts;
+	int64_t			ext_ts;			//unwrapped RTP time stamp
+	int				ts_valid;
+
+	RtpDepackStat	stat;
+} RtpDepack;
+
+/* depth : packets kept for reordering before a gap is declared lost (0 : RTP_JITTER_DEPTH) */
+RtpDepack* tcc_rtp_depack_create(int depth);
+void tcc_rtp_depack_destroy(RtpDepack *rtp);
+
+/* one complete RTP packet (header included) as received from the socket.
+ * complete access units go to tcc_vdec_process_pts(), a loss calls tcc_vdec_NotifyStreamLoss(). */
+int tcc_rtp_depack_push(RtpDepack *rtp, const unsigned char *packet, int size);
+
+void tcc_rtp_depack_get_stat(RtpDepack *rtp, RtpDepackStat *stat);
+
+#endif	// __TCC_RTP_DEPACK_H__
@@ -0,0 +1,389 @@
+//********************************************************************************************
+/**
+ * @file        tcc_stream_capture.c
+ * @brief		Capture of the compressed input fed to the decoder, and replay of a capture file.
+ * 				This interface contain : Start/Stop capture, Queue one access unit, Replay a capture.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tcc_stream_capture.h"
+#include "tcc_vdec_api.h"
+
+//#define	DEBUG_MODE
+#ifdef	DEBUG_MODE
+	#define	DebugPrint( fmt, ... )	printf( "[TCC_STREAM_CAPTURE](D):"fmt"\n", ##__VA_ARGS__ )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_STREAM_CAPTURE](E):"fmt"\n", ##__VA_ARGS__ )
+#else
+	#define	DebugPrint( fmt, ... )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_STREAM_CAPTURE](E):"fmt"\n", ##__VA_ARGS__ )
+#endif
+
+/* entry in the ring : header then data, padded to 8 bytes */
+typedef struct _RingEntry {
+	uint32_t	len;		//data length, RING_WRAP : skip to the start of the ring
+	uint32_t	call;
+	int64_t		time_us;
+	uint32_t	pts_ms;
+	uint32_t	reserved;
+} RingEntry;
+
+#define RING_WRAP		0xFFFFFFFF
+#define RING_ALIGN(x)	(((x) + 7) & ~7)
+
+static unsigned char *g_Ring = NULL;
+static volatile uint32_t g_Head = 0;	//bytes produced
+static volatile uint32_t g_Tail = 0;	//bytes consumed
+static volatile int g_Running = 0;
+static volatile uint32_t g_Dropped = 0;
+static sem_t g_Sem;
+static pthread_t g_Thread;
+static FILE *g_File = NULL;
+static int64_t g_StartUs = 0;
+
+static uint64_t *g_Index = NULL;	//keyframe record offsets, writer thread only
+static uint32_t g_IndexCnt = 0;
+static uint32_t g_IndexCap = 0;
+
+static int64_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void put_le(unsigned char *p, uint64_t v, int bytes)
+{
+	int i;
+
+	for( i = 0; i < bytes; i++ )
+		p[i] = (unsigned char)(v >> (i * 8));
+}
+
+static uint64_t get_le(const unsigned char *p, int bytes)
+{
+	uint64_t v = 0;
+	int i;
+
+	for( i = bytes - 1; i >= 0; i-- )
+		v = (v << 8) | p[i];
+	return v;
+}
+
+static uint32_t scan_nal_mask(const unsigned char *p, uint32_t size)
+{
+	uint32_t mask = 0;
+	uint32_t i;
+
+	for( i = 0; i + 3 < size; i++ )
+	{
+		if( p[i] == 0 && p[i+1] == 0 && p[i+2] == 1 )
+		{
+			mask |= 1u << (p[i+3] & 0x1F);
+			i += 3;
+		}
+	}
+	return mask;
+}
+
+static void write_record(const RingEntry *ent, const unsigned char *data, uint32_t gap)
+{
+	unsigned char hdr[CAPTURE_RECORD_SIZE];
+	uint32_t mask = scan_nal_mask( data, ent->len );
+	unsigned char flags = 0;
+	long offset = ftell( g_File );
+
+	// SPS(7) or IDR(5) : a replay can start here
+	if( mask & ((1u << 5) | (1u << 7)) )
+	{
+		flags |= CAPTURE_FLAG_KEYFRAME;
+		if( g_IndexCnt == g_IndexCap )
+		{
+			uint32_t cap = g_IndexCap ? g_IndexCap * 2 : 256;
+			uint64_t *idx = (uint64_t*)realloc( g_Index, cap * sizeof(uint64_t) );
+			if( idx != NULL )
+			{
+				g_Index = idx;
+				g_IndexCap = cap;
+			}
+		}
+		if( g_IndexCnt < g_IndexCap )
+			g_Index[g_IndexCnt++] = (uint64_t)offset;
+	}
+	if( gap )
+		flags |= CAPTURE_FLAG_GAP;
+
+	put_le( hdr + 0, (uint64_t)ent->time_us, 8 );
+	put_le( hdr + 8, ent->len, 4 );
+	put_le( hdr + 12, mask, 4 );
+	put_le( hdr + 16, ent->pts_ms, 4 );
+	hdr[20] = (unsigned char)ent->call;
+	hdr[21] = flags;
+	hdr[22] = hdr[23] = 0;
+
+	fwrite( hdr, 1, sizeof(hdr), g_File );
+	fwrite( data, 1, ent->len, g_File );
+}
+
+static void* capture_thread(void *arg)
+{
+	uint32_t seen_dropped = 0;
+
+	while( 1 )
+	{
+		uint32_t head;
+
+		if( !g_Running && g_Head == g_Tail )
+			break;
+
+		sem_wait( &g_Sem );
+
+		head = g_Head;
+		__sync_synchronize();
+
+		while( g_Tail != head )
+		{
+			uint32_t pos = g_Tail % CAPTURE_RING_SIZE;
+			RingEntry *ent = (RingEntry*)(g_Ring + pos);
+			uint32_t dropped;
+
+			if( ent->len == RING_WRAP )
+			{
+				g_Tail += CAPTURE_RING_SIZE - pos;
+				continue;
+			}
+
+			dropped = g_Dropped;
+			write_record( ent, g_Ring + pos + sizeof(RingEntry), dropped != seen_dropped );
+			seen_dropped = dropped;
+
+			__sync_synchronize();
+			g_Tail += RING_ALIGN( sizeof(RingEntry) + ent->len );
+		}
+	}
+
+	return NULL;
+}
+
+int tcc_stream_capture_start(const char *path)
+{
+	if( g_Running )
+		return 0;
+
+	g_File = fopen( path, "wb" );
+	if( g_File == NULL )
+	{
+		ErrorPrint( "Cannot open '%s'", path );
+		return -1;
+	}
+	// large stdio buffer : the writer thread issues big writes
+	setvbuf( g_File, NULL, _IOFBF, 256 * 1024 );
+	fwrite( CAPTURE_MAGIC, 1, 4, g_File );
+	{
+		unsigned char ver[4];
+		put_le( ver, CAPTURE_VERSION, 4 );
+		fwrite( ver, 1, 4, g_File );
+	}
+
+	g_Ring = (unsigned char*)malloc( CAPTURE_RING_SIZE );
+	if( g_Ring == NULL || sem_init( &g_Sem, 0, 0 ) != 0 )
+	{
+		free( g_Ring );
+		g_Ring = NULL;
+		fclose( g_File );
+		g_File = NULL;
+		return -1;
+	}
+
+	g_Head = g_Tail = 0;
+	g_Dropped = 0;
+	g_IndexCnt = 0;
+	g_StartUs = now_us();
+	g_Running = 1;
+
+	if( pthread_create( &g_Thread, NULL, capture_thread, NULL ) != 0 )
+	{
+		ErrorPrint( "capture thread create fail" );
+		g_Running = 0;
+		sem_destroy( &g_Sem );
+		free( g_Ring );
+		g_Ring = NULL;
+		fclose( g_File );
+		g_File = NULL;
+		return -1;
+	}
+
+	DebugPrint( "capture start : %s", path );
+	return 0;
+}
+
+void tcc_stream_capture_stop(void)
+{
+	unsigned char footer[CAPTURE_FOOTER_SIZE];
+	unsigned char off[8];
+	long index_offset;
+	uint32_t i;
+
+	if( !g_Running )
+		return;
+
+	g_Running = 0;
+	sem_post( &g_Sem );
+	pthread_join( g_Thread, NULL );
+	sem_destroy( &g_Sem );
+
+	// trailing keyframe index
+	index_offset = ftell( g_File );
+	for( i = 0; i < g_IndexCnt; i++ )
+	{
+		put_le( off, g_Index[i], 8 );
+		fwrite( off, 1, 8, g_File );
+	}
+	put_le( footer + 0, (uint64_t)index_offset, 8 );
+	put_le( footer + 8, g_IndexCnt, 4 );
+	memcpy( footer + 12, CAPTURE_INDEX_MAGIC, 4 );
+	fwrite( footer, 1, sizeof(footer), g_File );
+	fclose( g_File );
+	g_File = NULL;
+
+	DebugPrint( "capture stop : %d keyframes, %d dropped", g_IndexCnt, g_Dropped );
+
+	free( g_Index );
+	g_Index = NULL;
+	g_IndexCnt = g_IndexCap = 0;
+	free( g_Ring );
+	g_Ring = NULL;
+}
+
+int tcc_stream_capture_is_running(void)
+{
+	return g_Running;
+}
+
+int tcc_stream_capture_push(int call, const unsigned char *data, int size, unsigned int pts_ms)
+{
+	uint32_t need, pos, used;
+	RingEntry *ent;
+
+	if( !g_Running || data == NULL || size <= 0 )
+		return -1;
+
+	need = RING_ALIGN( sizeof(RingEntry) + (uint32_t)size );
+	pos = g_Head % CAPTURE_RING_SIZE;
+	used = g_Head - g_Tail;
+
+	// the entry must be contiguous : wrap first if it does not fit at the end
+	if( CAPTURE_RING_SIZE - pos < need )
+	{
+		if( used + (CAPTURE_RING_SIZE - pos) + need > CAPTURE_RING_SIZE )
+			goto drop;
+		((RingEntry*)(g_Ring + pos))->len = RING_WRAP;
+		__sync_synchronize();
+		g_Head += CAPTURE_RING_SIZE - pos;
+		pos = 0;
+		used = g_Head - g_Tail;
+	}
+	if( used + need > CAPTURE_RING_SIZE )
+		goto drop;
+
+	ent = (RingEntry*)(g_Ring + pos);
+	ent->len = (uint32_t)size;
+	ent->call = (uint32_t)call;
+	ent->time_us = now_us() - g_StartUs;
+	ent->pts_ms = pts_ms;
+	memcpy( g_Ring + pos + sizeof(RingEntry), data, size );
+
+	__sync_synchronize();
+	g_Head += need;
+	sem_post( &g_Sem );
+	return 0;
+
+drop:
+	__sync_fetch_and_add( &g_Dropped, 1 );
+	return -1;
+}
+
+int tcc_stream_replay(const char *path, int realtime)
+{
+	struct stat st;
+	unsigned char *map;
+	uint64_t end, pos;
+	int64_t start;
+	int fd, count = 0;
+
+	fd = open( path, O_RDONLY );
+	if( fd < 0 )
+	{
+		ErrorPrint( "Cannot open '%s'", path );
+		return -1;
+	}
+	if( fstat( fd, &st ) < 0 || st.st_size < 8 )
+	{
+		close( fd );
+		return -1;
+	}
+	// read-only : the decoder never writes into the access units it is given
+	map = (unsigned char*)mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if( map == MAP_FAILED )
+		return -1;
+
+	if( memcmp( map, CAPTURE_MAGIC, 4 ) != 0 || get_le( map + 4, 4 ) != CAPTURE_VERSION )
+	{
+		ErrorPrint( "'%s' is not a capture file", path );
+		munmap( map, st.st_size );
+		return -1;
+	}
+
+	// records end where the index starts, or at EOF for a capture that was never stopped
+	end = st.st_size;
+	if( st.st_size >= 8 + CAPTURE_FOOTER_SIZE && memcmp( map + st.st_size - 4, CAPTURE_INDEX_MAGIC, 4 ) == 0 )
+		end = get_le( map + st.st_size - CAPTURE_FOOTER_SIZE, 8 );
+
+	start = now_us();
+	pos = 8;
+	while( pos + CAPTURE_RECORD_SIZE <= end )
+	{
+		int64_t time_us = (int64_t)get_le( map + pos, 8 );
+		uint32_t size = (uint32_t)get_le( map + pos + 8, 4 );
+		uint32_t pts_ms = (uint32_t)get_le( map + pos + 16, 4 );
+		int call = map[pos + 20];
+		unsigned char *data = map + pos + CAPTURE_RECORD_SIZE;
+
+		if( pos + CAPTURE_RECORD_SIZE + size > end )
+			break;	// truncated record
+
+		if( realtime )
+		{
+			int64_t wait = time_us - (now_us() - start);
+			if( wait > 0 )
+				usleep( (useconds_t)wait );
+		}
+
+		if( call == CAPTURE_CALL_HEADER )
+			tcc_vdec_process_annexb_header( data, (int)size );
+		else
+			tcc_vdec_process_pts( data, (int)size, pts_ms );
+
+		count++;
+		pos += CAPTURE_RECORD_SIZE + size;
+	}
+
+	munmap( map, st.st_size );
+	DebugPrint( "replay done : %d records", count );
+	return count;
+}
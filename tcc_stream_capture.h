@@ -0,0 +1,55 @@
+//********************************************************************************************
+/**
+ * @file        tcc_stream_capture.h
+ * @brief		Capture of the compressed input fed to the decoder, and replay of a capture file.
+ * 				This interface contain : Start/Stop capture, Queue one access unit, Replay a capture.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+#ifndef	__TCC_STREAM_CAPTURE_H__
+#define	__TCC_STREAM_CAPTURE_H__
+
+#include <stdint.h>
+
+/*
+ * File layout (all fields little endian)
+ *
+ *   file header   : "TVDC" | version(u32)
+ *   record        : time_us(u64) | size(u32) | nal_mask(u32) | pts_ms(u32) | call(u8) | flags(u8) | reserved(u16) | data[size]
+ *   ...
+ *   index         : offset(u64) of every keyframe record
+ *   footer        : index_offset(u64) | index_count(u32) | "TVDI"
+ *
+ * time_us is the arrival time relative to the start of the capture.
+ * nal_mask has bit n set when a NAL unit of type n is present in the data.
+ * pts_ms is the time stamp the access unit was submitted with, 0 if unknown.
+ */
+#define CAPTURE_MAGIC			"TVDC"
+#define CAPTURE_INDEX_MAGIC		"TVDI"
+#define CAPTURE_VERSION			1
+#define CAPTURE_RECORD_SIZE		24
+#define CAPTURE_FOOTER_SIZE		16
+#define CAPTURE_RING_SIZE		(4*1024*1024)	/* bytes queued between the caller and the writer thread */
+
+/* API call the access unit was submitted with */
+#define CAPTURE_CALL_HEADER		0	/* tcc_vdec_process_annexb_header */
+#define CAPTURE_CALL_FRAME		1	/* tcc_vdec_process, tcc_vdec_process_pts, tcc_vdec_process_batch */
+
+/* record flags */
+#define CAPTURE_FLAG_KEYFRAME	(1<<0)	/* contains SPS or IDR */
+#define CAPTURE_FLAG_GAP		(1<<1)	/* records were dropped right before this one */
+
+int tcc_stream_capture_start(const char *path);
+void tcc_stream_capture_stop(void);
+int tcc_stream_capture_is_running(void);
+
+/* copies the access unit into the ring and returns, the writer thread does the rest */
+int tcc_stream_capture_push(int call, const unsigned char *data, int size, unsigned int pts_ms);
+
+/* replay a capture against the public tcc_vdec_* API.
+ * realtime = 1 : keep the recorded arrival timing, 0 : as fast as possible */
+int tcc_stream_replay(const char *path, int realtime);
+
+#endif	// __TCC_STREAM_CAPTURE_H__
@@ -0,0 +1,447 @@
+//********************************************************************************************
+/**
+ * @file        tcc_ts_demux.c
+ * @brief		MPEG-2 TS demuxer for one H.264 program, from DVB packet streams or recorded .ts files.
+ * 				This interface contain : Create/Destroy, Feed packets, Play file, Stop.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tcc_ts_demux.h"
+#include "tcc_vdec_api.h"
+
+//#define	DEBUG_MODE
+#ifdef	DEBUG_MODE
+	#define	DebugPrint( fmt, ... )	printf( "[TCC_TS_DEMUX](D):"fmt"\n", ##__VA_ARGS__ )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_TS_DEMUX](E):"fmt"\n", ##__VA_ARGS__ )
+#else
+	#define	DebugPrint( fmt, ... )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_TS_DEMUX](E):"fmt"\n", ##__VA_ARGS__ )
+#endif
+
+#define TS_FILE_CHUNK		(TS_PACKET_SIZE * 64)	/* bytes fed per round in file playback, stop is checked in between */
+#define TS_PCR_JUMP_US		(10 * 1000000LL)		/* PCR step taken as a discontinuity (loop, splice) */
+
+static int64_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* PAT / PMT : one section starting in this packet, which is the usual case for a single program */
+static const unsigned char* section_start(const unsigned char *p, const unsigned char *end, int *len)
+{
+	int l;
+
+	p += 1 + p[0];		// pointer_field
+	if( end - p < 8 )
+		return NULL;
+	l = ((p[1] & 0x0F) << 8) | p[2];
+	if( l < 9 || 3 + l > end - p )
+		return NULL;
+	*len = 3 + l - 4;	// without CRC
+	return p;
+}
+
+static void parse_pat(TsDemux *ts, const unsigned char *p, const unsigned char *end)
+{
+	const unsigned char *sec;
+	int len, i;
+
+	sec = section_start( p, end, &len );
+	if( sec == NULL || sec[0] != 0x00 )
+		return;
+
+	for( i = 8; i + 4 <= len; i += 4 )
+	{
+		int program = (sec[i] << 8) | sec[i+1];
+		uint16_t pid = ((sec[i+2] & 0x1F) << 8) | sec[i+3];
+
+		// first program only
+		if( program != 0 )
+		{
+			if( ts->pmt_pid != pid )
+			{
+				ts->pmt_pid = pid;
+				ts->pmt_version = -1;
+			}
+			return;
+		}
+	}
+}
+
+static void parse_pmt(TsDemux *ts, const unsigned char *p, const unsigned char *end)
+{
+	const unsigned char *sec;
+	int len, version, i;
+
+	sec = section_start( p, end, &len );
+	if( sec == NULL || sec[0] != 0x02 )
+		return;
+
+	version = (sec[5] >> 1) & 0x1F;
+	if( version == ts->pmt_version )
+		return;
+	ts->pmt_version = version;
+
+	ts->pcr_pid = ((sec[8] & 0x1F) << 8) | sec[9];
+	i = 12 + (((sec[10] & 0x0F) << 8) | sec[11]);
+	for( ; i + 5 <= len; i += 5 + (((sec[i+3] & 0x0F) << 8) | sec[i+4]) )
+	{
+		uint16_t pid = ((sec[i+1] & 0x1F) << 8) | sec[i+2];
+
+		if( sec[i] == TS_STREAM_TYPE_H264 )
+		{
+			if( ts->video_pid != pid )
+			{
+				DebugPrint( "video PID 0x%x, PCR PID 0x%x", pid, ts->pcr_pid );
+				ts->video_pid = pid;
+				ts->cc = -1;
+				ts->pes_started = 0;
+			}
+			return;
+		}
+	}
+	ErrorPrint( "no H.264 stream in the program" );
+}
+
+static void pes_flush(TsDemux *ts)
+{
+	if( ts->pes_started && !ts->pes_broken && ts->pes_len > 4 )
+	{
+		tcc_vdec_process_pts( ts->pes, (int)ts->pes_len, ts->pes_pts_ms );
+		ts->stat.pes++;
+	}
+	else if( ts->pes_started && ts->pes_broken )
+	{
+		ts->stat.dropped++;
+	}
+	ts->pes_started = 0;
+	ts->pes_len = 0;
+}
+
+static void pes_append(TsDemux *ts, const unsigned char *p, uint32_t len)
+{
+	if( ts->pes_len + len > ts->pes_cap )
+	{
+		uint32_t cap = ts->pes_cap * 2;
+		unsigned char *buf;
+
+		while( cap < ts->pes_len + len )
+			cap *= 2;
+		buf = (unsigned char*)realloc( ts->pes, cap );
+		if( buf == NULL )
+		{
+			ts->pes_broken = 1;
+			return;
+		}
+		ts->pes = buf;
+		ts->pes_cap = cap;
+	}
+	memcpy( ts->pes + ts->pes_len, p, len );
+	ts->pes_len += len;
+}
+
+static void pes_start(TsDemux *ts, const unsigned char *p, const unsigned char *end)
+{
+	int hdr_len, plen;
+
+	pes_flush( ts );
+
+	if( end - p < 9 || p[0] != 0 || p[1] != 0 || p[2] != 1 )
+		return;
+	plen = (p[4] << 8) | p[5];
+	hdr_len = 9 + p[8];
+	if( hdr_len > end - p )
+		return;
+
+	// PTS : 33 bits at 90kHz
+	if( (p[7] & 0x80) && p[8] >= 5 )
+	{
+		uint64_t pts = ((uint64_t)(p[9] & 0x0E) << 29) | ((uint64_t)p[10] << 22) | ((uint64_t)(p[11] & 0xFE) << 14)
+					 | ((uint64_t)p[12] << 7) | (p[13] >> 1);
+		ts->pes_pts_ms = (uint32_t)(pts / 90);
+	}
+	else
+	{
+		ts->pes_pts_ms = 0;		// the decoder extrapolates from the last one
+	}
+
+	ts->pes_expect = plen ? (uint32_t)(plen - (hdr_len - 6)) : 0;
+	ts->pes_started = 1;
+	ts->pes_broken = 0;
+	pes_append( ts, p + hdr_len, (uint32_t)(end - p - hdr_len) );
+}
+
+static void pcr_pace(TsDemux *ts, const unsigned char *af)
+{
+	int64_t pcr = ((int64_t)af[0] << 25) | (af[1] << 17) | (af[2] << 9) | (af[3] << 1) | (af[4] >> 7);
+	int64_t due_us;
+
+	if( ts->pcr0 < 0 )
+	{
+		ts->pcr0 = pcr;
+		ts->pcr0_us = now_us();
+		return;
+	}
+
+	due_us = ts->pcr0_us + (pcr - ts->pcr0) * 100 / 9;
+	if( pcr < ts->pcr0 || due_us - now_us() > TS_PCR_JUMP_US )
+	{
+		// discontinuity : restart the reference here
+		ts->pcr0 = pcr;
+		ts->pcr0_us = now_us();
+		return;
+	}
+	while( !ts->stop )
+	{
+		int64_t wait = due_us - now_us();
+		if( wait <= 0 )
+			break;
+		usleep( (useconds_t)wait );
+	}
+}
+
+static void ts_packet(TsDemux *ts, const unsigned char *p)
+{
+	const unsigned char *end = p + TS_PACKET_SIZE;
+	uint16_t pid = ((p[1] & 0x1F) << 8) | p[2];
+	int pusi = p[1] & 0x40;
+	int afc = (p[3] >> 4) & 0x03;
+	int discontinuity = 0;
+	const unsigned char *payload = p + 4;
+
+	ts->stat.packets++;
+
+	// most packets are other programs or audio : leave as early as possible
+	if( pid != ts->video_pid && pid != TS_PID_PAT && pid != ts->pmt_pid && pid != ts->pcr_pid )
+		return;
+	if( p[1] & 0x80 )	// transport_error_indicator
+	{
+		if( pid == ts->video_pid )
+			ts->pes_broken = 1;
+		return;
+	}
+
+	if( afc & 0x02 )
+	{
+		int af_len = p[4];
+
+		if( af_len > TS_PACKET_SIZE - 5 )
+			return;
+		if( af_len > 0 )
+		{
+			discontinuity = p[5] & 0x80;
+			if( ts->realtime && pid == ts->pcr_pid && (p[5] & 0x10) && af_len >= 7 )
+				pcr_pace( ts, p + 6 );
+		}
+		payload = p + 5 + af_len;
+	}
+	if( !(afc & 0x01) || payload >= end )
+		return;
+
+	if( pid == ts->video_pid )
+	{
+		int cc = p[3] & 0x0F;
+
+		if( ts->cc >= 0 && !discontinuity && cc != ((ts->cc + 1) & 0x0F) )
+		{
+			if( cc == ts->cc )
+				return;		// duplicate packet
+			ts->stat.cc_errors++;
+			ts->pes_broken = 1;
+		}
+		ts->cc = cc;
+
+		if( pusi )
+		{
+			pes_start( ts, payload, end );
+		}
+		else if( ts->pes_started )
+		{
+			pes_append( ts, payload, (uint32_t)(end - payload) );
+		}
+
+		// bounded PES : hand it over as soon as it is complete instead of at the next start
+		if( ts->pes_started && ts->pes_expect && ts->pes_len >= ts->pes_expect )
+		{
+			ts->pes_len = ts->pes_expect;
+			pes_flush( ts );
+		}
+	}
+	else if( pusi && pid == TS_PID_PAT )
+	{
+		parse_pat( ts, payload, end );
+	}
+	else if( pusi && pid == ts->pmt_pid )
+	{
+		parse_pmt( ts, payload, end );
+	}
+}
+
+TsDemux* tcc_ts_demux_create(void)
+{
+	TsDemux *ts;
+
+	ts = (TsDemux*)calloc( 1, sizeof(TsDemux) );
+	if( ts == NULL )
+		return NULL;
+
+	ts->pes = (unsigned char*)malloc( TS_PES_BUF_SIZE );
+	if( ts->pes == NULL )
+	{
+		free( ts );
+		return NULL;
+	}
+	ts->pes_cap = TS_PES_BUF_SIZE;
+	tcc_ts_demux_reset( ts );
+	return ts;
+}
+
+void tcc_ts_demux_destroy(TsDemux *ts)
+{
+	if( ts == NULL )
+		return;
+	free( ts->pes );
+	free( ts );
+}
+
+void tcc_ts_demux_reset(TsDemux *ts)
+{
+	ts->pmt_pid = TS_PID_NONE;
+	ts->video_pid = TS_PID_NONE;
+	ts->pcr_pid = TS_PID_NONE;
+	ts->pmt_version = -1;
+	ts->cc = -1;
+	ts->pes_len = 0;
+	ts->pes_started = 0;
+	ts->pes_broken = 0;
+	ts->carry_len = 0;
+	ts->pcr0 = -1;
+	memset( &ts->stat, 0, sizeof(ts->stat) );
+}
+
+int tcc_ts_demux_feed(TsDemux *ts, const unsigned char *data, int size)
+{
+	const unsigned char *end;
+
+	if( ts == NULL || data == NULL || size <= 0 )
+		return -1;
+	end = data + size;
+
+	// complete the packet left over from the last call
+	if( ts->carry_len > 0 )
+	{
+		int n = TS_PACKET_SIZE - ts->carry_len;
+
+		if( n > size )
+			n = size;
+		memcpy( ts->carry + ts->carry_len, data, n );
+		ts->carry_len += n;
+		data += n;
+		if( ts->carry_len < TS_PACKET_SIZE )
+			return 0;
+		ts->carry_len = 0;
+		if( ts->carry[0] == TS_SYNC_BYTE )
+			ts_packet( ts, ts->carry );
+		else
+			ts->stat.resync++;
+	}
+
+	// whole packets straight from the caller buffer
+	while( end - data >= TS_PACKET_SIZE && !ts->stop )
+	{
+		if( data[0] != TS_SYNC_BYTE || (end - data > TS_PACKET_SIZE && data[TS_PACKET_SIZE] != TS_SYNC_BYTE) )
+		{
+			const unsigned char *s = memchr( data + 1, TS_SYNC_BYTE, end - data - 1 );
+
+			ts->stat.resync++;
+			if( s == NULL )
+			{
+				data = end;
+				break;
+			}
+			data = s;
+			continue;
+		}
+		ts_packet( ts, data );
+		data += TS_PACKET_SIZE;
+	}
+
+	if( data < end && !ts->stop )
+	{
+		ts->carry_len = (int)(end - data);
+		memcpy( ts->carry, data, ts->carry_len );
+	}
+	return 0;
+}
+
+int tcc_ts_demux_play_file(TsDemux *ts, const char *path, int realtime)
+{
+	struct stat st;
+	unsigned char *map;
+	size_t pos;
+	int fd;
+
+	if( ts == NULL )
+		return -1;
+
+	fd = open( path, O_RDONLY );
+	if( fd < 0 )
+	{
+		ErrorPrint( "Cannot open '%s'", path );
+		return -1;
+	}
+	if( fstat( fd, &st ) < 0 || st.st_size < TS_PACKET_SIZE )
+	{
+		close( fd );
+		return -1;
+	}
+	map = (unsigned char*)mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if( map == MAP_FAILED )
+		return -1;
+	madvise( map, st.st_size, MADV_SEQUENTIAL );
+
+	tcc_ts_demux_reset( ts );
+	ts->stop = 0;
+	ts->realtime = realtime;
+
+	for( pos = 0; pos < (size_t)st.st_size && !ts->stop; pos += TS_FILE_CHUNK )
+	{
+		size_t n = (size_t)st.st_size - pos;
+
+		if( n > TS_FILE_CHUNK )
+			n = TS_FILE_CHUNK;
+		tcc_ts_demux_feed( ts, map + pos, (int)n );
+	}
+	if( !ts->stop )
+		pes_flush( ts );	// last PES has no following start
+
+	munmap( map, st.st_size );
+	ts->realtime = 0;
+
+	DebugPrint( "'%s' : %u packets, %u PES, %u CC errors, %u dropped, %u resync", path,
+				ts->stat.packets, ts->stat.pes, ts->stat.cc_errors, ts->stat.dropped, ts->stat.resync );
+	return (int)ts->stat.pes;
+}
+
+void tcc_ts_demux_stop(TsDemux *ts)
+{
+	if( ts != NULL )
+		ts->stop = 1;
+}
@@ -0,0 +1,72 @@
+//********************************************************************************************
+/**
+ * @file        tcc_ts_demux.h
+ * @brief		MPEG-2 TS demuxer for one H.264 program, from DVB packet streams or recorded .ts files.
+ * 				This interface contain : Create/Destroy, Feed packets, Play file, Stop.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+#ifndef	__TCC_TS_DEMUX_H__
+#define	__TCC_TS_DEMUX_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TS_PACKET_SIZE		188
+#define TS_SYNC_BYTE		0x47
+#define TS_PID_PAT			0x0000
+#define TS_PID_NONE			0xFFFF
+#define TS_STREAM_TYPE_H264	0x1B
+
+#define TS_PES_BUF_SIZE		(512 * 1024)	/* initial PES assembly buffer, grown only for larger PES */
+
+typedef struct _TsDemuxStat {
+	unsigned int	packets;
+	unsigned int	pes;			//PES passed to the decoder
+	unsigned int	cc_errors;		//continuity counter errors on the video PID
+	unsigned int	dropped;		//PES dropped because of a continuity error
+	unsigned int	resync;			//times the packet sync was lost
+} TsDemuxStat;
+
+typedef struct _TsDemux {
+	uint16_t		pmt_pid;
+	uint16_t		video_pid;
+	uint16_t		pcr_pid;
+	int				pmt_version;
+	int				cc;				//last continuity counter of the video PID, -1 unknown
+
+	unsigned char	*pes;			//PES payload being assembled (Annex-B)
+	uint32_t		pes_len;
+	uint32_t		pes_cap;
+	uint32_t		pes_expect;		//payload length from the PES header, 0 : unbounded
+	uint32_t		pes_pts_ms;
+	int				pes_started;
+	int				pes_broken;
+
+	unsigned char	carry[TS_PACKET_SIZE];	//partial packet between two feeds
+	int				carry_len;
+
+	int				realtime;		//pace on PCR (file playback)
+	int64_t			pcr0;			//90kHz PCR base of the pacing reference, -1 none
+	int64_t			pcr0_us;		//CLOCK_MONOTONIC at pcr0
+
+	TsDemuxStat		stat;
+	volatile int	stop;
+} TsDemux;
+
+TsDemux* tcc_ts_demux_create(void);
+void tcc_ts_demux_destroy(TsDemux *ts);
+void tcc_ts_demux_reset(TsDemux *ts);
+
+/* feed any number of bytes of a packet stream, packets may be split between calls.
+ * every complete video PES goes to tcc_vdec_process_pts() with its PTS. returns 0 */
+int tcc_ts_demux_feed(TsDemux *ts, const unsigned char *data, int size);
+
+/* play a recorded .ts file, blocks until the end of the file or tcc_ts_demux_stop().
+ * realtime = 1 : paced on the PCR. returns the number of PES fed */
+int tcc_ts_demux_play_file(TsDemux *ts, const char *path, int realtime);
+void tcc_ts_demux_stop(TsDemux *ts);
+
+#endif	// __TCC_TS_DEMUX_H__
@@ -11,8 +11,18 @@
 
 #include <mach/tcc_overlay_ioctl.h>
 #include <mach/vioc_global.h>
+#include <sched.h>
 
 #include "tcc_vpudec_intf.h"
+#include "tcc_disp_sink.h"
+#include "tcc_vsync.h"
+#include "tcc_frame_dump.h"
+#include "tcc_stream_capture.h"
+#include "tcc_file_player.h"
+#include "tcc_mp4_demux.h"
+#include "tcc_ts_demux.h"
+#include "tcc_rtp_depack.h"
+#include "tcc_vdec_event.h"
 #include "tcc_vdec_api.h"
 
 //#define	DEBUG_MODE
@@ -24,113 +34,1243 @@
 	#define	ErrorPrint( fmt, ... )	printf( "[TCC_VDEC_API](E):"fmt, ##__VA_ARGS__ )
 #endif
 
-// Overlay Driver
-#define	OVERLAY_DRIVER	"/dev/overlay"
-#define TCC_LCDC_SET_WMIXER_OVP         0x0045
-#define OVERLAY_SET_CROP_INFO 0x1234
-#define OVERLAY_SET_SCALER_INFO 0x2345
+typedef struct _DecodeDate {
+	
+	int 					OverlayDrv;		//overlay driver handler
+	bool					IsViewValid;	//view valid ?
+	bool					IsDecoderOpen;	//whether decode is in use ?
+	bool					IsConfigured;	//whether be configured ?
+	unsigned int			default_ovp;	//set overlay layer
+	unsigned int			LCD_width;		//LCD size - width
+	unsigned int			LCD_height;		//LCD size - height
+	overlay_video_buffer_t	lastinfo;		//backup last_overlay_info
+	
+	pthread_mutex_t 		mutex_lock;
+} DecodeDate;
+
+// 表示先 : g_SinkWantedがNULLならOverlay、開けなければFBへのソフトウェア描画
+static const DispSink *g_SinkWanted = NULL;
+static const DispSink *g_Sink = NULL;	// open中の表示先
+
+// Decoder State
+static int g_DecoderState = -1;
+
+// 入力のタイムスタンプの種類 (CONTAINER_MP4 : PTS, それ以外 : DTS)
+static int g_ContainerType = CONTAINER_NONE;
+
+
+// 描画可否フラグ
+static int g_IsViewValid = 0;	// 0:不可, 1:可
+
+// 一番最後に表示した画像情報 (y == NULL : 無し)
+static DispFrame g_LastFrame;
+
+// Mutex
+static pthread_mutex_t g_Mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Control plane
+// UI側の呼び出し(view/geometry/skip)はg_Mutexを待たずにここへ書き込むだけにする。
+// 書き込み側同士はg_CtrlMutexで直列化し、decode側はseqlockで読むのでロックを取らない。
+// 反映はg_Mutexを持っているスレッドがフレーム境界で行う。
+#define CTRL_PENDING_VIEW		(1<<0)
+#define CTRL_PENDING_GEOMETRY	(1<<1)
+#define CTRL_PENDING_SKIP		(1<<2)
+
+typedef struct _VdecCtrl {
+	volatile unsigned int	seq;			//seqlock counter, odd while a writer is updating
+	volatile unsigned int	pending;		//CTRL_PENDING_xxx not yet applied
+	int						view_valid;
+	int						sx;				//display window
+	int						sy;
+	int						width;
+	int						height;
+	int						skip_level;		//VDEC_SKIP_FRAME_xxx
+	int						skip_interval;
+} VdecCtrl;
+
+static VdecCtrl g_Ctrl = { 0, 0, 0, 0, 0, 800, 480, 0, 0 };
+static pthread_mutex_t g_CtrlMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Applied copies, only touched while holding g_Mutex
+static int g_DispX = 0;
+static int g_DispY = 0;
+static int g_DispW = 800;
+static int g_DispH = 480;
+static int g_SkipLevel = 0;
+static int g_SkipInterval = 0;
+
+// Frames pushed to the overlay, oldest first. A frame goes back to the VPU only
+// once the frame pushed after it is being scanned out. The VPU keeps VPU_DISP_HOLD_BUFF_COUNT
+// buffers for the display on top of the ones it decodes with : the queue never holds more.
+#define DISP_QUEUE_SIZE		VPU_DISP_HOLD_BUFF_COUNT
+
+typedef struct _DispEntry {
+	int				disp_idx;
+	unsigned int	epoch;		//tcc_vpudec_buffer_epoch() when pushed
+	VsyncStamp		stamp;
+} DispEntry;
+
+static DispEntry g_DispQueue[DISP_QUEUE_SIZE];
+static int g_DispQueueCnt = 0;
+static int g_ReleaseByDisplay = 0;	// 0 : VPU FIFO releases frames by position
+
+// キーフレーム要求 : デコーダが参照の欠落を検出したら送信側(RTCP PLI, AndroidAutoのIDR要求)へ知らせる
+// VDEC_KEYFRAME_xxxはVPU_KEYFRAME_xxxと同じビット
+static VdecKeyframeCallback g_KeyframeCb = NULL;
+static void *g_KeyframeUser = NULL;
+static int g_KeyframeIntervalMs = VDEC_KEYFRAME_MIN_INTERVAL_MS;
+static long long g_KeyframeLastUs = 0;
+static unsigned int g_KeyframeHeld = 0;		// 間隔制限で保留している理由
+
+// g_Mutexを持った状態で呼ぶこと。通知する理由を返す(0 : 通知しない)
+static unsigned int keyframe_poll_locked(VdecKeyframeCallback *cb, void **user)
+{
+	unsigned int reason;
+	long long now;
+	
+	g_KeyframeHeld |= tcc_vpudec_take_keyframe_request();
+	if( g_KeyframeCb == NULL ){
+		g_KeyframeHeld = 0;
+		return 0;
+	}
+	if( g_KeyframeHeld == 0 ){
+		return 0;
+	}
+	
+	now = tcc_vsync_now_us();
+	if( g_KeyframeLastUs != 0 && now - g_KeyframeLastUs < (long long)g_KeyframeIntervalMs * 1000 ){
+		return 0;
+	}
+	g_KeyframeLastUs = now;
+	
+	reason = g_KeyframeHeld;
+	g_KeyframeHeld = 0;
+	*cb = g_KeyframeCb;
+	*user = g_KeyframeUser;
+	return reason;
+}
+
+// g_Mutexを離してから呼ぶこと (コールバックからAPIを呼んでもデッドロックしないように)
+static void keyframe_notify(unsigned int reason, VdecKeyframeCallback cb, void *user)
+{
+	if( reason != 0 ){
+		DebugPrint( "keyframe request 0x%x\n", reason );
+		cb(reason, user);
+	}
+}
+
+// イベント通知 : キューへの書き込みはg_Mutexを持ったスレッドだけ、読み出しはg_EventMutexで一人ずつ
+// コールバックが設定されている時はデコードしたスレッドがg_Mutexを離してから配る
+static pthread_mutex_t g_EventMutex = PTHREAD_MUTEX_INITIALIZER;
+static VdecEventCallback g_EventCb = NULL;
+static void *g_EventUser = NULL;
+
+// 最後に通知した出力サイズとクロップ (width == 0 : 無し)
+static VdecEvent g_OutGeom;
+
+// g_Mutexを離してから呼ぶこと
+static void event_dispatch(void)
+{
+	VdecEvent ev;
+	VdecEventCallback cb;
+	void *user;
+	
+	for( ;; ){
+		pthread_mutex_lock(&g_EventMutex);
+		cb = g_EventCb;
+		user = g_EventUser;
+		if( cb == NULL || tcc_event_get(&ev) < 0 ){
+			pthread_mutex_unlock(&g_EventMutex);
+			return;
+		}
+		pthread_mutex_unlock(&g_EventMutex);
+		
+		// コールバックからtcc_vdec_GetEvent等を呼べるようにロックの外で呼ぶ
+		cb(&ev, user);
+	}
+}
+
+static void disp_queue_pop(void)
+{
+	// VPUが再初期化された後の古いindexは返さない(新しいフレームを解放してしまう)
+	if( g_DispQueue[0].epoch == tcc_vpudec_buffer_epoch() ){
+		tcc_vpudec_release_frame(g_DispQueue[0].disp_idx);
+		if( g_Sink != NULL && g_Sink->release != NULL ){
+			g_Sink->release(g_DispQueue[0].disp_idx);
+		}
+	}
+	memmove( &g_DispQueue[0], &g_DispQueue[1], sizeof(DispEntry) * (g_DispQueueCnt - 1) );
+	g_DispQueueCnt--;
+}
+
+// g_Mutexを持った状態で呼ぶこと
+static void disp_release_latched(void)
+{
+	while( g_DispQueueCnt >= 2 && tcc_vsync_latched(&g_DispQueue[1].stamp) ){
+		disp_queue_pop();
+	}
+}
+
+static void disp_queue_push(int disp_idx)
+{
+	// 前回と同じバッファ(保持フレームの再表示)は二重に積まない
+	unsigned int epoch = tcc_vpudec_buffer_epoch();
+	
+	if( g_DispQueueCnt > 0 && g_DispQueue[g_DispQueueCnt-1].disp_idx == disp_idx && g_DispQueue[g_DispQueueCnt-1].epoch == epoch ){
+		tcc_vsync_stamp(&g_DispQueue[g_DispQueueCnt-1].stamp);
+		return;
+	}
+	
+	if( g_DispQueueCnt == DISP_QUEUE_SIZE ){
+		// 呼び出し側で空きを作っているので来ないはず。来たら一番古いものをVPUに返して追い出す
+		disp_queue_pop();
+	}
+	g_DispQueue[g_DispQueueCnt].disp_idx = disp_idx;
+	g_DispQueue[g_DispQueueCnt].epoch = epoch;
+	tcc_vsync_stamp(&g_DispQueue[g_DispQueueCnt].stamp);
+	g_DispQueueCnt++;
+}
+
+static void disp_queue_reset(void)
+{
+	g_DispQueueCnt = 0;
+}
+
+static void disp_window(DispWindow *win)
+{
+	win->x = g_DispX;
+	win->y = g_DispY;
+	win->width = g_DispW;
+	win->height = g_DispH;
+}
+
+static void ctrl_publish_begin(void)
+{
+	pthread_mutex_lock(&g_CtrlMutex);
+	g_Ctrl.seq++;
+	__sync_synchronize();
+}
+
+static void ctrl_publish_end(unsigned int what)
+{
+	__sync_synchronize();
+	g_Ctrl.seq++;
+	pthread_mutex_unlock(&g_CtrlMutex);
+	__sync_fetch_and_or(&g_Ctrl.pending, what);
+}
+
+static void ctrl_snapshot(VdecCtrl *snap)
+{
+	unsigned int seq;
+	
+	do{
+		// 書き込み側がプリエンプトされていたらシングルコアでは回っても進まないので譲る
+		while( (seq = g_Ctrl.seq) & 1 )
+			sched_yield();
+		__sync_synchronize();
+		memcpy( snap, (const void*)&g_Ctrl, sizeof(VdecCtrl) );
+		__sync_synchronize();
+	}while( seq != g_Ctrl.seq );
+}
+
+// g_Mutexを持った状態で呼ぶこと
+static void ctrl_apply_locked(void)
+{
+	VdecCtrl snap;
+	unsigned int what;
+	
+	what = __sync_fetch_and_and(&g_Ctrl.pending, 0);
+	if( what == 0 )
+		return;
+	
+	ctrl_snapshot(&snap);
+	
+	if( what & CTRL_PENDING_GEOMETRY ){
+		g_DispX = snap.sx;
+		g_DispY = snap.sy;
+		g_DispW = snap.width;
+		g_DispH = snap.height;
+	}
+	
+	if( what & CTRL_PENDING_SKIP ){
+		g_SkipLevel = snap.skip_level;
+		g_SkipInterval = snap.skip_interval;
+		if( g_DecoderState >= 0 )
+			tcc_vpudec_set_skip_mode(g_SkipLevel, g_SkipInterval);
+	}
+	
+	if( what & CTRL_PENDING_VIEW ){
+		
+		// 非表示になる際は最後に表示したフレームをVPUに返さずに保持しておく
+		if( g_IsViewValid == 1 && snap.view_valid != 1 ){
+			if( g_DecoderState >= 0 && g_LastFrame.y != NULL ){
+				// 最後にVPUが出力したフレームではなく、表示先に渡した最後のフレームを保持する
+				tcc_vpudec_hold_frame(g_LastFrame.disp_idx);
+			}
+		}
+		
+		// 2015.04.23 N.Tanaka
+		g_IsViewValid = snap.view_valid;
+		
+		// 無効から有効に状態が変わった際に、最後のデータを描画する
+		if( g_IsViewValid == 1 && g_Sink != NULL ){
+			DispWindow win;
+			
+			disp_window(&win);
+			if( g_Sink->configure != NULL ){
+				g_Sink->configure(&win);
+			}
+			
+			// 最後のデコードデータが存在していればそれを表示先に渡す
+			// 保持できていない(VPU再初期化などで破棄された)場合は上書き中の可能性があるので渡さない
+			if( g_Sink->present != NULL && g_LastFrame.y != NULL && g_DecoderState >= 0 && tcc_vpudec_is_frame_held() ){
+				int idx;
+				
+				g_Sink->present(&g_LastFrame, &win);
+				// 再表示したフレームは他のフレームと同じく表示待ちキューから返す
+				// (次のフレームで保持を解くと、まだ表示しているバッファにVPUが書き込んでしまう)
+				if( g_ReleaseByDisplay && (idx = tcc_vpudec_unpin_to_display()) >= 0 ){
+					disp_queue_push(idx);
+				}
+			}
+		}
+	}
+}
+
+// decodeが走っていなければ呼び出し側で反映し、走っていればdecode側のフレーム境界に任せる
+static void ctrl_kick(void)
+{
+	while( g_Ctrl.pending != 0 && pthread_mutex_trylock(&g_Mutex) == 0 ){
+		ctrl_apply_locked();
+		pthread_mutex_unlock(&g_Mutex);
+	}
+}
+
+// アイドル時の省電力 : 入力がg_IdleTimeoutMs途絶えたらVPUとフレームバッファを解放する
+// 最新のSPS/PPSとIDRはデコーダがキャッシュしていて、次の入力でそこから再開する
+#define IDLE_TICK_MS	100
+
+static pthread_t g_IdleThread;
+static volatile int g_IdleRun = 0;
+static volatile int g_IdleTimeoutMs = 0;	// 0 : 無効
+static pthread_mutex_t g_IdleMutex = PTHREAD_MUTEX_INITIALIZER;	// SetIdleTimeout同士の排他
+
+// 以下はg_Mutexで保護
+static long long g_IdleLastUs = 0;		// 最後に入力を受けた時刻
+static int g_IdleSuspended = 0;			// VPUを解放中
+static long long g_ResumeUs = 0;		// 解放後の最初の入力の時刻 (0 : 再開中でない)
+static VdecIdleStat g_IdleStat;
+
+// g_Mutexを持った状態で呼ぶこと。open/close/デコーダの開き直しで呼ぶ
+static void idle_reset_locked(void)
+{
+	g_IdleLastUs = tcc_vsync_now_us();
+	g_IdleSuspended = 0;
+	g_ResumeUs = 0;
+}
+
+// g_Mutexを持った状態で呼ぶこと。解放したら1を返す
+static int idle_suspend_locked(void)
+{
+	if( g_DecoderState < 0 || g_IdleSuspended || g_IdleTimeoutMs == 0 ){
+		return 0;
+	}
+	if( tcc_vsync_now_us() - g_IdleLastUs < (long long)g_IdleTimeoutMs * 1000 ){
+		return 0;
+	}
+	// Overlayが表示しているのはVPUのフレームバッファそのものなので、見えている間は解放できない
+	if( g_IsViewValid && g_Sink != NULL && g_Sink->zero_copy && g_LastFrame.y != NULL ){
+		return 0;
+	}
+	
+	if( g_Sink != NULL && g_Sink->flush != NULL ){
+		g_Sink->flush();
+	}
+	if( tcc_vpudec_suspend() <= 0 ){
+		return 0;	// VPUがまだ開いていない
+	}
+	// 保持していたフレームもバッファごと無くなる
+	disp_queue_reset();
+	memset( &g_LastFrame, 0, sizeof(DispFrame) );
+	memset( &g_OutGeom, 0, sizeof(VdecEvent) );
+	
+	g_IdleSuspended = 1;
+	g_IdleStat.suspends++;
+	DebugPrint( "idle %d ms : VPU released\n", g_IdleTimeoutMs );
+	tcc_event_post_code(VDEC_EVENT_SUSPEND, g_IdleTimeoutMs);
+	return 1;
+}
+
+static void* idle_thread(void *arg)
+{
+	int suspended;
+	
+	while( g_IdleRun ){
+		usleep( IDLE_TICK_MS * 1000 );
+		
+		// デコード中なら入力が来ているので待たずに次の周期で見る
+		if( pthread_mutex_trylock(&g_Mutex) != 0 ){
+			continue;
+		}
+		suspended = idle_suspend_locked();
+		pthread_mutex_unlock(&g_Mutex);
+		
+		if( suspended ){
+			event_dispatch();
+		}
+	}
+	
+	return NULL;
+}
+
+// g_Mutexを持った状態で呼ぶこと
+// 入力時刻を記録し、解放後の最初の入力から最初の出力までを再開時間として計る
+static int vdec_decode_locked(unsigned int *inputdata, unsigned int *outputdata)
+{
+	int iret;
+	unsigned int ms;
+	long long now = tcc_vsync_now_us();
+	
+	g_IdleLastUs = now;
+	if( g_IdleSuspended ){
+		// デコーダがキャッシュしたIDRからVPUを初期化し直す
+		g_IdleSuspended = 0;
+		g_ResumeUs = now;
+	}
+	
+	iret = tcc_vpudec_decode(inputdata, outputdata);
+	
+	if( iret >= 0 && g_ResumeUs != 0 ){
+		ms = (unsigned int)((tcc_vsync_now_us() - g_ResumeUs) / 1000);
+		g_ResumeUs = 0;
+		g_IdleStat.resumes++;
+		g_IdleStat.last_resume_ms = ms;
+		if( ms > g_IdleStat.max_resume_ms ){
+			g_IdleStat.max_resume_ms = ms;
+		}
+		DebugPrint( "resumed in %u ms\n", ms );
+		tcc_event_post_code(VDEC_EVENT_RESUME, (int)ms);
+	}
+	
+	return iret;
+}
+
+// ソース切り替え : 新しいストリームを2つ目のVPUインスタンスで裏でデコードし、最初のフレームが出来た
+// フレーム境界で表示を切り替える。古いインスタンスは切り替えたフレームが表示されてから別スレッドで閉じる
+// デコーダは常にg_ActiveSlotを選択しておき、裏のインスタンスを使う間だけg_Mutexの中で切り替える
+#define SWITCH_RETIRE_TICK_MS	10
+#define SWITCH_RETIRE_WAIT_MS	200		// vsyncが取れなくてもこれだけ待てば表示は切り替わっている
+
+static int g_ActiveSlot = 0;			// 表示中のデコーダ
+static int g_SwitchSlot = -1;			// プリロール中のデコーダ (-1 : 無し)
+static int g_SwitchContainer = CONTAINER_NONE;
+static long long g_SwitchStartUs = 0;
+static int g_RetireSlot = -1;			// 切り替え後に閉じる古いデコーダ (-1 : 無し)
+static unsigned int g_RetireGen = 0;	// 閉じるスレッドが古い切り替えのものか見分ける
+static int g_RetireWaitVsync = 0;
+static VsyncStamp g_RetireStamp;		// 新しいデコーダの最初の表示
+
+// g_Mutexを持った状態で呼ぶこと
+static void switch_close_slot_locked(int slot)
+{
+	tcc_vpudec_select(slot);
+	tcc_vpudec_close();
+	tcc_vpudec_select(g_ActiveSlot);
+}
+
+// 古いデコーダのフレームは新しいフレームがラッチされるまでスキャンアウトされている。待った時間(ms)を返す
+static int switch_retire_wait(void)
+{
+	int waited;
+	
+	for( waited = 0; waited < SWITCH_RETIRE_WAIT_MS; waited += SWITCH_RETIRE_TICK_MS ){
+		if( !g_RetireWaitVsync || tcc_vsync_latched(&g_RetireStamp) ){
+			break;
+		}
+		usleep( SWITCH_RETIRE_TICK_MS * 1000 );
+	}
+	return waited;
+}
+
+// g_Mutexを持った状態で呼ぶこと。プリロール中と切り替え待ちのデコーダを閉じる
+static void switch_reset_locked(void)
+{
+	if( g_RetireSlot >= 0 ){
+		// 切り替えの直後ならまだ古いデコーダのフレームが表示されている : 解放する前に切り替えを待つ
+		// (閉じるスレッドはg_RetireSlotが空なので何もしない)
+		switch_retire_wait();
+		switch_close_slot_locked(g_RetireSlot);
+		g_RetireSlot = -1;
+	}
+	if( g_SwitchSlot >= 0 ){
+		switch_close_slot_locked(g_SwitchSlot);
+		g_SwitchSlot = -1;
+	}
+}
+
+static void* switch_retire_thread(void *arg)
+{
+	unsigned int gen = (unsigned int)(intptr_t)arg;
+	int waited;
+	
+	waited = switch_retire_wait();
+	
+	pthread_mutex_lock(&g_Mutex);
+	if( gen == g_RetireGen && g_RetireSlot >= 0 ){
+		switch_close_slot_locked(g_RetireSlot);
+		g_RetireSlot = -1;
+		DebugPrint( "old decoder closed after %d ms\n", waited );
+	}
+	pthread_mutex_unlock(&g_Mutex);
+	
+	return NULL;
+}
+
+// 2015.04.23 N.Tanaka
+// 描画可否のフラグを追加/設定する
+int tcc_SetViewValidFlag(int isValid)
+{
+	ctrl_publish_begin();
+	g_Ctrl.view_valid = isValid;
+	ctrl_publish_end(CTRL_PENDING_VIEW);
+	
+	ctrl_kick();
+	
+	return 0;
+}
+
+int tcc_vdec_SetViewFlag(int isValid)
+{
+	return tcc_SetViewValidFlag(isValid);
+}
+
+int tcc_vdec_SetSkipMode(int level, int interval)
+{
+	// 下位層が受け付けないレベルは反映されないので、ここで失敗を返す
+	if( level < VDEC_SKIP_FRAME_DISABLE || level > VDEC_SKIP_FRAME_ONLY_B || interval < 0 ){
+		ErrorPrint( "invalid skip mode %d/%d\n", level, interval );
+		return -1;
+	}
+	
+	ctrl_publish_begin();
+	g_Ctrl.skip_level = level;
+	g_Ctrl.skip_interval = interval;
+	ctrl_publish_end(CTRL_PENDING_SKIP);
+	
+	ctrl_kick();
+	
+	return 0;
+}
+
+int tcc_vdec_StartDump(const char *prefix)
+{
+	int ret;
+	
+	pthread_mutex_lock(&g_Mutex);
+	ret = tcc_frame_dump_start(prefix);
+	pthread_mutex_unlock(&g_Mutex);
+	
+	return ret;
+}
+
+int tcc_vdec_StopDump(void)
+{
+	FrameDumpStat stat;
+	pthread_t thread;
+	int joinable;
+	
+	pthread_mutex_lock(&g_Mutex);
+	joinable = tcc_frame_dump_stop_signal(&thread);
+	pthread_mutex_unlock(&g_Mutex);
+	
+	// 書き込みスレッドの flush 中もデコードは止めない
+	if( joinable ){
+		tcc_frame_dump_stop_join(thread);
+	}
+	tcc_frame_dump_get_stat(&stat);
+	
+	printf("[TCC_VDEC_API] dump : queued %u, written %u, dropped %u\n", stat.queued, stat.written, stat.dropped);
+	return 0;
+}
+
+int tcc_vdec_StartCapture(const char *path)
+{
+	int ret;
+	
+	pthread_mutex_lock(&g_Mutex);
+	ret = tcc_stream_capture_start(path);
+	pthread_mutex_unlock(&g_Mutex);
+	
+	return ret;
+}
+
+int tcc_vdec_StopCapture(void)
+{
+	pthread_mutex_lock(&g_Mutex);
+	tcc_stream_capture_stop();
+	pthread_mutex_unlock(&g_Mutex);
+	
+	return 0;
+}
+
+int tcc_vdec_Replay(const char *path, int realtime)
+{
+	int ret;
+	
+	// 通常のAPIを記録時と同じ順番で呼ぶだけなので、ロックはそれぞれのAPIで取る
+	ret = tcc_stream_replay(path, realtime);
+	
+	pthread_mutex_lock(&g_Mutex);
+	tcc_event_post_code(VDEC_EVENT_EOS, (ret < 0) ? -1 : 0);
+	pthread_mutex_unlock(&g_Mutex);
+	event_dispatch();
+	
+	return (ret < 0) ? -1 : 0;
+}
+
+// ファイル再生中のプレイヤー（停止要求用）
+static FilePlayer *g_Player = NULL;
+static Mp4Demux *g_Mp4 = NULL;
+static TsDemux *g_TsFile = NULL;
+static pthread_mutex_t g_PlayerMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// トリックプレイの速度 (1 : 通常再生)、次に再生するファイルにも使う (g_PlayerMutex)
+static int g_TrickSpeed = 1;
+
+// DVBなどから流し込むTSのデマックス (FeedTsとStartTs/StopTsの排他はg_TsMutex)
+static TsDemux *g_TsLive = NULL;
+static pthread_mutex_t g_TsMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// RTPの受信 (FeedRtpとStartRtp/StopRtpの排他はg_RtpMutex)
+static RtpDepack *g_Rtp = NULL;
+static pthread_mutex_t g_RtpMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// g_Mutexを取った状態で呼ぶこと
+// タイムスタンプの扱いはVPUの初期化時に決まるので、種類が変わる時はデコーダを開き直す
+static void vdec_set_container_locked(int type)
+{
+	if( g_ContainerType == type ){
+		return;
+	}
+	g_ContainerType = type;
+	
+	if( g_DecoderState >= 0 ){
+		if( g_Sink != NULL && g_Sink->flush != NULL ){
+			g_Sink->flush();
+		}
+		tcc_vpudec_close();
+		disp_queue_reset();
+		memset( &g_LastFrame, 0, sizeof(DispFrame) );
+		memset( &g_OutGeom, 0, sizeof(VdecEvent) );
+		g_DecoderState = tcc_vpudec_init_container(800, 476, g_ContainerType);
+		idle_reset_locked();
+		if( g_DecoderState >= 0 ){
+			tcc_vpudec_set_skip_mode(g_SkipLevel, g_SkipInterval);
+			tcc_vpudec_set_release_mode(g_ReleaseByDisplay);
+		}
+	}
+}
+
+// g_PlayerMutexを取った状態で呼ぶこと (順番は g_PlayerMutex → g_TsMutex / g_RtpMutex → g_Mutex)
+// ライブ入力(StartTs/StartRtp)の受信中か。ファイル再生とはコンテナの種類を取り合うので同時には動かさない
+static int vdec_live_active_locked(void)
+{
+	int active;
+	
+	pthread_mutex_lock(&g_TsMutex);
+	active = (g_TsLive != NULL);
+	pthread_mutex_unlock(&g_TsMutex);
+	pthread_mutex_lock(&g_RtpMutex);
+	active |= (g_Rtp != NULL);
+	pthread_mutex_unlock(&g_RtpMutex);
+	
+	return active;
+}
+
+// g_PlayerMutexを取った状態で呼ぶこと
+static int vdec_file_active_locked(void)
+{
+	return (g_Player != NULL || g_Mp4 != NULL || g_TsFile != NULL);
+}
+
+// g_PlayerMutex, g_Mutexを取らずに呼ぶこと
+// 再生中のファイルの速度をデコーダへ反映する (再生中でなければ通常に戻す)
+// Iピクチャだけを送っている間はデコーダ側でもフレーム番号の飛びやレートの計測を無視させる
+static void vdec_trick_apply(void)
+{
+	pthread_mutex_lock(&g_PlayerMutex);
+	pthread_mutex_lock(&g_Mutex);
+	if( g_DecoderState >= 0 ){
+		tcc_vpudec_set_trick((g_Player != NULL || g_Mp4 != NULL) ? g_TrickSpeed : 1);
+	}
+	pthread_mutex_unlock(&g_Mutex);
+	pthread_mutex_unlock(&g_PlayerMutex);
+}
 
-// FB Driver
-#define FB_DEV "/dev/fb0"
+int tcc_vdec_PlayFile(const char *path, int fps)
+{
+	FilePlayer *player;
+	int ret;
+	
+	player = tcc_file_player_open(path);
+	if( player == NULL )
+		return -1;
+	
+	pthread_mutex_lock(&g_PlayerMutex);
+	if( vdec_file_active_locked() || vdec_live_active_locked() )
+	{
+		// 同時に再生できるのは1ファイルのみ、ライブ入力の受信中も再生しない
+		pthread_mutex_unlock(&g_PlayerMutex);
+		tcc_file_player_close(player);
+		return -1;
+	}
+	g_Player = player;
+	player->speed = g_TrickSpeed;
+	pthread_mutex_unlock(&g_PlayerMutex);
+	
+	vdec_trick_apply();
+	
+	// AUはファイルのマッピングから直接デコーダへ渡す（コピーなし）
+	ret = tcc_file_player_play(player, fps);
+	
+	pthread_mutex_lock(&g_Mutex);
+	tcc_event_post_code(VDEC_EVENT_EOS, (ret < 0) ? -1 : 0);
+	pthread_mutex_unlock(&g_Mutex);
+	event_dispatch();
+	
+	pthread_mutex_lock(&g_PlayerMutex);
+	g_Player = NULL;
+	pthread_mutex_unlock(&g_PlayerMutex);
+	vdec_trick_apply();
+	tcc_file_player_close(player);
+	
+	return (ret < 0) ? -1 : 0;
+}
+
+int tcc_vdec_PlayMp4(const char *path, int realtime)
+{
+	Mp4Demux *mp4;
+	int prev_container;
+	int ret;
+	
+	mp4 = tcc_mp4_demux_open(path);
+	if( mp4 == NULL )
+		return -1;
+	
+	pthread_mutex_lock(&g_PlayerMutex);
+	if( vdec_file_active_locked() || vdec_live_active_locked() )
+	{
+		// 同時に再生できるのは1ファイルのみ、ライブ入力の受信中も再生しない
+		pthread_mutex_unlock(&g_PlayerMutex);
+		tcc_mp4_demux_close(mp4);
+		return -1;
+	}
+	g_Mp4 = mp4;
+	mp4->speed = g_TrickSpeed;
+	pthread_mutex_unlock(&g_PlayerMutex);
+	
+	// MP4はPTS(表示順)のタイムスタンプを渡す
+	// コンテナが変わるとデコーダを開き直すので、トリックプレイの設定はその後
+	pthread_mutex_lock(&g_Mutex);
+	prev_container = g_ContainerType;
+	vdec_set_container_locked(CONTAINER_MP4);
+	pthread_mutex_unlock(&g_Mutex);
+	vdec_trick_apply();
+	
+	ret = tcc_mp4_demux_play(mp4, realtime);
+	
+	// 再生前の種類に戻す
+	pthread_mutex_lock(&g_Mutex);
+	tcc_event_post_code(VDEC_EVENT_EOS, (ret < 0) ? -1 : 0);
+	vdec_set_container_locked(prev_container);
+	pthread_mutex_unlock(&g_Mutex);
+	event_dispatch();
+	
+	pthread_mutex_lock(&g_PlayerMutex);
+	g_Mp4 = NULL;
+	pthread_mutex_unlock(&g_PlayerMutex);
+	vdec_trick_apply();
+	tcc_mp4_demux_close(mp4);
+	
+	return (ret < 0) ? -1 : 0;
+}
+
+int tcc_vdec_PlayTs(const char *path, int realtime)
+{
+	TsDemux *ts;
+	int prev_container;
+	int ret;
+	
+	ts = tcc_ts_demux_create();
+	if( ts == NULL )
+		return -1;
+	
+	pthread_mutex_lock(&g_PlayerMutex);
+	if( vdec_file_active_locked() || vdec_live_active_locked() )
+	{
+		// 同時に再生できるのは1ファイルのみ、ライブ入力の受信中も再生しない
+		pthread_mutex_unlock(&g_PlayerMutex);
+		tcc_ts_demux_destroy(ts);
+		return -1;
+	}
+	g_TsFile = ts;
+	pthread_mutex_unlock(&g_PlayerMutex);
+	
+	// TSはPESのPTSを渡し、VPU側のTS用タイムスタンプ補正を使う
+	pthread_mutex_lock(&g_Mutex);
+	prev_container = g_ContainerType;
+	vdec_set_container_locked(CONTAINER_TS);
+	pthread_mutex_unlock(&g_Mutex);
+	
+	ret = tcc_ts_demux_play_file(ts, path, realtime);
+	
+	// 再生前の種類に戻す
+	pthread_mutex_lock(&g_Mutex);
+	tcc_event_post_code(VDEC_EVENT_EOS, (ret < 0) ? -1 : 0);
+	vdec_set_container_locked(prev_container);
+	pthread_mutex_unlock(&g_Mutex);
+	event_dispatch();
+	
+	pthread_mutex_lock(&g_PlayerMutex);
+	g_TsFile = NULL;
+	pthread_mutex_unlock(&g_PlayerMutex);
+	tcc_ts_demux_destroy(ts);
+	
+	return (ret < 0) ? -1 : 0;
+}
+
+int tcc_vdec_StartTs(void)
+{
+	// ファイル再生中は受信しない (再生が終わるとコンテナの種類を戻すため)
+	pthread_mutex_lock(&g_PlayerMutex);
+	if( vdec_file_active_locked() ){
+		pthread_mutex_unlock(&g_PlayerMutex);
+		return -1;
+	}
+	pthread_mutex_lock(&g_TsMutex);
+	pthread_mutex_unlock(&g_PlayerMutex);
+	if( g_TsLive == NULL ){
+		g_TsLive = tcc_ts_demux_create();
+		if( g_TsLive == NULL ){
+			pthread_mutex_unlock(&g_TsMutex);
+			return -1;
+		}
+		pthread_mutex_lock(&g_Mutex);
+		vdec_set_container_locked(CONTAINER_TS);
+		pthread_mutex_unlock(&g_Mutex);
+	}
+	pthread_mutex_unlock(&g_TsMutex);
+	
+	return 0;
+}
+
+int tcc_vdec_FeedTs(const unsigned char *data, int size)
+{
+	int ret = -1;
+	
+	pthread_mutex_lock(&g_TsMutex);
+	if( g_TsLive != NULL ){
+		ret = tcc_ts_demux_feed(g_TsLive, data, size);
+	}
+	pthread_mutex_unlock(&g_TsMutex);
+	
+	return ret;
+}
+
+int tcc_vdec_StopTs(void)
+{
+	pthread_mutex_lock(&g_TsMutex);
+	if( g_TsLive != NULL ){
+		tcc_ts_demux_destroy(g_TsLive);
+		g_TsLive = NULL;
+		pthread_mutex_lock(&g_Mutex);
+		vdec_set_container_locked(CONTAINER_NONE);
+		pthread_mutex_unlock(&g_Mutex);
+	}
+	pthread_mutex_unlock(&g_TsMutex);
+	
+	return 0;
+}
+
+int tcc_vdec_StartRtp(int jitter_depth)
+{
+	// ファイル再生中は受信しない (再生が終わるとコンテナの種類を戻すため)
+	pthread_mutex_lock(&g_PlayerMutex);
+	if( vdec_file_active_locked() ){
+		pthread_mutex_unlock(&g_PlayerMutex);
+		return -1;
+	}
+	pthread_mutex_lock(&g_RtpMutex);
+	pthread_mutex_unlock(&g_PlayerMutex);
+	if( g_Rtp == NULL ){
+		g_Rtp = tcc_rtp_depack_create(jitter_depth);
+		if( g_Rtp == NULL ){
+			pthread_mutex_unlock(&g_RtpMutex);
+			return -1;
+		}
+		// RTPのタイムスタンプは表示時刻なので、MP4と同じくPTSとして扱う
+		pthread_mutex_lock(&g_Mutex);
+		vdec_set_container_locked(CONTAINER_MP4);
+		pthread_mutex_unlock(&g_Mutex);
+	}
+	pthread_mutex_unlock(&g_RtpMutex);
+	
+	return 0;
+}
+
+int tcc_vdec_FeedRtp(const unsigned char *packet, int size)
+{
+	int ret = -1;
+	
+	pthread_mutex_lock(&g_RtpMutex);
+	if( g_Rtp != NULL ){
+		ret = tcc_rtp_depack_push(g_Rtp, packet, size);
+	}
+	pthread_mutex_unlock(&g_RtpMutex);
+	
+	return ret;
+}
+
+int tcc_vdec_StopRtp(void)
+{
+	RtpDepackStat stat;
+	
+	pthread_mutex_lock(&g_RtpMutex);
+	if( g_Rtp != NULL ){
+		tcc_rtp_depack_get_stat(g_Rtp, &stat);
+		tcc_rtp_depack_destroy(g_Rtp);
+		g_Rtp = NULL;
+		pthread_mutex_lock(&g_Mutex);
+		vdec_set_container_locked(CONTAINER_NONE);
+		pthread_mutex_unlock(&g_Mutex);
+		
+		printf("[TCC_VDEC_API] rtp : packets %u, lost %u, late %u, au %u, au dropped %u\n",
+				stat.packets, stat.lost, stat.late, stat.au, stat.au_dropped);
+	}
+	pthread_mutex_unlock(&g_RtpMutex);
+	
+	return 0;
+}
+
+int tcc_vdec_NotifyStreamLoss(void)
+{
+	VdecKeyframeCallback cb = NULL;
+	void *user = NULL;
+	unsigned int reason = 0;
+	
+	pthread_mutex_lock(&g_Mutex);
+	if( g_DecoderState >= 0 ){
+		// 欠けた参照フレームでデコードを続けず、次のIフレームまで飛ばす
+		tcc_vpudec_request_iframe_search();
+		// 次のIフレームを待たずに送信側へ要求する
+		reason = keyframe_poll_locked(&cb, &user);
+	}
+	pthread_mutex_unlock(&g_Mutex);
+	keyframe_notify(reason, cb, user);
+	
+	return 0;
+}
+
+int tcc_vdec_SetKeyframeCallback(VdecKeyframeCallback cb, void *user, int min_interval_ms)
+{
+	if( min_interval_ms < 0 ){
+		return -1;
+	}
+	
+	pthread_mutex_lock(&g_Mutex);
+	g_KeyframeCb = cb;
+	g_KeyframeUser = user;
+	g_KeyframeIntervalMs = (min_interval_ms > 0) ? min_interval_ms : VDEC_KEYFRAME_MIN_INTERVAL_MS;
+	g_KeyframeLastUs = 0;
+	g_KeyframeHeld = 0;
+	pthread_mutex_unlock(&g_Mutex);
+	
+	return 0;
+}
+
+int tcc_vdec_GetTelemetry(VdecTelemetry *tel)
+{
+	if( tel == NULL ){
+		return -1;
+	}
+	
+	pthread_mutex_lock(&g_Mutex);
+	tcc_telemetry_get(tel);
+	pthread_mutex_unlock(&g_Mutex);
+	
+	return 0;
+}
+
+int tcc_vdec_GetSanitizeStat(BsSanitizeStat *stat)
+{
+	if( stat == NULL ){
+		return -1;
+	}
+	
+	pthread_mutex_lock(&g_Mutex);
+	tcc_bs_sanitize_get_stat(stat);
+	pthread_mutex_unlock(&g_Mutex);
+	
+	return 0;
+}
+
+int tcc_vdec_GetWatchdogStat(VpuWatchdogStat *stat)
+{
+	if( stat == NULL ){
+		return -1;
+	}
+	
+	// g_MutexはVPUが固まっている間デコードスレッドが持ったままなので取らない
+	tcc_vpu_watchdog_get_stat(stat);
+	
+	return 0;
+}
+
+int tcc_vdec_InjectFault(int fault, int permille)
+{
+#ifdef VDEC_FAULT_INJECT
+	int ret = 0;
+	
+	pthread_mutex_lock(&g_Mutex);
+	if( fault < 0 ){
+		tcc_vpu_fault_reset();
+	}else{
+		ret = tcc_vpu_fault_set(fault, permille);
+	}
+	pthread_mutex_unlock(&g_Mutex);
+	
+	return ret;
+#else
+	return -1;
+#endif
+}
+
+int tcc_vdec_GetFaultStat(VpuFaultStat *stat)
+{
+#ifdef VDEC_FAULT_INJECT
+	if( stat == NULL ){
+		return -1;
+	}
+	
+	pthread_mutex_lock(&g_Mutex);
+	tcc_vpu_fault_get_stat(stat);
+	pthread_mutex_unlock(&g_Mutex);
+	
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+int tcc_vdec_SetIdleTimeout(int timeout_ms)
+{
+	int ret = 0;
+	
+	if( timeout_ms < 0 ){
+		return -1;
+	}
+	
+	pthread_mutex_lock(&g_IdleMutex);
+	g_IdleTimeoutMs = timeout_ms;
+	if( timeout_ms > 0 && !g_IdleRun ){
+		g_IdleRun = 1;
+		if( pthread_create(&g_IdleThread, NULL, idle_thread, NULL) != 0 ){
+			ErrorPrint( "idle thread create fail\n" );
+			g_IdleRun = 0;
+			g_IdleTimeoutMs = 0;
+			ret = -1;
+		}
+	}else if( timeout_ms == 0 && g_IdleRun ){
+		g_IdleRun = 0;
+		pthread_join(g_IdleThread, NULL);	// 1周期以内に終わる
+	}
+	pthread_mutex_unlock(&g_IdleMutex);
+	
+	return ret;
+}
 
-typedef struct _DecodeDate {
+int tcc_vdec_GetIdleStat(VdecIdleStat *stat)
+{
+	if( stat == NULL ){
+		return -1;
+	}
 	
-	int 					OverlayDrv;		//overlay driver handler
-	bool					IsViewValid;	//view valid ?
-	bool					IsDecoderOpen;	//whether decode is in use ?
-	bool					IsConfigured;	//whether be configured ?
-	unsigned int			default_ovp;	//set overlay layer
-	unsigned int			LCD_width;		//LCD size - width
-	unsigned int			LCD_height;		//LCD size - height
-	overlay_video_buffer_t	lastinfo;		//backup last_overlay_info
+	pthread_mutex_lock(&g_Mutex);
+	memcpy( stat, &g_IdleStat, sizeof(VdecIdleStat) );
+	stat->suspended = g_IdleSuspended;
+	pthread_mutex_unlock(&g_Mutex);
 	
-	pthread_mutex_t 		mutex_lock;
-} DecodeDate;
+	return 0;
+}
 
-static int g_OverlayDrv = -1;
+unsigned int tcc_vdec_GetHeapOps(void)
+{
+	return tcc_vpudec_heap_ops();
+}
 
-// Decoder State
-static int g_DecoderState = -1;
+int tcc_vdec_GetEventFd(void)
+{
+	int fd;
+	
+	pthread_mutex_lock(&g_EventMutex);
+	fd = tcc_event_fd();
+	pthread_mutex_unlock(&g_EventMutex);
+	
+	return fd;
+}
 
+int tcc_vdec_GetEvent(VdecEvent *ev)
+{
+	int ret;
+	
+	if( ev == NULL ){
+		return -1;
+	}
+	
+	pthread_mutex_lock(&g_EventMutex);
+	ret = tcc_event_get(ev);
+	pthread_mutex_unlock(&g_EventMutex);
+	
+	return ret;
+}
 
-// 描画可否フラグ
-static int g_IsViewValid = 0;	// 0:不可, 1:可
+int tcc_vdec_SetEventCallback(VdecEventCallback cb, void *user)
+{
+	pthread_mutex_lock(&g_EventMutex);
+	g_EventCb = cb;
+	g_EventUser = user;
+	pthread_mutex_unlock(&g_EventMutex);
+	
+	// 設定前に溜まっていたイベントもすぐに配る
+	event_dispatch();
+	
+	return 0;
+}
 
-// SetConfigureを行ったかどうか
-static int g_IsSetConfigure = 0;	// 0:未設定, 1:設定済
-static unsigned int ignore = 1;
-// 一番最後にDecodeした画像情報
-static overlay_video_buffer_t g_lastinfo;
+int tcc_vdec_StopFile(void)
+{
+	pthread_mutex_lock(&g_PlayerMutex);
+	tcc_file_player_stop(g_Player);
+	tcc_mp4_demux_stop(g_Mp4);
+	tcc_ts_demux_stop(g_TsFile);
+	pthread_mutex_unlock(&g_PlayerMutex);
+	
+	return 0;
+}
 
-// Mutex
-static pthread_mutex_t g_Mutex = PTHREAD_MUTEX_INITIALIZER;
+int tcc_vdec_SetTrickSpeed(int speed)
+{
+	if( speed < 1 || speed > VDEC_TRICK_MAX_SPEED ){
+		ErrorPrint( "invalid trick speed %d\n", speed );
+		return -1;
+	}
+	
+	pthread_mutex_lock(&g_PlayerMutex);
+	g_TrickSpeed = speed;
+	tcc_file_player_set_speed(g_Player, speed);
+	tcc_mp4_demux_set_speed(g_Mp4, speed);
+	pthread_mutex_unlock(&g_PlayerMutex);
+	
+	// ライブ入力やTSの再生中はデコーダの設定を変えない
+	vdec_trick_apply();
+	
+	return 0;
+}
 
-static void SetConfigure(void)
+int tcc_vdec_init(int sx, int sy, int width, int height)
 {
-	overlay_config_t cfg;
-	unsigned int format = (unsigned int)'N' | (unsigned int)'V'<<8 | (unsigned int)'1'<<16 | (unsigned int)'2'<<24;
-	cfg.sx = 0;
-	cfg.sy = 0;
-	cfg.width = 800;
-	cfg.height = 480;
-	cfg.format = format;
-	cfg.transform = 0;
-	ioctl( g_OverlayDrv, OVERLAY_SET_CONFIGURE, &cfg );
-	g_IsSetConfigure = 1;
+	int visible=1;
+	
+	if( width > 0 && height > 0 ){
+		ctrl_publish_begin();
+		g_Ctrl.sx = sx;
+		g_Ctrl.sy = sy;
+		g_Ctrl.width = width;
+		g_Ctrl.height = height;
+		ctrl_publish_end(CTRL_PENDING_GEOMETRY);
+	}
 	
+	tcc_SetViewValidFlag(visible);
+	return 0;
 }
 
-// 2015.04.23 N.Tanaka
-// 描画可否のフラグを追加/設定する
-int tcc_SetViewValidFlag(int isValid)
+int tcc_vdec_SetDisplaySink(const DispSink *sink)
 {
+	// 次のtcc_vdec_openから有効
 	pthread_mutex_lock(&g_Mutex);
+	g_SinkWanted = sink;
+	pthread_mutex_unlock(&g_Mutex);
 	
-	g_IsViewValid = isValid;
+	return 0;
+}
+
+// g_Mutexを持った状態で呼ぶこと
+static void vdec_sink_open_locked(void)
+{
+	const DispSink *sink = g_SinkWanted;
 	
-	// 無効から有効に状態が変わった際に、最後のデータを描画する
-	if( isValid == 1 ){
-		
-		// Overlay Driverが開かれている時
-		if( g_OverlayDrv >= 0 ){
-			
-			// SetConfigureを呼んでいない場合には呼ぶ
-			if( g_IsSetConfigure == 0 ){
-				
-				SetConfigure();
-			}
-			
-			// 最後のデコードデータが存在していればそれをDriverに渡す
-			if( g_lastinfo.addr != 0 ){	// Addressが0かどうかでデータが存在しているのかを判断する
-				ioctl( g_OverlayDrv, OVERLAY_PUSH_VIDEO_BUFFER, &g_lastinfo );
-			}
+	if( sink == NULL ){
+		sink = tcc_disp_sink_overlay();
+		if( sink->open() < 0 ){
+			// Overlayが無い場合はFBへのソフトウェア描画に切り替える
+			sink = tcc_disp_sink_fb();
+		}else{
+			g_Sink = sink;
+		}
+	}
+	if( g_Sink == NULL ){
+		if( sink->open != NULL && sink->open() < 0 ){
+			ErrorPrint( "Error : display sink '%s' is not available\n", sink->name );
+			return;
 		}
+		g_Sink = sink;
 	}
 	
-	pthread_mutex_unlock(&g_Mutex);
+	if( g_Sink->zero_copy ){
+		// 表示先がバッファを表示し終えてからVPUに返す
+		tcc_vsync_start();
+		g_ReleaseByDisplay = 1;
+	}
 	
-	return 0;
+	if( g_IsViewValid && g_Sink->configure != NULL ){	// 2015.04.23 : N.Tanaka 描画可否を判断する
+		DispWindow win;
+		
+		disp_window(&win);
+		g_Sink->configure(&win);
+	}
 }
 
-int tcc_vdec_init(int sx, int sy, int width, int height)
+// g_Mutexを持った状態で呼ぶこと
+static void vdec_sink_close_locked(void)
 {
-	int visible=1;
-	tcc_SetViewValidFlag(visible);
-	return 0;
+	if( g_Sink != NULL ){
+		if( g_Sink->flush != NULL ){
+			g_Sink->flush();
+		}
+		if( g_Sink->close != NULL ){
+			g_Sink->close();
+		}
+		g_Sink = NULL;
+	}
+	tcc_vsync_stop();
+	disp_queue_reset();
+	g_ReleaseByDisplay = 0;
 }
 
 int tcc_vdec_open(void)
 {
-	overlay_config_t cfg;
-	unsigned int format = (unsigned int)'N' | (unsigned int)'V'<<8 | (unsigned int)'1'<<16 | (unsigned int)'2'<<24;
-	
+	int ret;
 	
 	pthread_mutex_lock(&g_Mutex);
 	
-	// 2015.04.23 N.Tanaka SetConfigureしたかのフラグ。停止時にフラグ解除はしているが、念のためここでもフラグ解除
-	g_IsSetConfigure = 0;
+	memset( &g_LastFrame, 0, sizeof(DispFrame) );
+	memset( &g_OutGeom, 0, sizeof(VdecEvent) );
+	tcc_telemetry_reset();
+	tcc_bs_sanitize_reset();
+	memset( &g_IdleStat, 0, sizeof(VdecIdleStat) );
+	idle_reset_locked();
 	
-	memset( &g_lastinfo, 0, sizeof(overlay_video_buffer_t) );
+	switch_reset_locked();
 	
 	// AndroidAutoでCloseされないので、Openされている時には一度閉じてあげる
 	if( g_DecoderState >= 0 ){
@@ -145,85 +1285,51 @@ int tcc_vdec_open(void)
 		g_DecoderState = tcc_vpudec_init(800, 480);
 		#else
 		// 2015.3.2 yuichi mod
-		g_DecoderState = tcc_vpudec_init(800, 476);
+		g_DecoderState = tcc_vpudec_init_container(800, 476, g_ContainerType);
 		#endif
 	}
-	
-	// Overlay Driver準備
-	if( g_OverlayDrv >= 0 ){
-		close( g_OverlayDrv );
+	if( g_DecoderState >= 0 ){
+		tcc_vpudec_set_skip_mode(g_SkipLevel, g_SkipInterval);
 	}
-	g_OverlayDrv = -1;
 	
-	g_OverlayDrv = open( OVERLAY_DRIVER, O_RDWR );
-	if( g_OverlayDrv < 0 ){
-		ErrorPrint( "Error : Overlay Driver Open Fail\n" );
-	}else{
-		cfg.sx = 0;
-		cfg.sy = 0;
-		cfg.width = 800;
-		#if 0
-		cfg.height = 480;
-		#else
-		// 2015.3.2 yuichi mod
-		cfg.height = 480;
-		#endif
-		cfg.format = format;
-		cfg.transform = 0;
-		
-		if(g_IsViewValid){	// 2015.04.23 : N.Tanaka 描画可否を判断する
-			ioctl( g_OverlayDrv, OVERLAY_SET_IGNORE_PRIORITY, &ignore );
-			ioctl( g_OverlayDrv, OVERLAY_SET_CONFIGURE, &cfg );
-			g_IsSetConfigure = 1;
-		}
-	}
-	int fbdev;
-	int ovp=8;
-	fbdev = open(FB_DEV, O_RDWR);
-	if ( fbdev < 0 ) {
-		printf("Error opening %s.\n", FB_DEV);
-		return 1;
-	}
-	if ( ioctl(fbdev, TCC_LCDC_SET_WMIXER_OVP, &ovp) < 0 ) {
-		printf("FB Driver IOCTL ERROR\n");
-		close(fbdev);
-		return 1;
+	// 表示先の準備 : 開き直しの場合は前回の表示先を閉じる
+	vdec_sink_close_locked();
+	
+	// 表示先を開く前に未反映の設定(描画可否など)を取り込んでおく
+	ctrl_apply_locked();
+	
+	vdec_sink_open_locked();
+	
+	if( g_DecoderState >= 0 ){
+		tcc_vpudec_set_release_mode(g_ReleaseByDisplay);
+		tcc_event_post_code(VDEC_EVENT_INPUT_READY, 0);
 	}
+	// デコーダが開けなければ失敗 (表示先は開いたまま、tcc_vdec_closeで閉じる)
+	ret = ( g_DecoderState >= 0 ) ? 0 : -1;
 
 	pthread_mutex_unlock(&g_Mutex);
+	event_dispatch();
+	ctrl_kick();
 	
-	return 0;
+	return ret;
 }
 
 int tcc_vdec_close(void)
 {
 	pthread_mutex_lock(&g_Mutex);
 	
-	if( g_OverlayDrv >= 0 ){
-		close( g_OverlayDrv );
-	}
-	g_OverlayDrv = -1;
-	g_IsSetConfigure = 0;	// 2015.04.23 : N.Tanaka
+	vdec_sink_close_locked();
 	
+	switch_reset_locked();
 	if( g_DecoderState >= 0 ){
 		tcc_vpudec_close();
 	}
 	g_DecoderState = -1;
+	idle_reset_locked();
 	
-	memset( &g_lastinfo, 0, sizeof(overlay_video_buffer_t) );	// 2015.04.24 N.Tanaka
+	memset( &g_LastFrame, 0, sizeof(DispFrame) );	// 2015.04.24 N.Tanaka
+	memset( &g_OutGeom, 0, sizeof(VdecEvent) );
 	
-	int fbdev;
-	int ovp=24;
-	fbdev = open(FB_DEV, O_RDWR);
-	if ( fbdev < 0 ) {
-		printf("Error opening %s.\n", FB_DEV);
-		return 1;
-	}
-	if ( ioctl(fbdev, TCC_LCDC_SET_WMIXER_OVP, &ovp) < 0 ) {
-		printf("FB Driver IOCTL ERROR\n");
-		close(fbdev);
-		return 1;
-	}
 	pthread_mutex_unlock(&g_Mutex);
 	
 	return 0;
@@ -232,7 +1338,10 @@ int tcc_vdec_close(void)
 int tcc_vdec_process_annexb_header( unsigned char* data, int datalen)
 {
 	int iret = 0;
-	unsigned int outputdata[11] = {0};
+	unsigned int outputdata[16] = {0};
+	VdecKeyframeCallback cb = NULL;
+	void *user = NULL;
+	unsigned int reason;
 	
 	unsigned int inputdata[4] = {0};
 	inputdata[0] = (unsigned int)data;
@@ -246,34 +1355,144 @@ int tcc_vdec_process_annexb_header( unsigned char* data, int datalen)
 		return -1;
 	}
 	
+	ctrl_apply_locked();
+	
+	if( tcc_stream_capture_is_running() ){
+		tcc_stream_capture_push(CAPTURE_CALL_HEADER, data, datalen, 0);
+	}
+	
 	//iret = decoder_decode( data, datalen, outputdata );
-	iret = tcc_vpudec_decode(inputdata, outputdata);
+	iret = vdec_decode_locked(inputdata, outputdata);
 	
 	// Annex-Bヘッダは動画データではないので、描画要求はしない
+	// 万一フレームが出てきた場合はそのままVPUに返す
+	if( iret >= 0 && g_ReleaseByDisplay ){
+		tcc_vpudec_release_frame(outputdata[15]);
+	}
 	
+	// 入力を受け取ったので次のAUを渡せる
+	tcc_event_post_code(VDEC_EVENT_INPUT_READY, 0);
+	reason = keyframe_poll_locked(&cb, &user);
 	
 	pthread_mutex_unlock(&g_Mutex);
+	keyframe_notify(reason, cb, user);
+	event_dispatch();
+	ctrl_kick();
 	
 	return 0;
 }
 
-#define MAX(a,b) (a>b)?a:b
-#define TARGET_WIDTH 800.00
-#define TARGET_HEIGHT 480.00
-float TARGET_RATIO = (TARGET_WIDTH/TARGET_HEIGHT);
 int tcc_vdec_process( unsigned char* data, int size)
+{
+	return tcc_vdec_process_pts( data, size, 0 );
+}
+
+// g_Mutexを持った状態で呼ぶこと。display = 0 はデコードだけして表示しない(サムネイル等)
+// 戻り値 1 : フレームバッファはもうVPUに返した(次のデコードで上書きされる)
+static int vdec_frame_out_locked(unsigned int *outputdata, int display)
+{
+	DispFrame frame;
+	DispWindow win;
+	VdecEvent ev;
+	
+	// 出力サイズかクロップが変わった時だけ通知する
+	memset( &ev, 0, sizeof(VdecEvent) );
+	ev.type = VDEC_EVENT_RESOLUTION;
+	ev.width = outputdata[8] - outputdata[11] - outputdata[13];
+	ev.height = outputdata[9] - outputdata[12] - outputdata[14];
+	ev.crop_left = outputdata[11];
+	ev.crop_top = outputdata[12];
+	ev.crop_right = outputdata[13];
+	ev.crop_bottom = outputdata[14];
+	if( memcmp( &ev, &g_OutGeom, sizeof(VdecEvent) ) != 0 ){
+		DebugPrint( "output %d x %d crop %d,%d,%d,%d\n", ev.width, ev.height, ev.crop_left, ev.crop_top, ev.crop_right, ev.crop_bottom );
+		memcpy( &g_OutGeom, &ev, sizeof(VdecEvent) );
+		tcc_event_post(&ev);
+	}
+	ev.type = VDEC_EVENT_FRAME_READY;
+	ev.pts_ms = outputdata[7];
+	tcc_event_post(&ev);
+	
+	// 現場での解析用 : 別スレッドでファイルに書き出す(書き込みが遅ければ捨てる)
+	if( tcc_frame_dump_is_running() ){
+		tcc_frame_dump_push( (const unsigned char*)outputdata[4], (const unsigned char*)outputdata[5], outputdata[10],
+							outputdata[11], outputdata[12],
+							outputdata[8] - outputdata[11] - outputdata[13], outputdata[9] - outputdata[12] - outputdata[14] );
+	}
+	
+	if( g_Sink == NULL ){
+		ErrorPrint( "Decode but display sink is not opened\n" );
+		display = 0;
+	}else if( g_Sink->present == NULL ){
+		// デコードのみ : 表示処理は一切しない
+		display = 0;
+	}
+	
+	// 表示側が追いついていない : 表示中かもしれないバッファは返せないので、このフレームを表示しない
+	if( display && g_IsViewValid && g_ReleaseByDisplay ){
+		disp_release_latched();
+		if( g_DispQueueCnt == DISP_QUEUE_SIZE ){
+			DebugPrint( "display queue full, frame %d not shown\n", outputdata[15] );
+			display = 0;
+		}
+	}
+	
+	// 表示しないフレームはすぐにVPUに返す
+	if( !display || !g_IsViewValid ){	// 2015.04.23 : N.Tanaka 描画可否を判断する
+		if( g_ReleaseByDisplay ){
+			tcc_vpudec_release_frame(outputdata[15]);
+			return 1;
+		}
+		return 0;
+	}
+	
+	frame.phy[0] = outputdata[1];
+	frame.phy[1] = outputdata[2];
+	frame.phy[2] = outputdata[3];
+	frame.y = (unsigned char*)outputdata[4];
+	frame.uv = (unsigned char*)outputdata[5];
+	frame.pts_ms = outputdata[7];
+	frame.width = outputdata[8];
+	frame.height = outputdata[9];
+	frame.stride = outputdata[10];
+	frame.crop_left = outputdata[11];
+	frame.crop_top = outputdata[12];
+	frame.crop_right = outputdata[13];
+	frame.crop_bottom = outputdata[14];
+	frame.disp_idx = outputdata[15];
+	
+	disp_window(&win);
+	g_Sink->present(&frame, &win);
+	if( g_ReleaseByDisplay ){
+		disp_queue_push(outputdata[15]);
+	}
+	
+	// 新しいフレームに切り替わったので、保持していたフレームを解放する
+	if( tcc_vpudec_is_frame_held() ){
+		tcc_vpudec_hold_frame(-1);
+	}
+	
+	// 2015.04.24 N.Tanaka
+	// 最後のDecodeデータ情報を保持しておく
+	// 非表示中は保持しているフレームの情報を残すため更新しない
+	memcpy( &g_LastFrame, &frame, sizeof(DispFrame) );
+	return 0;
+}
+
+int tcc_vdec_process_pts( unsigned char* data, int size, unsigned int pts_ms)
 {
 	int iret = 0;
 	unsigned int inputdata[4] = {0};
-	unsigned int outputdata[15] = {0};
-	overlay_video_buffer_t info;
-	unsigned int crop_info[4]={0};
-	unsigned int scaler_info[2]={0};
+	unsigned int outputdata[16] = {0};
+	VdecKeyframeCallback cb = NULL;
+	void *user = NULL;
+	unsigned int reason;
 	
 	pthread_mutex_lock(&g_Mutex);
 	
 	inputdata[0] = (unsigned int)data;
 	inputdata[1] = (unsigned int)size;
+	inputdata[2] = pts_ms;
 	
 	if( g_DecoderState == -1 ){
 		ErrorPrint( "decoder is not opened...\n" );
@@ -281,96 +1500,245 @@ int tcc_vdec_process( unsigned char* data, int size)
 		return -1;
 	}
 	
+	// フレーム境界でUI側の設定を反映する
+	ctrl_apply_locked();
+	
+	// 表示が終わったバッファをVPUに返してからデコードする
+	disp_release_latched();
+	
+	// 現場での再現用 : 入力をそのまま記録する
+	if( tcc_stream_capture_is_running() ){
+		tcc_stream_capture_push(CAPTURE_CALL_FRAME, data, size, pts_ms);
+	}
+	
 	//iret = decoder_decode( data, size, outputdata );
-	iret = tcc_vpudec_decode(inputdata, outputdata);
+	iret = vdec_decode_locked(inputdata, outputdata);
 	
 	if( iret >= 0 ){
+		vdec_frame_out_locked(outputdata, 1);
+	}else{
 		
-		if( g_OverlayDrv >= 0 ){
-			
+		ErrorPrint( "Decode fail\n" );
+		
+	}
+	
+	// 入力を受け取ったので次のAUを渡せる
+	tcc_event_post_code(VDEC_EVENT_INPUT_READY, 0);
+	reason = keyframe_poll_locked(&cb, &user);
+	
+	pthread_mutex_unlock(&g_Mutex);
+	keyframe_notify(reason, cb, user);
+	event_dispatch();
+	ctrl_kick();
+	
+	return 0;
+}
 
-			info.cfg.width = outputdata[8];
-			info.cfg.height = outputdata[9];
-			info.cfg.format = (unsigned int)'N' | (unsigned int)'V'<<8 | (unsigned int)'1'<<16 | (unsigned int)'2'<<24;
-			//info.cfg.format = 0;		// 使われてないようなので無視
-			info.cfg.transform = 0;		// 使われてないようなので無視
-			info.addr = outputdata[1];		// Y Address;
-			#if 1	// 2015.3.2 yuichi add, UとVのアドレスも使う
-			info.addr1 = outputdata[2];
-			info.addr2 = outputdata[3];
-			#endif
-			//for crop
-			crop_info[0] = 0;
-			crop_info[1] = 0;
-			crop_info[2] = outputdata[8]-outputdata[13];
-			crop_info[3] = outputdata[9]-outputdata[14];
-
-			///for scaler
-			float ratio0 = (float)info.cfg.width/(float)info.cfg.height;
-			float ratio1 = (float)info.cfg.height/(float)info.cfg.width;
-			//printf("[Yusuf] ratio0=%.5f, ratio1=%.5f, target_ratio=%.5f...\n",ratio0, ratio1, TARGET_RATIO);
-			if((ratio0 >= TARGET_RATIO) || (ratio1 >= TARGET_RATIO)) //ratio is 16:9
-			{
-				if(info.cfg.width > info.cfg.height)
-				{
-					scaler_info[0] = TARGET_WIDTH;
-					//scaler_info[1] = (800*9)/16;
-					scaler_info[1] = (TARGET_WIDTH*(float)crop_info[3])/(float)crop_info[2];
-				}else{
-					//scaler_info[0] = (480*9)/16;
-					scaler_info[0] = (TARGET_HEIGHT*(float)crop_info[2])/(float)crop_info[3];
-					scaler_info[1] = TARGET_HEIGHT;
-				}
-			}else{//ratio is 4:3
-				if(info.cfg.width > info.cfg.height)
-				{
-					scaler_info[0] = (480*4)/3;//(unsigned int)(480.00 * (MAX(ratio0,ratio1))); //640;
-					scaler_info[1] = 480;
+int tcc_vdec_process_batch( const VdecAU *au, VdecAUResult *result, int count)
+{
+	int i;
+	int iret;
+	int released;
+	unsigned int inputdata[4] = {0};
+	unsigned int outputdata[16] = {0};
+	VdecKeyframeCallback cb = NULL;
+	void *user = NULL;
+	unsigned int reason;
+	
+	if( au == NULL || count < 0 ){
+		return -1;
+	}
+	
+	pthread_mutex_lock(&g_Mutex);
+	
+	if( g_DecoderState == -1 ){
+		ErrorPrint( "decoder is not opened...\n" );
+		pthread_mutex_unlock(&g_Mutex);
+		return -1;
+	}
+	
+	// ロックと設定の反映はバッチ全体で一回だけ
+	ctrl_apply_locked();
+	
+	for( i = 0; i < count; i++ ){
+		
+		inputdata[0] = (unsigned int)au[i].data;
+		inputdata[1] = (unsigned int)au[i].size;
+		inputdata[2] = au[i].pts_ms;
+		
+		// 表示が終わったバッファはAUごとに返さないとVPUのバッファが尽きる
+		disp_release_latched();
+		
+		if( tcc_stream_capture_is_running() ){
+			tcc_stream_capture_push(CAPTURE_CALL_FRAME, au[i].data, au[i].size, au[i].pts_ms);
+		}
+		
+		iret = vdec_decode_locked(inputdata, outputdata);
+		
+		released = 0;
+		if( iret >= 0 ){
+			released = vdec_frame_out_locked(outputdata, (au[i].flags & VDEC_AU_FLAG_NO_DISPLAY) == 0);
+		}
+		
+		if( result != NULL ){
+			if( iret >= 0 ){
+				result[i].ret = 0;
+				result[i].pts_ms = outputdata[7];
+				result[i].width = outputdata[8] - outputdata[11] - outputdata[13];
+				result[i].height = outputdata[9] - outputdata[12] - outputdata[14];
+				result[i].stride = outputdata[10];
+				// VPUに返したバッファはバッチの次のAUで上書きされるかもしれないので渡さない
+				if( released ){
+					result[i].y = result[i].uv = NULL;
 				}else{
-					scaler_info[0] = (480*3)/4;//(unsigned int)(480.00 / (MAX(ratio0,ratio1))); //360;
-					scaler_info[1] = 480;
-				}
-			}
-			info.cfg.sx = (800-scaler_info[0])/2;
-			info.cfg.sy = (480-scaler_info[1])/2;
-			printf("[libH264] crop_width=%d, crop_height=%d\n",crop_info[2],crop_info[3]);
-			printf("[libH264] Scaler: src (%d x %d) -- dst (%d x %d) \n", info.cfg.width, info.cfg.height, scaler_info[0], scaler_info[1]);
-			printf("[libH264] (%d,%d) - (%d x %d)... \n",info.cfg.sx, info.cfg.sy, scaler_info[0], scaler_info[1]);
-
-			ioctl( g_OverlayDrv, OVERLAY_SET_CROP_INFO, &crop_info);
-			ioctl( g_OverlayDrv, OVERLAY_SET_SCALER_INFO, &scaler_info);	
-			
-			//printf( "%s: [0]=0x%08x, [1]=0x%08x, [2]=0x%08x\n", __func__, 
-			//		info.addr, info.addr1, info.addr2 );	// yuichi
-			
-			if(g_IsViewValid){	// 2015.04.23 : N.Tanaka 描画可否を判断する
-				
-				// Start時にフラグが立っておらずSetConfigureされていない場合にはここでSetConfiguresする
-				if( g_IsSetConfigure == 0 ){
-					SetConfigure();
+					result[i].y = (unsigned char*)outputdata[4] + outputdata[12] * outputdata[10] + outputdata[11];
+					result[i].uv = (unsigned char*)outputdata[5] + (outputdata[12] / 2) * outputdata[10] + (outputdata[11] & ~1u);
 				}
-				ioctl( g_OverlayDrv, OVERLAY_SET_CONFIGURE, &info.cfg );	
-				ioctl( g_OverlayDrv, OVERLAY_PUSH_VIDEO_BUFFER, &info );
 			}else{
-				//printf("IsViewValid is false...\n");
+				memset( &result[i], 0x00, sizeof(VdecAUResult) );
+				result[i].ret = -1;
 			}
-			
-			// 2015.04.24 N.Tanaka
-			// 最後のDecodeデータ情報を保持しておく
-			memcpy( &g_lastinfo, &info, sizeof(overlay_video_buffer_t) );
-			
-		}else{
-			ErrorPrint( "Decode but Overlay Driver is not opened\n" );
 		}
-		
-	}else{
-		
-		ErrorPrint( "Decode fail\n" );
-		
 	}
 	
+	// 入力を受け取ったので次のAUを渡せる
+	tcc_event_post_code(VDEC_EVENT_INPUT_READY, 0);
+	reason = keyframe_poll_locked(&cb, &user);
+	
 	pthread_mutex_unlock(&g_Mutex);
+	keyframe_notify(reason, cb, user);
+	event_dispatch();
+	ctrl_kick();
 	
 	return 0;
 }
 
+// g_Mutexを持った状態で、プリロール中のデコーダを選択して呼ぶこと。最初のフレームで表示を切り替える
+static void switch_flip_locked(unsigned int *outputdata)
+{
+	pthread_t th;
+	unsigned int ms;
+	
+	// 古いデコーダの表示待ちバッファはデコーダごと閉じるので一つずつ返さない
+	disp_queue_reset();
+	memset( &g_LastFrame, 0, sizeof(DispFrame) );
+	memset( &g_OutGeom, 0, sizeof(VdecEvent) );
+	
+	g_RetireSlot = g_ActiveSlot;
+	g_ActiveSlot = g_SwitchSlot;
+	g_SwitchSlot = -1;
+	g_ContainerType = g_SwitchContainer;
+	idle_reset_locked();
+	
+	vdec_frame_out_locked(outputdata, 1);
+	
+	g_RetireWaitVsync = ( g_ReleaseByDisplay && g_DispQueueCnt > 0 );
+	if( g_RetireWaitVsync ){
+		memcpy( &g_RetireStamp, &g_DispQueue[g_DispQueueCnt-1].stamp, sizeof(VsyncStamp) );
+	}
+	
+	ms = (unsigned int)((tcc_vsync_now_us() - g_SwitchStartUs) / 1000);
+	DebugPrint( "switched to slot %d in %u ms\n", g_ActiveSlot, ms );
+	tcc_event_post_code(VDEC_EVENT_SWITCHED, (int)ms);
+	
+	g_RetireGen++;
+	if( pthread_create(&th, NULL, switch_retire_thread, (void*)(intptr_t)g_RetireGen) == 0 ){
+		pthread_detach(th);
+	}else{
+		// スレッドが作れなければここで閉じる (表示が一瞬乱れる可能性はある)
+		switch_close_slot_locked(g_RetireSlot);
+		g_RetireSlot = -1;
+	}
+}
+
+int tcc_vdec_SwitchBegin(int container_type)
+{
+	int slot;
+	int ret;
+	
+	pthread_mutex_lock(&g_Mutex);
+	
+	if( g_DecoderState == -1 ){
+		// 表示中のストリームが無ければtcc_vdec_openで良い
+		ErrorPrint( "decoder is not opened...\n" );
+		pthread_mutex_unlock(&g_Mutex);
+		return -1;
+	}
+	
+	switch_reset_locked();
+	
+	slot = (g_ActiveSlot + 1) % VPU_SLOT_COUNT;
+	tcc_vpudec_select(slot);
+	// 新しいストリームの統計 : 表示中のストリームの統計はそのまま
+	tcc_telemetry_reset();
+	ret = tcc_vpudec_init_container(800, 476, container_type);
+	if( ret >= 0 ){
+		tcc_vpudec_set_skip_mode(g_SkipLevel, g_SkipInterval);
+		tcc_vpudec_set_release_mode(g_ReleaseByDisplay);
+	}else{
+		tcc_vpudec_close();
+	}
+	tcc_vpudec_select(g_ActiveSlot);
+	
+	if( ret >= 0 ){
+		g_SwitchSlot = slot;
+		g_SwitchContainer = container_type;
+		g_SwitchStartUs = tcc_vsync_now_us();
+	}
+	
+	pthread_mutex_unlock(&g_Mutex);
+	
+	return (ret >= 0) ? 0 : -1;
+}
+
+int tcc_vdec_SwitchProcess(unsigned char* data, int size, unsigned int pts_ms)
+{
+	int iret;
+	int ret = 0;
+	unsigned int inputdata[4] = {0};
+	unsigned int outputdata[16] = {0};
+	VdecKeyframeCallback cb = NULL;
+	void *user = NULL;
+	unsigned int reason;
+	
+	pthread_mutex_lock(&g_Mutex);
+	
+	if( g_SwitchSlot < 0 ){
+		// 切り替え済み(またはキャンセル済み) : 表示中のデコーダへの普通の入力
+		pthread_mutex_unlock(&g_Mutex);
+		return (tcc_vdec_process_pts(data, size, pts_ms) < 0) ? -1 : 1;
+	}
+	
+	inputdata[0] = (unsigned int)data;
+	inputdata[1] = (unsigned int)size;
+	inputdata[2] = pts_ms;
+	
+	tcc_vpudec_select(g_SwitchSlot);
+	iret = tcc_vpudec_decode(inputdata, outputdata);
+	if( iret >= 0 ){
+		switch_flip_locked(outputdata);
+		ret = 1;
+	}
+	// 新しいストリームのIDR要求 : 切り替えまでの時間はここで決まる
+	reason = keyframe_poll_locked(&cb, &user);
+	tcc_vpudec_select(g_ActiveSlot);
+	
+	pthread_mutex_unlock(&g_Mutex);
+	keyframe_notify(reason, cb, user);
+	event_dispatch();
+	ctrl_kick();
+	
+	return ret;
+}
+
+int tcc_vdec_SwitchCancel(void)
+{
+	pthread_mutex_lock(&g_Mutex);
+	if( g_SwitchSlot >= 0 ){
+		switch_close_slot_locked(g_SwitchSlot);
+		g_SwitchSlot = -1;
+	}
+	pthread_mutex_unlock(&g_Mutex);
+	
+	return 0;
+}
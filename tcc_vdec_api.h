@@ -24,6 +24,13 @@
 #include <sys/stat.h>
 #include <sys/ioctl.h>
 
+#include "tcc_disp_sink.h"
+#include "tcc_vdec_telemetry.h"
+#include "tcc_vdec_event.h"
+#include "tcc_bs_sanitize.h"
+#include "tcc_vpu_watchdog.h"
+#include "tcc_vpu_fault.h"
+
 
 #ifdef	__cplusplus
 extern "C"{
@@ -35,9 +42,166 @@ extern int tcc_vdec_open(void);
 extern int tcc_vdec_close(void);
 extern int tcc_vdec_process_annexb_header( unsigned char* data, int datalen);
 extern int tcc_vdec_process( unsigned char* data, int size);
+//same as tcc_vdec_process with the time stamp of the access unit in ms, 0 if unknown
+extern int tcc_vdec_process_pts( unsigned char* data, int size, unsigned int pts_ms);
+
+//one access unit of tcc_vdec_process_batch()
+#define VDEC_AU_FLAG_NO_DISPLAY		0x01	//decode only, the frame is not shown (clip import, thumbnails)
+
+typedef struct _VdecAU {
+	unsigned char	*data;
+	int				size;
+	unsigned int	pts_ms;			//0 if unknown
+	unsigned int	flags;			//VDEC_AU_FLAG_*
+} VdecAU;
+
+typedef struct _VdecAUResult {
+	int				ret;			//0 : a frame was output, -1 : no frame (more data needed, skipped or error)
+	unsigned int	pts_ms;			//time stamp of the output frame
+	int				width;			//output frame geometry, crop already removed
+	int				height;
+	int				stride;
+	unsigned char	*y;				//frame buffer virtual addresses, reused by the VPU once later frames are decoded.
+	unsigned char	*uv;			//NULL when the frame went back to the VPU at once (release by display : not shown)
+} VdecAUResult;
+
+//decode 'count' access units back to back under one lock, per-AU results go to result[] (may be NULL).
+//control calls made meanwhile are applied before the next batch.
+extern int tcc_vdec_process_batch( const VdecAU *au, VdecAUResult *result, int count);
 extern int tcc_vdec_SetViewFlag(int isValid);
+
+//display sink used from the next tcc_vdec_open (see tcc_disp_sink.h), NULL : overlay, or the frame buffer without it.
+//tcc_disp_sink_null() decodes only, for throughput measurements.
+extern int tcc_vdec_SetDisplaySink(const DispSink *sink);
 extern int tcc_vdec_init(int x, int y, int w, int h);
 
+//control calls below never wait for a running decode, they are picked up at the next frame boundary
+//level : 0 = no skip, 1 = skip all except I, 2 = skip B every 'interval' frames
+extern int tcc_vdec_SetSkipMode(int level, int interval);
+
+//dump decoded frames as packed NV12 to "<prefix>_<w>x<h>.nv12" from a background thread.
+//frames are dropped, never waited for, when the disk is slower than the decoder.
+extern int tcc_vdec_StartDump(const char *prefix);
+extern int tcc_vdec_StopDump(void);
+
+//record every access unit passed to tcc_vdec_process_annexb_header/tcc_vdec_process (see tcc_stream_capture.h)
+//and replay such a recording with the same call sequence, realtime = 1 keeps the recorded timing.
+extern int tcc_vdec_StartCapture(const char *path);
+extern int tcc_vdec_StopCapture(void);
+extern int tcc_vdec_Replay(const char *path, int realtime);
+
+//play a local H.264 Annex-B file, blocks until the end of the file or tcc_vdec_StopFile() from another thread.
+//fps > 0 : paced in real time, fps = 0 : as fast as the decoder goes.
+//One file at a time, and not while live input (StartTs/StartRtp) runs : -1. The live input is refused the same way
+//during a file. PlayMp4/PlayTs put the time stamp mode back as it was before the file when it ends.
+extern int tcc_vdec_PlayFile(const char *path, int fps);
+
+//play the first H.264 track of an MP4 file (e.g. dash-cam recordings), blocks like tcc_vdec_PlayFile().
+//realtime = 1 : paced on the track time stamps, realtime = 0 : as fast as the decoder goes.
+extern int tcc_vdec_PlayMp4(const char *path, int realtime);
+
+//play the first H.264 program of a recorded MPEG-2 TS file, blocks like tcc_vdec_PlayFile().
+//realtime = 1 : paced on the PCR, realtime = 0 : as fast as the decoder goes.
+extern int tcc_vdec_PlayTs(const char *path, int realtime);
+
+//trick play for tcc_vdec_PlayFile() / tcc_vdec_PlayMp4() : speed 2..VDEC_TRICK_MAX_SPEED fast forwards, 1 plays normally.
+//applies to the file being played and to the next ones, from any thread. Only I pictures are fed, at most one per
+//VDEC_TRICK_MIN_INTERVAL_MS : the index picks the next one at the position the speed has reached, every other AU
+//stays in the file. MP4 time stamps are divided by the speed. The TS player has no index and ignores the speed.
+#define VDEC_TRICK_MAX_SPEED			32
+#define VDEC_TRICK_MIN_INTERVAL_MS		66		/* about the decode load of normal play */
+#define VDEC_TRICK_NOMINAL_FPS			30		/* media clock of an Annex-B file played with fps = 0 */
+extern int tcc_vdec_SetTrickSpeed(int speed);
+
+//live MPEG-2 TS input (e.g. DVB) : StartTs, then FeedTs with any number of bytes of 188 byte packets, then StopTs.
+extern int tcc_vdec_StartTs(void);
+extern int tcc_vdec_FeedTs(const unsigned char *data, int size);
+extern int tcc_vdec_StopTs(void);
+
+//RTP H.264 input (RFC 6184 single NAL, STAP-A, FU-A) : StartRtp, then FeedRtp with every received
+//RTP packet (header included), then StopRtp. jitter_depth : packets held for reordering, 0 = default.
+extern int tcc_vdec_StartRtp(int jitter_depth);
+extern int tcc_vdec_FeedRtp(const unsigned char *packet, int size);
+extern int tcc_vdec_StopRtp(void);
+
+//input data was lost : the decoder skips to the next I-frame instead of showing broken pictures
+extern int tcc_vdec_NotifyStreamLoss(void);
+
+//key frame request : cb is called when the decoder sees lost or broken references, so the transport can ask
+//the source for an IDR (RTCP PLI/FIR, Android Auto). It is called outside the decoder lock, at most once every
+//min_interval_ms (0 = VDEC_KEYFRAME_MIN_INTERVAL_MS) and again while the decoder still waits for an I-frame.
+//reason : VDEC_KEYFRAME_xxx bits gathered since the previous call. cb = NULL disables it.
+#define VDEC_KEYFRAME_DECODE_ERROR		(1<<0)	//decode failed or the decoder was restored
+#define VDEC_KEYFRAME_FRAME_GAP			(1<<1)	//H.264 frame_num skipped a reference picture
+#define VDEC_KEYFRAME_ERROR_MB			(1<<2)	//picture with many error macroblocks
+#define VDEC_KEYFRAME_LOSS				(1<<3)	//tcc_vdec_NotifyStreamLoss() or a transport loss
+#define VDEC_KEYFRAME_SEARCH			(1<<4)	//still waiting for an I-frame
+#define VDEC_KEYFRAME_MIN_INTERVAL_MS	500
+
+typedef void (*VdecKeyframeCallback)(unsigned int reason, void *user);
+extern int tcc_vdec_SetKeyframeCallback(VdecKeyframeCallback cb, void *user, int min_interval_ms);
+
+//stream quality over the last TELEMETRY_WINDOW_SEC seconds : bitrate, picture types, GOP, errors, I-frame searches.
+//cleared by tcc_vdec_open.
+extern int tcc_vdec_GetTelemetry(VdecTelemetry *tel);
+
+//what the bitstream check fixed or dropped before the VPU saw it : empty/double start codes, NALs with
+//forbidden_zero_bit, truncated NALs, oversize access units. cleared by tcc_vdec_open.
+extern int tcc_vdec_GetSanitizeStat(BsSanitizeStat *stat);
+
+//VPU commands that overran their deadline (tcc_vpu_watchdog.h) and how long video took to come back.
+//does not take the decoder lock, so it answers while a VPU command hangs. VDEC_EVENT_STALL reports a stall
+//on the event fd at once, a callback gets it only after the hung command returned.
+extern int tcc_vdec_GetWatchdogStat(VpuWatchdogStat *stat);
+
+//fault injection (FAULT_xxx in tcc_vpu_fault.h), test builds with -DVDEC_FAULT_INJECT only, -1 otherwise.
+//permille : chance per VPU call (per open for FAULT_OVERLAY_OPEN), 0 = off. fault = -1 turns all off and clears the counters.
+//the stat gives time-to-recovered-output, frames lost and live VPU instances, tcc_vdec_GetHeapOps() the heap side.
+extern int tcc_vdec_InjectFault(int fault, int permille);
+extern int tcc_vdec_GetFaultStat(VpuFaultStat *stat);
+
+//idle power down : no input for timeout_ms (0 = off, the default) releases the VPU and its frame buffers.
+//the latest SPS/PPS and IDR stay cached, the next input re-initializes from them without tcc_vdec_open.
+//a frame the overlay still shows keeps the VPU, a hidden view or a copying sink does not.
+//VDEC_EVENT_SUSPEND / VDEC_EVENT_RESUME report both ends. the stat is cleared by tcc_vdec_open.
+typedef struct _VdecIdleStat {
+	unsigned int	suspends;
+	unsigned int	resumes;			//suspends followed by a frame out
+	unsigned int	last_resume_ms;		//first input after the suspend -> first frame out, VPU init included
+	unsigned int	max_resume_ms;
+	unsigned int	suspended;			//1 : the VPU is released right now
+} VdecIdleStat;
+extern int tcc_vdec_SetIdleTimeout(int timeout_ms);
+extern int tcc_vdec_GetIdleStat(VdecIdleStat *stat);
+
+//decoder heap allocations and frees since start up : unchanged between open and close while decoding
+extern unsigned int tcc_vdec_GetHeapOps(void);
+
+//decoder events (VDEC_EVENT_xxx in tcc_vdec_event.h) : frame ready, input ready, resolution/crop change,
+//error, restore, sequence header retry, end of stream. Either
+// - add tcc_vdec_GetEventFd() to an epoll/poll set and call tcc_vdec_GetEvent() until it returns -1 when it is readable, or
+// - set a callback : it is called outside the decoder lock by the thread that produced the events.
+//with a callback set, the callback takes every event and tcc_vdec_GetEvent() finds the queue empty.
+typedef void (*VdecEventCallback)(const VdecEvent *ev, void *user);
+extern int tcc_vdec_GetEventFd(void);
+extern int tcc_vdec_GetEvent(VdecEvent *ev);
+extern int tcc_vdec_SetEventCallback(VdecEventCallback cb, void *user);
+
+//seamless source switch (projection, camera, media) without close/open and the black screen in between :
+//tcc_vdec_SwitchBegin opens a second VPU instance for the new stream, tcc_vdec_SwitchProcess decodes its AUs
+//in the background while the current stream keeps playing through tcc_vdec_process*. The first frame of the
+//new stream flips the display at once (VDEC_EVENT_SWITCHED, code = ms since SwitchBegin) and SwitchProcess
+//returns 1 : from then on it feeds the new stream like tcc_vdec_process_pts. Stop feeding the old stream then,
+//its VPU instance is closed in the background once the new frame is on screen. returns 0 while pre-rolling, -1 on error.
+//both instances hold frame buffers during the switch : if the VPU memory is short SwitchBegin or the pre-roll
+//fails, close/open is the fallback. tcc_vdec_SwitchCancel drops a pre-roll that has not flipped yet.
+extern int tcc_vdec_SwitchBegin(int container_type);
+extern int tcc_vdec_SwitchProcess(unsigned char* data, int size, unsigned int pts_ms);
+extern int tcc_vdec_SwitchCancel(void);
+
+//stop tcc_vdec_PlayFile() / tcc_vdec_PlayMp4() / tcc_vdec_PlayTs() from another thread
+extern int tcc_vdec_StopFile(void);
+
 #ifdef	__cplusplus
 }
 #endif
@@ -0,0 +1,242 @@
+//********************************************************************************************
+/**
+ * @file        tcc_vdec_client.c
+ * @brief		Client side of the decode service : connect, push access units, take events.
+ * 				This interface contain : Connect/Close, Push access unit, Event fd/Get event, Display control.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+
+#include "tcc_vdec_client.h"
+
+//#define	DEBUG_MODE
+#ifdef	DEBUG_MODE
+	#define	DebugPrint( fmt, ... )	printf( "[TCC_VDEC_CLIENT](D):"fmt"\n", ##__VA_ARGS__ )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_VDEC_CLIENT](E):"fmt"\n", ##__VA_ARGS__ )
+#else
+	#define	DebugPrint( fmt, ... )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_VDEC_CLIENT](E):"fmt"\n", ##__VA_ARGS__ )
+#endif
+
+static int client_shm_create(uint32_t size)
+{
+	char name[64];
+	int fd;
+
+	// the name is only needed until the daemon has the fd : unlinked at once
+	snprintf( name, sizeof(name), "/tccvdec-%d-%p", (int)getpid(), (void*)&name );
+	fd = shm_open( name, O_RDWR | O_CREAT | O_EXCL, 0600 );
+	if( fd < 0 )
+		return -1;
+	shm_unlink( name );
+
+	if( ftruncate( fd, size ) < 0 )
+	{
+		close( fd );
+		return -1;
+	}
+	return fd;
+}
+
+static int client_send(VdecClient *c, uint32_t type, int a0, int a1, int a2, int a3)
+{
+	ServiceMsg msg;
+
+	memset( &msg, 0x00, sizeof(ServiceMsg) );
+	msg.type = type;
+	msg.version = SHM_VERSION;
+	msg.arg[0] = a0;
+	msg.arg[1] = a1;
+	msg.arg[2] = a2;
+	msg.arg[3] = a3;
+	if( send( c->sock, &msg, sizeof(ServiceMsg), MSG_NOSIGNAL ) != sizeof(ServiceMsg) )
+		return -1;
+	return 0;
+}
+
+static int client_hello(VdecClient *c, int priority)
+{
+	ServiceMsg msg;
+	ServiceReply reply;
+	struct msghdr mh;
+	struct iovec iov;
+	struct cmsghdr *cm;
+	char ctrl[CMSG_SPACE(3 * sizeof(int))];
+	int fds[3];
+
+	memset( &msg, 0x00, sizeof(ServiceMsg) );
+	msg.type = SERVICE_MSG_HELLO;
+	msg.version = SHM_VERSION;
+	msg.arg[0] = priority;
+
+	fds[0] = c->shm_fd;
+	fds[1] = c->data_fd;
+	fds[2] = c->event_fd;
+
+	memset( &mh, 0x00, sizeof(mh) );
+	memset( ctrl, 0x00, sizeof(ctrl) );
+	iov.iov_base = &msg;
+	iov.iov_len = sizeof(ServiceMsg);
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	mh.msg_control = ctrl;
+	mh.msg_controllen = sizeof(ctrl);
+	cm = CMSG_FIRSTHDR( &mh );
+	cm->cmsg_level = SOL_SOCKET;
+	cm->cmsg_type = SCM_RIGHTS;
+	cm->cmsg_len = CMSG_LEN(3 * sizeof(int));
+	memcpy( CMSG_DATA(cm), fds, sizeof(fds) );
+
+	if( sendmsg( c->sock, &mh, MSG_NOSIGNAL ) != sizeof(ServiceMsg) )
+		return -1;
+	if( recv( c->sock, &reply, sizeof(ServiceReply), MSG_WAITALL ) != sizeof(ServiceReply) )
+		return -1;
+	if( reply.status != 0 )
+		return -1;
+
+	c->client_id = reply.client_id;
+	return 0;
+}
+
+VdecClient* tcc_vdec_client_connect(const char *path, int priority, uint32_t ring_size)
+{
+	VdecClient *c;
+	struct sockaddr_un addr;
+
+	if( path == NULL )
+		path = VDEC_SERVICE_SOCKET;
+	if( ring_size == 0 )
+		ring_size = SHM_DATA_SIZE;
+	if( ring_size > SHM_DATA_SIZE_MAX || (ring_size & (ring_size - 1)) != 0 || strlen( path ) >= sizeof(addr.sun_path) )
+		return NULL;
+
+	c = (VdecClient*)calloc( 1, sizeof(VdecClient) );
+	if( c == NULL )
+		return NULL;
+	c->sock = c->shm_fd = c->data_fd = c->event_fd = -1;
+	c->map_size = SHM_TOTAL_SIZE(ring_size);
+
+	c->shm_fd = client_shm_create( c->map_size );
+	c->data_fd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+	c->event_fd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+	if( c->shm_fd < 0 || c->data_fd < 0 || c->event_fd < 0 )
+		goto fail;
+
+	c->shm = (ShmHeader*)mmap( NULL, c->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, c->shm_fd, 0 );
+	if( c->shm == MAP_FAILED )
+	{
+		c->shm = NULL;
+		goto fail;
+	}
+	tcc_shm_init( c->shm, ring_size );
+
+	c->sock = socket( AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0 );
+	if( c->sock < 0 )
+		goto fail;
+	memset( &addr, 0x00, sizeof(addr) );
+	addr.sun_family = AF_UNIX;
+	strcpy( addr.sun_path, path );
+	if( connect( c->sock, (struct sockaddr*)&addr, sizeof(addr) ) < 0 )
+	{
+		DebugPrint( "no service on %s (%d)", path, errno );
+		goto fail;
+	}
+	if( client_hello( c, priority ) < 0 )
+	{
+		ErrorPrint( "service refused the client" );
+		goto fail;
+	}
+
+	DebugPrint( "client %d connected, ring %u bytes", c->client_id, ring_size );
+	return c;
+
+fail:
+	tcc_vdec_client_close( c );
+	return NULL;
+}
+
+void tcc_vdec_client_close(VdecClient *c)
+{
+	if( c == NULL )
+		return;
+
+	// the daemon sees the hang up and drops whatever is left in the ring
+	if( c->sock >= 0 )
+		close( c->sock );
+	if( c->shm != NULL )
+		munmap( c->shm, c->map_size );
+	if( c->shm_fd >= 0 )
+		close( c->shm_fd );
+	if( c->data_fd >= 0 )
+		close( c->data_fd );
+	if( c->event_fd >= 0 )
+		close( c->event_fd );
+	free( c );
+}
+
+int tcc_vdec_client_push(VdecClient *c, const unsigned char *data, uint32_t len, uint32_t pts_ms)
+{
+	uint64_t one = 1;
+
+	if( tcc_shm_write( c->shm, data, len, pts_ms, 0 ) < 0 )
+	{
+		c->dropped++;
+		return -1;
+	}
+	// the unit is in the ring either way : EAGAIN means the daemon has been signalled already,
+	// on another failure it finds the unit at its next wake up
+	if( write( c->data_fd, &one, sizeof(one) ) != sizeof(one) && errno != EAGAIN )
+		ErrorPrint( "data fd write fail (%d)", errno );
+	return 0;
+}
+
+int tcc_vdec_client_event_fd(VdecClient *c)
+{
+	return c->event_fd;
+}
+
+int tcc_vdec_client_get_event(VdecClient *c, VdecEvent *ev)
+{
+	uint64_t cnt;
+
+	if( tcc_shm_event_get( c->shm, ev ) == 0 )
+		return 0;
+
+	// clear the signal, then look again for an event posted in between
+	if( read( c->event_fd, &cnt, sizeof(cnt) ) != sizeof(cnt) && errno != EAGAIN )
+		ErrorPrint( "event fd read fail (%d)", errno );
+	return tcc_shm_event_get( c->shm, ev );
+}
+
+int tcc_vdec_client_set_view(VdecClient *c, int valid)
+{
+	return client_send( c, SERVICE_MSG_VIEW, valid, 0, 0, 0 );
+}
+
+int tcc_vdec_client_set_geometry(VdecClient *c, int x, int y, int w, int h)
+{
+	return client_send( c, SERVICE_MSG_GEOMETRY, x, y, w, h );
+}
+
+int tcc_vdec_client_notify_loss(VdecClient *c)
+{
+	return client_send( c, SERVICE_MSG_LOSS, 0, 0, 0, 0 );
+}
+
+int tcc_vdec_client_set_priority(VdecClient *c, int priority)
+{
+	return client_send( c, SERVICE_MSG_PRIORITY, priority, 0, 0, 0 );
+}
@@ -0,0 +1,50 @@
+//********************************************************************************************
+/**
+ * @file        tcc_vdec_client.h
+ * @brief		Client side of the decode service : connect, push access units, take events.
+ * 				This interface contain : Connect/Close, Push access unit, Event fd/Get event, Display control.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+#ifndef	__TCC_VDEC_CLIENT_H__
+#define	__TCC_VDEC_CLIENT_H__
+
+#include <stdint.h>
+
+#include "tcc_vdec_event.h"
+#include "tcc_vdec_shm.h"
+#include "tcc_vdec_service.h"
+
+typedef struct _VdecClient {
+	int				sock;
+	int				shm_fd;
+	int				data_fd;		//eventfd : access units in the ring
+	int				event_fd;		//eventfd : events in the ring
+	ShmHeader		*shm;
+	uint32_t		map_size;
+	int				client_id;
+	unsigned int	dropped;		//access units refused because the ring was full
+} VdecClient;
+
+/* path : NULL for VDEC_SERVICE_SOCKET, ring_size : access unit ring in bytes, power of two (0 : SHM_DATA_SIZE).
+ * priority : the highest priority client owns the decoder and the display. NULL : no daemon or refused */
+VdecClient* tcc_vdec_client_connect(const char *path, int priority, uint32_t ring_size);
+void tcc_vdec_client_close(VdecClient *c);
+
+/* one Annex-B access unit : a ring write and an eventfd signal, no system call else.
+ * 0 queued, -1 the ring is full (the daemon is behind, the unit is dropped and counted) */
+int tcc_vdec_client_push(VdecClient *c, const unsigned char *data, uint32_t len, uint32_t pts_ms);
+
+/* readable while events are waiting. Read it empty, then call tcc_vdec_client_get_event until it returns -1 */
+int tcc_vdec_client_event_fd(VdecClient *c);
+int tcc_vdec_client_get_event(VdecClient *c, VdecEvent *ev);
+
+/* display and stream control, applied by the daemon while the client owns the display, kept for later else */
+int tcc_vdec_client_set_view(VdecClient *c, int valid);
+int tcc_vdec_client_set_geometry(VdecClient *c, int x, int y, int w, int h);
+int tcc_vdec_client_notify_loss(VdecClient *c);
+int tcc_vdec_client_set_priority(VdecClient *c, int priority);
+
+#endif	// __TCC_VDEC_CLIENT_H__
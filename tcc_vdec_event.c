@@ -0,0 +1,150 @@
+//********************************************************************************************
+/**
+ * @file        tcc_vdec_event.c
+ * @brief		Decoder event queue, lock free between the decoding thread and one reader, signalled on an eventfd.
+ * 				This interface contain : Post event, Get event, Event fd.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "tcc_vdec_event.h"
+
+//#define	DEBUG_MODE
+#ifdef	DEBUG_MODE
+	#define	DebugPrint( fmt, ... )	printf( "[TCC_VDEC_EVENT](D):"fmt"\n", ##__VA_ARGS__ )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_VDEC_EVENT](E):"fmt"\n", ##__VA_ARGS__ )
+#else
+	#define	DebugPrint( fmt, ... )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_VDEC_EVENT](E):"fmt"\n", ##__VA_ARGS__ )
+#endif
+
+/* single producer / single consumer ring : only the producer moves g_Head, only the reader moves g_Tail.
+ * The decoding thread posts nearly everything, g_PostLock only matters when the watchdog posts meanwhile. */
+static VdecEvent g_Queue[EVENT_QUEUE_SIZE];
+static volatile int g_PostLock = 0;
+static volatile unsigned int g_Head = 0;
+static volatile unsigned int g_Tail = 0;
+static volatile unsigned int g_Dropped = 0;
+static volatile int g_InputReadyQueued = 0;
+static volatile int g_Fd = -1;
+
+static void event_signal(void)
+{
+	uint64_t one = 1;
+
+	if( g_Fd >= 0 && write( g_Fd, &one, sizeof(one) ) != sizeof(one) )
+		DebugPrint( "eventfd write failed" );
+}
+
+static void event_push(const VdecEvent *ev)
+{
+	unsigned int head = g_Head;
+
+	if( ev->type == VDEC_EVENT_INPUT_READY )
+	{
+		// one pending input-ready says it all
+		if( g_InputReadyQueued )
+			return;
+		g_InputReadyQueued = 1;
+	}
+
+	if( head - g_Tail >= EVENT_QUEUE_SIZE )
+	{
+		if( ev->type == VDEC_EVENT_INPUT_READY )
+			g_InputReadyQueued = 0;
+		__sync_fetch_and_add( &g_Dropped, 1 );
+		return;
+	}
+
+	memcpy( &g_Queue[head & (EVENT_QUEUE_SIZE - 1)], ev, sizeof(VdecEvent) );
+	__sync_synchronize();	// the entry is complete before the reader can see it
+	g_Head = head + 1;
+}
+
+void tcc_event_post(const VdecEvent *ev)
+{
+	while( __sync_lock_test_and_set( &g_PostLock, 1 ) )
+		;
+	event_push( ev );
+	__sync_lock_release( &g_PostLock );
+	event_signal();
+}
+
+void tcc_event_post_code(unsigned int type, int code)
+{
+	VdecEvent ev;
+
+	memset( &ev, 0x00, sizeof(VdecEvent) );
+	ev.type = type;
+	ev.code = code;
+	tcc_event_post( &ev );
+}
+
+static int event_pop(VdecEvent *ev)
+{
+	unsigned int tail = g_Tail;
+	unsigned int dropped;
+
+	dropped = __sync_lock_test_and_set( &g_Dropped, 0 );
+	if( dropped != 0 )
+	{
+		memset( ev, 0x00, sizeof(VdecEvent) );
+		ev->type = VDEC_EVENT_OVERFLOW;
+		ev->code = (int)dropped;
+		return 0;
+	}
+
+	if( tail == g_Head )
+		return -1;
+	__sync_synchronize();	// read the entry only after seeing the producer's g_Head
+	memcpy( ev, &g_Queue[tail & (EVENT_QUEUE_SIZE - 1)], sizeof(VdecEvent) );
+	__sync_synchronize();	// done with the entry before the producer may reuse it
+	g_Tail = tail + 1;
+
+	if( ev->type == VDEC_EVENT_INPUT_READY )
+		g_InputReadyQueued = 0;
+	return 0;
+}
+
+int tcc_event_get(VdecEvent *ev)
+{
+	uint64_t cnt;
+
+	if( event_pop( ev ) == 0 )
+		return 0;
+
+	// clear the eventfd, then look again : an event posted before the clear is found now,
+	// one posted after it signals the fd again
+	if( g_Fd >= 0 && read( g_Fd, &cnt, sizeof(cnt) ) < 0 )
+		DebugPrint( "eventfd already clear" );
+	__sync_synchronize();
+	return event_pop( ev );
+}
+
+int tcc_event_fd(void)
+{
+	int fd;
+
+	if( g_Fd < 0 )
+	{
+		fd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+		if( fd < 0 )
+		{
+			ErrorPrint( "eventfd create failed" );
+			return -1;
+		}
+		g_Fd = fd;
+		// events queued before anyone watched the fd
+		if( g_Head != g_Tail || g_Dropped != 0 )
+			event_signal();
+	}
+	return g_Fd;
+}
@@ -0,0 +1,54 @@
+//********************************************************************************************
+/**
+ * @file        tcc_vdec_event.h
+ * @brief		Decoder event queue, lock free between the decoding thread and one reader, signalled on an eventfd.
+ * 				This interface contain : Post event, Get event, Event fd.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+#ifndef	__TCC_VDEC_EVENT_H__
+#define	__TCC_VDEC_EVENT_H__
+
+#define EVENT_QUEUE_SIZE	64		/* power of two */
+
+#define VDEC_EVENT_FRAME_READY		1	//a frame was output : pts_ms, width, height
+#define VDEC_EVENT_INPUT_READY		2	//the decoder took the last access unit and accepts the next one
+#define VDEC_EVENT_RESOLUTION		3	//output size or crop changed : width, height, crop_xxx
+#define VDEC_EVENT_ERROR			4	//decode failed : code = VPU return code
+#define VDEC_EVENT_RESTORE			5	//the VPU was closed and is re-initialized from the saved sequence header
+#define VDEC_EVENT_SEQ_RETRY		6	//sequence header init failed, retried with the next access unit : code
+#define VDEC_EVENT_EOS				7	//file or replay input ended : code = 0 end of input or stopped, -1 error
+#define VDEC_EVENT_OVERFLOW			8	//the reader fell behind : code = events lost
+#define VDEC_EVENT_STALL			9	//a VPU command is overdue, the decoder restores once it returns : code = deadline ms
+#define VDEC_EVENT_SUSPEND			10	//no input for the idle timeout, the VPU was released : code = timeout ms
+#define VDEC_EVENT_RESUME			11	//first frame after an idle suspend : code = ms since the input that woke it up
+#define VDEC_EVENT_SWITCHED			12	//the display flipped to the pre-rolled source : code = ms since tcc_vdec_SwitchBegin
+
+typedef struct _VdecEvent {
+	unsigned int	type;			//VDEC_EVENT_xxx
+	int				code;
+	unsigned int	pts_ms;
+	int				width;			//visible size, crop removed
+	int				height;
+	int				crop_left;
+	int				crop_top;
+	int				crop_right;
+	int				crop_bottom;
+} VdecEvent;
+
+/* producer side : any thread, producers are serialized by a short spin lock that the reader never takes.
+ * When the queue is full the event is dropped and counted for a VDEC_EVENT_OVERFLOW.
+ * VDEC_EVENT_INPUT_READY is not queued again until the reader took the previous one. */
+void tcc_event_post(const VdecEvent *ev);
+void tcc_event_post_code(unsigned int type, int code);
+
+/* reader side, one reader at a time : 0 an event was taken, -1 the queue is empty.
+ * The eventfd is cleared once the queue runs empty, so a level triggered epoll wakes up only for new events. */
+int tcc_event_get(VdecEvent *ev);
+
+/* eventfd readable while events are queued, created on the first call and kept open, -1 : not available */
+int tcc_event_fd(void);
+
+#endif	// __TCC_VDEC_EVENT_H__
@@ -0,0 +1,660 @@
+//********************************************************************************************
+/**
+ * @file        tcc_vdec_service.c
+ * @brief		Decode service : one daemon owns the VPU and the overlay, clients feed it through shared memory.
+ * 				This interface contain : Socket protocol, Service events, Run/Stop the service loop.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "tcc_vdec_api.h"
+#include "tcc_vpudec_intf.h"
+#include "tcc_vdec_shm.h"
+#include "tcc_vdec_service.h"
+
+//#define	DEBUG_MODE
+#ifdef	DEBUG_MODE
+	#define	DebugPrint( fmt, ... )	printf( "[TCC_VDEC_SERVICE](D):"fmt"\n", ##__VA_ARGS__ )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_VDEC_SERVICE](E):"fmt"\n", ##__VA_ARGS__ )
+#else
+	#define	DebugPrint( fmt, ... )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_VDEC_SERVICE](E):"fmt"\n", ##__VA_ARGS__ )
+#endif
+
+/* epoll tags : kind << 16 | client index */
+#define TAG_LISTEN		(1 << 16)
+#define TAG_STOP		(2 << 16)
+#define TAG_DECODER		(3 << 16)
+#define TAG_SOCK		(4 << 16)
+#define TAG_DATA		(5 << 16)
+#define TAG_KIND(tag)	((tag) & 0xFFFF0000)
+#define TAG_INDEX(tag)	((tag) & 0xFFFF)
+
+typedef struct _ServiceClient {
+	int				used;
+	int				id;
+	int				sock;
+	int				shm_fd;			//-1 until the hello
+	int				data_fd;
+	int				event_fd;
+	ShmHeader		*shm;
+	ShmReader		ring;			//daemon's own copy of the ring positions
+	unsigned char	*au;			//access unit copied out of the ring, data_size / 2 bytes
+	uint32_t		map_size;
+	int				priority;
+	unsigned int	order;			//connect order, the newest wins a priority tie
+
+	int				view;			//-1 : never set
+	int				geom_valid;
+	int				geom[4];
+
+	unsigned int	au_decoded;
+	unsigned int	au_dropped;		//consumed while another client owned the decoder
+} ServiceClient;
+
+static ServiceClient g_Client[SERVICE_MAX_CLIENTS];
+static int g_Epoll = -1;
+static int g_Listen = -1;
+static int g_StopFd = -1;
+static volatile int g_Stop = 0;
+static int g_NextId = 1;
+static unsigned int g_Order = 0;
+
+static int g_Open = 0;					//decoder opened by the service
+static ServiceClient *g_Owner = NULL;	//decoded and displayed
+static ServiceClient *g_Next = NULL;	//pre-rolled, takes the display on its first frame
+static ServiceClient *g_Feeding = NULL;	//client whose access unit is in the decoder right now
+
+static void service_post(ServiceClient *c, const VdecEvent *ev)
+{
+	uint64_t one = 1;
+
+	if( c == NULL || c->shm == NULL )
+		return;
+	tcc_shm_event_post( &c->ring, ev );
+	// EAGAIN : the counter is full, the client has been signalled already
+	if( write( c->event_fd, &one, sizeof(one) ) != sizeof(one) && errno != EAGAIN )
+		ErrorPrint( "client %d event fd write fail (%d)", c->id, errno );
+}
+
+static void service_post_code(ServiceClient *c, unsigned int type, int code)
+{
+	VdecEvent ev;
+
+	memset( &ev, 0x00, sizeof(VdecEvent) );
+	ev.type = type;
+	ev.code = code;
+	service_post( c, &ev );
+}
+
+/* decoder events : during a decode call they belong to the client being fed, else to the owner */
+static void service_forward_events(void)
+{
+	VdecEvent ev;
+
+	while( tcc_vdec_GetEvent( &ev ) == 0 )
+		service_post( (g_Feeding != NULL) ? g_Feeding : g_Owner, &ev );
+}
+
+/* called back from inside the decode calls of the service thread */
+static void service_keyframe(unsigned int reason, void *user)
+{
+	service_post_code( (g_Feeding != NULL) ? g_Feeding : g_Owner, SERVICE_EVENT_KEYFRAME, (int)reason );
+}
+
+static void service_apply_display(ServiceClient *c)
+{
+	if( c->geom_valid )
+		tcc_vdec_init( c->geom[0], c->geom[1], c->geom[2], c->geom[3] );
+	if( c->view >= 0 )
+		tcc_vdec_SetViewFlag( c->view );
+}
+
+static ServiceClient* service_best(void)
+{
+	ServiceClient *best = NULL;
+	int i;
+
+	for( i = 0; i < SERVICE_MAX_CLIENTS; i++ )
+	{
+		ServiceClient *c = &g_Client[i];
+
+		if( !c->used || c->shm == NULL )
+			continue;
+		if( best == NULL || c->priority > best->priority || (c->priority == best->priority && c->order > best->order) )
+			best = c;
+	}
+	return best;
+}
+
+/* the decoder could not be opened for c : nobody owns it, the next arbitration tries again */
+static void service_open_failed(ServiceClient *c)
+{
+	ErrorPrint( "decoder open fail for client %d", c->id );
+	tcc_vdec_close();
+	g_Open = 0;
+	g_Owner = g_Next = NULL;
+	service_post_code( c, SERVICE_EVENT_ERROR, -1 );
+}
+
+static void service_take_over(ServiceClient *c)
+{
+	int ret;
+
+	// no pre-roll possible : the old way, with the black screen in between
+	tcc_vdec_close();
+	ret = tcc_vdec_open();
+	if( g_Owner != NULL && g_Owner != c )
+		service_post_code( g_Owner, SERVICE_EVENT_OWNER, 0 );
+	if( ret < 0 )
+	{
+		service_open_failed( c );
+		return;
+	}
+	g_Owner = c;
+	g_Next = NULL;
+	service_apply_display( c );
+	service_post_code( c, SERVICE_EVENT_OWNER, 1 );
+}
+
+/* who decodes : after every connect, hang up and priority change */
+static void service_arbitrate(void)
+{
+	ServiceClient *best = service_best();
+	ServiceClient *target = (g_Next != NULL) ? g_Next : g_Owner;
+
+	if( best == NULL )
+	{
+		if( g_Open )
+		{
+			tcc_vdec_SwitchCancel();
+			tcc_vdec_close();
+			g_Open = 0;
+			DebugPrint( "last client gone, decoder closed" );
+		}
+		g_Owner = g_Next = NULL;
+		return;
+	}
+	if( best == target )
+		return;
+
+	if( !g_Open )
+	{
+		if( tcc_vdec_open() < 0 )
+		{
+			service_open_failed( best );
+			return;
+		}
+		g_Open = 1;
+		g_Owner = best;
+		service_apply_display( best );
+		service_post_code( best, SERVICE_EVENT_OWNER, 1 );
+		return;
+	}
+
+	// a pre-roll in progress is for a client that no longer wins
+	if( g_Next != NULL )
+	{
+		tcc_vdec_SwitchCancel();
+		service_post_code( g_Next, SERVICE_EVENT_OWNER, 0 );
+		g_Next = NULL;
+		if( best == g_Owner )
+			return;
+	}
+
+	// the current picture stays up until the new source has its first frame
+	if( tcc_vdec_SwitchBegin( CONTAINER_NONE ) == 0 )
+	{
+		g_Next = best;
+		service_post_code( best, SERVICE_EVENT_OWNER, 1 );
+	}
+	else
+		service_take_over( best );
+	DebugPrint( "client %d takes over from %d", best->id, (g_Owner != NULL) ? g_Owner->id : -1 );
+}
+
+static void service_decode(ServiceClient *c, unsigned char *data, uint32_t len, uint32_t pts_ms)
+{
+	int ret;
+
+	g_Feeding = c;
+	if( c == g_Next )
+	{
+		ret = tcc_vdec_SwitchProcess( data, (int)len, pts_ms );
+		if( ret == 1 )
+		{
+			// flipped : the old owner is not decoded any more
+			if( g_Owner != NULL )
+				service_post_code( g_Owner, SERVICE_EVENT_OWNER, 0 );
+			g_Owner = c;
+			g_Next = NULL;
+			service_apply_display( c );
+		}
+	}
+	else
+		tcc_vdec_process_pts( data, (int)len, pts_ms );
+	c->au_decoded++;
+	service_forward_events();
+	g_Feeding = NULL;
+}
+
+static void service_drop(ServiceClient *c)
+{
+	DebugPrint( "client %d gone : %u decoded, %u dropped", c->id, c->au_decoded, c->au_dropped );
+
+	epoll_ctl( g_Epoll, EPOLL_CTL_DEL, c->sock, NULL );
+	close( c->sock );
+	if( c->data_fd >= 0 )
+	{
+		epoll_ctl( g_Epoll, EPOLL_CTL_DEL, c->data_fd, NULL );
+		close( c->data_fd );
+	}
+	if( c->event_fd >= 0 )
+		close( c->event_fd );
+	if( c->shm != NULL )
+		munmap( c->shm, c->map_size );
+	free( c->au );
+	if( c->shm_fd >= 0 )
+		close( c->shm_fd );
+	memset( c, 0x00, sizeof(ServiceClient) );
+
+	if( c == g_Owner )
+		g_Owner = NULL;
+	if( c == g_Next )
+	{
+		tcc_vdec_SwitchCancel();
+		g_Next = NULL;
+	}
+	service_arbitrate();
+}
+
+/* up to SERVICE_AU_BUDGET units of every client, 1 : some are left */
+static int service_drain(void)
+{
+	uint32_t len, pts_ms, flags;
+	int i, n, ret;
+	int left = 0;
+
+	for( i = 0; i < SERVICE_MAX_CLIENTS; i++ )
+	{
+		ServiceClient *c = &g_Client[i];
+
+		if( !c->used || c->shm == NULL )
+			continue;
+
+		for( n = 0; n < SERVICE_AU_BUDGET; n++ )
+		{
+			ret = tcc_shm_peek( &c->ring, c->au, c->ring.data_size / 2, &len, &pts_ms, &flags );
+			if( ret < 0 )
+			{
+				ErrorPrint( "client %d broke its ring", c->id );
+				service_drop( c );
+				break;
+			}
+			if( ret == 0 )
+				break;
+			// the copy is ours : the client can write the next unit while this one decodes
+			tcc_shm_consume( &c->ring, len );
+
+			// only the owner and the source being pre-rolled get VPU time
+			if( c == g_Owner || c == g_Next )
+				service_decode( c, c->au, len, pts_ms );
+			else
+				c->au_dropped++;
+		}
+		if( n == SERVICE_AU_BUDGET && c->used )
+			left = 1;
+	}
+	return left;
+}
+
+static int service_add_fd(int fd, uint32_t tag)
+{
+	struct epoll_event ev;
+
+	memset( &ev, 0x00, sizeof(ev) );
+	ev.events = EPOLLIN;
+	ev.data.u32 = tag;
+	return epoll_ctl( g_Epoll, EPOLL_CTL_ADD, fd, &ev );
+}
+
+static void service_accept(void)
+{
+	int fd, i;
+
+	fd = accept( g_Listen, NULL, NULL );
+	if( fd < 0 )
+		return;
+	fcntl( fd, F_SETFD, FD_CLOEXEC );
+
+	for( i = 0; i < SERVICE_MAX_CLIENTS; i++ )
+	{
+		if( !g_Client[i].used )
+			break;
+	}
+	if( i == SERVICE_MAX_CLIENTS || service_add_fd( fd, TAG_SOCK | i ) < 0 )
+	{
+		ErrorPrint( "too many clients" );
+		close( fd );
+		return;
+	}
+
+	memset( &g_Client[i], 0x00, sizeof(ServiceClient) );
+	g_Client[i].used = 1;
+	g_Client[i].sock = fd;
+	g_Client[i].shm_fd = g_Client[i].data_fd = g_Client[i].event_fd = -1;
+	g_Client[i].view = -1;
+}
+
+/* the daemon must never block on a client's fd : data and event fds have to be non-blocking eventfds */
+static int service_check_eventfd(int fd)
+{
+	char path[32], link[32];
+	ssize_t n;
+	int flags;
+
+	snprintf( path, sizeof(path), "/proc/self/fd/%d", fd );
+	n = readlink( path, link, sizeof(link) - 1 );
+	if( n < 0 )
+		return -1;
+	link[n] = 0;
+	flags = fcntl( fd, F_GETFL );
+	if( strcmp( link, "anon_inode:[eventfd]" ) != 0 || flags < 0 || (flags & O_NONBLOCK) == 0 )
+		return -1;
+	return 0;
+}
+
+static int service_hello(ServiceClient *c, const ServiceMsg *msg, const int *fds, int nfds)
+{
+	ServiceReply reply;
+	struct stat st;
+	void *map;
+
+	if( nfds != 3 || msg->version != SHM_VERSION )
+		return -1;
+	if( service_check_eventfd( fds[1] ) < 0 || service_check_eventfd( fds[2] ) < 0 )
+		return -1;
+	if( fstat( fds[0], &st ) < 0 || st.st_size < (off_t)sizeof(ShmHeader) || st.st_size > (off_t)SHM_TOTAL_SIZE(SHM_DATA_SIZE_MAX) )
+		return -1;
+
+	map = mmap( NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0 );
+	if( map == MAP_FAILED )
+		return -1;
+	if( tcc_shm_attach( &c->ring, (ShmHeader*)map, (uint32_t)st.st_size ) < 0 )
+	{
+		munmap( map, st.st_size );
+		return -1;
+	}
+	c->au = (unsigned char*)malloc( c->ring.data_size / 2 );
+	if( c->au == NULL || service_add_fd( fds[1], TAG_DATA | (int)(c - g_Client) ) < 0 )
+	{
+		free( c->au );
+		c->au = NULL;
+		munmap( map, st.st_size );
+		return -1;
+	}
+
+	// all or nothing : the fds belong to the client record from here on, the caller closes them on failure
+	c->shm = (ShmHeader*)map;
+	c->map_size = (uint32_t)st.st_size;
+	c->shm_fd = fds[0];
+	c->data_fd = fds[1];
+	c->event_fd = fds[2];
+	c->priority = msg->arg[0];
+	c->id = g_NextId++;
+	c->order = ++g_Order;
+
+	reply.status = 0;
+	reply.client_id = c->id;
+	send( c->sock, &reply, sizeof(reply), MSG_NOSIGNAL );
+	DebugPrint( "client %d : priority %d, ring %u bytes", c->id, c->priority, c->ring.data_size );
+	return 0;
+}
+
+static void service_message(ServiceClient *c)
+{
+	ServiceMsg msg;
+	struct msghdr mh;
+	struct iovec iov;
+	struct cmsghdr *cm;
+	char ctrl[CMSG_SPACE(3 * sizeof(int))];
+	int fds[3];
+	int nfds = 0;
+	ssize_t len;
+	int i, n, fd;
+
+	memset( &mh, 0x00, sizeof(mh) );
+	iov.iov_base = &msg;
+	iov.iov_len = sizeof(ServiceMsg);
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	mh.msg_control = ctrl;
+	mh.msg_controllen = sizeof(ctrl);
+
+	len = recvmsg( c->sock, &mh, MSG_CMSG_CLOEXEC );
+	if( len < 0 )
+		mh.msg_controllen = 0;		// ctrl was not written
+	for( cm = CMSG_FIRSTHDR( &mh ); cm != NULL; cm = CMSG_NXTHDR( &mh, cm ) )
+	{
+		if( cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS )
+		{
+			// every fd received is ours to close : keep the first three, close the rest now
+			n = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+			for( i = 0; i < n; i++ )
+			{
+				memcpy( &fd, CMSG_DATA(cm) + i * sizeof(int), sizeof(int) );
+				if( nfds < 3 )
+					fds[nfds++] = fd;
+				else
+					close( fd );
+			}
+		}
+	}
+
+	if( len != sizeof(ServiceMsg) )
+		goto drop;
+
+	if( c->shm == NULL )
+	{
+		// nothing but the hello before the ring is known
+		if( msg.type != SERVICE_MSG_HELLO || service_hello( c, &msg, fds, nfds ) < 0 )
+		{
+			ErrorPrint( "bad hello" );
+			goto drop;
+		}
+		service_arbitrate();
+		return;
+	}
+
+	for( i = 0; i < nfds; i++ )
+		close( fds[i] );
+
+	switch( msg.type )
+	{
+		case SERVICE_MSG_VIEW:
+			c->view = (msg.arg[0] != 0);
+			if( c == g_Owner )
+				tcc_vdec_SetViewFlag( c->view );
+			break;
+
+		case SERVICE_MSG_GEOMETRY:
+			if( msg.arg[2] <= 0 || msg.arg[3] <= 0 )
+				break;
+			c->geom_valid = 1;
+			memcpy( c->geom, msg.arg, sizeof(c->geom) );
+			if( c == g_Owner )
+				tcc_vdec_init( c->geom[0], c->geom[1], c->geom[2], c->geom[3] );
+			break;
+
+		case SERVICE_MSG_LOSS:
+			if( c == g_Owner )
+			{
+				g_Feeding = c;
+				tcc_vdec_NotifyStreamLoss();
+				g_Feeding = NULL;
+			}
+			break;
+
+		case SERVICE_MSG_PRIORITY:
+			c->priority = msg.arg[0];
+			service_arbitrate();
+			break;
+
+		default:
+			break;
+	}
+	return;
+
+drop:
+	// only a successful hello takes the fds of its message over
+	for( i = 0; i < nfds; i++ )
+		close( fds[i] );
+	service_drop( c );
+}
+
+static int service_listen(const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	if( strlen( path ) >= sizeof(addr.sun_path) )
+		return -1;
+	fd = socket( AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0 );
+	if( fd < 0 )
+		return -1;
+
+	memset( &addr, 0x00, sizeof(addr) );
+	addr.sun_family = AF_UNIX;
+	strcpy( addr.sun_path, path );
+	unlink( path );
+	if( bind( fd, (struct sockaddr*)&addr, sizeof(addr) ) < 0 || listen( fd, SERVICE_MAX_CLIENTS ) < 0 )
+	{
+		ErrorPrint( "cannot listen on %s (%d)", path, errno );
+		close( fd );
+		return -1;
+	}
+	return fd;
+}
+
+int tcc_vdec_service_run(const char *path)
+{
+	struct epoll_event evs[SERVICE_MAX_CLIENTS * 2 + 3];
+	int n, i, left = 0;
+	int ret = -1;
+	uint64_t cnt;
+
+	if( path == NULL )
+		path = VDEC_SERVICE_SOCKET;
+
+	memset( g_Client, 0x00, sizeof(g_Client) );
+	g_Listen = service_listen( path );
+	g_Epoll = epoll_create1( EPOLL_CLOEXEC );
+	g_StopFd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+	if( g_Listen < 0 || g_Epoll < 0 || g_StopFd < 0 )
+		goto out;
+
+	service_add_fd( g_Listen, TAG_LISTEN );
+	service_add_fd( g_StopFd, TAG_STOP );
+	if( tcc_vdec_GetEventFd() >= 0 )
+		service_add_fd( tcc_vdec_GetEventFd(), TAG_DECODER );
+	tcc_vdec_SetEventCallback( NULL, NULL );
+	tcc_vdec_SetKeyframeCallback( service_keyframe, NULL, 0 );
+
+	DebugPrint( "service on %s", path );
+	while( !g_Stop )
+	{
+		// a client with units left after its budget is served again before sleeping
+		n = epoll_wait( g_Epoll, evs, sizeof(evs) / sizeof(evs[0]), left ? 0 : -1 );
+		if( n < 0 )
+		{
+			if( errno == EINTR )
+				continue;
+			goto out;
+		}
+
+		for( i = 0; i < n; i++ )
+		{
+			uint32_t tag = evs[i].data.u32;
+			ServiceClient *c = &g_Client[TAG_INDEX(tag)];
+
+			switch( TAG_KIND(tag) )
+			{
+				case TAG_LISTEN:
+					service_accept();
+					break;
+				case TAG_DECODER:
+					// events of the decoder's own threads : idle, watchdog
+					service_forward_events();
+					break;
+				case TAG_SOCK:
+					if( c->used )
+						service_message( c );
+					break;
+				case TAG_DATA:
+					// EAGAIN : the client or an earlier wake up has cleared it
+					if( c->used && c->data_fd >= 0 && read( c->data_fd, &cnt, sizeof(cnt) ) != sizeof(cnt) && errno != EAGAIN )
+					{
+						ErrorPrint( "client %d data fd read fail (%d)", c->id, errno );
+						service_drop( c );
+					}
+					break;
+				default:
+					break;
+			}
+		}
+		left = service_drain();
+	}
+	ret = 0;
+
+out:
+	tcc_vdec_SetKeyframeCallback( NULL, NULL, 0 );
+	for( i = 0; i < SERVICE_MAX_CLIENTS; i++ )
+	{
+		if( g_Client[i].used )
+			service_drop( &g_Client[i] );
+	}
+	if( g_Open )
+		tcc_vdec_close();
+	g_Open = 0;
+	g_Owner = g_Next = NULL;
+
+	if( g_Listen >= 0 )
+	{
+		close( g_Listen );
+		unlink( path );
+	}
+	if( g_Epoll >= 0 )
+		close( g_Epoll );
+	if( g_StopFd >= 0 )
+		close( g_StopFd );
+	g_Listen = g_Epoll = g_StopFd = -1;
+	g_Stop = 0;
+
+	return ret;
+}
+
+void tcc_vdec_service_stop(void)
+{
+	uint64_t one = 1;
+
+	// only async signal safe calls here
+	g_Stop = 1;
+	// the counter cannot fill up, on a failure all the same the loop sees g_Stop at its next wake up
+	if( g_StopFd >= 0 && write( g_StopFd, &one, sizeof(one) ) != sizeof(one) )
+		return;
+}
@@ -0,0 +1,53 @@
+//********************************************************************************************
+/**
+ * @file        tcc_vdec_service.h
+ * @brief		Decode service : one daemon owns the VPU and the overlay, clients feed it through shared memory.
+ * 				This interface contain : Socket protocol, Service events, Run/Stop the service loop.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+#ifndef	__TCC_VDEC_SERVICE_H__
+#define	__TCC_VDEC_SERVICE_H__
+
+#include <stdint.h>
+
+#define VDEC_SERVICE_SOCKET		"/tmp/tccvdec.sock"
+#define SERVICE_MAX_CLIENTS		8
+#define SERVICE_AU_BUDGET		4		/* access units of one client per turn before the others are looked at */
+
+/* messages on the socket, client -> daemon */
+#define SERVICE_MSG_HELLO		1	//arg[0] = priority : first message, with the shm, data and event fds (SCM_RIGHTS)
+#define SERVICE_MSG_VIEW		2	//arg[0] = tcc_vdec_SetViewFlag
+#define SERVICE_MSG_GEOMETRY	3	//arg[0..3] = tcc_vdec_init x, y, w, h
+#define SERVICE_MSG_LOSS		4	//tcc_vdec_NotifyStreamLoss
+#define SERVICE_MSG_PRIORITY	5	//arg[0] = new priority
+
+typedef struct _ServiceMsg {
+	uint32_t		type;			//SERVICE_MSG_xxx
+	uint32_t		version;		//SHM_VERSION
+	int32_t			arg[4];
+} ServiceMsg;
+
+/* reply to SERVICE_MSG_HELLO : 0 accepted, -1 refused (the daemon closes the socket) */
+typedef struct _ServiceReply {
+	int32_t			status;
+	int32_t			client_id;
+} ServiceReply;
+
+/* events the daemon adds to the VDEC_EVENT_xxx of the decoder in a client's event ring */
+#define SERVICE_EVENT_OWNER		0x100	//code = 1 the client's stream is decoded and displayed, 0 its access units are dropped
+#define SERVICE_EVENT_KEYFRAME	0x101	//code = VDEC_KEYFRAME_xxx : send an IDR
+#define SERVICE_EVENT_ERROR		0x102	//code = -1 the decoder could not be opened for the client's stream, tried again on the next arbitration
+
+/* runs the daemon on path (NULL : VDEC_SERVICE_SOCKET) until tcc_vdec_service_stop, -1 : could not listen.
+ * The decoder is opened for the first client and closed after the last one. Only the owner, the client with
+ * the highest priority (the newest on a tie), is decoded ; a new owner is pre-rolled with tcc_vdec_SwitchBegin
+ * while the old one keeps the display. */
+int tcc_vdec_service_run(const char *path);
+
+/* any thread or a signal handler */
+void tcc_vdec_service_stop(void);
+
+#endif	// __TCC_VDEC_SERVICE_H__
@@ -0,0 +1,175 @@
+//********************************************************************************************
+/**
+ * @file        tcc_vdec_shm.c
+ * @brief		Shared memory rings between a decode service client and the daemon : access units in, events out.
+ * 				This interface contain : Ring layout, Init/Attach, Write/Read access unit, Post/Get event.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+
+#include "tcc_vdec_shm.h"
+
+//#define	DEBUG_MODE
+#ifdef	DEBUG_MODE
+	#define	DebugPrint( fmt, ... )	printf( "[TCC_VDEC_SHM](D):"fmt"\n", ##__VA_ARGS__ )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_VDEC_SHM](E):"fmt"\n", ##__VA_ARGS__ )
+#else
+	#define	DebugPrint( fmt, ... )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_VDEC_SHM](E):"fmt"\n", ##__VA_ARGS__ )
+#endif
+
+#define REC_SIZE(len)	(sizeof(ShmRecord) + (((len) + SHM_REC_ALIGN - 1) & ~(SHM_REC_ALIGN - 1)))
+
+void tcc_shm_init(ShmHeader *h, uint32_t data_size)
+{
+	memset( h, 0x00, sizeof(ShmHeader) );
+	h->magic = SHM_MAGIC;
+	h->version = SHM_VERSION;
+	h->data_size = data_size;
+}
+
+int tcc_shm_attach(ShmReader *r, ShmHeader *h, uint32_t map_size)
+{
+	uint32_t size = h->data_size;
+
+	if( h->magic != SHM_MAGIC || h->version != SHM_VERSION )
+		return -1;
+	if( size < 64 * 1024 || size > SHM_DATA_SIZE_MAX || (size & (size - 1)) != 0 )
+		return -1;
+	if( map_size < SHM_TOTAL_SIZE(size) )
+		return -1;
+
+	r->h = h;
+	r->data_size = size;
+	r->tail = h->tail;
+	r->ev_head = h->ev_head;
+	return 0;
+}
+
+int tcc_shm_write(ShmHeader *h, const unsigned char *data, uint32_t len, uint32_t pts_ms, uint32_t flags)
+{
+	uint32_t size = h->data_size;
+	uint32_t head = h->head;
+	uint32_t need = REC_SIZE(len);
+	uint32_t off = head & (size - 1);
+	uint32_t to_end = size - off;
+	uint32_t used;
+	ShmRecord *rec;
+
+	// at most half the ring, so a unit behind a wrap still fits into an empty ring
+	if( need > size / 2 )
+		return -1;
+
+	__sync_synchronize();
+	used = head - h->tail;
+	if( used + need + (need > to_end ? to_end : 0) > size )
+		return -1;
+
+	// records are aligned : a wrap record always fits in front of the end
+	if( need > to_end )
+	{
+		rec = (ShmRecord*)(SHM_DATA(h) + off);
+		rec->len = SHM_REC_WRAP;
+		head += to_end;
+		off = 0;
+	}
+
+	rec = (ShmRecord*)(SHM_DATA(h) + off);
+	rec->len = len;
+	rec->pts_ms = pts_ms;
+	rec->flags = flags;
+	memcpy( rec + 1, data, len );
+
+	// the daemon must see the record before the head that covers it
+	__sync_synchronize();
+	h->head = head + need;
+	return 0;
+}
+
+int tcc_shm_peek(ShmReader *r, unsigned char *buf, uint32_t buf_size, uint32_t *len, uint32_t *pts_ms, uint32_t *flags)
+{
+	ShmHeader *h = r->h;
+	uint32_t size = r->data_size;
+	uint32_t tail = r->tail;
+	uint32_t head = h->head;
+	uint32_t off, avail, rec_len;
+	ShmRecord *rec;
+
+	__sync_synchronize();
+	avail = head - tail;
+	if( avail == 0 )
+		return 0;
+	if( avail > size )
+		return -1;
+
+	// the client owns the ring contents : every field is read once, checked, and only that copy is used
+	off = tail & (size - 1);
+	rec = (ShmRecord*)(SHM_DATA(h) + off);
+	rec_len = rec->len;
+	if( rec_len == SHM_REC_WRAP )
+	{
+		if( avail < size - off )
+			return -1;
+		tail += size - off;
+		r->tail = tail;
+		h->tail = tail;
+		avail = head - tail;
+		if( avail == 0 )
+			return 0;
+		off = 0;
+		rec = (ShmRecord*)SHM_DATA(h);
+		rec_len = rec->len;
+	}
+
+	if( rec_len > size / 2 || rec_len > buf_size || REC_SIZE(rec_len) > avail || REC_SIZE(rec_len) > size - off )
+		return -1;
+	*len = rec_len;
+	*pts_ms = rec->pts_ms;
+	*flags = rec->flags;
+	memcpy( buf, rec + 1, rec_len );
+	return 1;
+}
+
+void tcc_shm_consume(ShmReader *r, uint32_t len)
+{
+	// len as tcc_shm_peek returned it : the record in the ring may have been rewritten since
+	r->tail += REC_SIZE(len);
+	__sync_synchronize();
+	r->h->tail = r->tail;
+}
+
+void tcc_shm_event_post(ShmReader *r, const VdecEvent *ev)
+{
+	ShmHeader *h = r->h;
+	uint32_t head = r->ev_head;
+
+	__sync_synchronize();
+	// a bad ev_tail from the client only costs it events, the slot index is ours
+	if( head - h->ev_tail >= SHM_EVENT_SLOTS )
+	{
+		h->ev_dropped++;
+		return;
+	}
+	h->ev[head & (SHM_EVENT_SLOTS - 1)] = *ev;
+	__sync_synchronize();
+	r->ev_head = head + 1;
+	h->ev_head = r->ev_head;
+}
+
+int tcc_shm_event_get(ShmHeader *h, VdecEvent *ev)
+{
+	uint32_t tail = h->ev_tail;
+
+	__sync_synchronize();
+	if( tail == h->ev_head )
+		return -1;
+	*ev = h->ev[tail & (SHM_EVENT_SLOTS - 1)];
+	__sync_synchronize();
+	h->ev_tail = tail + 1;
+	return 0;
+}
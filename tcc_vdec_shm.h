@@ -0,0 +1,79 @@
+//********************************************************************************************
+/**
+ * @file        tcc_vdec_shm.h
+ * @brief		Shared memory rings between a decode service client and the daemon : access units in, events out.
+ * 				This interface contain : Ring layout, Init/Attach, Write/Read access unit, Post/Get event.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+#ifndef	__TCC_VDEC_SHM_H__
+#define	__TCC_VDEC_SHM_H__
+
+#include <stdint.h>
+
+#include "tcc_vdec_event.h"
+
+#define SHM_MAGIC				0x54564453	/* "TVDS" */
+#define SHM_VERSION				1
+#define SHM_DATA_SIZE			(2 * 1024 * 1024)	/* default access unit ring, power of two */
+#define SHM_DATA_SIZE_MAX		(16 * 1024 * 1024)
+#define SHM_EVENT_SLOTS			64					/* power of two */
+#define SHM_REC_ALIGN			16
+#define SHM_REC_WRAP			0xFFFFFFFF			/* record length : continue at the start of the ring */
+
+/* one access unit : header, then len bytes padded to SHM_REC_ALIGN */
+typedef struct _ShmRecord {
+	uint32_t		len;
+	uint32_t		pts_ms;
+	uint32_t		flags;
+	uint32_t		reserved;
+} ShmRecord;
+
+/* positions run freely, offset = pos & (data_size - 1).
+ * The client only moves head and ev_tail, the daemon only tail and ev_head. */
+typedef struct _ShmHeader {
+	uint32_t			magic;
+	uint32_t			version;
+	uint32_t			data_size;
+	uint32_t			reserved;
+	volatile uint32_t	head;			//access unit bytes written
+	volatile uint32_t	tail;			//access unit bytes consumed
+	volatile uint32_t	ev_head;		//events posted
+	volatile uint32_t	ev_tail;		//events taken
+	volatile uint32_t	ev_dropped;		//events lost because the client did not take them
+	uint32_t			pad[3];
+	VdecEvent			ev[SHM_EVENT_SLOTS];
+} ShmHeader;
+
+#define SHM_TOTAL_SIZE(data_size)	(sizeof(ShmHeader) + (data_size))
+#define SHM_DATA(h)					((unsigned char*)(h) + sizeof(ShmHeader))
+
+/* daemon side view of a client's ring. The client can rewrite the shared header at any time :
+ * what the daemon relies on is read once at attach and kept here, its own positions are only written out */
+typedef struct _ShmReader {
+	ShmHeader		*h;
+	uint32_t		data_size;		//checked at attach
+	uint32_t		tail;			//published to h->tail
+	uint32_t		ev_head;		//published to h->ev_head
+} ShmReader;
+
+void tcc_shm_init(ShmHeader *h, uint32_t data_size);
+
+/* daemon side : 0 if the client's header is usable for a mapping of map_size bytes, r is set up then */
+int tcc_shm_attach(ShmReader *r, ShmHeader *h, uint32_t map_size);
+
+/* client side : 0 written, -1 the ring is full (or the unit can never fit) */
+int tcc_shm_write(ShmHeader *h, const unsigned char *data, uint32_t len, uint32_t pts_ms, uint32_t flags);
+
+/* daemon side : the next access unit copied into buf, 1 found, 0 empty, -1 the client broke the ring.
+ * Nothing is parsed in the shared memory, the client may rewrite it meanwhile. tcc_shm_consume() takes the len returned */
+int tcc_shm_peek(ShmReader *r, unsigned char *buf, uint32_t buf_size, uint32_t *len, uint32_t *pts_ms, uint32_t *flags);
+void tcc_shm_consume(ShmReader *r, uint32_t len);
+
+/* daemon posts, client gets : 0 taken, -1 empty */
+void tcc_shm_event_post(ShmReader *r, const VdecEvent *ev);
+int tcc_shm_event_get(ShmHeader *h, VdecEvent *ev);
+
+#endif	// __TCC_VDEC_SHM_H__
@@ -0,0 +1,216 @@
+//********************************************************************************************
+/**
+ * @file        tcc_vdec_telemetry.c
+ * @brief		Rolling stream quality statistics fed by the decoder, constant memory.
+ * 				This interface contain : Reset, Account decoded/output frames and I-frame searches, Get snapshot.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "tcc_vdec_telemetry.h"
+
+//#define	DEBUG_MODE
+#ifdef	DEBUG_MODE
+	#define	DebugPrint( fmt, ... )	printf( "[TCC_VDEC_TELEMETRY](D):"fmt"\n", ##__VA_ARGS__ )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_VDEC_TELEMETRY](E):"fmt"\n", ##__VA_ARGS__ )
+#else
+	#define	DebugPrint( fmt, ... )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_VDEC_TELEMETRY](E):"fmt"\n", ##__VA_ARGS__ )
+#endif
+
+#define BUCKETS		(TELEMETRY_WINDOW_SEC + 1)
+
+typedef struct _TelBucket {
+	unsigned int	bytes;
+	unsigned int	decoded;
+	unsigned int	output;
+	unsigned int	type[4];		//TELEMETRY_FRAME_xxx
+	unsigned int	err_mbs;
+	unsigned int	mbs;
+} TelBucket;
+
+typedef struct _Telemetry {
+	TelBucket		bucket[BUCKETS];
+	long long		sec;				//second of the bucket being filled, -1 : nothing yet
+	long long		first_sec;
+
+	unsigned int	since_i;			//pictures since the last I picture
+	unsigned int	gop_len;
+	int				i_seen;
+	long long		last_idr_ms;		//-1 : none
+	unsigned int	idr_interval_ms;
+
+	int				searching;
+	long long		search_start_ms;
+	unsigned int	search_count;
+	unsigned int	search_last_ms;
+	unsigned int	search_max_ms;
+} Telemetry;
+
+/* one per decoder slot : a stream in pre-roll keeps its own numbers until it goes on screen */
+static Telemetry g_SlotTel[TELEMETRY_SLOT_COUNT] = { { .sec = -1, .last_idr_ms = -1 }, { .sec = -1, .last_idr_ms = -1 } };
+static Telemetry *g_Tel = &g_SlotTel[0];
+
+static long long now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* bucket of the current second, buckets of the seconds skipped since the last call are cleared */
+static TelBucket* bucket_now(long long ms)
+{
+	long long sec = ms / 1000;
+
+	if( g_Tel->sec < 0 || sec - g_Tel->sec >= BUCKETS )
+	{
+		memset( g_Tel->bucket, 0x00, sizeof(g_Tel->bucket) );
+		if( g_Tel->sec < 0 )
+			g_Tel->first_sec = sec;
+		g_Tel->sec = sec;
+	}
+	while( g_Tel->sec < sec )
+	{
+		g_Tel->sec++;
+		memset( &g_Tel->bucket[g_Tel->sec % BUCKETS], 0x00, sizeof(TelBucket) );
+	}
+	return &g_Tel->bucket[g_Tel->sec % BUCKETS];
+}
+
+void tcc_telemetry_reset(void)
+{
+	memset( g_Tel, 0x00, sizeof(Telemetry) );
+	g_Tel->sec = -1;
+	g_Tel->last_idr_ms = -1;
+}
+
+void tcc_telemetry_select(int slot)
+{
+	if( slot >= 0 && slot < TELEMETRY_SLOT_COUNT )
+		g_Tel = &g_SlotTel[slot];
+}
+
+void tcc_telemetry_decoded(int bytes, int frame_type, int is_idr, int err_mbs, int mbs)
+{
+	long long ms = now_ms();
+	TelBucket *b = bucket_now( ms );
+
+	if( bytes > 0 )
+		b->bytes += bytes;
+	if( frame_type < 0 )
+		return;
+
+	b->decoded++;
+	b->type[(frame_type > TELEMETRY_FRAME_B) ? TELEMETRY_FRAME_UNKNOWN : frame_type]++;
+	if( err_mbs > 0 )
+		b->err_mbs += err_mbs;
+	if( mbs > 0 )
+		b->mbs += mbs;
+
+	if( frame_type == TELEMETRY_FRAME_I )
+	{
+		if( g_Tel->i_seen )
+			g_Tel->gop_len = g_Tel->since_i + 1;
+		g_Tel->i_seen = 1;
+		g_Tel->since_i = 0;
+	}
+	else
+	{
+		g_Tel->since_i++;
+	}
+
+	if( is_idr )
+	{
+		if( g_Tel->last_idr_ms >= 0 )
+			g_Tel->idr_interval_ms = (unsigned int)(ms - g_Tel->last_idr_ms);
+		g_Tel->last_idr_ms = ms;
+	}
+}
+
+void tcc_telemetry_output(void)
+{
+	bucket_now( now_ms() )->output++;
+}
+
+void tcc_telemetry_search(int searching)
+{
+	long long ms;
+
+	if( searching == g_Tel->searching )
+		return;
+
+	ms = now_ms();
+	if( searching )
+	{
+		g_Tel->search_start_ms = ms;
+		g_Tel->search_count++;
+	}
+	else
+	{
+		g_Tel->search_last_ms = (unsigned int)(ms - g_Tel->search_start_ms);
+		if( g_Tel->search_last_ms > g_Tel->search_max_ms )
+			g_Tel->search_max_ms = g_Tel->search_last_ms;
+		DebugPrint( "I-frame search took %u ms", g_Tel->search_last_ms );
+	}
+	g_Tel->searching = searching;
+}
+
+void tcc_telemetry_get(VdecTelemetry *tel)
+{
+	unsigned long long bytes = 0, mbs = 0;
+	unsigned int i, n;
+
+	memset( tel, 0x00, sizeof(VdecTelemetry) );
+
+	if( g_Tel->sec >= 0 )
+	{
+		bucket_now( now_ms() );
+
+		// complete seconds only, the bucket being filled would read low
+		n = (unsigned int)(g_Tel->sec - g_Tel->first_sec);
+		if( n > TELEMETRY_WINDOW_SEC )
+			n = TELEMETRY_WINDOW_SEC;
+		tel->window_sec = n;
+
+		for( i = 1; i <= n; i++ )
+		{
+			const TelBucket *b = &g_Tel->bucket[(g_Tel->sec - i) % BUCKETS];
+			unsigned int kbps = (unsigned int)(((unsigned long long)b->bytes * 8) / 1000);
+
+			if( i == 1 )
+			{
+				tel->bitrate_kbps = kbps;
+				tel->decode_fps = b->decoded;
+				tel->output_fps = b->output;
+			}
+			if( kbps > tel->bitrate_peak_kbps )
+				tel->bitrate_peak_kbps = kbps;
+			bytes += b->bytes;
+			tel->frames_other += b->type[TELEMETRY_FRAME_UNKNOWN];
+			tel->frames_i += b->type[TELEMETRY_FRAME_I];
+			tel->frames_p += b->type[TELEMETRY_FRAME_P];
+			tel->frames_b += b->type[TELEMETRY_FRAME_B];
+			tel->err_mbs += b->err_mbs;
+			mbs += b->mbs;
+		}
+		if( n > 0 )
+			tel->bitrate_avg_kbps = (unsigned int)((bytes * 8) / (1000ULL * n));
+		if( mbs > 0 )
+			tel->err_mb_permille = (unsigned int)(((unsigned long long)tel->err_mbs * 1000) / mbs);
+	}
+
+	tel->gop_len = g_Tel->gop_len;
+	tel->idr_interval_ms = g_Tel->idr_interval_ms;
+	tel->search_count = g_Tel->search_count;
+	tel->search_last_ms = g_Tel->search_last_ms;
+	tel->search_max_ms = g_Tel->search_max_ms;
+	tel->searching = g_Tel->searching;
+}
@@ -0,0 +1,58 @@
+//********************************************************************************************
+/**
+ * @file        tcc_vdec_telemetry.h
+ * @brief		Rolling stream quality statistics fed by the decoder, constant memory.
+ * 				This interface contain : Reset, Select slot, Account decoded/output frames and I-frame searches, Get snapshot.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+#ifndef	__TCC_VDEC_TELEMETRY_H__
+#define	__TCC_VDEC_TELEMETRY_H__
+
+#define TELEMETRY_WINDOW_SEC	8		/* one bucket per second, the newest one is still filling */
+#define TELEMETRY_SLOT_COUNT	2		/* VPU_SLOT_COUNT : one set of statistics per decoder */
+
+/* frame types, same numbering as get_frame_type_for_frame_skipping() */
+#define TELEMETRY_FRAME_UNKNOWN	0
+#define TELEMETRY_FRAME_I		1
+#define TELEMETRY_FRAME_P		2
+#define TELEMETRY_FRAME_B		3
+
+typedef struct _VdecTelemetry {
+	unsigned int	window_sec;			//complete seconds the window figures below cover
+	unsigned int	bitrate_kbps;		//input bitrate of the last complete second
+	unsigned int	bitrate_avg_kbps;	//average over the window
+	unsigned int	bitrate_peak_kbps;	//highest second of the window
+	unsigned int	decode_fps;			//pictures decoded in the last complete second
+	unsigned int	output_fps;			//frames output in the last complete second
+	unsigned int	frames_i;			//picture type mix over the window
+	unsigned int	frames_p;
+	unsigned int	frames_b;
+	unsigned int	frames_other;
+	unsigned int	gop_len;			//pictures from the previous I picture to the last one
+	unsigned int	idr_interval_ms;	//time between the last two IDR pictures, 0 : fewer than two seen
+	unsigned int	err_mbs;			//error macroblocks over the window
+	unsigned int	err_mb_permille;	//error macroblocks per 1000 decoded over the window
+	unsigned int	search_count;		//I-frame searches since reset (seek, loss, start)
+	unsigned int	search_last_ms;		//duration of the last completed search
+	unsigned int	search_max_ms;
+	unsigned int	searching;			//1 : a search is running now
+} VdecTelemetry;
+
+/* reset clears the statistics of the selected slot only, every other call works on it too */
+void tcc_telemetry_reset(void);
+void tcc_telemetry_select(int slot);
+
+/* one VDEC_DECODE call that consumed its input.
+ * frame_type : TELEMETRY_FRAME_xxx, -1 : no picture was decoded (header, skipped), mbs : macroblocks of the picture */
+void tcc_telemetry_decoded(int bytes, int frame_type, int is_idr, int err_mbs, int mbs);
+void tcc_telemetry_output(void);
+
+/* the decoder is (1) or is not (0) searching for an I-frame after this call */
+void tcc_telemetry_search(int searching);
+
+void tcc_telemetry_get(VdecTelemetry *tel);
+
+#endif	// __TCC_VDEC_TELEMETRY_H__
@@ -0,0 +1,38 @@
+//********************************************************************************************
+/**
+ * @file        tcc_vdecd.c
+ * @brief		Decode service daemon : owns the VPU and the overlay for all clients of tcc_vdec_client.
+ * 				This interface contain : main.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+
+#include <stdio.h>
+#include <signal.h>
+
+#include "tcc_vdec_service.h"
+
+static void on_signal(int sig)
+{
+	tcc_vdec_service_stop();
+}
+
+/* tccvdecd [socket path] */
+int main(int argc, char **argv)
+{
+	const char *path = (argc > 1) ? argv[1] : VDEC_SERVICE_SOCKET;
+
+	signal( SIGINT, on_signal );
+	signal( SIGTERM, on_signal );
+	// a client that dies mid write must not take the daemon with it
+	signal( SIGPIPE, SIG_IGN );
+
+	if( tcc_vdec_service_run( path ) < 0 )
+	{
+		printf( "[TCC_VDECD](E):cannot serve on %s\n", path );
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,170 @@
+//********************************************************************************************
+/**
+ * @file        tcc_vpu_fault.c
+ * @brief		Fault injection into the VPU and display calls, to drive the decoder error paths in test builds.
+ * 				This interface contain : Set fault rate, Wrap vdec_vpu, Fault points, Recovery and leak counters.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "tcc_vpudec_intf.h"
+#include "tcc_vpu_fault.h"
+
+//#define	DEBUG_MODE
+#ifdef	DEBUG_MODE
+	#define	DebugPrint( fmt, ... )	printf( "[TCC_VPU_FAULT](D):"fmt"\n", ##__VA_ARGS__ )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_VPU_FAULT](E):"fmt"\n", ##__VA_ARGS__ )
+#else
+	#define	DebugPrint( fmt, ... )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_VPU_FAULT](E):"fmt"\n", ##__VA_ARGS__ )
+#endif
+
+/* buffer-full reports in a row : one more than the decoder tolerates before it restores */
+#define FAULT_BUF_FULL_BURST	(MAX_CONSECUTIVE_VPU_BUFFER_FULL_COUNT + 2)
+
+#ifdef	DEBUG_MODE
+static const char *g_FaultName[FAULT_CLASS_COUNT] = {
+	"seq_header", "buf_full", "codec_exit", "buf_clear", "hang", "overlay_open"
+};
+#endif
+
+static VpuFaultVdec g_Vdec = NULL;		// the real vdec_vpu
+static int g_Permille[FAULT_CLASS_COUNT];
+static unsigned int g_Seed = 1;
+static int g_BufFullLeft = 0;			// calls left in the current buffer-full burst
+static long long g_InjectMs = -1;		// first injection since the last frame out, -1 : none
+static VpuFaultStat g_Stat;
+
+static long long now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int tcc_vpu_fault_set(int fault, int permille)
+{
+	if( fault < 0 || fault >= FAULT_CLASS_COUNT || permille < 0 || permille > 1000 )
+		return -1;
+	g_Permille[fault] = permille;
+	return 0;
+}
+
+void tcc_vpu_fault_seed(unsigned int seed)
+{
+	g_Seed = seed;
+}
+
+void tcc_vpu_fault_reset(void)
+{
+	int instances = g_Stat.vpu_instances;
+
+	memset( g_Permille, 0x00, sizeof(g_Permille) );
+	memset( &g_Stat, 0x00, sizeof(VpuFaultStat) );
+	g_Stat.vpu_instances = instances;
+	g_BufFullLeft = 0;
+	g_InjectMs = -1;
+}
+
+void tcc_vpu_fault_get_stat(VpuFaultStat *stat)
+{
+	memcpy( stat, &g_Stat, sizeof(VpuFaultStat) );
+}
+
+int tcc_vpu_fault_hit(int fault)
+{
+	if( g_Permille[fault] == 0 || (int)(rand_r( &g_Seed ) % 1000) >= g_Permille[fault] )
+		return 0;
+
+	g_Stat.injected[fault]++;
+	if( g_InjectMs < 0 )
+		g_InjectMs = now_ms();
+	DebugPrint( "inject %s", g_FaultName[fault] );
+	return 1;
+}
+
+static int fault_vdec(int cmd, int *handle, void *param1, void *param2, void *instance)
+{
+	int ret;
+
+	switch( cmd )
+	{
+		case VDEC_DEC_SEQ_HEADER:
+			if( tcc_vpu_fault_hit( FAULT_SEQ_HEADER ) )
+				return -1;
+			break;
+
+		case VDEC_DECODE:
+			if( tcc_vpu_fault_hit( FAULT_HANG ) )
+				usleep( FAULT_HANG_MS * 1000 );
+			if( tcc_vpu_fault_hit( FAULT_CODEC_EXIT ) )
+				return -RETCODE_CODEC_EXIT;
+
+			ret = g_Vdec( cmd, handle, param1, param2, instance );
+			if( ret >= 0 && param2 != NULL )
+			{
+				// one buffer-full alone is harmless, the escalation needs a run of them
+				if( g_BufFullLeft == 0 && tcc_vpu_fault_hit( FAULT_BUF_FULL ) )
+					g_BufFullLeft = FAULT_BUF_FULL_BURST;
+				if( g_BufFullLeft > 0 )
+				{
+					g_BufFullLeft--;
+					((vdec_output_t*)param2)->m_DecOutInfo.m_iDecodingStatus = VPU_DEC_BUF_FULL;
+				}
+			}
+			return ret;
+
+		case VDEC_BUF_FLAG_CLEAR:
+			if( tcc_vpu_fault_hit( FAULT_BUF_CLEAR ) )
+				return -1;
+			break;
+
+		default:
+			break;
+	}
+
+	return g_Vdec( cmd, handle, param1, param2, instance );
+}
+
+VpuFaultVdec tcc_vpu_fault_wrap(VpuFaultVdec vdec)
+{
+	g_Vdec = vdec;
+	return fault_vdec;
+}
+
+void tcc_vpu_fault_instance(int delta)
+{
+	g_Stat.vpu_instances += delta;
+}
+
+/* the access unit hit by the fault is not counted on its way in, the one that brings the frame back is :
+ * frames_lost ends up as the number of access units without output */
+void tcc_vpu_fault_au_in(void)
+{
+	if( g_InjectMs >= 0 )
+		g_Stat.frames_lost++;
+}
+
+void tcc_vpu_fault_frame_out(void)
+{
+	unsigned int ms;
+
+	if( g_InjectMs < 0 )
+		return;
+
+	ms = (unsigned int)(now_ms() - g_InjectMs);
+	g_InjectMs = -1;
+	g_Stat.recoveries++;
+	g_Stat.last_recovery_ms = ms;
+	if( ms > g_Stat.max_recovery_ms )
+		g_Stat.max_recovery_ms = ms;
+}
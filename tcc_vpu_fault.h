@@ -0,0 +1,55 @@
+//********************************************************************************************
+/**
+ * @file        tcc_vpu_fault.h
+ * @brief		Fault injection into the VPU and display calls, to drive the decoder error paths in test builds.
+ * 				This interface contain : Set fault rate, Wrap vdec_vpu, Fault points, Recovery and leak counters.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+#ifndef	__TCC_VPU_FAULT_H__
+#define	__TCC_VPU_FAULT_H__
+
+/* the decoder only calls the hooks below when built with -DVDEC_FAULT_INJECT.
+ * test/vdec_stress.c drives every class on the host and checks recovery and leaks (make check) */
+
+#define FAULT_SEQ_HEADER	0	/* VDEC_DEC_SEQ_HEADER fails : retried with the next access unit */
+#define FAULT_BUF_FULL		1	/* VDEC_DECODE reports VPU_DEC_BUF_FULL long enough to escalate to a restore */
+#define FAULT_CODEC_EXIT	2	/* VDEC_DECODE returns -RETCODE_CODEC_EXIT : close and restore from the saved header */
+#define FAULT_BUF_CLEAR		3	/* VDEC_BUF_FLAG_CLEAR fails */
+#define FAULT_HANG			4	/* VDEC_DECODE blocks FAULT_HANG_MS before it runs : watchdog path */
+#define FAULT_OVERLAY_OPEN	5	/* /dev/overlay does not open : frame buffer fallback */
+#define FAULT_CLASS_COUNT	6
+
+#define FAULT_HANG_MS			300		/* above the 1080p watchdog deadline */
+
+typedef struct _VpuFaultStat {
+	unsigned int	injected[FAULT_CLASS_COUNT];
+	unsigned int	recoveries;			//injections followed by a frame out
+	unsigned int	last_recovery_ms;	//first injection since the last frame out -> next frame out
+	unsigned int	max_recovery_ms;
+	unsigned int	frames_lost;		//access units decoded without a frame out while recovering
+	int				vpu_instances;		//vdec instances alive, 0 once the decoder is closed
+} VpuFaultStat;
+
+/* chance per call in 1/1000, 0 : off. -1 : unknown class */
+int tcc_vpu_fault_set(int fault, int permille);
+
+/* same seed, same stream : same injection points */
+void tcc_vpu_fault_seed(unsigned int seed);
+
+/* all faults off, counters cleared (vpu_instances is kept) */
+void tcc_vpu_fault_reset(void);
+void tcc_vpu_fault_get_stat(VpuFaultStat *stat);
+
+/* hooks. VpuFaultVdec has the signature of vdec_vpu() */
+typedef int (*VpuFaultVdec)(int cmd, int *handle, void *param1, void *param2, void *instance);
+
+VpuFaultVdec tcc_vpu_fault_wrap(VpuFaultVdec vdec);
+int tcc_vpu_fault_hit(int fault);
+void tcc_vpu_fault_instance(int delta);
+void tcc_vpu_fault_au_in(void);
+void tcc_vpu_fault_frame_out(void);
+
+#endif	// __TCC_VPU_FAULT_H__
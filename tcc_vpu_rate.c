@@ -0,0 +1,194 @@
+//********************************************************************************************
+/**
+ * @file        tcc_vpu_rate.c
+ * @brief		Frame rate and bitrate of the incoming stream, for the VPU performance hints and the PTS interval.
+ * 				This interface contain : Reset, VUI timing, Account access units, Estimated rates, Material change.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "tcc_vpu_rate.h"
+
+//#define	DEBUG_MODE
+#ifdef	DEBUG_MODE
+	#define	DebugPrint( fmt, ... )	printf( "[TCC_VPU_RATE](D):"fmt"\n", ##__VA_ARGS__ )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_VPU_RATE](E):"fmt"\n", ##__VA_ARGS__ )
+#else
+	#define	DebugPrint( fmt, ... )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_VPU_RATE](E):"fmt"\n", ##__VA_ARGS__ )
+#endif
+
+#define RATE_MAX_FPS	120
+
+typedef struct _VpuRate {
+	unsigned int	vui_fps_milli;		//0 : no VUI timing
+	long long		last_ms;			//arrival of the last picture, -1 : none
+	unsigned int	pts[RATE_REORDER_WINDOW];	//last time stamps in decode order, by pts_cnt % RATE_REORDER_WINDOW
+	unsigned int	pts_cnt;
+	unsigned int	interval_us;		//running average of the picture interval
+	unsigned int	samples;
+
+	long long		sec;				//arrival second being counted, -1 : none
+	unsigned int	sec_bytes;
+	unsigned int	kbps[RATE_WINDOW_SEC];	//complete seconds by sec % RATE_WINDOW_SEC, 0 : no input
+	unsigned int	seconds;			//complete seconds seen, up to RATE_WINDOW_SEC
+} VpuRate;
+
+/* one estimate per decoder slot : the stream in pre-roll must not disturb the one on screen */
+static VpuRate g_SlotRate[RATE_SLOT_COUNT] = { { .last_ms = -1, .sec = -1 }, { .last_ms = -1, .sec = -1 } };
+static VpuRate *g_Rate = &g_SlotRate[0];
+
+static long long now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void tcc_vpu_rate_reset(void)
+{
+	memset( g_Rate, 0x00, sizeof(VpuRate) );
+	g_Rate->last_ms = -1;
+	g_Rate->sec = -1;
+}
+
+void tcc_vpu_rate_select(int slot)
+{
+	if( slot >= 0 && slot < RATE_SLOT_COUNT )
+		g_Rate = &g_SlotRate[slot];
+}
+
+void tcc_vpu_rate_vui(unsigned int num_units_in_tick, unsigned int time_scale)
+{
+	// one tick is a field : two per frame
+	if( num_units_in_tick == 0 || time_scale == 0 )
+		g_Rate->vui_fps_milli = 0;
+	else
+		g_Rate->vui_fps_milli = (unsigned int)(((unsigned long long)time_scale * 1000) / (2ULL * num_units_in_tick));
+}
+
+static void rate_bytes(int bytes, long long ms)
+{
+	long long sec = ms / 1000;
+
+	if( g_Rate->sec >= 0 && sec != g_Rate->sec )
+	{
+		// close the second just finished, seconds without input count as empty
+		g_Rate->kbps[g_Rate->sec % RATE_WINDOW_SEC] = g_Rate->sec_bytes / 125;
+		if( g_Rate->seconds < RATE_WINDOW_SEC )
+			g_Rate->seconds++;
+		if( sec - g_Rate->sec > RATE_WINDOW_SEC )
+			memset( g_Rate->kbps, 0x00, sizeof(g_Rate->kbps) );
+		else
+			while( ++g_Rate->sec < sec )
+				g_Rate->kbps[g_Rate->sec % RATE_WINDOW_SEC] = 0;
+		g_Rate->sec_bytes = 0;
+	}
+	g_Rate->sec = sec;
+	g_Rate->sec_bytes += bytes;
+}
+
+/* smallest positive step between the time stamps of the window : the interval of neighbours in display order,
+ * wherever the reordering put them. -1 until the window is full */
+static long long rate_pts_step(unsigned int pts_ms)
+{
+	unsigned int i, j, n;
+	long long step = -1;
+
+	g_Rate->pts[g_Rate->pts_cnt++ % RATE_REORDER_WINDOW] = pts_ms;
+	if( g_Rate->pts_cnt < RATE_REORDER_WINDOW )
+		return -1;
+
+	n = RATE_REORDER_WINDOW;
+	for( i = 0; i < n; i++ )
+	{
+		for( j = i + 1; j < n; j++ )
+		{
+			long long d = (g_Rate->pts[i] > g_Rate->pts[j]) ? g_Rate->pts[i] - g_Rate->pts[j] : g_Rate->pts[j] - g_Rate->pts[i];
+
+			if( d > 0 && (step < 0 || d < step) )
+				step = d;
+		}
+	}
+	return step;
+}
+
+void tcc_vpu_rate_au(int bytes, unsigned int pts_ms, int picture)
+{
+	long long ms = now_ms();
+	long long delta_ms;
+
+	rate_bytes( bytes, ms );
+	if( !picture )
+		return;
+
+	// time stamps are exact when the source has them, arrival times carry the transport jitter
+	if( pts_ms != 0 )
+		delta_ms = rate_pts_step( pts_ms );
+	else if( g_Rate->last_ms >= 0 )
+		delta_ms = ms - g_Rate->last_ms;
+	else
+		delta_ms = -1;
+	g_Rate->last_ms = ms;
+
+	if( delta_ms <= 0 || delta_ms > RATE_MAX_GAP_MS )
+		return;
+	if( g_Rate->samples == 0 )
+		g_Rate->interval_us = (unsigned int)(delta_ms * 1000);
+	else
+		g_Rate->interval_us = (unsigned int)((g_Rate->interval_us * 7LL + delta_ms * 1000) / 8);
+	g_Rate->samples++;
+}
+
+unsigned int tcc_vpu_rate_fps(void)
+{
+	unsigned int vui = (g_Rate->vui_fps_milli + 500) / 1000;
+	unsigned int fps;
+
+	if( g_Rate->samples < RATE_MIN_SAMPLES || g_Rate->interval_us == 0 )
+		fps = (vui != 0) ? vui : RATE_DEFAULT_FPS;
+	else
+	{
+		fps = (1000000 + g_Rate->interval_us / 2) / g_Rate->interval_us;
+		// the VUI is exact as long as the source really sends at that rate
+		if( vui != 0 && (fps > vui ? fps - vui : vui - fps) * 100 <= vui * RATE_FPS_TOLERANCE )
+			fps = vui;
+	}
+
+	if( fps == 0 )
+		fps = 1;
+	if( fps > RATE_MAX_FPS )
+		fps = RATE_MAX_FPS;
+	return fps;
+}
+
+unsigned int tcc_vpu_rate_mbps(void)
+{
+	unsigned int i, peak = 0;
+
+	if( g_Rate->seconds == 0 )
+		return RATE_DEFAULT_MBPS;
+	for( i = 0; i < RATE_WINDOW_SEC; i++ )
+	{
+		if( g_Rate->kbps[i] > peak )
+			peak = g_Rate->kbps[i];
+	}
+	return (peak < 1000) ? 1 : (peak + 999) / 1000;
+}
+
+int tcc_vpu_rate_changed(unsigned int cur_fps, unsigned int cur_mbps, unsigned int fps, unsigned int mbps)
+{
+	if( (fps > cur_fps ? fps - cur_fps : cur_fps - fps) * 100 > cur_fps * RATE_FPS_TOLERANCE )
+		return 1;
+	// the clock steps are coarse, a quarter either way is worth a change
+	if( mbps * 4 > cur_mbps * 5 || mbps * 4 < cur_mbps * 3 )
+		return 1;
+	return 0;
+}
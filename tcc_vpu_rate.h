@@ -0,0 +1,41 @@
+//********************************************************************************************
+/**
+ * @file        tcc_vpu_rate.h
+ * @brief		Frame rate and bitrate of the incoming stream, for the VPU performance hints and the PTS interval.
+ * 				This interface contain : Reset, Select slot, VUI timing, Account access units, Estimated rates, Material change.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+#ifndef	__TCC_VPU_RATE_H__
+#define	__TCC_VPU_RATE_H__
+
+#define RATE_DEFAULT_FPS		30		/* until the stream tells otherwise */
+#define RATE_DEFAULT_MBPS		10
+#define RATE_MIN_SAMPLES		16		/* picture intervals before the arrival estimate is trusted */
+#define RATE_MAX_GAP_MS			1000	/* a longer gap is a pause, not a frame interval */
+#define RATE_REORDER_WINDOW		8		/* time stamps looked at together : B pictures arrive out of display order */
+#define RATE_WINDOW_SEC			4		/* the bitrate is the busiest second of this window */
+#define RATE_FPS_TOLERANCE		15		/* % : smaller frame rate changes are not applied */
+#define RATE_SLOT_COUNT			2		/* VPU_SLOT_COUNT : one estimate per decoder */
+
+/* reset clears the estimate of the selected slot only, every other call works on it too */
+void tcc_vpu_rate_reset(void);
+void tcc_vpu_rate_select(int slot);
+
+/* timing_info of the H.264 VUI, 0 : not present */
+void tcc_vpu_rate_vui(unsigned int num_units_in_tick, unsigned int time_scale);
+
+/* one access unit in. pts_ms : 0 if unknown, the arrival time is used then. picture : 0 for headers only.
+ * pts_ms may come in decode order : the picture interval is the smallest step between the last RATE_REORDER_WINDOW of them */
+void tcc_vpu_rate_au(int bytes, unsigned int pts_ms, int picture);
+
+/* best estimates so far : RATE_DEFAULT_xxx before anything is known */
+unsigned int tcc_vpu_rate_fps(void);
+unsigned int tcc_vpu_rate_mbps(void);
+
+/* 1 if fps/mbps moved far enough from the values in use to be worth applying */
+int tcc_vpu_rate_changed(unsigned int cur_fps, unsigned int cur_mbps, unsigned int fps, unsigned int mbps);
+
+#endif	// __TCC_VPU_RATE_H__
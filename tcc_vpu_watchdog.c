@@ -0,0 +1,202 @@
+//********************************************************************************************
+/**
+ * @file        tcc_vpu_watchdog.c
+ * @brief		Watchdog over VPU commands : reports commands that overrun their deadline, asks for a restore of a
+ * 				wedged VPU and times the recovery.
+ * 				This interface contain : Start/Stop, Arm/Disarm around a VPU command, Frame out, Get counters.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "tcc_vdec_event.h"
+#include "tcc_vpu_watchdog.h"
+
+//#define	DEBUG_MODE
+#ifdef	DEBUG_MODE
+	#define	DebugPrint( fmt, ... )	printf( "[TCC_VPU_WATCHDOG](D):"fmt"\n", ##__VA_ARGS__ )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_VPU_WATCHDOG](E):"fmt"\n", ##__VA_ARGS__ )
+#else
+	#define	DebugPrint( fmt, ... )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_VPU_WATCHDOG](E):"fmt"\n", ##__VA_ARGS__ )
+#endif
+
+static pthread_t g_WdThread;
+static volatile int g_WdRun = 0;
+
+/* command in flight, written by the decoding thread only */
+static volatile int g_Armed = 0;
+static volatile long long g_StartMs = 0;
+static volatile int g_DeadlineMs = 0;
+static volatile int g_Stalled = 0;		// set once per command, by whichever thread sees the overrun first
+static volatile int g_ArmedSlot = 0;	// decoder slot the command runs for
+
+/* per decoder slot : a stall of the stream in pre-roll is not ended by a frame of the one on screen */
+static volatile long long g_RecoverFromMs[WATCHDOG_SLOT_COUNT] = { -1, -1 };		// -1 : not recovering
+static int g_Overruns[WATCHDOG_SLOT_COUNT];		// in a row
+static int g_WdSlot = 0;
+static VpuWatchdogStat g_Stat;
+
+static long long now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* 1 if this call is the one that reports the stall */
+static int report_stall(long long overdue_ms)
+{
+	if( !__sync_bool_compare_and_swap( &g_Stalled, 0, 1 ) )
+		return 0;
+
+	__sync_fetch_and_add( &g_Stat.stalls, 1 );
+	g_RecoverFromMs[g_ArmedSlot] = g_StartMs + g_DeadlineMs;
+	ErrorPrint( "VPU command overdue by %lld ms (deadline %d ms)", overdue_ms, g_DeadlineMs );
+	tcc_event_post_code( VDEC_EVENT_STALL, g_DeadlineMs );
+	return 1;
+}
+
+static void* watchdog_thread(void *arg)
+{
+	long long overdue;
+
+	while( g_WdRun )
+	{
+		usleep( WATCHDOG_TICK_MS * 1000 );
+
+		if( !g_Armed || g_Stalled )
+			continue;
+		__sync_synchronize();
+		overdue = now_ms() - g_StartMs - g_DeadlineMs;
+		// the decoding thread is stuck inside the VPU library : all that can be done here is to tell
+		if( overdue > 0 && g_Armed )
+			report_stall( overdue );
+	}
+
+	return NULL;
+}
+
+int tcc_vpu_watchdog_start(void)
+{
+	int i;
+
+	// a new stream on the selected slot, the other one may be running already
+	g_RecoverFromMs[g_WdSlot] = -1;
+	g_Overruns[g_WdSlot] = 0;
+	if( g_WdRun )
+		return 0;
+
+	g_Armed = 0;
+	g_Stalled = 0;
+	for( i = 0; i < WATCHDOG_SLOT_COUNT; i++ )
+	{
+		g_RecoverFromMs[i] = -1;
+		g_Overruns[i] = 0;
+	}
+	g_WdRun = 1;
+	if( pthread_create( &g_WdThread, NULL, watchdog_thread, NULL ) != 0 )
+	{
+		ErrorPrint( "watchdog thread create fail" );
+		g_WdRun = 0;
+		return -1;
+	}
+	return 0;
+}
+
+void tcc_vpu_watchdog_stop(void)
+{
+	int i;
+
+	if( g_WdRun )
+	{
+		g_WdRun = 0;
+		pthread_join( g_WdThread, NULL );	// returns within one tick
+	}
+	g_Armed = 0;
+	for( i = 0; i < WATCHDOG_SLOT_COUNT; i++ )
+		g_RecoverFromMs[i] = -1;
+}
+
+void tcc_vpu_watchdog_select(int slot)
+{
+	if( slot >= 0 && slot < WATCHDOG_SLOT_COUNT )
+		g_WdSlot = slot;
+}
+
+int tcc_vpu_watchdog_deadline(int width, int height)
+{
+	int mbs = ((width + 15) >> 4) * ((height + 15) >> 4);
+
+	return WATCHDOG_BASE_MS + (mbs * WATCHDOG_US_PER_MB) / 1000;
+}
+
+void tcc_vpu_watchdog_arm(int deadline_ms)
+{
+	g_Stalled = 0;
+	g_ArmedSlot = g_WdSlot;
+	g_DeadlineMs = deadline_ms;
+	g_StartMs = now_ms();
+	__sync_synchronize();	// the thread must not see the old start time with the new armed flag
+	g_Armed = 1;
+}
+
+int tcc_vpu_watchdog_disarm(void)
+{
+	long long elapsed;
+
+	g_Armed = 0;
+	__sync_synchronize();
+	elapsed = now_ms() - g_StartMs;
+	if( elapsed > g_Stat.longest_cmd_ms )
+		g_Stat.longest_cmd_ms = (unsigned int)elapsed;
+
+	// overran between two ticks : still a stall
+	if( elapsed > g_DeadlineMs )
+		report_stall( elapsed - g_DeadlineMs );
+	if( !g_Stalled )
+	{
+		g_Overruns[g_ArmedSlot] = 0;
+		return WATCHDOG_IN_TIME;
+	}
+
+	// the driver gave up neither in time nor on its own : do not trust it with the next picture either
+	if( elapsed > (long long)g_DeadlineMs * WATCHDOG_HARD_FACTOR || ++g_Overruns[g_ArmedSlot] >= WATCHDOG_MAX_OVERRUNS )
+	{
+		DebugPrint( "VPU wedged : %lld ms, %d overruns in a row, restore", elapsed, g_Overruns[g_ArmedSlot] );
+		g_Overruns[g_ArmedSlot] = 0;
+		g_Stat.restores++;
+		return WATCHDOG_RESTORE;
+	}
+	return WATCHDOG_OVERRUN;
+}
+
+void tcc_vpu_watchdog_frame_out(void)
+{
+	unsigned int ms;
+
+	if( g_RecoverFromMs[g_WdSlot] < 0 )
+		return;
+
+	ms = (unsigned int)(now_ms() - g_RecoverFromMs[g_WdSlot]);
+	g_RecoverFromMs[g_WdSlot] = -1;
+	g_Stat.recoveries++;
+	g_Stat.last_recovery_ms = ms;
+	if( ms > g_Stat.max_recovery_ms )
+		g_Stat.max_recovery_ms = ms;
+	DebugPrint( "video back %u ms after the stall", ms );
+}
+
+void tcc_vpu_watchdog_get_stat(VpuWatchdogStat *stat)
+{
+	memcpy( stat, &g_Stat, sizeof(VpuWatchdogStat) );
+	stat->stalled = (g_Armed && g_Stalled) ? 1 : 0;
+}
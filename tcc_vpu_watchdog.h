@@ -0,0 +1,58 @@
+//********************************************************************************************
+/**
+ * @file        tcc_vpu_watchdog.h
+ * @brief		Watchdog over VPU commands : reports commands that overrun their deadline, asks for a restore of a
+ * 				wedged VPU and times the recovery.
+ * 				This interface contain : Start/Stop, Arm/Disarm around a VPU command, Frame out, Get counters.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+#ifndef	__TCC_VPU_WATCHDOG_H__
+#define	__TCC_VPU_WATCHDOG_H__
+
+/* deadline of one picture decode : base + time per macroblock, 1080p gets ~130 ms (4 frame times at 30 fps) */
+#define WATCHDOG_BASE_MS			50
+#define WATCHDOG_US_PER_MB			10
+#define WATCHDOG_SEQ_HEADER_MS		200
+#define WATCHDOG_TICK_MS			20		/* stall detection granularity */
+#define WATCHDOG_SLOT_COUNT			2		/* VPU_SLOT_COUNT : recoveries are timed per decoder */
+/* a slow picture is used, a wedged VPU is restored : one command past WATCHDOG_HARD_FACTOR deadlines,
+ * or WATCHDOG_MAX_OVERRUNS overruns in a row */
+#define WATCHDOG_HARD_FACTOR		4
+#define WATCHDOG_MAX_OVERRUNS		3
+
+/* tcc_vpu_watchdog_disarm() */
+#define WATCHDOG_IN_TIME			0
+#define WATCHDOG_OVERRUN			1		/* late, the result stands */
+#define WATCHDOG_RESTORE			2		/* handle like -RETCODE_MULTI_CODEC_EXIT_TIMEOUT whatever the command returned */
+
+typedef struct _VpuWatchdogStat {
+	unsigned int	stalls;				//VPU commands that ran past their deadline
+	unsigned int	restores;			//stalls that closed and restored the decoder
+	unsigned int	recoveries;			//stalls followed by video again
+	unsigned int	last_recovery_ms;	//deadline passed -> first frame out after it
+	unsigned int	max_recovery_ms;
+	unsigned int	longest_cmd_ms;		//slowest VPU command since start
+	unsigned int	stalled;			//1 : a command is overdue right now
+} VpuWatchdogStat;
+
+int tcc_vpu_watchdog_start(void);
+void tcc_vpu_watchdog_stop(void);
+
+/* decoder slot of the following commands and frames out */
+void tcc_vpu_watchdog_select(int slot);
+
+int tcc_vpu_watchdog_deadline(int width, int height);
+
+/* around every VPU command of the decoding thread. disarm returns WATCHDOG_IN_TIME / _OVERRUN / _RESTORE */
+void tcc_vpu_watchdog_arm(int deadline_ms);
+int tcc_vpu_watchdog_disarm(void);
+
+/* a frame was output : ends a recovery */
+void tcc_vpu_watchdog_frame_out(void);
+
+void tcc_vpu_watchdog_get_stat(VpuWatchdogStat *stat);
+
+#endif	// __TCC_VPU_WATCHDOG_H__
@@ -10,6 +10,14 @@
 //********************************************************************************************
 
 #include "tcc_vpudec_intf.h"
+#include "tcc_vdec_telemetry.h"
+#include "tcc_vdec_event.h"
+#include "tcc_bs_sanitize.h"
+#include "tcc_vpu_watchdog.h"
+#include "tcc_vpu_rate.h"
+#ifdef VDEC_FAULT_INJECT
+#include "tcc_vpu_fault.h"
+#endif
 
 
 //#define	DEBUG_MODE
@@ -23,6 +31,65 @@
 
 ///////////   Global Define    //////////////////////
 static tDEC_PRIVATE *dec_private;
+static unsigned int g_HeapOps;		//heap allocations and frees done by this module, constant while decoding
+
+/* every per-stream buffer lives in one block allocated at init and freed at close */
+typedef struct _VPU_ARENA {
+	unsigned char	*base;
+	size_t			size;
+	size_t			used;
+} VPU_ARENA;
+static VPU_ARENA g_Arena;
+
+/* contexts of the slots not selected : a second stream can be pre-rolled while the first one is shown.
+ * dec_private and g_Arena always belong to g_Slot */
+static tDEC_PRIVATE *g_SlotPrivate[VPU_SLOT_COUNT];
+static VPU_ARENA g_SlotArena[VPU_SLOT_COUNT];
+static int g_Slot = 0;
+
+/* rate estimate, telemetry and watchdog recovery are per stream too, tcc_vpudec_select() moves them along */
+#if RATE_SLOT_COUNT < VPU_SLOT_COUNT || TELEMETRY_SLOT_COUNT < VPU_SLOT_COUNT || WATCHDOG_SLOT_COUNT < VPU_SLOT_COUNT
+#error "per slot state of the rate estimate, telemetry or watchdog is smaller than VPU_SLOT_COUNT"
+#endif
+
+#define ARENA_ALIGN(x)	(((x) + 15) & ~(size_t)15)
+
+static int DECODER_DEC_AvcSteady( tDEC_FRAME_INPUT *pInput, tDEC_FRAME_OUTPUT *pOutput, tDEC_RESULT *pResult );
+static void DECODER_CLOSE(void);
+
+static int arena_open(size_t size)
+{
+	g_Arena.base = (unsigned char*)calloc( 1, size );
+	g_HeapOps++;
+	if( g_Arena.base == NULL )
+		return -1;
+	g_Arena.size = size;
+	g_Arena.used = 0;
+	return 0;
+}
+
+static void arena_close(void)
+{
+	if( g_Arena.base != NULL )
+	{
+		free( g_Arena.base );
+		g_HeapOps++;
+	}
+	memset( &g_Arena, 0x00, sizeof(VPU_ARENA) );
+}
+
+/* zeroed slot from the arena, NULL when the size computed at init was too small */
+static void* arena_carve(size_t size)
+{
+	void *p;
+
+	size = ARENA_ALIGN(size);
+	if( g_Arena.base == NULL || g_Arena.used + size > g_Arena.size )
+		return NULL;
+	p = g_Arena.base + g_Arena.used;
+	g_Arena.used += size;
+	return p;
+}
 
 static void
 disp_pic_info (int Opcode, void* pParam1, void *pParam2, void *pParam3, unsigned int fps)
@@ -388,29 +455,113 @@ void print_user_data(unsigned char * pUserData)
 	}
 }
 
+/* Return a display buffer to the VPU unless it is pinned for the view hold. A failed clear is not an error for the
+ * caller : it is reported with VDEC_EVENT_ERROR and retried by DispBufClearRetry() before the next decode. */
+static void DispBufClear(unsigned int idx)
+{
+	int ret;
+
+	if(dec_private->pinned_index >= 0 && idx == (unsigned int)dec_private->pinned_index)
+	{
+		DebugPrint("DispIdx %d is pinned, withhold clear", idx);
+		dec_private->pinned_withheld = 1;
+		return;
+	}
+
+	if( ( ret = dec_private->pVideoDecodInstance.gspfVDec( VDEC_BUF_FLAG_CLEAR, NULL, &idx, NULL, dec_private->pVideoDecodInstance.pVdec_Instance ) ) < 0 )
+	{
+		// the VPU still counts it as in use : dropped here, it would be lost until the next restore.
+		// Tried again before the next decode instead, the caller goes on as if it had been cleared.
+		DebugPrint( "[VDEC_BUF_FLAG_CLEAR] Idx = %d, ret = %d, retry", idx, ret );
+		tcc_event_post_code(VDEC_EVENT_ERROR, ret);
+		if(idx < 32)
+			dec_private->clear_retry_mask |= (1u << idx);
+	}
+}
+
+/* give the VPU back the buffers whose clear failed before it looks for a free one */
+static void DispBufClearRetry(void)
+{
+	unsigned int mask = dec_private->clear_retry_mask;
+	unsigned int idx;
+
+	dec_private->clear_retry_mask = 0;
+	for(idx = 0; mask != 0; idx++, mask >>= 1)
+	{
+		if(mask & 1)
+			DispBufClear(idx);
+	}
+}
+
+/* VDEC_DECODE / VDEC_DEC_SEQ_HEADER under the watchdog. An overrun is reported (VDEC_EVENT_STALL and the stall
+ * counters) and a slow command that came back with a picture is used. A wedged VPU (past the hard cap, or overrunning
+ * again and again) is handled like -RETCODE_MULTI_CODEC_EXIT_TIMEOUT whatever it returned : closed, and restored from
+ * the saved sequence header. There is no abort in the driver, the cap starts counting once the call is back. */
+static int VpuCommandWatched(int cmd, void *pParam1, void *pParam2)
+{
+	_VIDEO_DECOD_INSTANCE_ *pInst = &dec_private->pVideoDecodInstance;
+	int deadline;
+	int ret;
+
+	if(cmd == VDEC_DEC_SEQ_HEADER)
+		deadline = WATCHDOG_SEQ_HEADER_MS;
+	else
+		deadline = tcc_vpu_watchdog_deadline(pInst->gsVDecInit.m_iPicWidth, pInst->gsVDecInit.m_iPicHeight);
+
+	tcc_vpu_watchdog_arm(deadline);
+	ret = pInst->gspfVDec( cmd, NULL, pParam1, pParam2, pInst->pVdec_Instance );
+	switch( tcc_vpu_watchdog_disarm() )
+	{
+	case WATCHDOG_OVERRUN:
+		DebugPrint("[cmd:%d] overran %d ms, ret = %d", cmd, deadline, ret);
+		break;
+	case WATCHDOG_RESTORE:
+		DebugPrint("[cmd:%d] VPU wedged, ret = %d discarded", cmd, ret);
+		ret = -RETCODE_MULTI_CODEC_EXIT_TIMEOUT;
+		break;
+	}
+	return ret;
+}
+
+/* VDEC_CLOSE, the next VDEC_DEC_SEQ_HEADER starts over. The frame buffers go with it : forget every index into them */
+static void VpuCloseForReinit(void)
+{
+	dec_private->seq_header_init_error_count = SEQ_HEADER_INIT_ERROR_COUNT;
+	dec_private->ConsecutiveBufferFullCnt = 0;
+	if(dec_private->pVideoDecodInstance.isVPUClosed != 1)
+	{
+		dec_private->pVideoDecodInstance.gspfVDec( VDEC_CLOSE, NULL, NULL, &dec_private->pVideoDecodInstance.gsVDecOutput, dec_private->pVideoDecodInstance.pVdec_Instance);
+		dec_private->pVideoDecodInstance.isVPUClosed = 1;
+	}
+
+	dec_private->isSequenceHeaderDone = 0;
+	dec_private->in_index = dec_private->out_index = dec_private->frm_clear = 0;
+	dec_private->pinned_index = dec_private->last_disp_index = -1;
+	dec_private->pinned_withheld = 0;
+	dec_private->outstanding_mask = 0;
+	dec_private->clear_retry_mask = 0;
+	dec_private->buf_epoch++;
+}
+
 static void VideoDecErrorProcess(int ret)
 {
+	// whatever the decoder does next, the references are gone until a key frame
+	dec_private->keyframe_reason |= VPU_KEYFRAME_DECODE_ERROR;
+	tcc_event_post_code(VDEC_EVENT_ERROR, ret);
+
     if(dec_private->cntDecError > MAX_CONSECUTIVE_VPU_FAIL_TO_RESTORE_COUNT)
     {
 		DebugPrint("Consecutive decode-cmd failure is occurred");
     }
 
 #ifdef RESTORE_DECODE_ERR
-	if((ret == -RETCODE_CODEC_EXIT || ret == -RETCODE_MULTI_CODEC_EXIT_TIMEOUT) && dec_private->cntDecError <= MAX_CONSECUTIVE_VPU_FAIL_TO_RESTORE_COUNT && dec_private->seqHeader_backup != NULL)
+	if((ret == -RETCODE_CODEC_EXIT || ret == -RETCODE_MULTI_CODEC_EXIT_TIMEOUT) && dec_private->cntDecError <= MAX_CONSECUTIVE_VPU_FAIL_TO_RESTORE_COUNT && dec_private->seqHeader_len != 0)
 	{
-		dec_private->seq_header_init_error_count = SEQ_HEADER_INIT_ERROR_COUNT;
-		dec_private->ConsecutiveBufferFullCnt = 0;
 		dec_private->cntDecError++;
-		if(dec_private->pVideoDecodInstance.isVPUClosed != 1)
-		{
-			dec_private->pVideoDecodInstance.gspfVDec( VDEC_CLOSE, NULL, NULL, &dec_private->pVideoDecodInstance.gsVDecOutput, dec_private->pVideoDecodInstance.pVdec_Instance);
-			dec_private->pVideoDecodInstance.isVPUClosed = 1;
-		}
-
-		dec_private->isSequenceHeaderDone = 0;
+		VpuCloseForReinit();
 		dec_private->cntDecError = 1;
-		dec_private->in_index = dec_private->out_index = dec_private->frm_clear = 0;
 		DebugPrint("try to restore decode error");
+		tcc_event_post_code(VDEC_EVENT_RESTORE, ret);
 	}
 #endif
 }
@@ -553,8 +704,6 @@ static int extract_h264_seqheader(
 						if ( *plSeqHeaderSize + l_seq_length > MAX_SEQ_HEADER_ALLOC_SIZE ) // check the maximum threshold
 							return 0;
 
-						free(*ppbySeqHeaderData);
-						*ppbySeqHeaderData = calloc(1 , *plSeqHeaderSize + l_seq_length );     // allocation memory for sequence header array (must free this at the CLOSE step)
 						memcpy( (unsigned char*) (*ppbySeqHeaderData) + *plSeqHeaderSize , &pbyStreamData[l_seq_start_pos], l_seq_length);   // save the seq. header to array
 						*plSeqHeaderSize = *plSeqHeaderSize + l_seq_length;
 					}
@@ -567,9 +716,8 @@ static int extract_h264_seqheader(
 					// calculate the length of the sequence header
 					l_seq_length = l_seq_end_pos - l_seq_start_pos + 1;       
 
-					if ( l_seq_length > 0 )
+					if ( l_seq_length > 0 && l_seq_length <= MAX_SEQ_HEADER_ALLOC_SIZE )	// the slot is MAX_SEQ_HEADER_ALLOC_SIZE bytes
 					{
-						*ppbySeqHeaderData = calloc(1, l_seq_length );     // allocation memory for sequence header array (must free this at the CLOSE step)
 						memcpy( (unsigned char*) (*ppbySeqHeaderData), &pbyStreamData[l_seq_start_pos], l_seq_length);   // save the seq. header to array
 						*plSeqHeaderSize = l_seq_length;
 
@@ -596,16 +744,13 @@ static int extract_h264_seqheader(
 				if ( *plSeqHeaderSize + l_seq_length > MAX_SEQ_HEADER_ALLOC_SIZE )     // check the maximum threshold
 					return 0;
 
-				free(*ppbySeqHeaderData);
-				*ppbySeqHeaderData = calloc(1 , *plSeqHeaderSize + l_seq_length );     // allocate memory for sequence header array (must free this at the CLOSE step)
 				memcpy( (unsigned char*) (*ppbySeqHeaderData) + *plSeqHeaderSize , &pbyStreamData[l_seq_start_pos], l_seq_length);   // save the seq. header to array
 				*plSeqHeaderSize = *plSeqHeaderSize + l_seq_length;
 			}
 
 		}
-		else
+		else if ( l_seq_length <= MAX_SEQ_HEADER_ALLOC_SIZE )
 		{
-			*ppbySeqHeaderData = calloc(1, l_seq_length );           // allocate memory for sequence header array (must free this at the CLOSE step)
 			memcpy( (unsigned char*) (*ppbySeqHeaderData), &pbyStreamData[l_seq_start_pos], l_seq_length);   // save the seq. header to array
 			*plSeqHeaderSize = *plSeqHeaderSize + l_seq_length;
 		}
@@ -783,22 +928,39 @@ static int DECODER_INIT_NoReordering(tDEC_INIT_PARAMS *pInit)
 	
 	DebugPrint( "DECODER_INIT_NoReordering\n" );
 	
-	dec_private = (tDEC_PRIVATE*)calloc( 1, sizeof(tDEC_PRIVATE) );
-	if( dec_private == NULL ){
+	if( arena_open( ARENA_ALIGN(sizeof(tDEC_PRIVATE)) + ARENA_ALIGN(MAX_SEQ_HEADER_ALLOC_SIZE) + ARENA_ALIGN(VPU_SEQ_BACKUP_SIZE) + ARENA_ALIGN(MAX_SEQ_HEADER_ALLOC_SIZE) + ARENA_ALIGN(VPU_SANITIZE_BUF_SIZE) ) < 0 ){
 		DebugPrint( "calloc fail\n" );
-		return 1;
+		return -1;
 	}
+	dec_private = (tDEC_PRIVATE*)arena_carve( sizeof(tDEC_PRIVATE) );
 	
 	memset(dec_private, 0x00, sizeof(tDEC_PRIVATE));
+	dec_private->sanitize_buf = (unsigned char*)arena_carve( VPU_SANITIZE_BUF_SIZE );
+#ifdef RESTORE_DECODE_ERR
+	dec_private->seqHeader_backup = (unsigned char*)arena_carve( VPU_SEQ_BACKUP_SIZE );
+	dec_private->seqHeader_len = 0;
+	dec_private->avc_params = (unsigned char*)arena_carve( MAX_SEQ_HEADER_ALLOC_SIZE );
+	dec_private->avc_params_len = 0;
+#endif
 	memset(&dec_private->pVideoDecodInstance, 0x00, sizeof(_VIDEO_DECOD_INSTANCE_));
-	dec_private->nFps = 30;
+	dec_private->nFps = RATE_DEFAULT_FPS;
+	tcc_vpu_rate_reset();
 	dec_private->seq_header_init_error_count = SEQ_HEADER_INIT_ERROR_COUNT;	
 	dec_private->ConsecutiveBufferFullCnt = 0;
 	dec_private->cntDecError = 0;
 	dec_private->pVideoDecodInstance.pVdec_Instance = (void*)vdec_alloc_instance(dec_private->pVideoDecodInstance.gsVDecInit.m_iBitstreamFormat, 0);
+#ifdef VDEC_FAULT_INJECT
+	if(dec_private->pVideoDecodInstance.pVdec_Instance != NULL)
+		tcc_vpu_fault_instance(1);
+#endif
 	dec_private->pVideoDecodInstance.video_dec_idx = 0;
 	dec_private->max_fifo_cnt = VPU_BUFF_COUNT;	
 	dec_private->out_index = dec_private->in_index = dec_private->frm_clear = 0;
+	dec_private->pinned_index = dec_private->last_disp_index = -1;
+	dec_private->pinned_withheld = 0;
+	dec_private->keyframe_reason = 0;
+	dec_private->avc_log2_max_frame_num = 0;
+	dec_private->avc_prev_ref_frame_num = -1;
 	dec_private->pVideoDecodInstance.restred_count = 0;
 	
 #ifdef EXT_V_DECODER_TR_TEST
@@ -806,13 +968,14 @@ static int DECODER_INIT_NoReordering(tDEC_INIT_PARAMS *pInit)
 	dec_private->pVideoDecodInstance.gsextReference_Flag = 1;
 #endif
 #ifdef CHECK_SEQHEADER_WITH_SYNCFRAME
-	dec_private->sequence_header_only = NULL;
+	dec_private->sequence_header_only = (unsigned char*)arena_carve( MAX_SEQ_HEADER_ALLOC_SIZE );
 	dec_private->sequence_header_size = 0;
 	dec_private->need_sequence_header_attachment = 0;
 #endif
 	
 	dec_private->pVideoDecodInstance.isVPUClosed = 1;
 	dec_private->isFirst_Frame = 1;
+	tcc_vpu_watchdog_start();
 	
 	switch(pInit->codecFormat)
 	{
@@ -824,7 +987,10 @@ static int DECODER_INIT_NoReordering(tDEC_INIT_PARAMS *pInit)
 		case CODEC_FORMAT_DIV3:  dec_private->pVideoDecodInstance.video_coding_type = STD_DIV3;		break;
 		case CODEC_FORMAT_VC1:	 dec_private->pVideoDecodInstance.video_coding_type = STD_VC1;  	break;
 		case CODEC_FORMAT_MJPG:  dec_private->pVideoDecodInstance.video_coding_type = STD_MJPG;		break;
-		default: return -1;
+		default:
+			// the caller only closes a decoder that opened : nothing may stay behind
+			DECODER_CLOSE();
+			return -1;
 	}
 	
 	// Memo : 2014.10.29 N.Tanaka 抜けを追加>>>>>>>>>>>>>>>>>>>>
@@ -837,11 +1003,21 @@ static int DECODER_INIT_NoReordering(tDEC_INIT_PARAMS *pInit)
 	dec_private->pVideoDecodInstance.container_type 					= pInit->container_type;
 	// <<<<<<<<<<<<<<<<<<<<
 	
+	// 定常状態のデコード処理はコーデック/コンテナの組み合わせでここで一度だけ選ぶ
+	if( dec_private->pVideoDecodInstance.video_coding_type == STD_AVC
+		&& (pInit->container_type == CONTAINER_NONE || pInit->container_type == CONTAINER_MP4) )
+		dec_private->pfDecodeSteady = DECODER_DEC_AvcSteady;
+	else
+		dec_private->pfDecodeSteady = NULL;
+	
 	// 基本的にHWDecodeのみになるはずなので、SWかの判断をせずにHWの時の処理を移植
 	dec_private->pVideoDecodInstance.gsVDecInit.m_bCbCrInterleaveMode	= 1;
 	
 	// Memo : 2014.10.29 N.Tanaka 抜けを追加>>>>>>>>>>>>>>>>>>>>
 	dec_private->pVideoDecodInstance.gspfVDec = vdec_vpu;
+#ifdef VDEC_FAULT_INJECT
+	dec_private->pVideoDecodInstance.gspfVDec = tcc_vpu_fault_wrap(vdec_vpu);
+#endif
 	// <<<<<<<<<<<<<<<<<<<<
 	
 	{
@@ -862,8 +1038,9 @@ static int DECODER_INIT_NoReordering(tDEC_INIT_PARAMS *pInit)
 		disp_pic_info ( CVDEC_DISP_INFO_INIT, (void*)&dec_private->pVideoDecodInstance.dec_disp_info_ctrl, (void*)dec_private->pVideoDecodInstance.dec_disp_info,(void*)&dec_private->pVideoDecodInstance.dec_disp_info_input, dec_private->nFps);
 	}
 	
-	dec_private->pVideoDecodInstance.gsVDecUserInfo.bitrate_mbps = 10;
-	dec_private->pVideoDecodInstance.gsVDecUserInfo.frame_rate = 30;
+	// first guess : tcc_vpu_rate corrects both for the next VDEC_INIT once the stream shows its real rates
+	dec_private->pVideoDecodInstance.gsVDecUserInfo.bitrate_mbps = RATE_DEFAULT_MBPS;
+	dec_private->pVideoDecodInstance.gsVDecUserInfo.frame_rate = RATE_DEFAULT_FPS;
 	dec_private->pVideoDecodInstance.gsVDecUserInfo.m_bJpegOnly = 0;
 	
 	// Linuxになって、この設定がなくなっている。実際にはre-ordering無効設定が必要なので後で確認
@@ -888,6 +1065,7 @@ static int DECODER_INIT_NoReordering(tDEC_INIT_PARAMS *pInit)
 
 		if(ret != -VPU_ENV_INIT_ERROR) //to close vpu!!
 			dec_private->pVideoDecodInstance.isVPUClosed = 0;			
+		DECODER_CLOSE();
 		return ret;
 	}
 	dec_private->pVideoDecodInstance.isVPUClosed = 0;
@@ -899,7 +1077,7 @@ static int DECODER_INIT_NoReordering(tDEC_INIT_PARAMS *pInit)
 
 static void DECODER_CLOSE(void)
 {
-	int ret;
+	int ret, i;
 	
 	if(dec_private->pVideoDecodInstance.isVPUClosed == 0)
 	{
@@ -911,56 +1089,421 @@ static void DECODER_CLOSE(void)
 		dec_private->pVideoDecodInstance.isVPUClosed = 1;
 	}
 
-#ifdef RESTORE_DECODE_ERR
-	if(dec_private->seqHeader_backup != NULL)
-		free(dec_private->seqHeader_backup);
+#ifdef VDEC_FAULT_INJECT
+	if(dec_private->pVideoDecodInstance.pVdec_Instance != NULL)
+		tcc_vpu_fault_instance(-1);
 #endif
+    vdec_release_instance(dec_private->pVideoDecodInstance.pVdec_Instance);
+	for( i = 0; i < VPU_SLOT_COUNT; i++ )
+	{
+		if( i != g_Slot && g_SlotPrivate[i] != NULL )
+			break;
+	}
+	if( i == VPU_SLOT_COUNT )
+		tcc_vpu_watchdog_stop();	// the last decoder
 
-#ifdef CHECK_SEQHEADER_WITH_SYNCFRAME
-	if(dec_private->sequence_header_only != NULL)
-		free(dec_private->sequence_header_only);
+	// dec_private, seqHeader_backup and sequence_header_only all go with the arena
+	dec_private = NULL;
+	arena_close();
+}
+
+/* output frame size, stride, format and crop, valid whether or not a frame is output */
+static void FrameOutputGeometry(tDEC_FRAME_OUTPUT *pOutput)
+{
+	vdec_output_t *pVOut = &dec_private->pVideoDecodInstance.gsVDecOutput;
+
+	//ZzaU ? :: width and stride	
+	pOutput->picWidth = pVOut->m_DecOutInfo.m_iWidth;
+	pOutput->picHeight = pVOut->m_DecOutInfo.m_iHeight;
+	pOutput->stride = ((pVOut->m_DecOutInfo.m_iWidth+15)>>4)<<4;
+	pOutput->frameFormat = FRAME_BUF_FORMAT_YUV420P;
+	//add by yusufu for crop info
+	pOutput->crop_left = pVOut->m_pInitialInfo->m_iAvcPicCrop.m_iCropLeft;
+	pOutput->crop_top = pVOut->m_pInitialInfo->m_iAvcPicCrop.m_iCropTop;
+	pOutput->crop_right = pVOut->m_pInitialInfo->m_iAvcPicCrop.m_iCropRight;
+	pOutput->crop_bottom = pVOut->m_pInitialInfo->m_iAvcPicCrop.m_iCropBottom;
+
+	if(dec_private->pVideoDecodInstance.gsVDecInit.m_bCbCrInterleaveMode == 1)
+		pOutput->frameFormat = FRAME_BUF_FORMAT_YUV420I;
+}
+
+static void FrameOutputAddress(tDEC_FRAME_OUTPUT *pOutput)
+{
+	int i;
+	unsigned char *buffer;
+
+	/* physical address */
+	buffer = (unsigned char*)pOutput->bufPhyAddr;
+	for(i=0;i<3;i++)
+		memcpy(buffer+i*4, &dec_private->pVideoDecodInstance.gsVDecOutput.m_pDispOut[PA][i], 4);
+	
+	/* logical address */
+	buffer = (unsigned char*)pOutput->bufVirtAddr;
+	for(i=0;i<3;i++)
+		memcpy(buffer+i*4, &dec_private->pVideoDecodInstance.gsVDecOutput.m_pDispOut[VA][i], 4);
+}
+
+/* hand the output display index over : outstanding for the display, or through the FIFO */
+static void DispOutRelease(void)
+{
+	dec_private->last_disp_index = dec_private->pVideoDecodInstance.gsVDecOutput.m_DecOutInfo.m_iDispOutIdx;
+
+/*ZzaU :: Clear decoded frame-buffer according with sequence-order after it was used!!*/
+	if(dec_private->release_by_display)
+	{
+		// cleared by tcc_vpudec_release_frame() once the display is done with it
+		unsigned int idx = dec_private->pVideoDecodInstance.gsVDecOutput.m_DecOutInfo.m_iDispOutIdx;
+		if(idx < 32)
+			dec_private->outstanding_mask |= (1u << idx);
+		DebugPrint("DispIdx Out %d", idx);
+	}
+	else if(dec_private->max_fifo_cnt != 0)
+	{				
+		dec_private->Display_index[dec_private->in_index] = dec_private->pVideoDecodInstance.gsVDecOutput.m_DecOutInfo.m_iDispOutIdx;
+		DebugPrint("DispIdx Queue %d", dec_private->Display_index[dec_private->in_index]);
+		dec_private->in_index = (dec_private->in_index + 1) % dec_private->max_fifo_cnt;
+		
+		if(dec_private->in_index == 0 && !dec_private->frm_clear)
+			dec_private->frm_clear = 1;
+
+		if(dec_private->frm_clear)
+		{
+			DebugPrint("Normal DispIdx Clear %d", dec_private->Display_index[dec_private->out_index]);
+			DispBufClear( dec_private->Display_index[dec_private->out_index] );
+			
+			dec_private->out_index = (dec_private->out_index + 1) % dec_private->max_fifo_cnt;
+		}
+	}
+	else
+	{		
+		DebugPrint("@ DispIdx Queue %d", dec_private->Display_index[dec_private->in_index]);
+		DispBufClear( dec_private->pVideoDecodInstance.gsVDecOutput.m_DecOutInfo.m_iDispOutIdx );
+	}
+}
+
+/* Exp-Golomb reader over a NAL payload, emulation prevention bytes skipped */
+typedef struct _AvcBitReader {
+	const unsigned char *p;
+	const unsigned char *end;
+	int zeros;
+	int bit;
+} AvcBitReader;
+
+static int AvcBit(AvcBitReader *br)
+{
+	int v;
+
+	if( br->p >= br->end )
+		return 0;
+	if( br->bit == 0 && br->zeros >= 2 && *br->p == 0x03 )
+	{
+		br->p++;
+		br->zeros = 0;
+		if( br->p >= br->end )
+			return 0;
+	}
+	v = (*br->p >> (7 - br->bit)) & 1;
+	if( ++br->bit == 8 )
+	{
+		br->zeros = (*br->p == 0) ? br->zeros + 1 : 0;
+		br->bit = 0;
+		br->p++;
+	}
+	return v;
+}
+
+static unsigned int AvcBits(AvcBitReader *br, int n)
+{
+	unsigned int v = 0;
+
+	while( n-- > 0 )
+		v = (v << 1) | AvcBit(br);
+	return v;
+}
+
+static unsigned int AvcUe(AvcBitReader *br)
+{
+	int lz = 0;
+
+	while( lz < 31 && AvcBit(br) == 0 )
+		lz++;
+	return ((1u << lz) - 1) + AvcBits(br, lz);
+}
+
+/* SPS fields up to gaps_in_frame_num_value_allowed_flag and the VUI timing, p : payload after the NAL header */
+static void AvcParseSps(const unsigned char *p, const unsigned char *end)
+{
+	AvcBitReader br = { p, end, 0, 0 };
+	unsigned int profile, chroma = 1, i, j, n, last, next;
+
+	profile = AvcBits(&br, 8);
+	AvcBits(&br, 16);							// constraint flags, level_idc
+	AvcUe(&br);									// seq_parameter_set_id
+	if( profile == 100 || profile == 110 || profile == 122 || profile == 244 || profile == 44
+		|| profile == 83 || profile == 86 || profile == 118 || profile == 128 || profile == 138
+		|| profile == 139 || profile == 134 || profile == 135 )
+	{
+		chroma = AvcUe(&br);
+		if( chroma == 3 )
+			AvcBit(&br);						// separate_colour_plane_flag
+		AvcUe(&br);								// bit_depth_luma_minus8
+		AvcUe(&br);								// bit_depth_chroma_minus8
+		AvcBit(&br);							// qpprime_y_zero_transform_bypass_flag
+		if( AvcBit(&br) )						// seq_scaling_matrix_present_flag
+		{
+			for( i = 0; i < ((chroma != 3) ? 8u : 12u); i++ )
+			{
+				if( !AvcBit(&br) )
+					continue;
+				n = (i < 6) ? 16 : 64;
+				for( j = 0, last = 8, next = 8; j < n && next != 0; j++ )
+				{
+					unsigned int ue = AvcUe(&br);
+					int delta = (ue & 1) ? (int)((ue + 1) / 2) : -(int)(ue / 2);
+
+					next = (last + delta + 256) % 256;
+					if( next != 0 )
+						last = next;
+				}
+			}
+		}
+	}
+	dec_private->avc_log2_max_frame_num = (unsigned char)(AvcUe(&br) + 4);
+	if( dec_private->avc_log2_max_frame_num > 16 )
+		dec_private->avc_log2_max_frame_num = 0;	// broken SPS : don't judge gaps with it
+	n = AvcUe(&br);								// pic_order_cnt_type
+	if( n == 0 )
+	{
+		AvcUe(&br);								// log2_max_pic_order_cnt_lsb_minus4
+	}
+	else if( n == 1 )
+	{
+		AvcBit(&br);							// delta_pic_order_always_zero_flag
+		AvcUe(&br);								// offset_for_non_ref_pic
+		AvcUe(&br);								// offset_for_top_to_bottom_field
+		for( i = AvcUe(&br); i > 0 && br.p < br.end; i-- )
+			AvcUe(&br);							// offset_for_ref_frame
+	}
+	AvcUe(&br);									// max_num_ref_frames
+	dec_private->avc_gaps_allowed = AvcBit(&br);
+	dec_private->avc_prev_ref_frame_num = -1;
+
+	AvcUe(&br);									// pic_width_in_mbs_minus1
+	AvcUe(&br);									// pic_height_in_map_units_minus1
+	if( !AvcBit(&br) )							// frame_mbs_only_flag
+		AvcBit(&br);							// mb_adaptive_frame_field_flag
+	AvcBit(&br);								// direct_8x8_inference_flag
+	if( AvcBit(&br) )							// frame_cropping_flag
+	{
+		for( i = 0; i < 4; i++ )
+			AvcUe(&br);
+	}
+	if( !AvcBit(&br) || br.p >= end )			// vui_parameters_present_flag
+	{
+		tcc_vpu_rate_vui(0, 0);
+		return;
+	}
+	if( AvcBit(&br) && AvcBits(&br, 8) == 255 )	// aspect_ratio_info_present_flag, aspect_ratio_idc : Extended_SAR
+		AvcBits(&br, 32);						// sar_width, sar_height
+	if( AvcBit(&br) )							// overscan_info_present_flag
+		AvcBit(&br);
+	if( AvcBit(&br) )							// video_signal_type_present_flag
+	{
+		AvcBits(&br, 4);						// video_format, video_full_range_flag
+		if( AvcBit(&br) )						// colour_description_present_flag
+			AvcBits(&br, 24);
+	}
+	if( AvcBit(&br) )							// chroma_loc_info_present_flag
+	{
+		AvcUe(&br);
+		AvcUe(&br);
+	}
+	if( AvcBit(&br) )							// timing_info_present_flag
+	{
+		n = AvcBits(&br, 32);					// num_units_in_tick
+		tcc_vpu_rate_vui(n, AvcBits(&br, 32));	// time_scale
+	}
+	else
+	{
+		tcc_vpu_rate_vui(0, 0);
+	}
+}
+
+/* frame_num of the first slice against the last reference picture (7.4.3) : a skipped value is a lost reference.
+ * 1 if the access unit carries a picture, 0 for parameter sets only */
+static int AvcCheckFrameGap(const unsigned char *p, int len)
+{
+	const unsigned char *end = p + len;
+	int i, type, ref_idc;
+	unsigned int max, frame_num;
+	AvcBitReader br;
+
+	for( i = 0; i + 3 < len; i++ )
+	{
+		if( p[i] != 0x00 || p[i+1] != 0x00 || p[i+2] != 0x01 )
+			continue;
+		i += 3;
+		type = p[i] & 0x1F;
+		ref_idc = (p[i] >> 5) & 3;
+		if( type == 7 )
+		{
+			AvcParseSps( p + i + 1, end );
+		}
+		else if( type >= 1 && type <= 5 )
+		{
+			if( dec_private->avc_log2_max_frame_num == 0 )
+				return 1;
+			br.p = p + i + 1;
+			br.end = end;
+			br.zeros = 0;
+			br.bit = 0;
+			AvcUe(&br);							// first_mb_in_slice
+			AvcUe(&br);							// slice_type
+			AvcUe(&br);							// pic_parameter_set_id
+			frame_num = AvcBits(&br, dec_private->avc_log2_max_frame_num);
+			max = 1u << dec_private->avc_log2_max_frame_num;
+
+			if( type == 5 )
+			{
+				dec_private->avc_prev_ref_frame_num = 0;
+				return 1;
+			}
+			// in trick play every I picture jumps ahead on purpose
+			if( dec_private->avc_prev_ref_frame_num >= 0 && !dec_private->avc_gaps_allowed && dec_private->trick_speed <= 1
+				&& frame_num != (unsigned int)dec_private->avc_prev_ref_frame_num
+				&& frame_num != ((unsigned int)dec_private->avc_prev_ref_frame_num + 1) % max )
+			{
+				DebugPrint("[LOSS] frame_num %u after %d", frame_num, dec_private->avc_prev_ref_frame_num);
+				dec_private->keyframe_reason |= VPU_KEYFRAME_FRAME_GAP;
+			}
+			if( ref_idc != 0 )
+				dec_private->avc_prev_ref_frame_num = (int)frame_num;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* 1 if the first coded slice of the access unit is an IDR slice */
+static int AvcIsIdr(const unsigned char *p, int len)
+{
+	int i, type;
+
+	for( i = 0; i + 3 < len; i++ )
+	{
+		if( p[i] != 0x00 || p[i+1] != 0x00 || p[i+2] != 0x01 )
+			continue;
+		type = p[i+3] & 0x1F;
+		if( type >= 1 && type <= 5 )
+			return (type == 5);
+		i += 3;
+	}
+	return 0;
+}
+
+#ifdef RESTORE_DECODE_ERR
+/* keep the latest SPS/PPS and IDR access unit in seqHeader_backup : a restore or an idle resume
+ * starts from the newest key frame instead of the first one */
+static void AvcCacheKeyframe(const unsigned char *p, int len)
+{
+	int i, j, end, type, plen = 0, has_params = 0, idr = 0;
+
+	for( i = 0; i + 3 < len; i = end )
+	{
+		if( p[i] != 0x00 || p[i+1] != 0x00 || p[i+2] != 0x01 )
+		{
+			end = i + 1;
+			continue;
+		}
+		type = p[i+3] & 0x1F;
+		if( type >= 1 && type <= 5 )
+		{
+			idr = (type == 5);
+			break;
+		}
+
+		for( end = i + 3; end + 2 < len && (p[end] != 0x00 || p[end+1] != 0x00 || p[end+2] != 0x01); end++ )
+			;
+		if( end + 2 >= len )
+			end = len;
+		if( type != 7 && type != 8 )
+			continue;
+
+		// a new set replaces the cached one, each NAL behind a 4 byte start code
+		for( j = end; j > i + 3 && p[j-1] == 0x00; j-- )
+			;
+		has_params = 1;
+		if( plen + 4 + (j - i - 3) <= MAX_SEQ_HEADER_ALLOC_SIZE )
+		{
+			dec_private->avc_params[plen++] = 0x00;
+			memcpy( dec_private->avc_params + plen, p + i, j - i );
+			plen += j - i;
+		}
+	}
+	if( has_params )
+		dec_private->avc_params_len = plen;
+
+	if( !idr )
+		return;
+	if( has_params && len <= VPU_SEQ_BACKUP_SIZE )
+	{
+		memcpy( dec_private->seqHeader_backup, p, len );
+		dec_private->seqHeader_len = len;
+	}
+	else if( !has_params && dec_private->avc_params_len != 0 && dec_private->avc_params_len + len <= VPU_SEQ_BACKUP_SIZE )
+	{
+		memcpy( dec_private->seqHeader_backup, dec_private->avc_params, dec_private->avc_params_len );
+		memcpy( dec_private->seqHeader_backup + dec_private->avc_params_len, p, len );
+		dec_private->seqHeader_len = dec_private->avc_params_len + len;
+	}
+}
 #endif
 
-    vdec_release_instance(dec_private->pVideoDecodInstance.pVdec_Instance);
+/* statistics and loss signs of the VDEC_DECODE call that just returned */
+static void DecodeTelemetry(tDEC_FRAME_INPUT *pInput)
+{
+	vdec_output_t *pVOut = &dec_private->pVideoDecodInstance.gsVDecOutput;
+	int frame_type = -1;
+	int is_idr = 0;
+	int mbs = 0;
+
+	if(pVOut->m_DecOutInfo.m_iOutputStatus == VPU_DEC_OUTPUT_SUCCESS)
+		tcc_telemetry_output();
+
+	// the same input comes again
+	if(pVOut->m_DecOutInfo.m_iDecodingStatus == VPU_DEC_BUF_FULL)
+		return;
 
-	if(dec_private) {
-		free(dec_private);
-		dec_private = NULL;
+	if((pVOut->m_DecOutInfo.m_iDecodingStatus == VPU_DEC_SUCCESS || pVOut->m_DecOutInfo.m_iDecodingStatus == VPU_DEC_SUCCESS_FIELD_PICTURE)
+		&& pVOut->m_DecOutInfo.m_iDecodedIdx >= 0)
+	{
+		frame_type = get_frame_type_for_frame_skipping( dec_private->pVideoDecodInstance.gsVDecInit.m_iBitstreamFormat,
+														pVOut->m_DecOutInfo.m_iPicType, pVOut->m_DecOutInfo.m_iPictureStructure );
+		if(frame_type == 1 && dec_private->pVideoDecodInstance.video_coding_type == STD_AVC)
+			is_idr = AvcIsIdr( pInput->inputStreamAddr, pInput->inputStreamSize );
+		mbs = ((pVOut->m_DecOutInfo.m_iWidth + 15) >> 4) * ((pVOut->m_DecOutInfo.m_iHeight + 15) >> 4);
+
+		// a burst of concealed macroblocks : the references are damaged until the next key frame
+		if(mbs > 0 && pVOut->m_DecOutInfo.m_iNumOfErrMBs * 1000 > mbs * VPU_KEYFRAME_ERR_MB_PERMILLE)
+			dec_private->keyframe_reason |= VPU_KEYFRAME_ERROR_MB;
 	}
+	tcc_telemetry_decoded( pInput->inputStreamSize, frame_type, is_idr, pVOut->m_DecOutInfo.m_iNumOfErrMBs, mbs );
 }
 
-static int DECODER_DEC( tDEC_FRAME_INPUT *pInput, tDEC_FRAME_OUTPUT *pOutput, tDEC_RESULT *pResult )
+static int DECODER_DEC_Generic( tDEC_FRAME_INPUT *pInput, tDEC_FRAME_OUTPUT *pOutput, tDEC_RESULT *pResult )
 {
 	int ret = 0;
 	int nLen = 0;
 	int decode_result;	
-	unsigned int input_offset = 0;	
 	unsigned char retry_input = 0;
 	dec_disp_info_t dec_disp_info_tmp;
 	
 	memset(pOutput, 0x00, sizeof(tDEC_FRAME_OUTPUT));
 	memset(pResult, 0x00, sizeof(tDEC_RESULT));
 	
-	if(dec_private->pVideoDecodInstance.video_coding_type == STD_AVC)
-	{
-		unsigned char *p;
-		p = pInput->inputStreamAddr;
-		
-		if(p[0] == 0x00 && p[1] == 0x00 && p[2] == 0x00 && p[3] == 0x01 && p[4] == 0x00 && p[5] == 0x00 && p[6] == 0x00 && p[7] == 0x01)
-		{
-			input_offset = 4;
-			DebugPrint("Double NAL-Start Code!!");
-		}
-		else if(p[0] == 0x00 && p[1] == 0x00 && p[2] == 0x00 && p[3] == 0x01 && p[4] == 0x00 && p[5] == 0x00 && p[6] == 0x01)
-		{
-			input_offset = 3;
-			DebugPrint("remove 00 00 01 behind NAL-Start Code!!");
-			p[3] = 0x00;
-		}
-	}
-	
-	dec_private->pVideoDecodInstance.gsVDecInput.m_pInp[PA] =  dec_private->pVideoDecodInstance.gsVDecInput.m_pInp[VA] = pInput->inputStreamAddr + input_offset;
-	dec_private->pVideoDecodInstance.gsVDecInput.m_iInpLen  = pInput->inputStreamSize - input_offset;
+	// double or empty H.264 start codes are already removed by tcc_bs_sanitize() in DECODER_DEC
+	dec_private->pVideoDecodInstance.gsVDecInput.m_pInp[PA] =  dec_private->pVideoDecodInstance.gsVDecInput.m_pInp[VA] = pInput->inputStreamAddr;
+	dec_private->pVideoDecodInstance.gsVDecInput.m_iInpLen  = pInput->inputStreamSize;
 	
 	if(!dec_private->isSequenceHeaderDone)
 	{	
@@ -991,7 +1534,7 @@ static int DECODER_DEC( tDEC_FRAME_INPUT *pInput, tDEC_FRAME_OUTPUT *pOutput, tD
 		}
 
 #ifdef RESTORE_DECODE_ERR
-		if(dec_private->cntDecError != 0 && dec_private->seqHeader_backup != NULL)
+		if(dec_private->cntDecError != 0 && dec_private->seqHeader_len != 0)
 		{
 			dec_private->pVideoDecodInstance.gsVDecInput.m_pInp[PA] = dec_private->pVideoDecodInstance.gsVDecInput.m_pInp[VA] = dec_private->seqHeader_backup;
 			dec_private->pVideoDecodInstance.gsVDecInput.m_iInpLen	= dec_private->seqHeader_len;
@@ -1041,10 +1584,19 @@ static int DECODER_DEC( tDEC_FRAME_INPUT *pInput, tDEC_FRAME_OUTPUT *pOutput, tD
 		}
 		
 
-		dec_private->max_fifo_cnt = VPU_BUFF_COUNT;
-		vpu_set_additional_refframe_count(dec_private->max_fifo_cnt - 1, dec_private->pVideoDecodInstance.pVdec_Instance);
+		if(dec_private->release_by_display)
+		{
+			// the display keeps what it needs, the pinned frame is one of them
+			dec_private->max_fifo_cnt = 0;
+			vpu_set_additional_refframe_count(VPU_DISP_HOLD_BUFF_COUNT, dec_private->pVideoDecodInstance.pVdec_Instance);
+		}
+		else
+		{
+			dec_private->max_fifo_cnt = VPU_BUFF_COUNT;
+			vpu_set_additional_refframe_count(dec_private->max_fifo_cnt - 1 + VPU_PIN_BUFF_COUNT, dec_private->pVideoDecodInstance.pVdec_Instance);
+		}
 
-		if( (ret = dec_private->pVideoDecodInstance.gspfVDec( VDEC_DEC_SEQ_HEADER, NULL, &dec_private->pVideoDecodInstance.gsVDecInput, &dec_private->pVideoDecodInstance.gsVDecOutput, dec_private->pVideoDecodInstance.pVdec_Instance )) < 0 )
+		if( (ret = VpuCommandWatched( VDEC_DEC_SEQ_HEADER, &dec_private->pVideoDecodInstance.gsVDecInput, &dec_private->pVideoDecodInstance.gsVDecOutput )) < 0 )
 		{
 			if(dec_private->seq_header_init_error_count != 0)
 				dec_private->seq_header_init_error_count--;
@@ -1052,6 +1604,7 @@ static int DECODER_DEC( tDEC_FRAME_INPUT *pInput, tDEC_FRAME_OUTPUT *pOutput, tD
 			if ( (dec_private->seq_header_init_error_count == 0) || (ret == -RETCODE_INVALID_STRIDE) || (ret == -VPU_NOT_ENOUGH_MEM) )
 			{
 				DebugPrint( "[VDEC_DEC_SEQ_HEADER] [Err:%d]", ret );
+				tcc_event_post_code(VDEC_EVENT_ERROR, ret);
 				return -1;
 			}
 			else
@@ -1070,6 +1623,7 @@ static int DECODER_DEC( tDEC_FRAME_INPUT *pInput, tDEC_FRAME_OUTPUT *pOutput, tD
 				}
 				DebugPrint("skip seq header frame, data len %d", dec_private->pVideoDecodInstance.gsVDecInput.m_iInpLen);
 				DebugPrint( "[VDEC_DEC_SEQ_HEADER - %d] retry %d using next frame!", ret, SEQ_HEADER_INIT_ERROR_COUNT - dec_private->seq_header_init_error_count);
+				tcc_event_post_code(VDEC_EVENT_SEQ_RETRY, ret);
 				pResult->no_frame_output = 1;
 				return 1;
 			}
@@ -1077,9 +1631,12 @@ static int DECODER_DEC( tDEC_FRAME_INPUT *pInput, tDEC_FRAME_OUTPUT *pOutput, tD
 #ifdef RESTORE_DECODE_ERR
 		else
 		{
-			if(dec_private->seqHeader_backup == NULL)
+			if(dec_private->seqHeader_len == 0 && dec_private->pVideoDecodInstance.gsVDecInput.m_iInpLen > VPU_SEQ_BACKUP_SIZE)
+			{
+				ErrorPrint("seq_header frame(%d) too large to back up, decode errors won't be restored", dec_private->pVideoDecodInstance.gsVDecInput.m_iInpLen);
+			}
+			else if(dec_private->seqHeader_len == 0)
 			{
-				dec_private->seqHeader_backup = calloc(1,dec_private->pVideoDecodInstance.gsVDecInput.m_iInpLen);
 				memcpy(dec_private->seqHeader_backup, dec_private->pVideoDecodInstance.gsVDecInput.m_pInp[VA], dec_private->pVideoDecodInstance.gsVDecInput.m_iInpLen);
 				dec_private->seqHeader_len = dec_private->pVideoDecodInstance.gsVDecInput.m_iInpLen;
 				dec_private->cntDecError = 0;
@@ -1124,12 +1681,7 @@ static int DECODER_DEC( tDEC_FRAME_INPUT *pInput, tDEC_FRAME_OUTPUT *pOutput, tD
 			while(dec_private->in_index != dec_private->out_index)
 			{
 				DebugPrint("DispIdx Clear %d", dec_private->Display_index[dec_private->out_index]);
-				if( ( ret = dec_private->pVideoDecodInstance.gspfVDec( VDEC_BUF_FLAG_CLEAR, NULL, &dec_private->Display_index[dec_private->out_index], NULL, dec_private->pVideoDecodInstance.pVdec_Instance ) ) < 0 )
-				{
-					DebugPrint( "[VDEC_BUF_FLAG_CLEAR] Idx = %d, ret = %d", dec_private->Display_index[dec_private->out_index], ret );
-					VideoDecErrorProcess(ret);
-					return -1;
-				}
+				DispBufClear( dec_private->Display_index[dec_private->out_index] );
 				dec_private->out_index = (dec_private->out_index + 1) % dec_private->max_fifo_cnt;
 			}
 			dec_private->in_index = dec_private->out_index = dec_private->frm_clear = 0;
@@ -1164,6 +1716,10 @@ static int DECODER_DEC( tDEC_FRAME_INPUT *pInput, tDEC_FRAME_OUTPUT *pOutput, tD
 			break;
 	}
 	
+	// trick play : the caller only sends I pictures, anything else that slips through is not decoded
+	if(dec_private->trick_speed > 1)
+		dec_private->pVideoDecodInstance.gsVDecInput.m_iSkipFrameMode = VDEC_SKIP_FRAME_EXCEPT_I;
+	
 	if(dec_private->frameSearchOrSkip_flag == 1 )
 	{
 		dec_private->pVideoDecodInstance.gsVDecInput.m_iSkipFrameNum = 1;
@@ -1195,12 +1751,14 @@ static int DECODER_DEC( tDEC_FRAME_INPUT *pInput, tDEC_FRAME_OUTPUT *pOutput, tD
 		return -1;
 	}
 
-	if( (ret = dec_private->pVideoDecodInstance.gspfVDec( VDEC_DECODE, NULL, &dec_private->pVideoDecodInstance.gsVDecInput, &dec_private->pVideoDecodInstance.gsVDecOutput, dec_private->pVideoDecodInstance.pVdec_Instance )) < 0 )
+	DispBufClearRetry();
+	if( (ret = VpuCommandWatched( VDEC_DECODE, &dec_private->pVideoDecodInstance.gsVDecInput, &dec_private->pVideoDecodInstance.gsVDecOutput )) < 0 )
 	{
 		DebugPrint( "[VDEC_DECODE] [Err:%d] video decode", ret );
 		VideoDecErrorProcess(ret);
 		return -1;
 	}
+	DecodeTelemetry(pInput);
 	
 	if(dec_private->pVideoDecodInstance.gsVDecOutput.m_DecOutInfo.m_iDecodingStatus == VPU_DEC_BUF_FULL) 
 	{
@@ -1219,7 +1777,10 @@ static int DECODER_DEC( tDEC_FRAME_INPUT *pInput, tDEC_FRAME_OUTPUT *pOutput, tD
 	} 
 	else 
 	{
-		dec_private->ConsecutiveBufferFullCnt = 0;
+		// a picture skipped by the I-frame search or B skip proves no free frame buffer : only a decoded one ends the run.
+		// Otherwise a lost buffer starves every I picture of the search and the skips between them keep the restore away.
+		if(dec_private->pVideoDecodInstance.gsVDecOutput.m_DecOutInfo.m_iDecodedIdx != -2)
+			dec_private->ConsecutiveBufferFullCnt = 0;
 
 		if(dec_private->pVideoDecodInstance.gsVDecOutput.m_DecOutInfo.m_iOutputStatus == VPU_DEC_OUTPUT_SUCCESS)
 			decode_result = 2; // display Index : proceed.
@@ -1408,35 +1969,13 @@ static int DECODER_DEC( tDEC_FRAME_INPUT *pInput, tDEC_FRAME_OUTPUT *pOutput, tD
 		}
 	}
 	//////////////////////////////////////////////////////////////////////////////////////////
-	//ZzaU ? :: width and stride	
-	pOutput->picWidth = dec_private->pVideoDecodInstance.gsVDecOutput.m_DecOutInfo.m_iWidth;
-	pOutput->picHeight = dec_private->pVideoDecodInstance.gsVDecOutput.m_DecOutInfo.m_iHeight;
-	pOutput->stride = ((dec_private->pVideoDecodInstance.gsVDecOutput.m_DecOutInfo.m_iWidth+15)>>4)<<4;
-	pOutput->frameFormat = FRAME_BUF_FORMAT_YUV420P;
-	//add by yusufu for crop info
-	pOutput->crop_left = dec_private->pVideoDecodInstance.gsVDecOutput.m_pInitialInfo->m_iAvcPicCrop.m_iCropLeft;
-	pOutput->crop_top = dec_private->pVideoDecodInstance.gsVDecOutput.m_pInitialInfo->m_iAvcPicCrop.m_iCropTop;
-	pOutput->crop_right = dec_private->pVideoDecodInstance.gsVDecOutput.m_pInitialInfo->m_iAvcPicCrop.m_iCropRight;
-	pOutput->crop_bottom = dec_private->pVideoDecodInstance.gsVDecOutput.m_pInitialInfo->m_iAvcPicCrop.m_iCropBottom;
-
-	if(dec_private->pVideoDecodInstance.gsVDecInit.m_bCbCrInterleaveMode == 1)
-		pOutput->frameFormat = FRAME_BUF_FORMAT_YUV420I;
+	FrameOutputGeometry(pOutput);
 
 	if (dec_private->pVideoDecodInstance.gsVDecOutput.m_DecOutInfo.m_iOutputStatus == VPU_DEC_OUTPUT_SUCCESS)
 	{
-		int i;
-		unsigned char *buffer;
 		dec_private->ConsecutiveVdecFailCnt = 0; //Reset Consecutive Vdec Fail Counting B060955
 
-		/* physical address */
-		buffer = (unsigned char*)pOutput->bufPhyAddr;
-		for(i=0;i<3;i++)
-			memcpy(buffer+i*4, &dec_private->pVideoDecodInstance.gsVDecOutput.m_pDispOut[PA][i], 4);
-		
-		/* logical address */
-		buffer = (unsigned char*)pOutput->bufVirtAddr;
-		for(i=0;i<3;i++)
-			memcpy(buffer+i*4, &dec_private->pVideoDecodInstance.gsVDecOutput.m_pDispOut[VA][i], 4);
+		FrameOutputAddress(pOutput);
 
 		//Get TimeStamp!!
 		{
@@ -1482,39 +2021,7 @@ static int DECODER_DEC( tDEC_FRAME_INPUT *pInput, tDEC_FRAME_OUTPUT *pOutput, tD
 			}
 		}
 
-/*ZzaU :: Clear decoded frame-buffer according with sequence-order after it was used!!*/
-		if(dec_private->max_fifo_cnt != 0)
-		{				
-			dec_private->Display_index[dec_private->in_index] = dec_private->pVideoDecodInstance.gsVDecOutput.m_DecOutInfo.m_iDispOutIdx;
-			DebugPrint("DispIdx Queue %d", dec_private->Display_index[dec_private->in_index]);
-			dec_private->in_index = (dec_private->in_index + 1) % dec_private->max_fifo_cnt;
-			
-			if(dec_private->in_index == 0 && !dec_private->frm_clear)
-				dec_private->frm_clear = 1;
-
-			if(dec_private->frm_clear)
-			{
-				DebugPrint("Normal DispIdx Clear %d", dec_private->Display_index[dec_private->out_index]);
-				if( ( ret = dec_private->pVideoDecodInstance.gspfVDec( VDEC_BUF_FLAG_CLEAR, NULL, &dec_private->Display_index[dec_private->out_index], NULL, dec_private->pVideoDecodInstance.pVdec_Instance ) ) < 0 )
-				{
-					DebugPrint( "[VDEC_BUF_FLAG_CLEAR] Idx = %d, ret = %d", dec_private->Display_index[dec_private->out_index], ret );
-					VideoDecErrorProcess(ret);
-					return -1;
-				}
-				
-				dec_private->out_index = (dec_private->out_index + 1) % dec_private->max_fifo_cnt;
-			}
-		}
-		else
-		{		
-			DebugPrint("@ DispIdx Queue %d", dec_private->Display_index[dec_private->in_index]);
-			if( ( ret = dec_private->pVideoDecodInstance.gspfVDec( VDEC_BUF_FLAG_CLEAR, NULL, &dec_private->pVideoDecodInstance.gsVDecOutput.m_DecOutInfo.m_iDispOutIdx, NULL, dec_private->pVideoDecodInstance.pVdec_Instance ) ) < 0 )
-			{
-				DebugPrint( "[VDEC_BUF_FLAG_CLEAR] Idx = %d, ret = %d", dec_private->pVideoDecodInstance.gsVDecOutput.m_DecOutInfo.m_iDispOutIdx, ret );
-				VideoDecErrorProcess(ret);
-				return -1;
-			}
-		}
+		DispOutRelease();
 		dec_private->pVideoDecodInstance.video_dec_idx++;
 	}
 	else
@@ -1534,6 +2041,7 @@ static int DECODER_DEC( tDEC_FRAME_INPUT *pInput, tDEC_FRAME_OUTPUT *pOutput, tD
 		{
 			DebugPrint("[VDEC_ERROR]m_iOutputStatus %d %dtimes!!!\n",dec_private->pVideoDecodInstance.gsVDecOutput.m_DecOutInfo.m_iOutputStatus,dec_private->ConsecutiveVdecFailCnt);
 			dec_private->ConsecutiveVdecFailCnt = 0;
+			dec_private->keyframe_reason |= VPU_KEYFRAME_DECODE_ERROR;
 			return -1;
 		}
 	}
@@ -1580,36 +2088,198 @@ static int DECODER_DEC( tDEC_FRAME_INPUT *pInput, tDEC_FRAME_OUTPUT *pOutput, tD
 	
 	return 0;
 }
-#if 0
-static void save_decoded_frame(unsigned char* Y, unsigned char* U, unsigned char *V, int width, int height)
+
+/* Steady state H.264 Annex-B (no container, or a PTS container such as MP4) :
+ * sequence header done, no I-frame search, no skip mode, no seek.
+ * Restore and MPEG2/RV/TS specific handling stay in DECODER_DEC_Generic. */
+static int DECODER_DEC_AvcSteady( tDEC_FRAME_INPUT *pInput, tDEC_FRAME_OUTPUT *pOutput, tDEC_RESULT *pResult )
 {
+	_VIDEO_DECOD_INSTANCE_ *pInst = &dec_private->pVideoDecodInstance;
+	vdec_input_t *pVIn = &pInst->gsVDecInput;
+	vdec_output_t *pVOut = &pInst->gsVDecOutput;
+	int ret;
 
-	FILE *pFs = NULL;
-	char name[100];
+	pResult->need_input_retry = 0;
+	pResult->no_frame_output = 0;
+
+	pVIn->m_pInp[PA] = pVIn->m_pInp[VA] = pInput->inputStreamAddr;
+	pVIn->m_iInpLen = pInput->inputStreamSize;
+	pVIn->m_iSkipFrameNum = 0;
+	pVIn->m_iFrameSearchEnable = 0;
+	pVIn->m_iSkipFrameMode = VDEC_SKIP_FRAME_DISABLE;
+
+	DispBufClearRetry();
+	if( (ret = VpuCommandWatched( VDEC_DECODE, pVIn, pVOut )) < 0 )
+	{
+		DebugPrint( "[VDEC_DECODE] [Err:%d] video decode", ret );
+		VideoDecErrorProcess(ret);
+		return -1;
+	}
+	DecodeTelemetry(pInput);
 
-	sprintf(name, "/mnt/SD1p1/DecDump.raw");
-	if(!pFs){
-		pFs = fopen(name, "ab+");
-		if (!pFs) {
-			DebugPrint("Cannot open '%s'",name);
-			return;
+	if(pVOut->m_DecOutInfo.m_iDecodingStatus == VPU_DEC_BUF_FULL)
+	{
+		// Current input stream should be used next time.
+		if(dec_private->ConsecutiveBufferFullCnt++ > MAX_CONSECUTIVE_VPU_BUFFER_FULL_COUNT) {
+			DebugPrint("VPU_DEC_BUF_FULL");
+			dec_private->ConsecutiveBufferFullCnt = 0;
+			VideoDecErrorProcess(-RETCODE_CODEC_EXIT);
+			return -1;
 		}
+		pResult->need_input_retry = 1;
 	}
-	if(pFs){
-		fwrite( Y, width*height, 1, pFs);
-		fwrite( U, width*height/4, 1, pFs);
-		fwrite( V, width*height/4, 1, pFs);
+	else
+	{
+		dec_private->ConsecutiveBufferFullCnt = 0;
+	}
+
+//Update TimeStamp!!
+	if(pVOut->m_DecOutInfo.m_iDecodingStatus == VPU_DEC_SUCCESS && pVOut->m_DecOutInfo.m_iDecodedIdx >= 0)
+	{
+		dec_disp_info_t dec_disp_info_tmp;
+
+		dec_disp_info_tmp.m_iTimeStamp			= pInput->nTimeStamp;
+		dec_disp_info_tmp.m_iFrameType			= pVOut->m_DecOutInfo.m_iPicType;
+		dec_disp_info_tmp.m_iPicStructure		= pVOut->m_DecOutInfo.m_iPictureStructure;
+		dec_disp_info_tmp.m_iextTimeStamp		= 0;
+		dec_disp_info_tmp.m_iM2vFieldSequence	= 0;
+		dec_disp_info_tmp.m_iFrameSize			= pVOut->m_DecOutInfo.m_iConsumedBytes;
+		dec_disp_info_tmp.m_iFrameDuration		= 2;
+
+		pInst->dec_disp_info_input.m_iFrameIdx = pVOut->m_DecOutInfo.m_iDecodedIdx;
+		disp_pic_info( CVDEC_DISP_INFO_UPDATE, (void*)&pInst->dec_disp_info_ctrl, (void*)&dec_disp_info_tmp, (void*)&pInst->dec_disp_info_input, dec_private->nFps);
+	}
+
+	FrameOutputGeometry(pOutput);
+
+	if(pVOut->m_DecOutInfo.m_iOutputStatus != VPU_DEC_OUTPUT_SUCCESS)
+	{
+		pResult->no_frame_output = 1;
+		return 0;
+	}
+
+	dec_private->ConsecutiveVdecFailCnt = 0;
+	FrameOutputAddress(pOutput);
+
+	//Get TimeStamp!!
+	{
+		dec_disp_info_t *pdec_disp_info = NULL;
+
+		pInst->dec_disp_info_input.m_iFrameIdx = pVOut->m_DecOutInfo.m_iDispOutIdx;
+		disp_pic_info( CVDEC_DISP_INFO_GET, (void*)&pInst->dec_disp_info_ctrl, (void*)&pdec_disp_info, (void*)&pInst->dec_disp_info_input, dec_private->nFps);
+		pOutput->nTimeStamp = (pdec_disp_info != NULL) ? pdec_disp_info->m_iTimeStamp : pInput->nTimeStamp;
+	}
+
+	DispOutRelease();
+	pInst->video_dec_idx++;
+
+	return 0;
+}
+
+/* frame rate / bitrate hints : the PTS interval follows at once, the VPU takes its user info at VDEC_INIT */
+static void VpuApplyRate(void)
+{
+	_VIDEO_DECOD_INSTANCE_ *pInst = &dec_private->pVideoDecodInstance;
+	unsigned int fps = tcc_vpu_rate_fps();
+	unsigned int mbps = tcc_vpu_rate_mbps();
+
+	if( !tcc_vpu_rate_changed( dec_private->nFps, pInst->gsVDecUserInfo.bitrate_mbps, fps, mbps ) )
+		return;
+
+	DebugPrint("stream rate %u fps %u Mbps (was %u fps %u Mbps)", fps, mbps, dec_private->nFps, pInst->gsVDecUserInfo.bitrate_mbps);
+	dec_private->nFps = (fps > 255) ? 255 : (unsigned char)fps;
+	pInst->gsVDecUserInfo.frame_rate = fps;
+	pInst->gsVDecUserInfo.bitrate_mbps = mbps;
+	pInst->bitrate_mbps = mbps;
+
+	if( pInst->dec_disp_info_ctrl.m_iFmtType == CONTAINER_MPG )
+		dec_private->gsMPEG2PtsInfo.m_iPTSInterval = (((1000 * 1000) << 10) / fps) >> 10;
+#ifdef TS_TIMESTAMP_CORRECTION
+	if( pInst->dec_disp_info_ctrl.m_iFmtType == CONTAINER_TS )
+		pInst->gsTSPtsInfo.m_iPTSInterval = (((1000 * 1000) << 10) / fps) >> 10;
+#endif
+
+	// no frame buffers before the sequence header : re-open now so that the VPU clock fits from the first picture.
+	// Later the hints wait for the next VDEC_INIT (restore, idle resume), a re-open would cost pictures.
+	if( !dec_private->isSequenceHeaderDone && !pInst->isVPUClosed )
+	{
+		pInst->gspfVDec( VDEC_CLOSE, NULL, NULL, &pInst->gsVDecOutput, pInst->pVdec_Instance );
+		pInst->isVPUClosed = 1;
 	}
-	fclose(pFs);
 }
+
+/* Per-frame entry : the specialized path chosen at init when nothing but plain decoding is pending */
+static int DECODER_DEC( tDEC_FRAME_INPUT *pInput, tDEC_FRAME_OUTPUT *pOutput, tDEC_RESULT *pResult )
+{
+	int ret;
+	int picture = 1;
+
+	if( dec_private->pVideoDecodInstance.video_coding_type == STD_AVC )
+	{
+		const unsigned char *au;
+		int au_len;
+
+		// malformed input makes the VPU exit and costs a full restore : check it first, the caller's buffer stays untouched
+		if( tcc_bs_sanitize( pInput->inputStreamAddr, pInput->inputStreamSize, VPU_MAX_AU_SIZE,
+							dec_private->sanitize_buf, VPU_SANITIZE_BUF_SIZE, &au, &au_len ) < 0 )
+		{
+			memset( pResult, 0x00, sizeof(tDEC_RESULT) );
+			pResult->no_frame_output = 1;
+			// the pictures after a dropped access unit may reference it
+			if( dec_private->isSequenceHeaderDone )
+				tcc_vpudec_request_iframe_search();
+			return 1;
+		}
+		pInput->inputStreamAddr = (unsigned char*)au;
+		pInput->inputStreamSize = au_len;
+
+		picture = AvcCheckFrameGap( pInput->inputStreamAddr, pInput->inputStreamSize );
+#ifdef RESTORE_DECODE_ERR
+		AvcCacheKeyframe( pInput->inputStreamAddr, pInput->inputStreamSize );
 #endif
+	}
+	// trick play time stamps and I picture spacing say nothing about the stream's rates
+	if( dec_private->trick_speed <= 1 )
+	{
+		tcc_vpu_rate_au( pInput->inputStreamSize, pInput->nTimeStamp, picture );
+		VpuApplyRate();
+	}
+
+	if( dec_private->pfDecodeSteady != NULL
+		&& dec_private->isSequenceHeaderDone
+		&& !dec_private->isFirst_Frame
+		&& !pInput->seek
+		&& (dec_private->frameSearchOrSkip_flag | dec_private->i_skip_scheme_level) == 0
+		&& dec_private->trick_speed <= 1
+		&& !dec_private->pVideoDecodInstance.isVPUClosed )
+	{
+		return dec_private->pfDecodeSteady( pInput, pOutput, pResult );
+	}
+	ret = DECODER_DEC_Generic( pInput, pOutput, pResult );
+
+	// the search state only changes on the generic path
+	tcc_telemetry_search( dec_private->frameSearchOrSkip_flag == 1 );
+
+	// waiting passively may take a whole GOP : keep asking the source (rate limited by the caller)
+	if( dec_private->frameSearchOrSkip_flag == 1 )
+		dec_private->keyframe_reason |= VPU_KEYFRAME_SEARCH;
+	return ret;
+}
+
 int tcc_vpudec_init( int width, int height )
+{
+	return tcc_vpudec_init_container( width, height, CONTAINER_NONE );
+}
+
+/* container_type selects how input time stamps are handled :
+ * CONTAINER_MP4/AVI carry presentation time stamps, the others decode time stamps */
+int tcc_vpudec_init_container( int width, int height, int container_type )
 {
 	int ret = 0;
 	tDEC_INIT_PARAMS pInit;
 
 	pInit.codecFormat = CODEC_FORMAT_H264;  //set just for h264
-	pInit.container_type = CONTAINER_NONE;
+	pInit.container_type = container_type;
 	pInit.picWidth = width;
 	pInit.picHeight = height;
 	ret = DECODER_INIT_NoReordering(&pInit);
@@ -1624,9 +2294,255 @@ int tcc_vpudec_init( int width, int height )
 
 void tcc_vpudec_close(void)
 {
+	if(dec_private == NULL)
+		return;
 	DECODER_CLOSE();
 }
 
+/* every other tcc_vpudec_xxx() call works on the selected slot. Returns the slot selected before, -1 : bad slot */
+int tcc_vpudec_select(int slot)
+{
+	int prev = g_Slot;
+
+	if(slot < 0 || slot >= VPU_SLOT_COUNT)
+		return -1;
+	if(slot == g_Slot)
+		return prev;
+
+	g_SlotPrivate[g_Slot] = dec_private;
+	g_SlotArena[g_Slot] = g_Arena;
+	dec_private = g_SlotPrivate[slot];
+	g_Arena = g_SlotArena[slot];
+	g_Slot = slot;
+	tcc_vpu_rate_select(slot);
+	tcc_telemetry_select(slot);
+	tcc_vpu_watchdog_select(slot);
+	return prev;
+}
+
+int tcc_vpudec_set_skip_mode(int level, int interval)
+{
+	if(dec_private == NULL)
+		return -1;
+	
+	switch(level)
+	{
+		case VDEC_SKIP_FRAME_DISABLE:
+		case VDEC_SKIP_FRAME_EXCEPT_I:
+		case VDEC_SKIP_FRAME_ONLY_B:
+			break;
+		default:
+			ErrorPrint( "unknown skip level %d", level );
+			return -1;
+	}
+	
+	if(interval > 127)
+		interval = 127;
+	
+	dec_private->i_skip_scheme_level = (unsigned char)level;
+	dec_private->i_skip_interval = (signed char)interval;
+	dec_private->i_skip_count = (signed char)interval;
+	DebugPrint( "skip mode %d, interval %d", level, interval );
+	
+	return 0;
+}
+
+/* speed > 1 : trick play, the caller feeds I pictures only (see tcc_vdec_SetTrickSpeed).
+ * The frame_num jumps between them are not losses. Back at 1 the caller resumes at the next I picture,
+ * the P pictures right after the last one fed may reference pictures that were skipped :
+ * the frame_num check starts over there. */
+int tcc_vpudec_set_trick(int speed)
+{
+	if(dec_private == NULL)
+		return -1;
+	
+	if(speed < 1)
+		speed = 1;
+	if(speed > 255)
+		speed = 255;
+	
+	if(dec_private->trick_speed > 1 && speed == 1)
+		dec_private->avc_prev_ref_frame_num = -1;
+	dec_private->trick_speed = (unsigned char)speed;
+	DebugPrint( "trick speed %d", speed );
+	
+	return 0;
+}
+
+/* 1 : the display index is still out of the VPU, held by the display or queued in the FIFO */
+static int DispIdxOwned(int idx)
+{
+	unsigned int n;
+
+	if(idx < 0)
+		return 0;
+	if(dec_private->release_by_display)
+		return (idx < 32 && (dec_private->outstanding_mask & (1u << idx)));
+
+	if(dec_private->max_fifo_cnt == 0)
+		return 0;
+	for(n = dec_private->out_index; n != dec_private->in_index; n = (n + 1) % dec_private->max_fifo_cnt)
+	{
+		if(dec_private->Display_index[n] == (unsigned int)idx)
+			return 1;
+	}
+	return 0;
+}
+
+/* disp_idx >= 0 : pin this frame (the one on screen) so it survives the FIFO recycling and display releases.
+ *                 -1 when it already went back to the VPU : it may be overwritten, it cannot be held.
+ * disp_idx < 0  : give the pinned frame back to the VPU. */
+int tcc_vpudec_hold_frame(int disp_idx)
+{
+	if(dec_private == NULL)
+		return -1;
+
+	if(disp_idx >= 0)
+	{
+		if(dec_private->pinned_index >= 0)
+			return 0;
+		if(!DispIdxOwned(disp_idx))
+			return -1;
+
+		dec_private->pinned_index = disp_idx;
+		dec_private->pinned_withheld = 0;
+		DebugPrint("pin DispIdx %d", dec_private->pinned_index);
+		return 0;
+	}
+
+	if(dec_private->pinned_index < 0)
+		return 0;
+
+	if(dec_private->pinned_withheld)
+	{
+		unsigned int idx = (unsigned int)dec_private->pinned_index;
+
+		dec_private->pinned_index = -1;
+		dec_private->pinned_withheld = 0;
+		DebugPrint("unpin DispIdx %d", idx);
+		DispBufClear( idx );
+		return 0;
+	}
+
+	// still queued in the FIFO, it will be cleared there
+	dec_private->pinned_index = -1;
+	return 0;
+}
+
+/* the pinned frame is shown again : release by display only, it goes back with tcc_vpudec_release_frame()
+ * like any frame pushed to the display instead of at the next hold_frame(0). Returns its index, -1 : none */
+int tcc_vpudec_unpin_to_display(void)
+{
+	int idx;
+
+	if(dec_private == NULL || !dec_private->release_by_display || dec_private->pinned_index < 0)
+		return -1;
+
+	idx = dec_private->pinned_index;
+	// the display had given it back while it was pinned : it is the display's again
+	if(dec_private->pinned_withheld && idx < 32)
+		dec_private->outstanding_mask |= (1u << idx);
+	dec_private->pinned_index = -1;
+	dec_private->pinned_withheld = 0;
+	DebugPrint("pinned DispIdx %d handed to the display", idx);
+	return idx;
+}
+
+/* by_display = 1 : frames stay with the caller until tcc_vpudec_release_frame().
+ * Takes effect at the next sequence header, since it changes the number of frame buffers. */
+int tcc_vpudec_set_release_mode(int by_display)
+{
+	if(dec_private == NULL)
+		return -1;
+
+	dec_private->release_by_display = by_display ? 1 : 0;
+	return 0;
+}
+
+int tcc_vpudec_release_frame(int disp_idx)
+{
+	if(dec_private == NULL)
+		return -1;
+
+	// unknown or stale (the VPU was restored since) index : nothing to do
+	if(disp_idx < 0 || disp_idx >= 32 || !(dec_private->outstanding_mask & (1u << disp_idx)))
+		return 0;
+
+	dec_private->outstanding_mask &= ~(1u << disp_idx);
+	DebugPrint("Display done DispIdx Clear %d", disp_idx);
+	DispBufClear( (unsigned int)disp_idx );
+	return 0;
+}
+
+unsigned int tcc_vpudec_buffer_epoch(void)
+{
+	if(dec_private == NULL)
+		return 0;
+	return dec_private->buf_epoch;
+}
+
+/* input was lost : skip pictures until the next I-frame instead of decoding broken references.
+ * Before the sequence header the first-frame search does the same. */
+int tcc_vpudec_request_iframe_search(void)
+{
+	if(dec_private == NULL)
+		return -1;
+
+	dec_private->keyframe_reason |= VPU_KEYFRAME_LOSS;
+	if(dec_private->isSequenceHeaderDone && dec_private->frameSearchOrSkip_flag != 1)
+	{
+		DebugPrint("[LOSS] I-frame Search Mode enable");
+		dec_private->frameSearchOrSkip_flag = 1;
+	}
+	return 0;
+}
+
+/* VPU_KEYFRAME_xxx raised since the last call, cleared on read */
+unsigned int tcc_vpudec_take_keyframe_request(void)
+{
+	unsigned int reason;
+
+	if(dec_private == NULL)
+		return 0;
+	reason = dec_private->keyframe_reason;
+	dec_private->keyframe_reason = 0;
+	return reason;
+}
+
+/* heap operations of the decoder since start up : only init and close move it, never a decoded frame */
+unsigned int tcc_vpudec_heap_ops(void)
+{
+	return g_HeapOps;
+}
+
+/* idle : give the VPU instance and its frame buffers back, keeping the cached key frame.
+ * The next input re-initializes from it like a restore. 1 : released, 0 : nothing was open */
+int tcc_vpudec_suspend(void)
+{
+	if(dec_private == NULL)
+		return -1;
+	if(dec_private->pVideoDecodInstance.isVPUClosed)
+		return 0;
+
+	VpuCloseForReinit();
+	dec_private->avc_prev_ref_frame_num = -1;
+	dec_private->isFirst_Frame = 1;
+#ifdef RESTORE_DECODE_ERR
+	// restore path : sequence header and first picture from seqHeader_backup
+	if(dec_private->seqHeader_len != 0)
+		dec_private->cntDecError = 1;
+#endif
+	DebugPrint("suspended, key frame cache %d bytes", dec_private->seqHeader_len);
+	return 1;
+}
+
+int tcc_vpudec_is_frame_held(void)
+{
+	if(dec_private == NULL)
+		return 0;
+	return (dec_private->pinned_index >= 0);
+}
+
 int tcc_vpudec_decode(unsigned int *pInputStream, unsigned int *pOutstream)
 {
 	int ret = 0;
@@ -1636,8 +2552,11 @@ int tcc_vpudec_decode(unsigned int *pInputStream, unsigned int *pOutstream)
 
 	Input.inputStreamAddr = (unsigned char*)pInputStream[0];
 	Input.inputStreamSize = pInputStream[1];
-	Input.nTimeStamp = 0;	
+	Input.nTimeStamp = pInputStream[2];	/* TimeStamp of input bitstream, by ms (0 if unknown) */
 	Input.seek = 0;
+#ifdef VDEC_FAULT_INJECT
+	tcc_vpu_fault_au_in();
+#endif
 
 	//Display_Stream(Input.inputStreamAddr,Input.inputStreamSize);
 	
@@ -1649,11 +2568,17 @@ int tcc_vpudec_decode(unsigned int *pInputStream, unsigned int *pOutstream)
 	}
 	if(Result.no_frame_output)
 	{
-		ErrorPrint( "No_frame_output");
+		// normal while the VPU fills its reorder buffers or skips pictures, callers see VDEC_EVENT_FRAME_READY instead
+		DebugPrint( "No_frame_output");
 		return -1;
 	}
 	else
 	{
+		tcc_vpu_watchdog_frame_out();
+#ifdef VDEC_FAULT_INJECT
+		tcc_vpu_fault_frame_out();
+#endif
+
 		pOutstream[0] = Output.frameFormat;
 		pOutstream[1] = Output.bufPhyAddr[0];   //Physical Y
 		pOutstream[2] = Output.bufPhyAddr[1];   //Physical U
@@ -1669,6 +2594,7 @@ int tcc_vpudec_decode(unsigned int *pInputStream, unsigned int *pOutstream)
 		pOutstream[12] = Output.crop_top;
 		pOutstream[13] = Output.crop_right;
 		pOutstream[14] = Output.crop_bottom;
+		pOutstream[15] = dec_private->last_disp_index;
 		
 		//DebugPrint( "[libH264] pOutstream[1]=0x%08x, pOutstream[2]=0x%08x, pOutstream[3]=0x%08x",
 		//				pOutstream[1], pOutstream[2], pOutstream[3] );
@@ -1677,8 +2603,7 @@ int tcc_vpudec_decode(unsigned int *pInputStream, unsigned int *pOutstream)
 		//DebugPrint( "[libH264] pOutstream[13]=0x%08x, pOutstream[14]=0x%08x.",
 		//				pOutstream[13],pOutstream[14]);
 		
-		// Debug
-		//	save_decoded_frame( pOutstream[4], pOutstream[5], pOutstream[6], pOutstream[8], pOutstream[9] );
+		// Debug : decoded frames can be dumped with tcc_vdec_StartDump()
 	}
 
 	return ret;
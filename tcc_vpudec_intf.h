@@ -122,6 +122,36 @@ typedef struct EXT_F_frame_time_t {
 
 #define CHECK_SEQHEADER_WITH_SYNCFRAME
 
+/* one extra frame buffer is reserved so the last displayed frame can be pinned while the view is hidden */
+#define VPU_PIN_BUFF_COUNT	1
+
+/* frames the display side may hold when buffers are released on display completion : one being scanned out,
+ * one pushed whose latch is not confirmed yet (tcc_vsync_latched waits for the second vsync) and the newest one */
+#define VPU_DISP_HOLD_BUFF_COUNT	3
+
+/* largest first decodable frame (SPS/PPS + sync frame) kept to restore the decoder after a VPU exit.
+ * carved with the sequence header slot from the per-instance arena, nothing is allocated after init */
+#define VPU_SEQ_BACKUP_SIZE		(512 * 1024)
+
+/* decoder contexts, one VPU instance each : the second one pre-rolls the next source */
+#define VPU_SLOT_COUNT			2
+
+/* largest access unit passed to the VPU, larger ones would overflow its bitstream buffer and are dropped */
+#define VPU_MAX_AU_SIZE			(2 * 1024 * 1024)
+
+/* access units the bitstream sanitizer has to rebuild (NALs dropped in the middle) are copied here,
+ * a damaged access unit that does not fit is dropped instead */
+#define VPU_SANITIZE_BUF_SIZE	(512 * 1024)
+
+/* why the decoder wants a new key frame from the source, see tcc_vpudec_take_keyframe_request() */
+#define VPU_KEYFRAME_DECODE_ERROR	(1<<0)	/* VDEC_DECODE failed, the decoder is restored or keeps failing */
+#define VPU_KEYFRAME_FRAME_GAP		(1<<1)	/* H.264 frame_num skipped a reference picture */
+#define VPU_KEYFRAME_ERROR_MB		(1<<2)	/* a picture came out with too many error macroblocks */
+#define VPU_KEYFRAME_LOSS			(1<<3)	/* the input side reported lost data */
+#define VPU_KEYFRAME_SEARCH			(1<<4)	/* still searching for an I-frame */
+
+#define VPU_KEYFRAME_ERR_MB_PERMILLE	20	/* error macroblocks per 1000 in one picture that count as a spike */
+
 typedef struct dec_disp_info_ctrl_t {
 	int		m_iTimeStampType;	//! TS(Timestamp) type (0: Presentation TS(default), 1:Decode TS)
 	int		m_iStdType;			//! STD type
@@ -234,27 +264,58 @@ typedef struct dec_private_data {
 	unsigned int frm_clear;
 	unsigned int Display_index[VPU_BUFF_COUNT];
 	unsigned int max_fifo_cnt;
+	signed int			last_disp_index;	//display index of the last output frame
+	signed int			pinned_index;		//display index withheld from VDEC_BUF_FLAG_CLEAR, -1 : none
+	unsigned char		pinned_withheld;	//FIFO already passed pinned_index, clear it on unpin
+	unsigned char		release_by_display;	//1 : output frames are cleared by tcc_vpudec_release_frame() instead of the FIFO
+	unsigned int		outstanding_mask;	//display indexes handed out and not yet released (release_by_display)
+	unsigned int		clear_retry_mask;	//display indexes whose VDEC_BUF_FLAG_CLEAR failed, tried again before the next decode
+	unsigned int		buf_epoch;			//bumped whenever the frame buffers are re-allocated
+	unsigned int		keyframe_reason;	//VPU_KEYFRAME_xxx raised since the last tcc_vpudec_take_keyframe_request()
+	unsigned char		avc_log2_max_frame_num;	//from the last SPS, 0 : no SPS seen
+	unsigned char		avc_gaps_allowed;		//gaps_in_frame_num_value_allowed_flag
+	signed int			avc_prev_ref_frame_num;	//-1 : unknown until the next IDR
+	unsigned char		trick_speed;			//0/1 : normal play, 2.. : only I pictures are fed (trick play)
+	int					(*pfDecodeSteady)( tDEC_FRAME_INPUT *pInput, tDEC_FRAME_OUTPUT *pOutput, tDEC_RESULT *pResult );	//codec/container specific per-frame path, NULL : generic only
+	unsigned char*		sanitize_buf;		//VPU_SANITIZE_BUF_SIZE arena slot
+
 //error process
 	signed char 		seq_header_init_error_count;
 	unsigned char 		ConsecutiveVdecFailCnt;
 	signed int			ConsecutiveBufferFullCnt;
 
 #ifdef RESTORE_DECODE_ERR
-	unsigned char* 		seqHeader_backup;
-	unsigned int 		seqHeader_len;
+	unsigned char* 		seqHeader_backup;	//VPU_SEQ_BACKUP_SIZE arena slot
+	unsigned int 		seqHeader_len;		//0 : nothing backed up yet
 	unsigned char 		cntDecError;
+	unsigned char*		avc_params;			//latest SPS/PPS, MAX_SEQ_HEADER_ALLOC_SIZE arena slot
+	int					avc_params_len;
 #endif
 
 #ifdef CHECK_SEQHEADER_WITH_SYNCFRAME
-	unsigned char*		sequence_header_only;
-	unsigned char 		sequence_header_size;
+	unsigned char*		sequence_header_only;	//MAX_SEQ_HEADER_ALLOC_SIZE arena slot
+	long		 		sequence_header_size;
 	unsigned char 		need_sequence_header_attachment;
 #endif
 }tDEC_PRIVATE;
 
 
 int tcc_vpudec_init( int width, int height );
+int tcc_vpudec_init_container( int width, int height, int container_type );
 void tcc_vpudec_close(void);
+int tcc_vpudec_select(int slot);
 int tcc_vpudec_decode(unsigned int *pInputStream, unsigned int *pOutstream);
+int tcc_vpudec_set_skip_mode(int level, int interval);
+int tcc_vpudec_set_trick(int speed);
+int tcc_vpudec_hold_frame(int disp_idx);
+int tcc_vpudec_is_frame_held(void);
+int tcc_vpudec_unpin_to_display(void);
+int tcc_vpudec_suspend(void);
+int tcc_vpudec_set_release_mode(int by_display);
+int tcc_vpudec_release_frame(int disp_idx);
+unsigned int tcc_vpudec_buffer_epoch(void);
+int tcc_vpudec_request_iframe_search(void);
+unsigned int tcc_vpudec_take_keyframe_request(void);
+unsigned int tcc_vpudec_heap_ops(void);
 
 #endif	// __H264_DECODER_H__
@@ -0,0 +1,125 @@
+//********************************************************************************************
+/**
+ * @file        tcc_vsync.c
+ * @brief		Display vsync source used to release decoded buffers once the display has moved past them.
+ * 				This interface contain : Start/Stop vsync watcher, Check whether a push has been latched.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <linux/fb.h>
+
+#include "tcc_vsync.h"
+
+//#define	DEBUG_MODE
+#ifdef	DEBUG_MODE
+	#define	DebugPrint( fmt, ... )	printf( "[TCC_VSYNC](D):"fmt"\n", ##__VA_ARGS__ )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_VSYNC](E):"fmt"\n", ##__VA_ARGS__ )
+#else
+	#define	DebugPrint( fmt, ... )
+	#define	ErrorPrint( fmt, ... )	printf( "[TCC_VSYNC](E):"fmt"\n", ##__VA_ARGS__ )
+#endif
+
+#ifndef FBIO_WAITFORVSYNC
+#define FBIO_WAITFORVSYNC	_IOW('F', 0x20, unsigned int)
+#endif
+
+static int g_VsyncFd = -1;
+static pthread_t g_VsyncThread;
+static volatile int g_VsyncRun = 0;
+static volatile int g_VsyncValid = 0;		// 1 : driver reports vsync, 0 : use VSYNC_PERIOD_US
+static volatile unsigned int g_VsyncCount = 0;
+
+long long tcc_vsync_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void* vsync_thread(void *arg)
+{
+	unsigned int crtc = 0;
+
+	while( g_VsyncRun )
+	{
+		if( ioctl( g_VsyncFd, FBIO_WAITFORVSYNC, &crtc ) < 0 )
+		{
+			ErrorPrint( "FBIO_WAITFORVSYNC is not supported, use %d us period", VSYNC_PERIOD_US );
+			g_VsyncValid = 0;
+			break;
+		}
+		__sync_fetch_and_add( &g_VsyncCount, 1 );
+	}
+
+	return NULL;
+}
+
+int tcc_vsync_start(void)
+{
+	if( g_VsyncRun )
+		return 0;
+
+	g_VsyncValid = 0;
+	g_VsyncFd = open( VSYNC_DEV, O_RDWR );
+	if( g_VsyncFd < 0 )
+	{
+		ErrorPrint( "Error opening %s, use %d us period", VSYNC_DEV, VSYNC_PERIOD_US );
+		return -1;
+	}
+
+	g_VsyncValid = 1;
+	g_VsyncRun = 1;
+	if( pthread_create( &g_VsyncThread, NULL, vsync_thread, NULL ) != 0 )
+	{
+		ErrorPrint( "vsync thread create fail" );
+		g_VsyncRun = 0;
+		g_VsyncValid = 0;
+		close( g_VsyncFd );
+		g_VsyncFd = -1;
+		return -1;
+	}
+
+	return 0;
+}
+
+void tcc_vsync_stop(void)
+{
+	if( g_VsyncRun )
+	{
+		g_VsyncRun = 0;
+		pthread_join( g_VsyncThread, NULL );	// returns within one vsync
+	}
+	if( g_VsyncFd >= 0 )
+	{
+		close( g_VsyncFd );
+		g_VsyncFd = -1;
+	}
+	g_VsyncValid = 0;
+}
+
+void tcc_vsync_stamp(VsyncStamp *stamp)
+{
+	stamp->count = g_VsyncCount;
+	stamp->time_us = tcc_vsync_now_us();
+}
+
+int tcc_vsync_latched(const VsyncStamp *stamp)
+{
+	// the push may land just after the register update of the first vsync, so wait for the second one
+	if( g_VsyncValid )
+		return (int)(g_VsyncCount - stamp->count) >= 2;
+
+	// no driver notification : assume latched after one full period plus the partial one we pushed in
+	return (tcc_vsync_now_us() - stamp->time_us) >= 2 * VSYNC_PERIOD_US;
+}
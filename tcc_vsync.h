@@ -0,0 +1,33 @@
+//********************************************************************************************
+/**
+ * @file        tcc_vsync.h
+ * @brief		Display vsync source used to release decoded buffers once the display has moved past them.
+ * 				This interface contain : Start/Stop vsync watcher, Check whether a push has been latched.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+#ifndef	__TCC_VSYNC_H__
+#define	__TCC_VSYNC_H__
+
+#define VSYNC_DEV			"/dev/fb0"
+#define VSYNC_PERIOD_US		16667	/* used when the driver can not report vsync */
+
+typedef struct _VsyncStamp {
+	unsigned int	count;		//vsync count when the buffer was pushed
+	long long		time_us;	//monotonic time when the buffer was pushed
+} VsyncStamp;
+
+int tcc_vsync_start(void);
+void tcc_vsync_stop(void);
+
+/* take a stamp right after a buffer has been pushed to the display */
+void tcc_vsync_stamp(VsyncStamp *stamp);
+
+/* 1 once the pushed buffer is surely being scanned out, so the one before it can be released */
+int tcc_vsync_latched(const VsyncStamp *stamp);
+
+long long tcc_vsync_now_us(void);
+
+#endif	// __TCC_VSYNC_H__
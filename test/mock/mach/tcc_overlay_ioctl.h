@@ -0,0 +1,35 @@
+//********************************************************************************************
+/**
+ * @file        tcc_overlay_ioctl.h
+ * @brief		Host stand-in for the kernel overlay header : the structures and requests the decoder uses.
+ * 				This interface contain : Overlay config, Video buffer, Ioctl requests.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+#ifndef	__MOCK_TCC_OVERLAY_IOCTL_H__
+#define	__MOCK_TCC_OVERLAY_IOCTL_H__
+
+typedef struct {
+	unsigned int	sx;
+	unsigned int	sy;
+	unsigned int	width;
+	unsigned int	height;
+	unsigned int	format;
+	unsigned int	transform;
+} overlay_config_t;
+
+typedef struct {
+	overlay_config_t	cfg;
+	unsigned int		addr;
+	unsigned int		addr1;
+	unsigned int		addr2;
+} overlay_video_buffer_t;
+
+#define OVERLAY_SET_CONFIGURE			0x0101
+#define OVERLAY_PUSH_VIDEO_BUFFER		0x0102
+#define OVERLAY_SET_IGNORE_PRIORITY		0x0103
+#define OVERLAY_GET_PUSH_COUNT			0x0104
+
+#endif	// __MOCK_TCC_OVERLAY_IOCTL_H__
@@ -0,0 +1,13 @@
+//********************************************************************************************
+/**
+ * @file        vioc_global.h
+ * @brief		Host stand-in for the kernel VIOC header, nothing of it is used by the decoder.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+#ifndef	__MOCK_VIOC_GLOBAL_H__
+#define	__MOCK_VIOC_GLOBAL_H__
+
+#endif	// __MOCK_VIOC_GLOBAL_H__
@@ -0,0 +1,127 @@
+//********************************************************************************************
+/**
+ * @file        vdec_v1.h
+ * @brief		Host stand-in for the SDK vdec header : the types and codes the decoder uses, nothing else.
+ * 				This interface contain : VDEC commands, Input/Output/Init structures, Return codes, VPU entry points.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+#ifndef	__MOCK_VDEC_V1_H__
+#define	__MOCK_VDEC_V1_H__
+
+#define PA	0
+#define VA	1
+
+#define VPU_BUFF_COUNT							6
+#define MAX_SEQ_HEADER_ALLOC_SIZE				4096
+#define SEQ_HEADER_INIT_ERROR_COUNT				200
+#define MAX_CONSECUTIVE_VPU_FAIL_COUNT			200
+#define MAX_CONSECUTIVE_VPU_FAIL_TO_RESTORE_COUNT	10
+#define MAX_CONSECUTIVE_VPU_BUFFER_FULL_COUNT	30
+
+/* commands */
+enum { VDEC_INIT = 0, VDEC_DEC_SEQ_HEADER, VDEC_DECODE, VDEC_BUF_FLAG_CLEAR, VDEC_CLOSE };
+
+enum { VDEC_SKIP_FRAME_DISABLE = 0, VDEC_SKIP_FRAME_EXCEPT_I, VDEC_SKIP_FRAME_ONLY_B };
+enum { STD_AVC = 0, STD_VC1, STD_MPEG2, STD_MPEG4, STD_H263, STD_DIV3, STD_RV, STD_AVS, STD_MJPG };
+enum { PIC_TYPE_I = 0, PIC_TYPE_P, PIC_TYPE_B, PIC_TYPE_B_PB };
+enum { CVDEC_DISP_INFO_INIT = 0, CVDEC_DISP_INFO_UPDATE, CVDEC_DISP_INFO_GET, CVDEC_DISP_INFO_RESET };
+enum { CDMX_PTS_MODE = 0, CDMX_DTS_MODE };
+
+/* return codes, negated by the VPU calls */
+#define RETCODE_CODEC_EXIT					10
+#define RETCODE_MULTI_CODEC_EXIT_TIMEOUT	11
+#define RETCODE_INVALID_STRIDE				12
+#define VPU_NOT_ENOUGH_MEM					13
+#define VPU_ENV_INIT_ERROR					14
+
+/* m_iDecodingStatus / m_iOutputStatus */
+#define VPU_DEC_SUCCESS					1
+#define VPU_DEC_SUCCESS_FIELD_PICTURE	2
+#define VPU_DEC_BUF_FULL				3
+#define VPU_DEC_OUTPUT_SUCCESS			1
+
+#define EXT_FUNC_NO_BUFFER_DELAY		1
+
+#define MPEG4_VOL_STARTCODE_MIN		0x120
+#define MPEG4_VOL_STARTCODE_MAX		0x12F
+#define MPEG4_VOP_STARTCODE			0x1B6
+
+typedef struct {
+	int m_iCropLeft;
+	int m_iCropRight;
+	int m_iCropTop;
+	int m_iCropBottom;
+} crop_t;
+
+typedef struct {
+	int		m_iPicWidth;
+	int		m_iPicHeight;
+	int		m_iInterlace;
+	crop_t	m_iAvcPicCrop;
+	int		m_iMinFrameBufferCount;
+} init_info_t;
+
+typedef struct {
+	int				m_iPicType;
+	int				m_iPictureStructure;
+	int				m_iConsumedBytes;
+	int				m_iDecodingStatus;
+	int				m_iOutputStatus;
+	int				m_iDecodedIdx;
+	int				m_iDispOutIdx;
+	int				m_iNumOfErrMBs;
+	int				m_iWidth;
+	int				m_iHeight;
+	int				m_iRvTimestamp;
+	int				m_iM2vProgressiveFrame;
+	int				m_iInterlacedFrame;
+	int				m_iTopFieldFirst;
+	int				m_iRepeatFirstField;
+	int				m_iM2vFieldSequence;
+	int				m_iM2vFrameRate;
+	unsigned char	*m_UserDataAddress[2];
+} dec_out_info_t;
+
+typedef struct {
+	unsigned char	*m_pInp[2];
+	int				m_iInpLen;
+	int				m_iSkipFrameNum;
+	int				m_iFrameSearchEnable;
+	int				m_iSkipFrameMode;
+} vdec_input_t;
+
+typedef struct {
+	init_info_t		*m_pInitialInfo;
+	dec_out_info_t	m_DecOutInfo;
+	unsigned char	*m_pDispOut[2][3];
+} vdec_output_t;
+
+typedef struct {
+	int m_iBitstreamFormat;
+	int m_iPicWidth;
+	int m_iPicHeight;
+	int m_bEnableVideoCache;
+	int m_bFilePlayEnable;
+	int m_bCbCrInterleaveMode;
+	int m_bEnableUserData;
+} vdec_init_t;
+
+typedef struct {
+	unsigned int bitrate_mbps;
+	unsigned int frame_rate;
+	unsigned int m_bJpegOnly;
+	unsigned int extFunction;
+} vdec_user_info_t;
+
+typedef int (cdk_func_t)(int cmd, int *handle, void *param1, void *param2, void *instance);
+
+extern cdk_func_t vdec_vpu;
+void *vdec_alloc_instance(int format, int index);
+void vdec_release_instance(void *instance);
+void vpu_set_additional_refframe_count(int count, void *instance);
+unsigned char *vpu_getBitstreamBufAddr(int addr_type, void *instance);
+
+#endif	// __MOCK_VDEC_V1_H__
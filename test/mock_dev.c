@@ -0,0 +1,392 @@
+//********************************************************************************************
+/**
+ * @file        mock_dev.c
+ * @brief		Host stand-ins for /dev/overlay and /dev/fb0 behind open/ioctl/close, heap counters behind malloc/free.
+ * 				This interface contain : Wrapped open/ioctl/close, Wrapped malloc/calloc/realloc/free, Fd count, Low memory.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/fb.h>
+
+#include <mach/tcc_overlay_ioctl.h>
+
+#include "vdec_mock.h"
+
+#ifndef FBIO_WAITFORVSYNC
+#define FBIO_WAITFORVSYNC	_IOW('F', 0x20, unsigned int)
+#endif
+
+#define MOCK_OVERLAY_DEV	"/dev/overlay"
+#define MOCK_FB_DEV			"/dev/fb0"
+#define MOCK_MAX_FDS		32
+
+enum { MOCK_FD_OVERLAY = 1, MOCK_FD_FB };
+
+typedef struct _MockFd {
+	int		fd;
+	int		kind;
+} MockFd;
+
+static pthread_mutex_t g_DevMutex = PTHREAD_MUTEX_INITIALIZER;
+static MockFd g_Fds[MOCK_MAX_FDS];
+static MockDispStat g_DispStat;
+static unsigned int g_ScanAddr = 0;		//latched at the last vsync
+static unsigned int g_PendAddr = 0;		//pushed since, latched at the next one
+static int g_FailOverlay = 0;
+static int g_FbBpp = 32;				//pixel format of the next /dev/fb0 open : 32 ARGB8888, 16 RGB565
+
+static MockHeapStat g_Heap;
+
+int g_CheckFail = 0;
+
+long long mock_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*--------------------------------------------------------------------------------------------
+ * devices
+ */
+int __real_open(const char *path, int flags, ...);
+int __real_ioctl(int fd, unsigned long request, ...);
+int __real_close(int fd);
+
+static int fd_kind(int fd)
+{
+	int i;
+	int kind = 0;
+
+	pthread_mutex_lock( &g_DevMutex );
+	for( i = 0; i < MOCK_MAX_FDS; i++ )
+	{
+		if( g_Fds[i].kind != 0 && g_Fds[i].fd == fd )
+			kind = g_Fds[i].kind;
+	}
+	pthread_mutex_unlock( &g_DevMutex );
+	return kind;
+}
+
+static int fd_add(int fd, int kind)
+{
+	int i;
+
+	if( fd < 0 )
+		return -1;
+	pthread_mutex_lock( &g_DevMutex );
+	for( i = 0; i < MOCK_MAX_FDS; i++ )
+	{
+		if( g_Fds[i].kind == 0 )
+		{
+			g_Fds[i].fd = fd;
+			g_Fds[i].kind = kind;
+			g_DispStat.open_fds++;
+			pthread_mutex_unlock( &g_DevMutex );
+			return fd;
+		}
+	}
+	pthread_mutex_unlock( &g_DevMutex );
+	__real_close( fd );
+	errno = EMFILE;
+	return -1;
+}
+
+int __wrap_open(const char *path, int flags, ...)
+{
+	va_list ap;
+	int mode = 0;
+	int fd;
+
+	if( flags & O_CREAT )
+	{
+		va_start( ap, flags );
+		mode = va_arg( ap, int );
+		va_end( ap );
+	}
+
+	if( strcmp( path, MOCK_OVERLAY_DEV ) == 0 )
+	{
+		if( g_FailOverlay )
+		{
+			errno = ENODEV;
+			return -1;
+		}
+		return fd_add( __real_open( "/dev/null", O_RDWR | O_CLOEXEC ), MOCK_FD_OVERLAY );
+	}
+	if( strcmp( path, MOCK_FB_DEV ) == 0 )
+	{
+		fd = memfd_create( "fb0", MFD_CLOEXEC );
+		if( fd >= 0 && ftruncate( fd, MOCK_FB_WIDTH * MOCK_FB_HEIGHT * (g_FbBpp / 8) * 2 ) < 0 )
+		{
+			__real_close( fd );
+			fd = -1;
+		}
+		return fd_add( fd, MOCK_FD_FB );
+	}
+	return __real_open( path, flags, mode );
+}
+
+int __wrap_close(int fd)
+{
+	int i;
+
+	pthread_mutex_lock( &g_DevMutex );
+	for( i = 0; i < MOCK_MAX_FDS; i++ )
+	{
+		if( g_Fds[i].kind != 0 && g_Fds[i].fd == fd )
+		{
+			// the overlay driver turns the layer off on release : nothing is scanned out of video buffers any more
+			if( g_Fds[i].kind == MOCK_FD_OVERLAY )
+				g_ScanAddr = g_PendAddr = 0;
+			g_Fds[i].kind = 0;
+			g_DispStat.open_fds--;
+		}
+	}
+	pthread_mutex_unlock( &g_DevMutex );
+	return __real_close( fd );
+}
+
+static void vsync_wait(void)
+{
+	long long now = mock_now_us();
+	long long next = (now / MOCK_VSYNC_US + 1) * MOCK_VSYNC_US;
+
+	usleep( (useconds_t)(next - now) );
+	pthread_mutex_lock( &g_DevMutex );
+	if( g_PendAddr != 0 )
+	{
+		g_ScanAddr = g_PendAddr;
+		g_PendAddr = 0;
+	}
+	g_DispStat.vsyncs++;
+	pthread_mutex_unlock( &g_DevMutex );
+}
+
+static int fb_ioctl(unsigned long request, void *arg)
+{
+	struct fb_var_screeninfo *var;
+	struct fb_fix_screeninfo *fix;
+
+	switch( request )
+	{
+		case FBIO_WAITFORVSYNC:
+			vsync_wait();
+			return 0;
+
+		case FBIOGET_VSCREENINFO:
+			var = (struct fb_var_screeninfo*)arg;
+			memset( var, 0, sizeof(*var) );
+			var->xres = var->xres_virtual = MOCK_FB_WIDTH;
+			var->yres = MOCK_FB_HEIGHT;
+			var->yres_virtual = MOCK_FB_HEIGHT * 2;
+			var->bits_per_pixel = g_FbBpp;
+			if( g_FbBpp == 16 )
+			{
+				var->red.offset = 11;
+				var->red.length = 5;
+				var->green.offset = 5;
+				var->green.length = 6;
+				var->blue.length = 5;
+				return 0;
+			}
+			var->red.offset = 16;
+			var->red.length = 8;
+			var->green.offset = 8;
+			var->green.length = 8;
+			var->blue.length = 8;
+			var->transp.offset = 24;
+			var->transp.length = 8;
+			return 0;
+
+		case FBIOGET_FSCREENINFO:
+			fix = (struct fb_fix_screeninfo*)arg;
+			memset( fix, 0, sizeof(*fix) );
+			fix->line_length = MOCK_FB_WIDTH * (g_FbBpp / 8);
+			fix->smem_len = MOCK_FB_WIDTH * MOCK_FB_HEIGHT * (g_FbBpp / 8) * 2;
+			return 0;
+
+		case FBIOPAN_DISPLAY:
+			__sync_fetch_and_add( &g_DispStat.pans, 1 );
+			return 0;
+
+		default:
+			return 0;	//FBIOPUT_VSCREENINFO, layer order
+	}
+}
+
+static int overlay_ioctl(unsigned long request, void *arg)
+{
+	if( request == OVERLAY_PUSH_VIDEO_BUFFER )
+	{
+		pthread_mutex_lock( &g_DevMutex );
+		g_PendAddr = ((overlay_video_buffer_t*)arg)->addr;
+		g_DispStat.pushes++;
+		pthread_mutex_unlock( &g_DevMutex );
+	}
+	return 0;
+}
+
+int __wrap_ioctl(int fd, unsigned long request, ...)
+{
+	va_list ap;
+	void *arg;
+
+	va_start( ap, request );
+	arg = va_arg( ap, void* );
+	va_end( ap );
+
+	switch( fd_kind( fd ) )
+	{
+		case MOCK_FD_FB:
+			return fb_ioctl( request, arg );
+		case MOCK_FD_OVERLAY:
+			return overlay_ioctl( request, arg );
+		default:
+			return __real_ioctl( fd, request, arg );
+	}
+}
+
+void mock_disp_get_stat(MockDispStat *stat)
+{
+	pthread_mutex_lock( &g_DevMutex );
+	*stat = g_DispStat;
+	pthread_mutex_unlock( &g_DevMutex );
+}
+
+int mock_disp_busy(unsigned int addr)
+{
+	int busy;
+
+	pthread_mutex_lock( &g_DevMutex );
+	busy = (addr == g_ScanAddr || addr == g_PendAddr);
+	pthread_mutex_unlock( &g_DevMutex );
+	return busy;
+}
+
+void mock_disp_fail_overlay(int fail)
+{
+	g_FailOverlay = fail;
+}
+
+void mock_disp_set_fb_bpp(int bpp)
+{
+	g_FbBpp = (bpp == 16) ? 16 : 32;
+}
+
+/*--------------------------------------------------------------------------------------------
+ * heap : counted at the link, so the decoder needs no hook of its own
+ */
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+void __real_free(void *p);
+
+static void heap_add(long blocks, long bytes)
+{
+	__sync_fetch_and_add( &g_Heap.live_blocks, blocks );
+	__sync_fetch_and_add( &g_Heap.live_bytes, bytes );
+	__sync_fetch_and_add( &g_Heap.calls, 1 );
+}
+
+void *__wrap_malloc(size_t size)
+{
+	void *p = __real_malloc( size );
+
+	heap_add( p ? 1 : 0, p ? (long)malloc_usable_size( p ) : 0 );
+	return p;
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+	void *p = __real_calloc( n, size );
+
+	heap_add( p ? 1 : 0, p ? (long)malloc_usable_size( p ) : 0 );
+	return p;
+}
+
+void *__wrap_realloc(void *p, size_t size)
+{
+	long old = p ? (long)malloc_usable_size( p ) : 0;
+	void *q = __real_realloc( p, size );
+
+	if( q != NULL )
+		heap_add( p ? 0 : 1, (long)malloc_usable_size( q ) - old );
+	else if( p != NULL && size == 0 )
+		heap_add( -1, -old );
+	else
+		heap_add( 0, 0 );
+	return q;
+}
+
+void __wrap_free(void *p)
+{
+	if( p != NULL )
+		heap_add( -1, -(long)malloc_usable_size( p ) );
+	else
+		heap_add( 0, 0 );
+	__real_free( p );
+}
+
+void mock_heap_get_stat(MockHeapStat *stat)
+{
+	stat->live_blocks = __sync_fetch_and_add( &g_Heap.live_blocks, 0 );
+	stat->live_bytes = __sync_fetch_and_add( &g_Heap.live_bytes, 0 );
+	stat->calls = __sync_fetch_and_add( &g_Heap.calls, 0 );
+}
+
+int mock_fd_count(void)
+{
+	DIR *dir = opendir( "/proc/self/fd" );
+	struct dirent *ent;
+	int n = 0;
+
+	if( dir == NULL )
+		return -1;
+	while( (ent = readdir( dir )) != NULL )
+	{
+		if( ent->d_name[0] != '.' )
+			n++;
+	}
+	closedir( dir );
+	return n - 1;	//the directory itself
+}
+
+/*--------------------------------------------------------------------------------------------
+ * the decoder keeps addresses in unsigned int : heap from brk of a non-PIE binary, buffers MAP_32BIT
+ */
+void mock_init(void)
+{
+	mallopt( M_MMAP_MAX, 0 );
+	mallopt( M_ARENA_MAX, 1 );
+}
+
+void *mock_alloc32(int size)
+{
+	void *p = mmap( NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0 );
+
+	return (p == MAP_FAILED) ? NULL : p;
+}
+
+void mock_free32(void *p, int size)
+{
+	if( p != NULL )
+		munmap( p, (size_t)size );
+}
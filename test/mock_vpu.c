@@ -0,0 +1,434 @@
+//********************************************************************************************
+/**
+ * @file        mock_vpu.c
+ * @brief		Host stand-in for the VPU library : decodes the generated H.264 headers only, frame buffers in user memory.
+ * 				This interface contain : vdec_vpu, Instance alloc/release, Bitstream buffer, Mock VPU stat.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vdec_v1.h>
+
+#include "vdec_mock.h"
+
+#define MOCK_INSTANCES		4
+#define MOCK_MIN_FB			2		/* reference + the picture being decoded */
+#define MOCK_MAX_FB			32
+#define MOCK_BS_SIZE		(1024 * 1024)
+
+typedef struct _MockInst {
+	int				used;
+	int				opened;
+	int				seq_done;
+	int				additional;
+	int				nbuf;
+	int				fb_size;
+	unsigned char	*fb[MOCK_MAX_FB];
+	unsigned int	disp;			//handed out for display, until VDEC_BUF_FLAG_CLEAR
+	int				ref;
+	init_info_t		info;
+	unsigned char	*bs;
+} MockInst;
+
+static MockInst g_Inst[MOCK_INSTANCES];
+static MockVpuStat g_VpuStat;
+static int g_DecodeUs = 0;
+
+/*--------------------------------------------------------------------------------------------
+ * bitstream
+ */
+typedef struct _BitReader {
+	const unsigned char *p;
+	int		size;
+	int		pos;		//byte
+	int		bit;		//0..7 from the msb
+	int		zeros;		//00 bytes in a row, for the emulation prevention bytes
+} BitReader;
+
+static int br_u1(BitReader *br)
+{
+	int v;
+
+	if( br->pos >= br->size )
+		return 0;
+	if( br->bit == 0 )
+	{
+		if( br->zeros >= 2 && br->p[br->pos] == 0x03 )
+		{
+			br->pos++;
+			br->zeros = 0;
+			if( br->pos >= br->size )
+				return 0;
+		}
+		br->zeros = (br->p[br->pos] == 0) ? br->zeros + 1 : 0;
+	}
+	v = (br->p[br->pos] >> (7 - br->bit)) & 1;
+	if( ++br->bit == 8 )
+	{
+		br->bit = 0;
+		br->pos++;
+	}
+	return v;
+}
+
+static unsigned int br_u(BitReader *br, int n)
+{
+	unsigned int v = 0;
+
+	while( n-- > 0 )
+		v = (v << 1) | br_u1( br );
+	return v;
+}
+
+static unsigned int br_ue(BitReader *br)
+{
+	int lz = 0;
+
+	while( br_u1( br ) == 0 && lz < 32 )
+		lz++;
+	return ((1u << lz) - 1) + br_u( br, lz );
+}
+
+/* next NAL after *pos : payload after the header byte in *nal / *len, NAL type returned, -1 at the end */
+static int next_nal(const unsigned char *p, int size, int *pos, const unsigned char **nal, int *len)
+{
+	int i = *pos;
+	int start;
+
+	while( i + 3 <= size && !(p[i] == 0 && p[i+1] == 0 && p[i+2] == 1) )
+		i++;
+	if( i + 3 >= size )
+		return -1;
+	start = i + 3;
+	i = start;
+	while( i + 3 <= size && !(p[i] == 0 && p[i+1] == 0 && (p[i+2] == 1 || (p[i+2] == 0 && i + 3 < size && p[i+3] == 1))) )
+		i++;
+	if( i + 3 > size )
+		i = size;
+	*pos = i;
+	*nal = p + start + 1;
+	*len = i - start - 1;
+	return p[start] & 0x1F;
+}
+
+static int parse_sps(const unsigned char *nal, int len, int *width, int *height)
+{
+	BitReader br = { nal, len, 0, 0, 0 };
+	unsigned int poc_type;
+
+	br_u( &br, 24 );		//profile, constraints, level
+	br_ue( &br );			//sps id
+	br_ue( &br );			//log2_max_frame_num_minus4
+	poc_type = br_ue( &br );
+	if( poc_type == 0 )
+		br_ue( &br );
+	else if( poc_type == 1 )
+		return -1;
+	br_ue( &br );			//max_num_ref_frames
+	br_u1( &br );			//gaps
+	*width = (br_ue( &br ) + 1) * 16;
+	*height = (br_ue( &br ) + 1) * 16;
+	if( *width > 4096 || *height > 4096 )
+		return -1;
+	return 0;
+}
+
+/* picture type of the first slice of the access unit, -1 : no slice */
+static int slice_type(const unsigned char *p, int size)
+{
+	const unsigned char *nal;
+	int pos = 0;
+	int len;
+	int type;
+
+	while( (type = next_nal( p, size, &pos, &nal, &len )) >= 0 )
+	{
+		BitReader br = { nal, len, 0, 0, 0 };
+
+		if( type == 5 )
+			return PIC_TYPE_I;
+		if( type != 1 )
+			continue;
+		br_ue( &br );		//first_mb_in_slice
+		switch( br_ue( &br ) % 5 )
+		{
+			case 2:
+			case 4:
+				return PIC_TYPE_I;
+			case 1:
+				return PIC_TYPE_B;
+			default:
+				return PIC_TYPE_P;
+		}
+	}
+	return -1;
+}
+
+/*--------------------------------------------------------------------------------------------
+ * frame buffers
+ */
+static void fb_free(MockInst *inst)
+{
+	int i;
+
+	if( inst->nbuf == 0 )
+		return;
+	for( i = 0; i < inst->nbuf; i++ )
+	{
+		if( mock_disp_busy( (unsigned int)(unsigned long)inst->fb[i] ) )
+			__sync_fetch_and_add( &g_VpuStat.busy_frees, 1 );
+		mock_free32( inst->fb[i], inst->fb_size );
+	}
+	inst->nbuf = 0;
+	inst->disp = 0;
+	inst->ref = -1;
+	__sync_fetch_and_sub( &g_VpuStat.fb_maps, 1 );
+}
+
+static int fb_alloc(MockInst *inst, int width, int height)
+{
+	int i;
+
+	inst->nbuf = MOCK_MIN_FB + inst->additional;
+	if( inst->nbuf > MOCK_MAX_FB )
+		inst->nbuf = MOCK_MAX_FB;
+	inst->fb_size = width * height * 3 / 2;
+	for( i = 0; i < inst->nbuf; i++ )
+	{
+		if( (inst->fb[i] = (unsigned char*)mock_alloc32( inst->fb_size )) == NULL )
+		{
+			while( i-- > 0 )
+				mock_free32( inst->fb[i], inst->fb_size );
+			inst->nbuf = 0;
+			return -VPU_NOT_ENOUGH_MEM;
+		}
+	}
+	inst->disp = 0;
+	inst->ref = -1;
+	g_VpuStat.nbuf = inst->nbuf;
+	__sync_fetch_and_add( &g_VpuStat.fb_maps, 1 );
+	return 0;
+}
+
+/*--------------------------------------------------------------------------------------------
+ * commands
+ */
+static int mock_seq_header(MockInst *inst, vdec_input_t *in, vdec_output_t *out)
+{
+	const unsigned char *nal;
+	int pos = 0;
+	int len;
+	int type;
+	int width, height;
+
+	__sync_fetch_and_add( &g_VpuStat.seq_headers, 1 );
+	while( (type = next_nal( in->m_pInp[VA], in->m_iInpLen, &pos, &nal, &len )) >= 0 )
+	{
+		if( type == 7 )
+			break;
+	}
+	if( type != 7 || parse_sps( nal, len, &width, &height ) < 0 )
+		return -1;
+
+	fb_free( inst );
+	if( fb_alloc( inst, width, height ) < 0 )
+		return -VPU_NOT_ENOUGH_MEM;
+
+	memset( &inst->info, 0, sizeof(init_info_t) );
+	inst->info.m_iPicWidth = width;
+	inst->info.m_iPicHeight = height;
+	inst->info.m_iMinFrameBufferCount = MOCK_MIN_FB;
+	out->m_pInitialInfo = &inst->info;
+	inst->seq_done = 1;
+	return 0;
+}
+
+static int mock_decode(MockInst *inst, vdec_input_t *in, vdec_output_t *out)
+{
+	dec_out_info_t *info = &out->m_DecOutInfo;
+	int type;
+	int idx;
+
+	memset( info, 0, sizeof(dec_out_info_t) );
+	info->m_iDecodedIdx = -1;
+	info->m_iDispOutIdx = -1;
+	if( !inst->seq_done )
+		return -1;
+
+	__sync_fetch_and_add( &g_VpuStat.decodes, 1 );
+	if( g_DecodeUs > 0 )
+		usleep( g_DecodeUs );
+
+	info->m_iConsumedBytes = in->m_iInpLen;
+	info->m_iWidth = inst->info.m_iPicWidth;
+	info->m_iHeight = inst->info.m_iPicHeight;
+	if( (type = slice_type( in->m_pInp[VA], in->m_iInpLen )) < 0 )
+		return 0;
+
+	// I-frame search and skip modes drop the picture without touching a buffer
+	if( (in->m_iFrameSearchEnable && type != PIC_TYPE_I)
+		|| (in->m_iSkipFrameMode == VDEC_SKIP_FRAME_EXCEPT_I && type != PIC_TYPE_I)
+		|| (in->m_iSkipFrameMode == VDEC_SKIP_FRAME_ONLY_B && type == PIC_TYPE_B) )
+	{
+		info->m_iDecodingStatus = VPU_DEC_SUCCESS;
+		info->m_iDecodedIdx = -2;
+		return 0;
+	}
+
+	for( idx = 0; idx < inst->nbuf; idx++ )
+	{
+		if( !(inst->disp & (1u << idx)) && idx != inst->ref )
+			break;
+	}
+	if( idx == inst->nbuf )
+	{
+		__sync_fetch_and_add( &g_VpuStat.buf_full, 1 );
+		info->m_iDecodingStatus = VPU_DEC_BUF_FULL;
+		return 0;
+	}
+
+	if( mock_disp_busy( (unsigned int)(unsigned long)inst->fb[idx] ) )
+		__sync_fetch_and_add( &g_VpuStat.tears, 1 );
+	memset( inst->fb[idx], 0x10 + (g_VpuStat.decodes & 0x7F), 64 );
+
+	if( type != PIC_TYPE_B )
+		inst->ref = idx;
+	inst->disp |= (1u << idx);
+	__sync_fetch_and_add( &g_VpuStat.frames_out, 1 );
+
+	info->m_iPicType = type;
+	info->m_iPictureStructure = 3;
+	info->m_iM2vProgressiveFrame = 1;
+	info->m_iDecodingStatus = VPU_DEC_SUCCESS;
+	info->m_iOutputStatus = VPU_DEC_OUTPUT_SUCCESS;
+	info->m_iDecodedIdx = idx;
+	info->m_iDispOutIdx = idx;
+	out->m_pDispOut[PA][0] = out->m_pDispOut[VA][0] = inst->fb[idx];
+	out->m_pDispOut[PA][1] = out->m_pDispOut[VA][1] = inst->fb[idx] + inst->info.m_iPicWidth * inst->info.m_iPicHeight;
+	out->m_pDispOut[PA][2] = out->m_pDispOut[VA][2] = out->m_pDispOut[VA][1];
+	out->m_pInitialInfo = &inst->info;
+	return 0;
+}
+
+int vdec_vpu(int cmd, int *handle, void *param1, void *param2, void *instance)
+{
+	MockInst *inst = (MockInst*)instance;
+	unsigned int idx;
+
+	if( inst == NULL || !inst->used )
+		return -1;
+
+	switch( cmd )
+	{
+		case VDEC_INIT:
+			if( inst->opened )
+				return -1;
+			inst->opened = 1;
+			inst->seq_done = 0;
+			__sync_fetch_and_add( &g_VpuStat.opened, 1 );
+			return 0;
+
+		case VDEC_DEC_SEQ_HEADER:
+			if( !inst->opened )
+				return -1;
+			return mock_seq_header( inst, (vdec_input_t*)param1, (vdec_output_t*)param2 );
+
+		case VDEC_DECODE:
+			if( !inst->opened )
+				return -1;
+			return mock_decode( inst, (vdec_input_t*)param1, (vdec_output_t*)param2 );
+
+		case VDEC_BUF_FLAG_CLEAR:
+			idx = *(unsigned int*)param1;
+			if( idx >= (unsigned int)inst->nbuf || !(inst->disp & (1u << idx)) )
+			{
+				__sync_fetch_and_add( &g_VpuStat.bad_clears, 1 );
+				return 0;
+			}
+			if( mock_disp_busy( (unsigned int)(unsigned long)inst->fb[idx] ) )
+				__sync_fetch_and_add( &g_VpuStat.busy_clears, 1 );
+			inst->disp &= ~(1u << idx);
+			return 0;
+
+		case VDEC_CLOSE:
+			if( !inst->opened )
+				return -1;
+			fb_free( inst );
+			inst->opened = 0;
+			inst->seq_done = 0;
+			__sync_fetch_and_sub( &g_VpuStat.opened, 1 );
+			return 0;
+
+		default:
+			return -1;
+	}
+}
+
+void *vdec_alloc_instance(int format, int index)
+{
+	int i;
+
+	for( i = 0; i < MOCK_INSTANCES; i++ )
+	{
+		if( g_Inst[i].used )
+			continue;
+		memset( &g_Inst[i], 0, sizeof(MockInst) );
+		if( (g_Inst[i].bs = (unsigned char*)mock_alloc32( MOCK_BS_SIZE )) == NULL )
+			return NULL;
+		g_Inst[i].used = 1;
+		g_Inst[i].ref = -1;
+		__sync_fetch_and_add( &g_VpuStat.instances, 1 );
+		return &g_Inst[i];
+	}
+	return NULL;
+}
+
+/* frame buffers of an instance released without VDEC_CLOSE stay mapped : fb_maps shows the leak */
+void vdec_release_instance(void *instance)
+{
+	MockInst *inst = (MockInst*)instance;
+
+	if( inst == NULL || !inst->used )
+		return;
+	mock_free32( inst->bs, MOCK_BS_SIZE );
+	inst->used = 0;
+	__sync_fetch_and_sub( &g_VpuStat.instances, 1 );
+}
+
+void vpu_set_additional_refframe_count(int count, void *instance)
+{
+	((MockInst*)instance)->additional = count;
+}
+
+unsigned char *vpu_getBitstreamBufAddr(int addr_type, void *instance)
+{
+	return ((MockInst*)instance)->bs;
+}
+
+void mock_vpu_get_stat(MockVpuStat *stat)
+{
+	*stat = g_VpuStat;
+}
+
+void mock_vpu_reset_stat(void)
+{
+	g_VpuStat.seq_headers = 0;
+	g_VpuStat.decodes = 0;
+	g_VpuStat.frames_out = 0;
+	g_VpuStat.buf_full = 0;
+	g_VpuStat.bad_clears = 0;
+	g_VpuStat.tears = 0;
+	g_VpuStat.busy_clears = 0;
+	g_VpuStat.busy_frees = 0;
+}
+
+void mock_vpu_set_decode_us(int us)
+{
+	g_DecodeUs = us;
+}
@@ -0,0 +1,272 @@
+//********************************************************************************************
+/**
+ * @file        rtp_loopback.c
+ * @brief		RTP depacketizer over a loopback UDP socket : generated H.264 packetized as single NAL, STAP-A and FU-A,
+ * 				sent in order, reordered, with a loss and across a sender restart, received into tcc_rtp_depack_push().
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "tcc_vdec_api.h"
+#include "tcc_disp_sink.h"
+#include "tcc_rtp_depack.h"
+#include "vdec_mock.h"
+
+#define LOOP_AUS			90			/* three GOPs per case */
+#define LOOP_GOP			30
+#define LOOP_MAX_PACKETS	4096
+#define LOOP_PAYLOAD		1000		/* FU-A fragment size, smaller NAL units go as they are */
+#define LOOP_PT				96
+
+typedef struct _Packet {
+	unsigned char	data[RTP_MAX_PACKET];
+	int				len;
+	int				au;			//access unit the packet belongs to
+} Packet;
+
+static Packet g_Pkt[LOOP_MAX_PACKETS];
+static int g_PktCnt = 0;
+static int g_Tx = -1, g_Rx = -1;
+static struct sockaddr_in g_RxAddr;
+
+static void rtp_header(Packet *pkt, uint16_t seq, uint32_t ts, int marker)
+{
+	pkt->data[0] = 0x80;
+	pkt->data[1] = (unsigned char)((marker ? 0x80 : 0) | LOOP_PT);
+	pkt->data[2] = (unsigned char)(seq >> 8);
+	pkt->data[3] = (unsigned char)seq;
+	pkt->data[4] = (unsigned char)(ts >> 24);
+	pkt->data[5] = (unsigned char)(ts >> 16);
+	pkt->data[6] = (unsigned char)(ts >> 8);
+	pkt->data[7] = (unsigned char)ts;
+	memset( pkt->data + 8, 0x5A, 4 );	//SSRC
+	pkt->len = 12;
+}
+
+/* NAL units of an Annex-B access unit, 4 byte start codes as stream_gen writes them */
+static int split_nals(const unsigned char *au, int size, const unsigned char **nal, int *len, int max)
+{
+	int n = 0, i;
+
+	for( i = 0; i + 4 <= size && n < max; i++ )
+	{
+		if( au[i] == 0 && au[i+1] == 0 && au[i+2] == 0 && au[i+3] == 1 )
+		{
+			if( n > 0 )
+				len[n-1] = (int)(au + i - nal[n-1]);
+			nal[n++] = au + i + 4;
+			i += 3;
+		}
+	}
+	if( n > 0 )
+		len[n-1] = (int)(au + size - nal[n-1]);
+	return n;
+}
+
+/* SPS + PPS in one STAP-A, slices as single NAL units or FU-A fragments, marker on the last packet */
+static void packetize(const StreamGen *gen, int au, uint16_t *seq, uint32_t ts_base)
+{
+	const unsigned char *nal[8];
+	int len[8];
+	uint32_t ts = ts_base + gen->pts_ms * RTP_CLOCK_KHZ;
+	int n, i, off;
+	Packet *pkt;
+
+	n = split_nals( gen->au, gen->size, nal, len, 8 );
+	i = 0;
+	if( n >= 3 && (nal[0][0] & 0x1F) == 7 && (nal[1][0] & 0x1F) == 8 )
+	{
+		pkt = &g_Pkt[g_PktCnt++];
+		rtp_header( pkt, (*seq)++, ts, 0 );
+		pkt->data[pkt->len++] = 0x60 | 24;
+		for( ; i < 2; i++ )
+		{
+			pkt->data[pkt->len++] = (unsigned char)(len[i] >> 8);
+			pkt->data[pkt->len++] = (unsigned char)len[i];
+			memcpy( pkt->data + pkt->len, nal[i], len[i] );
+			pkt->len += len[i];
+		}
+		pkt->au = au;
+	}
+	for( ; i < n; i++ )
+	{
+		if( len[i] <= LOOP_PAYLOAD )
+		{
+			pkt = &g_Pkt[g_PktCnt++];
+			rtp_header( pkt, (*seq)++, ts, i == n - 1 );
+			memcpy( pkt->data + pkt->len, nal[i], len[i] );
+			pkt->len += len[i];
+			pkt->au = au;
+			continue;
+		}
+		for( off = 1; off < len[i]; off += LOOP_PAYLOAD )
+		{
+			int chunk = (len[i] - off < LOOP_PAYLOAD) ? len[i] - off : LOOP_PAYLOAD;
+			int last = (off + chunk == len[i]);
+
+			pkt = &g_Pkt[g_PktCnt++];
+			rtp_header( pkt, (*seq)++, ts, last && i == n - 1 );
+			pkt->data[pkt->len++] = (nal[i][0] & 0xE0) | 28;
+			pkt->data[pkt->len++] = (unsigned char)((off == 1 ? 0x80 : 0) | (last ? 0x40 : 0) | (nal[i][0] & 0x1F));
+			memcpy( pkt->data + pkt->len, nal[i] + off, chunk );
+			pkt->len += chunk;
+			pkt->au = au;
+		}
+	}
+}
+
+/* appends 'aus' access units of a new stream, sequence numbers from 'seq' */
+static void make_packets(int aus, uint16_t seq, uint32_t ts_base, unsigned int seed)
+{
+	StreamGen gen;
+	int i;
+
+	gen_init( &gen, 176, 144, LOOP_GOP, 0, seed );
+	for( i = 0; i < aus; i++ )
+	{
+		gen_next( &gen );
+		packetize( &gen, i, &seq, ts_base );
+	}
+	gen_free( &gen );
+}
+
+/* every packet through the socket in the order of 'order' (NULL : as built), -1 entries are not sent */
+static void run(RtpDepack *rtp, const int *order, int cnt)
+{
+	unsigned char buf[RTP_MAX_PACKET];
+	VdecEvent ev;
+	int i, n;
+
+	for( i = 0; i < cnt; i++ )
+	{
+		const Packet *pkt = &g_Pkt[order ? order[i] : i];
+
+		if( order && order[i] < 0 )
+			continue;
+		// one datagram in flight : the loopback queue never overflows and keeps the order
+		if( sendto( g_Tx, pkt->data, pkt->len, 0, (struct sockaddr*)&g_RxAddr, sizeof(g_RxAddr) ) != pkt->len )
+		{
+			CHECK( 0, "sendto failed" );
+			return;
+		}
+		n = (int)recv( g_Rx, buf, sizeof(buf), 0 );
+		CHECK( n == pkt->len, "received %d bytes of %d", n, pkt->len );
+		tcc_rtp_depack_push( rtp, buf, n );
+		while( tcc_vdec_GetEvent( &ev ) == 0 )
+			;
+	}
+}
+
+static void report(const char *name, const RtpDepackStat *st)
+{
+	fprintf( stderr, "  %-8s : %u packets, %u lost, %u late, %u AUs, %u AUs dropped\n", name,
+			st->packets, st->lost, st->late, st->au, st->au_dropped );
+}
+
+int main(void)
+{
+	static int order[LOOP_MAX_PACKETS];
+	RtpDepackStat st;
+	RtpDepack *rtp;
+	socklen_t alen = sizeof(g_RxAddr);
+	int i, drop, first;
+
+	mock_init();
+	if( freopen( "/dev/null", "w", stdout ) == NULL )
+		return 1;
+	tcc_vdec_SetDisplaySink( tcc_disp_sink_null() );
+	tcc_vdec_open();
+	tcc_vdec_init( 0, 0, MOCK_FB_WIDTH, MOCK_FB_HEIGHT );
+
+	g_Rx = socket( AF_INET, SOCK_DGRAM, 0 );
+	g_Tx = socket( AF_INET, SOCK_DGRAM, 0 );
+	memset( &g_RxAddr, 0, sizeof(g_RxAddr) );
+	g_RxAddr.sin_family = AF_INET;
+	g_RxAddr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+	if( g_Rx < 0 || g_Tx < 0 || bind( g_Rx, (struct sockaddr*)&g_RxAddr, sizeof(g_RxAddr) ) < 0
+		|| getsockname( g_Rx, (struct sockaddr*)&g_RxAddr, &alen ) < 0 )
+	{
+		fprintf( stderr, "rtp_loopback : no loopback UDP socket\n" );
+		return 1;
+	}
+
+	// in order, across the 16 bit sequence wrap
+	g_PktCnt = 0;
+	make_packets( LOOP_AUS, 65500, 1000, 1 );
+	rtp = tcc_rtp_depack_create( 0 );
+	run( rtp, NULL, g_PktCnt );
+	tcc_rtp_depack_get_stat( rtp, &st );
+	report( "in order", &st );
+	CHECK( st.au == LOOP_AUS && st.lost == 0 && st.late == 0 && st.au_dropped == 0, "in order" );
+	tcc_rtp_depack_destroy( rtp );
+
+	// neighbours swapped and one packet held back by half the jitter depth : all of it comes out in order
+	g_PktCnt = 0;
+	make_packets( LOOP_AUS, 100, 5000, 2 );
+	for( i = 0; i < g_PktCnt; i++ )
+		order[i] = i;
+	for( i = 10; i + 1 < g_PktCnt; i += 7 )
+	{
+		int t = order[i];
+		order[i] = order[i+1];
+		order[i+1] = t;
+	}
+	for( i = 0; i < RTP_JITTER_DEPTH / 2; i++ )
+		order[40 + i] = 41 + i;
+	order[40 + RTP_JITTER_DEPTH / 2] = 40;
+	rtp = tcc_rtp_depack_create( 0 );
+	run( rtp, order, g_PktCnt );
+	tcc_rtp_depack_get_stat( rtp, &st );
+	report( "reorder", &st );
+	CHECK( st.au == LOOP_AUS && st.lost == 0 && st.late == 0, "reordered within the jitter depth" );
+	tcc_rtp_depack_destroy( rtp );
+
+	// a packet inside a picture never arrives : that picture is dropped, nothing else
+	// (a whole lost picture would also cost the next one, its first packet may have been the lost one)
+	g_PktCnt = 0;
+	make_packets( LOOP_AUS, 2000, 9000, 3 );
+	for( drop = 1; drop + 1 < g_PktCnt; drop++ )
+	{
+		if( g_Pkt[drop].au >= LOOP_AUS / 2 && g_Pkt[drop-1].au == g_Pkt[drop].au && g_Pkt[drop+1].au == g_Pkt[drop].au )
+			break;
+	}
+	for( i = 0; i < g_PktCnt; i++ )
+		order[i] = (i == drop) ? -1 : i;
+	rtp = tcc_rtp_depack_create( 0 );
+	run( rtp, order, g_PktCnt );
+	tcc_rtp_depack_get_stat( rtp, &st );
+	report( "loss", &st );
+	CHECK( st.lost == 1 && st.au_dropped == 1 && st.au == LOOP_AUS - 1, "one packet lost" );
+	tcc_rtp_depack_destroy( rtp );
+
+	// the sender restarts with lower sequence numbers : resynchronized, not thrown away as late
+	g_PktCnt = 0;
+	make_packets( LOOP_AUS / 2, 30000, 20000, 4 );
+	first = g_PktCnt;
+	make_packets( LOOP_AUS, (uint16_t)(30000 - 1000), 700, 5 );
+	rtp = tcc_rtp_depack_create( 0 );
+	run( rtp, NULL, g_PktCnt );
+	tcc_rtp_depack_get_stat( rtp, &st );
+	report( "restart", &st );
+	// the picture being assembled at the jump is given up
+	CHECK( st.au >= LOOP_AUS / 2 + LOOP_AUS - 1, "%u AUs out of %d across the restart", st.au, LOOP_AUS / 2 + LOOP_AUS );
+	CHECK( st.late == 0, "%u packets after the restart dropped as late", st.late );
+	CHECK( st.packets == (unsigned int)g_PktCnt && first < g_PktCnt, "packets" );
+	tcc_rtp_depack_destroy( rtp );
+
+	close( g_Tx );
+	close( g_Rx );
+	tcc_vdec_close();
+
+	fprintf( stderr, "rtp_loopback : %s\n", g_CheckFail ? "FAIL" : "ok" );
+	return g_CheckFail ? 1 : 0;
+}
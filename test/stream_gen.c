@@ -0,0 +1,252 @@
+//********************************************************************************************
+/**
+ * @file        stream_gen.c
+ * @brief		H.264 Annex-B generator : valid SPS/PPS and slice headers, random slice data, PTS in display order.
+ * 				This interface contain : Init, Next access unit, Force IDR.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vdec_v1.h>
+
+#include "vdec_mock.h"
+
+#define GEN_PTS_BASE_MS		1000
+
+typedef struct _BitWriter {
+	unsigned char	buf[GEN_MAX_AU];
+	int				pos;
+	int				bit;
+} BitWriter;
+
+static void bw_init(BitWriter *bw)
+{
+	bw->pos = 0;
+	bw->bit = 0;
+	memset( bw->buf, 0, sizeof(bw->buf) );
+}
+
+static void bw_u(BitWriter *bw, unsigned int v, int n)
+{
+	while( n-- > 0 )
+	{
+		if( (v >> n) & 1 )
+			bw->buf[bw->pos] |= (unsigned char)(0x80 >> bw->bit);
+		if( ++bw->bit == 8 )
+		{
+			bw->bit = 0;
+			bw->pos++;
+		}
+	}
+}
+
+static void bw_ue(BitWriter *bw, unsigned int v)
+{
+	unsigned int x = v + 1;
+	int len = 0;
+
+	while( (x >> len) > 1 )
+		len++;
+	bw_u( bw, 0, len );
+	bw_u( bw, x, len + 1 );
+}
+
+static void bw_se(BitWriter *bw, int v)
+{
+	bw_ue( bw, v > 0 ? (unsigned int)(2 * v - 1) : (unsigned int)(-2 * v) );
+}
+
+static void bw_trailing(BitWriter *bw)
+{
+	bw_u( bw, 1, 1 );
+	if( bw->bit != 0 )
+	{
+		bw->bit = 0;
+		bw->pos++;
+	}
+}
+
+/* start code, NAL header and the RBSP with emulation prevention bytes */
+static void put_nal(StreamGen *gen, int header, const BitWriter *bw)
+{
+	unsigned char *out = gen->au + gen->size;
+	int zeros = 0;
+	int n = 0;
+	int i;
+
+	out[n++] = 0;
+	out[n++] = 0;
+	out[n++] = 0;
+	out[n++] = 1;
+	out[n++] = (unsigned char)header;
+	for( i = 0; i < bw->pos && gen->size + n < GEN_MAX_AU - 1; i++ )
+	{
+		if( zeros >= 2 && bw->buf[i] <= 3 )
+		{
+			out[n++] = 3;
+			zeros = 0;
+		}
+		out[n++] = bw->buf[i];
+		zeros = (bw->buf[i] == 0) ? zeros + 1 : 0;
+	}
+	gen->size += n;
+}
+
+static void put_sps(StreamGen *gen)
+{
+	BitWriter bw;
+
+	bw_init( &bw );
+	bw_u( &bw, 66, 8 );			//baseline
+	bw_u( &bw, 0xC0, 8 );
+	bw_u( &bw, 30, 8 );
+	bw_ue( &bw, 0 );			//sps id
+	bw_ue( &bw, 0 );			//log2_max_frame_num_minus4
+	bw_ue( &bw, 2 );			//pic_order_cnt_type
+	bw_ue( &bw, 1 );			//max_num_ref_frames
+	bw_u( &bw, 0, 1 );			//gaps_in_frame_num_value_allowed_flag
+	bw_ue( &bw, gen->width / 16 - 1 );
+	bw_ue( &bw, gen->height / 16 - 1 );
+	bw_u( &bw, 1, 1 );			//frame_mbs_only_flag
+	bw_u( &bw, 1, 1 );			//direct_8x8_inference_flag
+	bw_u( &bw, 0, 1 );			//frame_cropping_flag
+	bw_u( &bw, 0, 1 );			//vui_parameters_present_flag
+	bw_trailing( &bw );
+	put_nal( gen, 0x67, &bw );
+}
+
+static void put_pps(StreamGen *gen)
+{
+	BitWriter bw;
+
+	bw_init( &bw );
+	bw_ue( &bw, 0 );			//pps id
+	bw_ue( &bw, 0 );			//sps id
+	bw_u( &bw, 0, 1 );			//entropy_coding_mode_flag
+	bw_u( &bw, 0, 1 );			//bottom_field_pic_order_in_frame_present_flag
+	bw_ue( &bw, 0 );			//num_slice_groups_minus1
+	bw_ue( &bw, 0 );			//num_ref_idx_l0_default_active_minus1
+	bw_ue( &bw, 0 );			//num_ref_idx_l1_default_active_minus1
+	bw_u( &bw, 0, 1 );			//weighted_pred_flag
+	bw_u( &bw, 0, 2 );			//weighted_bipred_idc
+	bw_se( &bw, 0 );			//pic_init_qp_minus26
+	bw_se( &bw, 0 );			//pic_init_qs_minus26
+	bw_se( &bw, 0 );			//chroma_qp_index_offset
+	bw_u( &bw, 1, 1 );			//deblocking_filter_control_present_flag
+	bw_u( &bw, 0, 1 );			//constrained_intra_pred_flag
+	bw_u( &bw, 0, 1 );			//redundant_pic_cnt_present_flag
+	bw_trailing( &bw );
+	put_nal( gen, 0x68, &bw );
+}
+
+static void put_slice(StreamGen *gen, int type, int idr, int frame_num)
+{
+	BitWriter bw;
+	int header;
+	int len;
+	int i;
+
+	bw_init( &bw );
+	bw_ue( &bw, 0 );			//first_mb_in_slice
+	bw_ue( &bw, type == PIC_TYPE_I ? 7 : (type == PIC_TYPE_P ? 5 : 6) );
+	bw_ue( &bw, 0 );			//pps id
+	bw_u( &bw, (unsigned int)frame_num, 4 );
+	if( idr )
+		bw_ue( &bw, (unsigned int)(gen->pic & 0xFF) );
+	if( type == PIC_TYPE_B )
+		bw_u( &bw, 1, 1 );		//direct_spatial_mv_pred_flag
+	if( type != PIC_TYPE_I )
+	{
+		bw_u( &bw, 0, 1 );		//num_ref_idx_active_override_flag
+		bw_u( &bw, 0, 1 );		//ref_pic_list_modification_flag_l0
+		if( type == PIC_TYPE_B )
+			bw_u( &bw, 0, 1 );
+	}
+	if( type != PIC_TYPE_B )
+		bw_u( &bw, 0, idr ? 2 : 1 );	//dec_ref_pic_marking
+	bw_se( &bw, 0 );			//slice_qp_delta
+	bw_ue( &bw, 1 );			//disable_deblocking_filter_idc
+	bw_trailing( &bw );
+
+	// slice data : no 00 00 in it, so no start code emulation either
+	if( type == PIC_TYPE_I )
+		len = 2000 + rand_r( &gen->seed ) % 1500;
+	else if( type == PIC_TYPE_P )
+		len = 300 + rand_r( &gen->seed ) % 1000;
+	else
+		len = 100 + rand_r( &gen->seed ) % 400;
+	if( len > GEN_MAX_AU - 256 - bw.pos )
+		len = GEN_MAX_AU - 256 - bw.pos;
+	for( i = 0; i < len; i++ )
+		bw.buf[bw.pos++] = (unsigned char)(0x80 | rand_r( &gen->seed ));
+
+	header = idr ? 0x65 : (type == PIC_TYPE_B ? 0x01 : 0x41);
+	put_nal( gen, header, &bw );
+}
+
+void gen_init(StreamGen *gen, int width, int height, int gop, int bframes, unsigned int seed)
+{
+	memset( gen, 0, sizeof(StreamGen) );
+	gen->width = width;
+	gen->height = height;
+	gen->bframes = bframes;
+	// whole groups of one P and its B pictures after the IDR
+	gen->gop = ((gop - 1 + bframes) / (bframes + 1)) * (bframes + 1) + 1;
+	gen->frame_ms = 33;
+	gen->seed = seed;
+	gen->au = (unsigned char*)mock_alloc32( GEN_MAX_AU );
+}
+
+void gen_free(StreamGen *gen)
+{
+	mock_free32( gen->au, GEN_MAX_AU );
+	gen->au = NULL;
+}
+
+void gen_force_idr(StreamGen *gen)
+{
+	int n = gen->pic % gen->gop;
+
+	if( n != 0 )
+		gen->pic += gen->gop - n;
+}
+
+void gen_next(StreamGen *gen)
+{
+	int n = gen->pic % gen->gop;
+	int base = gen->pic - n;
+	int disp;
+	int type;
+
+	gen->size = 0;
+	if( n == 0 )
+	{
+		type = PIC_TYPE_I;
+		disp = 0;
+		gen->frame_num = 0;
+		put_sps( gen );
+		put_pps( gen );
+	}
+	else if( (n - 1) % (gen->bframes + 1) == 0 )
+	{
+		type = PIC_TYPE_P;
+		disp = n + gen->bframes;
+		gen->frame_num = (gen->frame_num + 1) & 0xF;
+	}
+	else
+	{
+		// a B picture follows the P that comes after it in display order
+		type = PIC_TYPE_B;
+		disp = n - 1;
+	}
+	put_slice( gen, type, n == 0, type == PIC_TYPE_B ? ((gen->frame_num + 1) & 0xF) : gen->frame_num );
+
+	gen->type = type;
+	gen->pts_ms = GEN_PTS_BASE_MS + (unsigned int)((base + disp) * gen->frame_ms);
+	gen->pic++;
+}
@@ -0,0 +1,236 @@
+//********************************************************************************************
+/**
+ * @file        vdec_bench.c
+ * @brief		Throughput of the decode paths against the mock VPU : what the library adds around VDEC_DECODE.
+ * 				This interface contain : Per-call against batch submission, Steady against generic decode path,
+ * 				Frame buffer render kernels.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tcc_vdec_api.h"
+#include "tcc_vpudec_intf.h"
+#include "tcc_disp_sink.h"
+#include "tcc_fb_render.h"
+#include "vdec_mock.h"
+
+#define BENCH_AUS			3000
+#define BENCH_BATCH			32
+#define BENCH_PASSES		10		/* over the stream per run */
+#define BENCH_RUNS			25		/* best of, the modes taking turns : the host is not quiet */
+#define BENCH_FRAMES		50		/* frames per render kernel and run */
+#define BENCH_SRC_STRIDE	1280
+#define BENCH_SRC_HEIGHT	720
+
+static VdecAU g_Au[BENCH_AUS];
+static VdecAUResult g_Result[BENCH_BATCH];
+static unsigned char *g_Pool = NULL;
+static unsigned char *g_SrcY = NULL;
+static unsigned char *g_SrcUV = NULL;
+
+/* one software render case on the 800x480 frame buffer of the mock */
+typedef struct _RenderCase {
+	const char	*name;
+	int			src_w, src_h;
+	int			dst_x, dst_y, dst_w, dst_h;
+	int			move;		//window moves every frame : the letterbox is redrawn each time
+} RenderCase;
+
+static const RenderCase g_Render[] = {
+	{ "1:1 800x480",             800,  480,   0,  0, 800, 480, 0 },
+	{ "up 320x240 -> 800x480",   320,  240,   0,  0, 800, 480, 0 },
+	{ "down 1280x720 -> 800x450", 1280, 720,  0, 15, 800, 450, 0 },
+	{ "letterbox 640x360 moving", 640,  360, 80, 60, 640, 360, 1 },
+	{ "clipped 1280x720 half off", 1280, 720, -400, 0, 800, 450, 0 },
+};
+#define RENDER_CASES		((int)(sizeof(g_Render) / sizeof(g_Render[0])))
+
+/* the same cases on each frame buffer format */
+static const int g_RenderBpp[] = { 32, 16 };
+#define RENDER_FORMATS		((int)(sizeof(g_RenderBpp) / sizeof(g_RenderBpp[0])))
+static long long g_RenderBest[RENDER_FORMATS][RENDER_CASES];
+
+/* CPU time of the calling thread : preemption and the library's own threads stay out of the numbers */
+static long long cpu_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_THREAD_CPUTIME_ID, &ts );
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* the whole stream up front and below 4GB, so that only the decoder is timed */
+static void make_stream(void)
+{
+	StreamGen gen;
+	int i;
+
+	g_Pool = (unsigned char*)mock_alloc32( BENCH_AUS * GEN_MAX_AU );
+	gen_init( &gen, 320, 240, 30, 0, 1 );
+	for( i = 0; i < BENCH_AUS; i++ )
+	{
+		gen_next( &gen );
+		g_Au[i].data = g_Pool + i * GEN_MAX_AU;
+		g_Au[i].size = gen.size;
+		g_Au[i].pts_ms = gen.pts_ms;
+		g_Au[i].flags = 0;
+		memcpy( g_Au[i].data, gen.au, gen.size );
+	}
+	gen_free( &gen );
+}
+
+/* microseconds of BENCH_PASSES passes over the stream, batch = 0 : one tcc_vdec_process_pts() per AU */
+static long long run(int batch)
+{
+	long long t0, t1;
+	int p, i, n;
+
+	tcc_vdec_open();
+	tcc_vdec_init( 0, 0, MOCK_FB_WIDTH, MOCK_FB_HEIGHT );
+	tcc_vdec_SetViewFlag( 1 );
+
+	t0 = cpu_us();
+	for( p = 0; p < BENCH_PASSES; p++ )
+	{
+		if( batch == 0 )
+		{
+			for( i = 0; i < BENCH_AUS; i++ )
+				tcc_vdec_process_pts( g_Au[i].data, g_Au[i].size, g_Au[i].pts_ms );
+		}
+		else
+		{
+			for( i = 0; i < BENCH_AUS; i += n )
+			{
+				n = (BENCH_AUS - i < batch) ? BENCH_AUS - i : batch;
+				tcc_vdec_process_batch( &g_Au[i], g_Result, n );
+			}
+		}
+	}
+	t1 = cpu_us();
+
+	tcc_vdec_close();
+	return t1 - t0;
+}
+
+/* microseconds of BENCH_PASSES passes through tcc_vpudec_decode() alone. After the first picture CONTAINER_NONE takes
+ * DECODER_DEC_AvcSteady, CONTAINER_TS stays on DECODER_DEC_Generic : the per-frame path before the split */
+static long long run_path(int container_type)
+{
+	unsigned int in[4] = { 0 };
+	unsigned int out[16];
+	long long t0, t1;
+	int p, i;
+
+	tcc_vpudec_init_container( 800, 476, container_type );
+	t0 = cpu_us();
+	for( p = 0; p < BENCH_PASSES; p++ )
+	{
+		for( i = 0; i < BENCH_AUS; i++ )
+		{
+			in[0] = (unsigned int)g_Au[i].data;
+			in[1] = (unsigned int)g_Au[i].size;
+			in[2] = g_Au[i].pts_ms;
+			tcc_vpudec_decode( in, out );
+		}
+	}
+	t1 = cpu_us();
+	tcc_vpudec_close();
+	return t1 - t0;
+}
+
+/* microseconds of BENCH_FRAMES calls of tcc_fb_render_frame() */
+static long long run_render(const RenderCase *rc)
+{
+	long long t0, t1;
+	int f;
+
+	t0 = cpu_us();
+	for( f = 0; f < BENCH_FRAMES; f++ )
+	{
+		// two pages : four positions so that each page sees a new window every time
+		int shift = rc->move ? (f & 3) * 8 : 0;
+
+		tcc_fb_render_frame( g_SrcY, g_SrcUV, BENCH_SRC_STRIDE, 0, 0, rc->src_w, rc->src_h,
+							rc->dst_x + shift, rc->dst_y + shift, rc->dst_w, rc->dst_h );
+	}
+	t1 = cpu_us();
+	return t1 - t0;
+}
+
+static void keep_min(long long *min, long long t)
+{
+	if( *min < 0 || t < *min )
+		*min = t;
+}
+
+int main(void)
+{
+	long long per_call = -1, batched = -1, steady = -1, generic = -1;
+	double aus = (double)BENCH_AUS * BENCH_PASSES;
+	int r, k, f;
+
+	mock_init();
+	// the decoder logs every picture
+	if( freopen( "/dev/null", "w", stdout ) == NULL )
+		return 1;
+	// decode only : the display path is not what is measured here
+	tcc_vdec_SetDisplaySink( tcc_disp_sink_null() );
+	make_stream();
+
+	// a gradient with some noise, so the converter sees every code path of the clamps
+	g_SrcY = (unsigned char*)malloc( BENCH_SRC_STRIDE * BENCH_SRC_HEIGHT );
+	g_SrcUV = (unsigned char*)malloc( BENCH_SRC_STRIDE * BENCH_SRC_HEIGHT / 2 );
+	if( g_SrcY == NULL || g_SrcUV == NULL )
+		return 1;
+	for( k = 0; k < BENCH_SRC_STRIDE * BENCH_SRC_HEIGHT; k++ )
+		g_SrcY[k] = (unsigned char)((k % BENCH_SRC_STRIDE) / 5 + (k * 7 & 15));
+	for( k = 0; k < BENCH_SRC_STRIDE * BENCH_SRC_HEIGHT / 2; k++ )
+		g_SrcUV[k] = (unsigned char)(64 + (k * 13 & 127));
+
+	for( r = 0; r < BENCH_RUNS; r++ )
+	{
+		keep_min( &per_call, run( 0 ) );
+		keep_min( &batched, run( BENCH_BATCH ) );
+		keep_min( &generic, run_path( CONTAINER_TS ) );
+		keep_min( &steady, run_path( CONTAINER_NONE ) );
+		for( f = 0; f < RENDER_FORMATS; f++ )
+		{
+			mock_disp_set_fb_bpp( g_RenderBpp[f] );
+			if( tcc_fb_render_open() != 0 )
+				return 1;
+			for( k = 0; k < RENDER_CASES; k++ )
+			{
+				if( r == 0 )
+					g_RenderBest[f][k] = -1;
+				keep_min( &g_RenderBest[f][k], run_render( &g_Render[k] ) );
+			}
+			tcc_fb_render_close();
+		}
+	}
+	mock_disp_set_fb_bpp( 32 );
+	fprintf( stderr, "vdec_bench : %d x %d AUs 320x240, CPU time of the caller, best of %d\n", BENCH_PASSES, BENCH_AUS, BENCH_RUNS );
+	fprintf( stderr, "  tcc_vdec_process_pts   : %6.2f us/AU\n", per_call / aus );
+	fprintf( stderr, "  tcc_vdec_process_batch : %6.2f us/AU (%d AUs per call), %.2fx\n", batched / aus, BENCH_BATCH,
+			batched ? (double)per_call / batched : 0.0 );
+	fprintf( stderr, "  generic decode path    : %6.2f us/AU\n", generic / aus );
+	fprintf( stderr, "  steady decode path     : %6.2f us/AU, %.2fx\n", steady / aus,
+			steady ? (double)generic / steady : 0.0 );
+	for( f = 0; f < RENDER_FORMATS; f++ )
+	{
+		fprintf( stderr, "  frame buffer render, %s :\n", (g_RenderBpp[f] == 16) ? "RGB565" : "ARGB8888" );
+		for( k = 0; k < RENDER_CASES; k++ )
+			fprintf( stderr, "    %-26s : %8.1f us/frame\n", g_Render[k].name, (double)g_RenderBest[f][k] / BENCH_FRAMES );
+	}
+
+	free( g_SrcY );
+	free( g_SrcUV );
+
+	mock_free32( g_Pool, BENCH_AUS * GEN_MAX_AU );
+	return 0;
+}
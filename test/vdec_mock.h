@@ -0,0 +1,117 @@
+//********************************************************************************************
+/**
+ * @file        vdec_mock.h
+ * @brief		Host stand-ins for the VPU, /dev/overlay and /dev/fb0, heap and fd counters, H.264 stream generator.
+ * 				This interface contain : Mock VPU stat, Mock display stat, Heap stat, Fd count, Stream generator.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+#ifndef	__VDEC_MOCK_H__
+#define	__VDEC_MOCK_H__
+
+/*--------------------------------------------------------------------------------------------
+ * VPU (vdec_vpu and friends, mock_vpu.c)
+ */
+typedef struct _MockVpuStat {
+	int				instances;		//vdec_alloc_instance - vdec_release_instance
+	int				opened;			//VDEC_INIT - VDEC_CLOSE
+	int				fb_maps;		//frame buffer sets mapped
+	unsigned int	seq_headers;
+	unsigned int	decodes;
+	unsigned int	frames_out;
+	unsigned int	buf_full;		//VDEC_DECODE without a free frame buffer
+	unsigned int	bad_clears;		//VDEC_BUF_FLAG_CLEAR of a buffer the VPU did not hand out
+	unsigned int	tears;			//decoded into a buffer the display scans or is about to latch
+	unsigned int	busy_clears;	//VDEC_BUF_FLAG_CLEAR of a buffer the display scans or is about to latch
+	unsigned int	busy_frees;		//frame buffer freed (VDEC_CLOSE) while the display scans or is about to latch it
+	int				nbuf;			//frame buffers of the last sequence header
+} MockVpuStat;
+
+void mock_vpu_get_stat(MockVpuStat *stat);
+void mock_vpu_reset_stat(void);
+/* extra time every VDEC_DECODE takes, 0 : none */
+void mock_vpu_set_decode_us(int us);
+
+/*--------------------------------------------------------------------------------------------
+ * display devices (mock_dev.c) : /dev/overlay and /dev/fb0 are served by the harness
+ */
+#define MOCK_FB_WIDTH		800
+#define MOCK_FB_HEIGHT		480
+#define MOCK_VSYNC_US		4000	/* shorter than a panel so the tests run fast */
+
+typedef struct _MockDispStat {
+	unsigned int	pushes;			//OVERLAY_PUSH_VIDEO_BUFFER
+	unsigned int	vsyncs;
+	unsigned int	pans;			//FBIOPAN_DISPLAY
+	int				open_fds;		//device fds the harness handed out and that are still open
+} MockDispStat;
+
+void mock_disp_get_stat(MockDispStat *stat);
+/* 1 : addr is scanned out or latched at the next vsync */
+int mock_disp_busy(unsigned int addr);
+/* /dev/overlay open fails while set */
+void mock_disp_fail_overlay(int fail);
+/* /dev/fb0 opened from now on : 32 ARGB8888 (default), 16 RGB565 */
+void mock_disp_set_fb_bpp(int bpp);
+
+/*--------------------------------------------------------------------------------------------
+ * heap (every malloc/calloc/realloc/free of the library goes through the wrappers) and fds
+ */
+typedef struct _MockHeapStat {
+	long			live_blocks;
+	long			live_bytes;
+	unsigned long	calls;			//malloc + calloc + realloc + free
+} MockHeapStat;
+
+void mock_heap_get_stat(MockHeapStat *stat);
+int mock_fd_count(void);
+
+/* keeps the heap and the test buffers below 4GB : the decoder passes addresses as unsigned int */
+void mock_init(void);
+void *mock_alloc32(int size);
+void mock_free32(void *p, int size);
+long long mock_now_us(void);
+
+/*--------------------------------------------------------------------------------------------
+ * H.264 Annex-B stream generator (stream_gen.c) : SPS/PPS + IDR, then P (and B) pictures
+ */
+#define GEN_MAX_AU		4096
+
+typedef struct _StreamGen {
+	int				width;
+	int				height;
+	int				gop;			//pictures per IDR
+	int				bframes;		//B pictures between references, PTS in display order
+	int				frame_ms;
+	unsigned int	seed;
+	int				pic;			//pictures generated
+	int				frame_num;
+	unsigned char	*au;			//GEN_MAX_AU bytes below 4GB
+	int				size;
+	unsigned int	pts_ms;
+	int				type;			//PIC_TYPE_I/P/B of the last AU
+} StreamGen;
+
+void gen_init(StreamGen *gen, int width, int height, int gop, int bframes, unsigned int seed);
+void gen_free(StreamGen *gen);
+/* next access unit in gen->au / gen->size / gen->pts_ms, an IDR carries SPS and PPS in front */
+void gen_next(StreamGen *gen);
+/* the next AU starts a new GOP */
+void gen_force_idr(StreamGen *gen);
+
+/*--------------------------------------------------------------------------------------------
+ * checks
+ */
+extern int g_CheckFail;
+
+#define CHECK(cond, fmt, ...)																\
+	do {																					\
+		if( !(cond) ) {																		\
+			fprintf( stderr, "FAIL %s:%d: %s : " fmt "\n", __FILE__, __LINE__, #cond, ##__VA_ARGS__ );	\
+			g_CheckFail++;																	\
+		}																					\
+	} while( 0 )
+
+#endif	// __VDEC_MOCK_H__
@@ -0,0 +1,544 @@
+//********************************************************************************************
+/**
+ * @file        vdec_service.c
+ * @brief		Decode service against clients that break the rules : malformed, oversize and wrapping ring records,
+ * 				hellos that carry fds but are otherwise bad, a live client that breaks its ring.
+ * 				The daemon runs in a thread of the test, every refused client must leave its fd count as it was.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+
+#include "tcc_vdec_api.h"
+#include "tcc_disp_sink.h"
+#include "tcc_vdec_shm.h"
+#include "tcc_vdec_client.h"
+#include "tcc_vdec_service.h"
+#include "vdec_mock.h"
+
+#define RING_SIZE		(64 * 1024)		/* smallest ring tcc_shm_attach takes */
+#define RING_BUF		(RING_SIZE / 2)	/* what the daemon copies a unit into */
+#define CANARY			0xA5
+#define CANARY_LEN		64
+
+static ShmHeader *g_Shm;
+static ShmReader g_Ring;
+static unsigned char g_Buf[RING_BUF + CANARY_LEN];
+static char g_Path[64];
+
+/*--------------------------------------------------------------------------------------------
+ * the ring on its own
+ */
+static int ring_reset(uint32_t pos)
+{
+	tcc_shm_init( g_Shm, RING_SIZE );
+	g_Shm->head = g_Shm->tail = pos;
+	memset( g_Buf, CANARY, sizeof(g_Buf) );
+	return tcc_shm_attach( &g_Ring, g_Shm, SHM_TOTAL_SIZE(RING_SIZE) );
+}
+
+/* a record header as a client could write it, anywhere in the ring */
+static void ring_put(uint32_t pos, uint32_t len)
+{
+	ShmRecord *rec = (ShmRecord*)(SHM_DATA(g_Shm) + (pos & (RING_SIZE - 1)));
+
+	memset( rec, 0x00, sizeof(ShmRecord) );
+	rec->len = len;
+}
+
+static int canary_ok(void)
+{
+	int i;
+
+	for( i = RING_BUF; i < RING_BUF + CANARY_LEN; i++ )
+	{
+		if( g_Buf[i] != CANARY )
+			return 0;
+	}
+	return 1;
+}
+
+static int peek(void)
+{
+	uint32_t len, pts_ms, flags;
+
+	return tcc_shm_peek( &g_Ring, g_Buf, RING_BUF, &len, &pts_ms, &flags );
+}
+
+/* lengths 0 .. a few KB, every fifth unit as long as the ring takes */
+static uint32_t unit_len(int i)
+{
+	return (i % 5 == 4) ? RING_BUF - sizeof(ShmRecord) : (uint32_t)(i * 7919) % 3000;
+}
+
+/* units of every size up to the limit, through the end of the ring and the 32 bit wrap of the positions */
+static void check_ring_wrap(void)
+{
+	static unsigned char unit[RING_BUF];
+	uint32_t len, pts_ms, flags, last;
+	int put = 0, got = 0, wraps = 0, ret, i;
+
+	CHECK( ring_reset( 0xFFFF0000 ) == 0, "attach" );
+	last = g_Ring.tail;
+	while( got < 400 )
+	{
+		// the client fills the ring, the daemon takes one unit, and so on
+		for( ; put < 400; put++ )
+		{
+			for( i = 0; i < (int)unit_len( put ); i++ )
+				unit[i] = (unsigned char)(put + i);
+			if( tcc_shm_write( g_Shm, unit, unit_len( put ), put, put * 3 ) < 0 )
+				break;
+		}
+
+		ret = tcc_shm_peek( &g_Ring, g_Buf, RING_BUF, &len, &pts_ms, &flags );
+		CHECK( ret == 1, "unit %d : peek %d", got, ret );
+		if( ret != 1 )
+			return;
+		CHECK( len == unit_len( got ) && pts_ms == (uint32_t)got && flags == (uint32_t)got * 3,
+				"unit %d : len %u pts %u flags %u", got, len, pts_ms, flags );
+		for( i = 0; i < (int)len; i++ )
+		{
+			if( g_Buf[i] != (unsigned char)(got + i) )
+			{
+				CHECK( 0, "unit %d : byte %d", got, i );
+				break;
+			}
+		}
+		tcc_shm_consume( &g_Ring, len );
+		if( (g_Ring.tail & (RING_SIZE - 1)) < (last & (RING_SIZE - 1)) )
+			wraps++;
+		last = g_Ring.tail;
+		got++;
+	}
+	CHECK( tcc_shm_peek( &g_Ring, g_Buf, RING_BUF, &len, &pts_ms, &flags ) == 0, "ring empty at the end" );
+	CHECK( g_Shm->tail == g_Shm->head && g_Ring.tail == g_Shm->tail, "positions" );
+	CHECK( wraps > 10 && g_Ring.tail < 0xFFFF0000, "%d wraps of the ring, tail %08x", wraps, g_Ring.tail );
+	CHECK( canary_ok(), "written past the unit buffer" );
+	CHECK( tcc_shm_write( g_Shm, unit, RING_BUF, 0, 0 ) < 0, "a unit that can never fit" );
+}
+
+/* every record a client can make up : refused, the daemon's tail where it was, nothing written past the buffer */
+static void check_ring_malformed(void)
+{
+	static const struct {
+		const char	*name;
+		uint32_t	pos;			//tail
+		uint32_t	len;			//record length at tail
+		uint32_t	avail;			//head - tail
+		uint32_t	next;			//record length after a wrap record
+	} bad[] = {
+		{ "head more than a ring ahead",	0,					16,					RING_SIZE + 16,	0 },
+		{ "head behind tail",				4096,				16,					0xFFFFFF00,		0 },
+		{ "longer than half the ring",		0,					RING_BUF + 1,		RING_SIZE,		0 },
+		{ "longer than the unit buffer",	0,					0xFFFFFFF0,			RING_SIZE,		0 },
+		{ "longer than the head covers",	0,					1000,				512,			0 },
+		{ "header only",					0,					1,					16,				0 },
+		{ "across the end of the ring",		RING_SIZE - 64,		100,				512,			0 },
+		{ "wrap with head before the end",	RING_SIZE - 64,		SHM_REC_WRAP,		32,				0 },
+		{ "oversize after a wrap",			RING_SIZE - 64,		SHM_REC_WRAP,		4096,			RING_BUF + 16 },
+		{ "wrap after a wrap",				RING_SIZE - 64,		SHM_REC_WRAP,		4096,			SHM_REC_WRAP },
+		{ "past head after a wrap",			RING_SIZE - 64,		SHM_REC_WRAP,		64 + 32,		100 },
+	};
+	unsigned int i;
+	uint32_t tail;
+
+	for( i = 0; i < sizeof(bad) / sizeof(bad[0]); i++ )
+	{
+		ring_reset( bad[i].pos );
+		ring_put( bad[i].pos, bad[i].len );
+		if( bad[i].len == SHM_REC_WRAP )
+			ring_put( 0, bad[i].next );
+		g_Shm->head = bad[i].pos + bad[i].avail;
+		tail = g_Ring.tail;
+
+		CHECK( peek() == -1, "%s : taken", bad[i].name );
+		// a wrap record itself is fine : only the record behind it is refused
+		if( bad[i].len != SHM_REC_WRAP || bad[i].avail < RING_SIZE - bad[i].pos )
+			CHECK( g_Ring.tail == tail && g_Shm->tail == tail, "%s : tail moved", bad[i].name );
+		CHECK( canary_ok(), "%s : written past the unit buffer", bad[i].name );
+	}
+
+	// the client rewrites a record between peek and consume : the daemon goes on with what it copied
+	ring_reset( 100 * 16 );
+	tcc_shm_write( g_Shm, g_Buf, 100, 0, 0 );
+	tcc_shm_write( g_Shm, g_Buf, 200, 0, 0 );
+	tail = g_Ring.tail;
+	CHECK( peek() == 1, "first unit" );
+	ring_put( tail, RING_BUF - 1 );
+	tcc_shm_consume( &g_Ring, 100 );
+	CHECK( g_Ring.tail == tail + sizeof(ShmRecord) + 112, "consume follows the copy, not the ring" );
+	CHECK( peek() == 1, "second unit after the rewrite" );
+
+	// whatever the client does to ev_tail, events land in the slots and the daemon's ev_head only moves on success
+	{
+		VdecEvent ev;
+		uint32_t ev_head;
+
+		memset( &ev, 0x00, sizeof(ev) );
+		ring_reset( 0 );
+		g_Shm->ev_tail = 0x80000000;
+		ev_head = g_Ring.ev_head;
+		tcc_shm_event_post( &g_Ring, &ev );
+		CHECK( g_Ring.ev_head == ev_head && g_Shm->ev_dropped == 1, "event with ev_tail far ahead" );
+		g_Shm->ev_tail = g_Ring.ev_head - SHM_EVENT_SLOTS;
+		tcc_shm_event_post( &g_Ring, &ev );
+		CHECK( g_Ring.ev_head == ev_head && g_Shm->ev_dropped == 2, "event with a full ring" );
+		g_Shm->ev_tail = g_Ring.ev_head;
+		g_Shm->ev_head = 12345;
+		tcc_shm_event_post( &g_Ring, &ev );
+		CHECK( g_Ring.ev_head == ev_head + 1 && g_Shm->ev_head == ev_head + 1, "event with ev_head rewritten" );
+	}
+}
+
+static void check_attach(void)
+{
+	ShmReader r;
+
+	tcc_shm_init( g_Shm, RING_SIZE );
+	CHECK( tcc_shm_attach( &r, g_Shm, SHM_TOTAL_SIZE(RING_SIZE) - 1 ) < 0, "mapping shorter than the ring" );
+	tcc_shm_init( g_Shm, RING_SIZE / 2 );
+	CHECK( tcc_shm_attach( &r, g_Shm, SHM_TOTAL_SIZE(RING_SIZE) ) < 0, "ring below the minimum" );
+	tcc_shm_init( g_Shm, RING_SIZE - 4096 );
+	CHECK( tcc_shm_attach( &r, g_Shm, SHM_TOTAL_SIZE(RING_SIZE) ) < 0, "ring not a power of two" );
+	tcc_shm_init( g_Shm, SHM_DATA_SIZE_MAX * 2 );
+	CHECK( tcc_shm_attach( &r, g_Shm, SHM_TOTAL_SIZE(RING_SIZE) ) < 0, "ring above the maximum" );
+	tcc_shm_init( g_Shm, RING_SIZE );
+	g_Shm->magic++;
+	CHECK( tcc_shm_attach( &r, g_Shm, SHM_TOTAL_SIZE(RING_SIZE) ) < 0, "magic" );
+	tcc_shm_init( g_Shm, RING_SIZE );
+	g_Shm->version++;
+	CHECK( tcc_shm_attach( &r, g_Shm, SHM_TOTAL_SIZE(RING_SIZE) ) < 0, "version" );
+}
+
+/*--------------------------------------------------------------------------------------------
+ * the daemon
+ */
+static void* service_thread(void *arg)
+{
+	tcc_vdec_service_run( g_Path );
+	return NULL;
+}
+
+static int service_connect(void)
+{
+	struct sockaddr_un addr;
+	struct timeval tv = { 2, 0 };
+	int fd;
+
+	fd = socket( AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0 );
+	memset( &addr, 0x00, sizeof(addr) );
+	addr.sun_family = AF_UNIX;
+	strcpy( addr.sun_path, g_Path );
+	if( fd < 0 || connect( fd, (struct sockaddr*)&addr, sizeof(addr) ) < 0 )
+	{
+		if( fd >= 0 )
+			close( fd );
+		return -1;
+	}
+	// a daemon that hangs fails the test instead of stalling it
+	setsockopt( fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv) );
+	return fd;
+}
+
+/* the daemon closes what it was given : back to base within a second or so */
+static int wait_fds(int base)
+{
+	int i, n = -1;
+
+	for( i = 0; i < 200; i++ )
+	{
+		n = mock_fd_count();
+		if( n == base )
+			break;
+		usleep( 5000 );
+	}
+	return n;
+}
+
+/* shm, data and event fds as tcc_vdec_client makes them, the ring header already written */
+static void make_fds(int *fds, uint32_t map_size, uint32_t data_size)
+{
+	ShmHeader *h;
+
+	fds[0] = memfd_create( "vdec_service", MFD_CLOEXEC );
+	if( fds[0] >= 0 && ftruncate( fds[0], map_size ) == 0 && map_size >= sizeof(ShmHeader) )
+	{
+		h = (ShmHeader*)mmap( NULL, sizeof(ShmHeader), PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0 );
+		if( h != MAP_FAILED )
+		{
+			tcc_shm_init( h, data_size );
+			munmap( h, sizeof(ShmHeader) );
+		}
+	}
+	fds[1] = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+	fds[2] = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+}
+
+/* msg_len bytes of msg with nfds fds on a connection of its own : 1 accepted (the socket in *sock), 0 refused */
+static int hello(const ServiceMsg *msg, int msg_len, const int *fds, int nfds, int *sock)
+{
+	ServiceReply reply;
+	struct msghdr mh;
+	struct iovec iov;
+	struct cmsghdr *cm;
+	char ctrl[CMSG_SPACE(8 * sizeof(int))];
+	int fd = service_connect();
+	ssize_t n;
+
+	*sock = -1;
+	if( fd < 0 )
+	{
+		CHECK( 0, "no daemon on %s", g_Path );
+		return 0;
+	}
+
+	memset( &mh, 0x00, sizeof(mh) );
+	memset( ctrl, 0x00, sizeof(ctrl) );
+	iov.iov_base = (void*)msg;
+	iov.iov_len = msg_len;
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	if( nfds > 0 )
+	{
+		mh.msg_control = ctrl;
+		mh.msg_controllen = CMSG_SPACE(nfds * sizeof(int));
+		cm = CMSG_FIRSTHDR( &mh );
+		cm->cmsg_level = SOL_SOCKET;
+		cm->cmsg_type = SCM_RIGHTS;
+		cm->cmsg_len = CMSG_LEN(nfds * sizeof(int));
+		memcpy( CMSG_DATA(cm), fds, nfds * sizeof(int) );
+	}
+	if( sendmsg( fd, &mh, MSG_NOSIGNAL ) != msg_len )
+	{
+		CHECK( 0, "sendmsg fail (%d)", errno );
+		close( fd );
+		return 0;
+	}
+
+	// refused : the daemon hangs up without a reply
+	n = recv( fd, &reply, sizeof(reply), 0 );
+	if( n == sizeof(reply) && reply.status == 0 )
+	{
+		*sock = fd;
+		return 1;
+	}
+	CHECK( n == 0, "no hang up (%d, errno %d)", (int)n, errno );
+	close( fd );
+	return 0;
+}
+
+static void close_fds(int *fds, int nfds)
+{
+	int i;
+
+	for( i = 0; i < nfds; i++ )
+	{
+		if( fds[i] >= 0 )
+			close( fds[i] );
+	}
+}
+
+static void check_bad_hellos(int base)
+{
+	enum { BAD_VERSION, BAD_SHORT, BAD_TYPE, BAD_TWO_FDS, BAD_SHM_SMALL, BAD_SHM_SHORT, BAD_SHM_PIPE,
+		BAD_MAGIC, BAD_DATA_SIZE, BAD_EVENT_PIPE, BAD_DATA_BLOCKING, BAD_CASES };
+	static const char *name[BAD_CASES] = { "version", "short message", "not a hello", "two fds", "shm smaller than a header",
+		"shm shorter than its ring", "shm fd is a pipe", "magic", "ring size", "event fd is a pipe", "blocking data fd" };
+	ServiceMsg msg;
+	int fds[8], pipe_fd[2];
+	int k, n, sock, nfds;
+
+	for( k = 0; k < BAD_CASES; k++ )
+	{
+		memset( &msg, 0x00, sizeof(msg) );
+		msg.type = SERVICE_MSG_HELLO;
+		msg.version = SHM_VERSION;
+		nfds = 3;
+		pipe_fd[0] = pipe_fd[1] = -1;
+
+		make_fds( fds, (k == BAD_SHM_SMALL) ? 64 : SHM_TOTAL_SIZE(RING_SIZE),
+				(k == BAD_SHM_SHORT) ? RING_SIZE * 2 : (k == BAD_DATA_SIZE) ? RING_SIZE + 4096 : RING_SIZE );
+		switch( k )
+		{
+			case BAD_VERSION:		msg.version = SHM_VERSION + 1;	break;
+			case BAD_TYPE:			msg.type = SERVICE_MSG_VIEW;	break;
+			case BAD_TWO_FDS:		close( fds[2] ); fds[2] = -1; nfds = 2;	break;
+			case BAD_MAGIC:
+			{
+				uint32_t magic = 0;
+
+				CHECK( pwrite( fds[0], &magic, sizeof(magic), 0 ) == sizeof(magic), "magic" );
+				break;
+			}
+			case BAD_SHM_PIPE:
+			case BAD_EVENT_PIPE:
+				CHECK( pipe( pipe_fd ) == 0, "pipe" );
+				close( fds[(k == BAD_SHM_PIPE) ? 0 : 2] );
+				fds[(k == BAD_SHM_PIPE) ? 0 : 2] = pipe_fd[1];
+				break;
+			case BAD_DATA_BLOCKING:
+				close( fds[1] );
+				fds[1] = eventfd( 0, EFD_CLOEXEC );
+				break;
+			default:
+				break;
+		}
+
+		n = hello( &msg, (k == BAD_SHORT) ? 8 : (int)sizeof(msg), fds, nfds, &sock );
+		CHECK( n == 0, "%s : accepted", name[k] );
+		if( sock >= 0 )
+			close( sock );
+		close_fds( fds, 3 );
+		if( pipe_fd[0] >= 0 )
+			close( pipe_fd[0] );
+		n = wait_fds( base );
+		CHECK( n == base, "%s : %d fds open, %d before", name[k], n, base );
+	}
+
+	// more fds than a hello takes : the rest is closed at once, and fds on later messages too
+	make_fds( fds, SHM_TOTAL_SIZE(RING_SIZE), RING_SIZE );
+	for( k = 3; k < 8; k++ )
+		fds[k] = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+	memset( &msg, 0x00, sizeof(msg) );
+	msg.type = SERVICE_MSG_HELLO;
+	msg.version = SHM_VERSION;
+	CHECK( hello( &msg, sizeof(msg), fds, 8, &sock ) == 1, "hello with extra fds refused" );
+	close_fds( fds, 8 );
+	if( sock >= 0 )
+	{
+		struct msghdr mh;
+		struct iovec iov;
+		struct cmsghdr *cm;
+		char ctrl[CMSG_SPACE(3 * sizeof(int))];
+
+		make_fds( fds, SHM_TOTAL_SIZE(RING_SIZE), RING_SIZE );
+		msg.type = SERVICE_MSG_VIEW;
+		memset( &mh, 0x00, sizeof(mh) );
+		memset( ctrl, 0x00, sizeof(ctrl) );
+		iov.iov_base = &msg;
+		iov.iov_len = sizeof(msg);
+		mh.msg_iov = &iov;
+		mh.msg_iovlen = 1;
+		mh.msg_control = ctrl;
+		mh.msg_controllen = sizeof(ctrl);
+		cm = CMSG_FIRSTHDR( &mh );
+		cm->cmsg_level = SOL_SOCKET;
+		cm->cmsg_type = SCM_RIGHTS;
+		cm->cmsg_len = CMSG_LEN(3 * sizeof(int));
+		memcpy( CMSG_DATA(cm), fds, 3 * sizeof(int) );
+		CHECK( sendmsg( sock, &mh, MSG_NOSIGNAL ) == sizeof(msg), "view with fds" );
+		close_fds( fds, 3 );
+		close( sock );
+	}
+	n = wait_fds( base );
+	CHECK( n == base, "extra fds : %d fds open, %d before", n, base );
+}
+
+/* a well behaved client through many ring wraps, then it writes an oversize record : dropped, nothing left open */
+static void check_broken_client(int base)
+{
+	VdecClient *c;
+	StreamGen gen;
+	MockVpuStat vs;
+	VdecEvent ev;
+	ShmRecord *rec;
+	unsigned int decodes;
+	struct timeval tv = { 2, 0 };
+	uint64_t one = 1;
+	char b;
+	int i, n;
+
+	mock_vpu_get_stat( &vs );
+	decodes = vs.decodes;
+
+	c = tcc_vdec_client_connect( g_Path, 0, RING_SIZE );
+	CHECK( c != NULL, "client refused" );
+	if( c == NULL )
+		return;
+	gen_init( &gen, 320, 240, 30, 0, 11 );
+	for( i = 0; i < 600; i++ )
+	{
+		gen_next( &gen );
+		for( n = 0; n < 1000 && tcc_vdec_client_push( c, gen.au, gen.size, gen.pts_ms ) < 0; n++ )
+			usleep( 1000 );
+		while( tcc_vdec_client_get_event( c, &ev ) == 0 )
+			;
+	}
+	gen_free( &gen );
+	for( n = 0; n < 1000 && c->shm->tail != c->shm->head; n++ )
+		usleep( 1000 );
+	mock_vpu_get_stat( &vs );
+	CHECK( c->shm->tail == c->shm->head, "ring not drained" );
+	CHECK( vs.decodes - decodes >= 600, "%u of 600 units decoded", vs.decodes - decodes );
+	CHECK( c->shm->head / RING_SIZE > 5, "ring went round %u times", c->shm->head / RING_SIZE );
+
+	// a record longer than the daemon's unit buffer, head covering it
+	rec = (ShmRecord*)(SHM_DATA(c->shm) + (c->shm->head & (RING_SIZE - 1)));
+	rec->len = RING_BUF + 16;
+	c->shm->head += 64;
+	CHECK( write( c->data_fd, &one, sizeof(one) ) == sizeof(one), "signal" );
+	setsockopt( c->sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv) );
+	CHECK( recv( c->sock, &b, 1, 0 ) == 0, "daemon kept a client with a broken ring" );
+	tcc_vdec_client_close( c );
+	n = wait_fds( base );
+	CHECK( n == base, "broken ring : %d fds open, %d before", n, base );
+}
+
+int main(void)
+{
+	pthread_t th;
+	int base, start, i, fd;
+
+	mock_init();
+	if( freopen( "/dev/null", "w", stdout ) == NULL )
+		return 1;
+
+	g_Shm = (ShmHeader*)malloc( SHM_TOTAL_SIZE(RING_SIZE) );
+	check_attach();
+	check_ring_wrap();
+	check_ring_malformed();
+	free( g_Shm );
+
+	tcc_vdec_SetDisplaySink( tcc_disp_sink_null() );
+	snprintf( g_Path, sizeof(g_Path), "/tmp/vdec_service.%d.sock", (int)getpid() );
+	// the decoder's event fd lives as long as the process, the daemon makes it on its start
+	tcc_vdec_GetEventFd();
+	start = mock_fd_count();
+	pthread_create( &th, NULL, service_thread, NULL );
+	for( i = 0; i < 200 && (fd = service_connect()) < 0; i++ )
+		usleep( 5000 );
+	if( fd < 0 )
+	{
+		fprintf( stderr, "vdec_service : daemon did not come up\n" );
+		return 1;
+	}
+	close( fd );
+	// the listening socket, epoll and the stop eventfd
+	base = wait_fds( start + 3 );
+
+	check_bad_hellos( base );
+	check_broken_client( base );
+
+	tcc_vdec_service_stop();
+	pthread_join( th, NULL );
+	i = wait_fds( start );
+	CHECK( i == start, "daemon gone : %d fds open, %d before", i, start );
+
+	fprintf( stderr, "vdec_service : %s\n", g_CheckFail ? "FAIL" : "ok" );
+	return g_CheckFail ? 1 : 0;
+}
@@ -0,0 +1,547 @@
+//********************************************************************************************
+/**
+ * @file        vdec_stress.c
+ * @brief		Randomized long-stream stress of the decoder error paths on the host stand-ins of the VPU and the display.
+ * 				Faults of every class, input loss, view toggles, resolution changes and close/open cycles, then
+ * 				recovery latency, frames lost and heap/fd/VPU handle leaks are checked.
+ *
+ * 				vdec_stress [seed] [cycles]
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <vdec_v1.h>
+
+#include "tcc_vdec_api.h"
+#include "vdec_mock.h"
+
+#define STRESS_CYCLES			8
+#define STRESS_AUS				600		/* per open/close cycle */
+#define STRESS_GOP				30
+#define STRESS_FEED_US			1000	/* input pacing : a 1000 fps source keeps the run short */
+
+/* a recovery waits for the next IDR at worst, a buffer-full burst runs first, a hang or two may land on top */
+#define STRESS_MAX_LOST_AUS		(MAX_CONSECUTIVE_VPU_BUFFER_FULL_COUNT + 2 + 2 * STRESS_GOP)
+#define STRESS_MAX_RECOVERY_MS	(3 * FAULT_HANG_MS + STRESS_MAX_LOST_AUS * STRESS_FEED_US / 1000 * 4)
+/* an injected hang is past the hard cap at every size : the stall ends with the first frame after the restore,
+ * the next IDR at worst. A fault landing on top may add another IDR search */
+#define STRESS_MAX_STALL_MS		(2 * FAULT_HANG_MS + STRESS_MAX_LOST_AUS * STRESS_FEED_US / 1000 * 4)
+
+static const int g_Sizes[][2] = { {176, 144}, {320, 240}, {480, 272}, {640, 368} };
+
+typedef struct _StressResult {
+	unsigned int	aus;
+	unsigned int	frames;
+	unsigned int	injected;
+	unsigned int	recoveries;
+	unsigned int	max_recovery_ms;
+	unsigned int	sum_recovery_ms;
+	unsigned int	max_lost;
+	unsigned int	sum_lost;
+	unsigned int	events;
+
+	unsigned int	stalls;				//watchdog : counters seen last, they run over the whole process
+	unsigned int	stall_recoveries;
+	unsigned int	stall_new;			//in this run
+	unsigned int	stall_ended;
+	unsigned int	max_stall_ms;
+	unsigned int	sum_stall_ms;
+} StressResult;
+
+static void drain_events(StressResult *res)
+{
+	VdecEvent ev;
+
+	while( tcc_vdec_GetEvent( &ev ) == 0 )
+	{
+		res->events++;
+		if( ev.type == VDEC_EVENT_FRAME_READY )
+			res->frames++;
+	}
+}
+
+/* stall -> first frame out, from the watchdog */
+static void check_stall(int cycle, int au, StressResult *res)
+{
+	VpuWatchdogStat ws;
+
+	tcc_vdec_GetWatchdogStat( &ws );
+	res->stall_new += ws.stalls - res->stalls;
+	res->stalls = ws.stalls;
+	if( ws.recoveries == res->stall_recoveries )
+		return;
+
+	res->stall_ended += ws.recoveries - res->stall_recoveries;
+	res->stall_recoveries = ws.recoveries;
+	res->sum_stall_ms += ws.last_recovery_ms;
+	if( ws.last_recovery_ms > res->max_stall_ms )
+		res->max_stall_ms = ws.last_recovery_ms;
+	CHECK( ws.last_recovery_ms <= STRESS_MAX_STALL_MS, "cycle %d au %d : video back %u ms after a stall", cycle, au, ws.last_recovery_ms );
+}
+
+static void set_faults(unsigned int *seed)
+{
+	tcc_vdec_InjectFault( -1, 0 );
+	tcc_vdec_InjectFault( FAULT_SEQ_HEADER, rand_r( seed ) % 100 );
+	tcc_vdec_InjectFault( FAULT_BUF_FULL, rand_r( seed ) % 6 );
+	tcc_vdec_InjectFault( FAULT_CODEC_EXIT, rand_r( seed ) % 20 );
+	tcc_vdec_InjectFault( FAULT_BUF_CLEAR, rand_r( seed ) % 20 );
+	tcc_vdec_InjectFault( FAULT_HANG, rand_r( seed ) % 4 );
+	tcc_vdec_InjectFault( FAULT_OVERLAY_OPEN, rand_r( seed ) % 400 );
+}
+
+static void new_stream(StreamGen *gen, unsigned int *seed)
+{
+	int s = rand_r( seed ) % (int)(sizeof(g_Sizes) / sizeof(g_Sizes[0]));
+
+	if( gen->au != NULL )
+		gen_free( gen );
+	gen_init( gen, g_Sizes[s][0], g_Sizes[s][1], STRESS_GOP, 0, rand_r( seed ) );
+}
+
+static void run_cycle(int cycle, unsigned int *seed, StressResult *res)
+{
+	StreamGen gen = { 0 };
+	VpuFaultStat fs;
+	unsigned int recoveries = 0;
+	unsigned int lost = 0;
+	int view = 1;
+	int i, n, r;
+
+	set_faults( seed );
+	tcc_vdec_open();
+	tcc_vdec_init( 0, 0, MOCK_FB_WIDTH, MOCK_FB_HEIGHT );
+	tcc_vdec_SetViewFlag( view );
+	new_stream( &gen, seed );
+
+	for( i = 0; i < STRESS_AUS; i++ )
+	{
+		r = rand_r( seed ) % 1000;
+		if( r < 8 )
+		{
+			// transport loss : a few AUs never arrive
+			for( n = 1 + rand_r( seed ) % 10; n > 0; n-- )
+				gen_next( &gen );
+			tcc_vdec_NotifyStreamLoss();
+		}
+		else if( r < 14 )
+		{
+			view = !view;
+			tcc_vdec_SetViewFlag( view );
+		}
+		else if( r < 16 )
+		{
+			new_stream( &gen, seed );
+		}
+
+		gen_next( &gen );
+		tcc_vdec_process_pts( gen.au, gen.size, gen.pts_ms );
+		res->aus++;
+		drain_events( res );
+
+		// one recovery ends with the frame out of this AU : its latency and the AUs it cost
+		tcc_vdec_GetFaultStat( &fs );
+		if( fs.recoveries != recoveries )
+		{
+			unsigned int d = fs.frames_lost - lost;
+
+			res->recoveries++;
+			res->sum_recovery_ms += fs.last_recovery_ms;
+			if( fs.last_recovery_ms > res->max_recovery_ms )
+				res->max_recovery_ms = fs.last_recovery_ms;
+			res->sum_lost += d;
+			if( d > res->max_lost )
+				res->max_lost = d;
+			CHECK( d <= STRESS_MAX_LOST_AUS, "cycle %d au %d : %u AUs lost", cycle, i, d );
+			CHECK( fs.last_recovery_ms <= STRESS_MAX_RECOVERY_MS, "cycle %d au %d : recovered in %u ms", cycle, i, fs.last_recovery_ms );
+			recoveries = fs.recoveries;
+			lost = fs.frames_lost;
+		}
+		check_stall( cycle, i, res );
+		usleep( STRESS_FEED_US );
+	}
+
+	tcc_vdec_GetFaultStat( &fs );
+	for( n = 0; n < FAULT_CLASS_COUNT; n++ )
+		res->injected += fs.injected[n];
+
+	tcc_vdec_close();
+	drain_events( res );
+	gen_free( &gen );
+}
+
+/* back to back source switches : the old decoder's frame buffers are freed only once the display has left them */
+static void check_switch(unsigned int seed, StressResult *res)
+{
+	StreamGen gen = { 0 };
+	MockVpuStat vs;
+	VdecEvent ev;
+	unsigned int busy_frees;
+	int c, n, r, flips = 0;
+
+	mock_vpu_get_stat( &vs );
+	busy_frees = vs.busy_frees;
+
+	tcc_vdec_open();
+	tcc_vdec_init( 0, 0, MOCK_FB_WIDTH, MOCK_FB_HEIGHT );
+	tcc_vdec_SetViewFlag( 1 );
+	gen_init( &gen, 320, 240, STRESS_GOP, 0, seed );
+	// one AU per vsync : the display latches every frame
+	for( c = 0; c < STRESS_GOP; c++ )
+	{
+		gen_next( &gen );
+		tcc_vdec_process_pts( gen.au, gen.size, gen.pts_ms );
+		drain_events( res );
+		usleep( MOCK_VSYNC_US );
+	}
+
+	for( n = 0; n < 4; n++ )
+	{
+		// right after the flip : the old stream's last frame is still scanned out
+		CHECK( tcc_vdec_SwitchBegin( 0 ) == 0, "switch %d : SwitchBegin failed", n );
+		gen_free( &gen );
+		gen_init( &gen, g_Sizes[n][0], g_Sizes[n][1], STRESS_GOP, 0, seed + n );
+		for( c = 0, r = 0; c < STRESS_GOP && r == 0; c++ )
+		{
+			gen_next( &gen );
+			r = tcc_vdec_SwitchProcess( gen.au, gen.size, gen.pts_ms );
+			if( r == 0 )
+				usleep( MOCK_VSYNC_US );
+		}
+		CHECK( r == 1, "switch %d : no flip in a GOP (%d)", n, r );
+		while( tcc_vdec_GetEvent( &ev ) == 0 )
+		{
+			res->events++;
+			if( ev.type == VDEC_EVENT_SWITCHED )
+				flips++;
+		}
+	}
+	CHECK( flips == n, "%d VDEC_EVENT_SWITCHED of %d switches", flips, n );
+
+	tcc_vdec_close();
+	drain_events( res );
+	gen_free( &gen );
+	mock_vpu_get_stat( &vs );
+	CHECK( vs.busy_frees == busy_frees, "%u frame buffers freed while on screen by a switch", vs.busy_frees - busy_frees );
+}
+
+/* idle power down with a hidden view, the next input resumes from the cached IDR */
+static void check_idle(unsigned int seed, StressResult *res)
+{
+	StreamGen gen;
+	VdecIdleStat is;
+	MockVpuStat vs;
+	unsigned int frames;
+	int c;
+
+	tcc_vdec_open();
+	tcc_vdec_init( 0, 0, MOCK_FB_WIDTH, MOCK_FB_HEIGHT );
+	tcc_vdec_SetViewFlag( 1 );
+	tcc_vdec_SetIdleTimeout( 50 );
+	gen_init( &gen, 320, 240, STRESS_GOP, 0, seed );
+	for( c = 0; c < 5; c++ )
+	{
+		gen_next( &gen );
+		tcc_vdec_process_pts( gen.au, gen.size, gen.pts_ms );
+		drain_events( res );
+	}
+
+	// a frame the overlay shows keeps the VPU
+	usleep( 300 * 1000 );
+	tcc_vdec_GetIdleStat( &is );
+	CHECK( is.suspends == 0, "VPU released under a frame on screen" );
+
+	tcc_vdec_SetViewFlag( 0 );
+	usleep( 300 * 1000 );
+	tcc_vdec_GetIdleStat( &is );
+	mock_vpu_get_stat( &vs );
+	CHECK( is.suspends == 1 && is.suspended == 1, "%u suspends, suspended %u with a hidden view", is.suspends, is.suspended );
+	CHECK( vs.opened == 0 && vs.fb_maps == 0, "suspended : %d VPU opened, %d frame buffer sets", vs.opened, vs.fb_maps );
+
+	// a P picture : the decoder starts over from the IDR it kept
+	tcc_vdec_SetViewFlag( 1 );
+	frames = res->frames;
+	gen_next( &gen );
+	tcc_vdec_process_pts( gen.au, gen.size, gen.pts_ms );
+	drain_events( res );
+	tcc_vdec_GetIdleStat( &is );
+	CHECK( is.resumes == 1 && is.suspended == 0, "%u resumes, suspended %u after the next input", is.resumes, is.suspended );
+	CHECK( res->frames > frames, "no frame out of the first input after the suspend" );
+
+	tcc_vdec_SetIdleTimeout( 0 );
+	tcc_vdec_close();
+	drain_events( res );
+	gen_free( &gen );
+}
+
+/* damaged access units : junk in front, an empty and a forbidden NAL unit are cut away, no start code is dropped */
+static void check_sanitize(unsigned int seed, StressResult *res)
+{
+	static const unsigned char junk[3] = { 0x11, 0x22, 0x33 };
+	static const unsigned char empty[4] = { 0x00, 0x00, 0x00, 0x01 };
+	static const unsigned char forbidden[7] = { 0x00, 0x00, 0x00, 0x01, 0x81, 0x9A, 0x5C };
+	StreamGen gen;
+	BsSanitizeStat st;
+	unsigned char *au;
+	unsigned int frames;
+	int c, len;
+
+	au = (unsigned char*)mock_alloc32( GEN_MAX_AU + 64 );
+	tcc_vdec_open();
+	tcc_vdec_init( 0, 0, MOCK_FB_WIDTH, MOCK_FB_HEIGHT );
+	tcc_vdec_SetViewFlag( 1 );
+	gen_init( &gen, 320, 240, STRESS_GOP, 0, seed );
+	gen_next( &gen );
+	tcc_vdec_process_pts( gen.au, gen.size, gen.pts_ms );
+	drain_events( res );
+
+	for( c = 0; c < 3; c++ )
+	{
+		gen_next( &gen );
+		len = 0;
+		if( c == 0 )
+		{
+			memcpy( au, junk, sizeof(junk) );
+			len = sizeof(junk);
+		}
+		else if( c == 1 )
+		{
+			memcpy( au, empty, sizeof(empty) );
+			len = sizeof(empty);
+		}
+		memcpy( au + len, gen.au, gen.size );
+		len += gen.size;
+		if( c == 2 )
+		{
+			memcpy( au + len, forbidden, sizeof(forbidden) );
+			len += sizeof(forbidden);
+		}
+		frames = res->frames;
+		tcc_vdec_process_pts( au, len, gen.pts_ms );
+		drain_events( res );
+		CHECK( res->frames > frames, "damaged AU %d : no frame out", c );
+	}
+	memset( au, 0x55, 64 );
+	tcc_vdec_process_pts( au, 64, gen.pts_ms + 1 );
+	drain_events( res );
+
+	tcc_vdec_GetSanitizeStat( &st );
+	CHECK( st.bytes_skipped == sizeof(junk), "%u junk bytes skipped", st.bytes_skipped );
+	CHECK( st.nal_empty == 1 && st.nal_forbidden == 1, "%u empty, %u forbidden NAL units", st.nal_empty, st.nal_forbidden );
+	CHECK( st.aus_rejected == 1, "%u AUs rejected", st.aus_rejected );
+	CHECK( st.aus == 5 && st.aus_clean == 1, "%u AUs checked, %u clean", st.aus, st.aus_clean );
+
+	tcc_vdec_close();
+	drain_events( res );
+	gen_free( &gen );
+	mock_free32( au, GEN_MAX_AU + 64 );
+}
+
+static void check_released(const char *when, long heap_blocks, int fds)
+{
+	MockVpuStat vs;
+	MockHeapStat hs;
+	MockDispStat ds;
+	VpuFaultStat fs;
+
+	mock_vpu_get_stat( &vs );
+	mock_heap_get_stat( &hs );
+	mock_disp_get_stat( &ds );
+	tcc_vdec_GetFaultStat( &fs );
+
+	CHECK( vs.instances == 0, "%s : %d VPU instances", when, vs.instances );
+	CHECK( vs.opened == 0, "%s : %d VPU opened", when, vs.opened );
+	CHECK( vs.fb_maps == 0, "%s : %d frame buffer sets", when, vs.fb_maps );
+	CHECK( fs.vpu_instances == 0, "%s : fault layer counts %d VPU instances", when, fs.vpu_instances );
+	CHECK( ds.open_fds == 0, "%s : %d device fds", when, ds.open_fds );
+	CHECK( hs.live_blocks == heap_blocks, "%s : %ld heap blocks, %ld before", when, hs.live_blocks, heap_blocks );
+	CHECK( mock_fd_count() == fds, "%s : %d fds, %d before", when, mock_fd_count(), fds );
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int seed = (argc > 1) ? (unsigned int)strtoul( argv[1], NULL, 0 ) : (unsigned int)time( NULL );
+	int cycles = (argc > 2) ? atoi( argv[2] ) : STRESS_CYCLES;
+	StressResult res = { 0 };
+	StressResult warm = { 0 };
+	MockHeapStat hs;
+	MockVpuStat vs;
+	MockDispStat ds;
+	VpuWatchdogStat ws;
+	unsigned int pushes, restores, stalls, frames;
+	int deadline;
+	long heap_blocks;
+	int fds;
+	int c, n;
+	char when[32];
+
+	mock_init();
+	// the decoder logs every overlay push
+	if( freopen( "/dev/null", "w", stdout ) == NULL )
+		return 1;
+	fprintf( stderr, "vdec_stress : seed %u, %d cycles of %d AUs\n", seed, cycles, STRESS_AUS );
+
+	tcc_vpu_fault_seed( seed );
+
+	// the first cycle creates what lives for the whole process (event fd, thread stacks)
+	set_faults( &seed );
+	tcc_vdec_InjectFault( -1, 0 );
+	tcc_vdec_open();
+	tcc_vdec_init( 0, 0, MOCK_FB_WIDTH, MOCK_FB_HEIGHT );
+	tcc_vdec_SetViewFlag( 1 );
+	// a level the decoder rejects must not be reported as applied
+	CHECK( tcc_vdec_SetSkipMode( 3, 0 ) == -1, "skip level 3 accepted" );
+	{
+		StreamGen gen;
+		unsigned long heap_calls = 0;
+
+		gen_init( &gen, 320, 240, STRESS_GOP, 0, seed );
+		for( c = 0; c < 2 * STRESS_GOP; c++ )
+		{
+			// the first GOP sets up the sequence, the second one is steady state : no heap call at all
+			if( c == STRESS_GOP )
+			{
+				mock_heap_get_stat( &hs );
+				heap_calls = hs.calls;
+			}
+			gen_next( &gen );
+			tcc_vdec_process_pts( gen.au, gen.size, gen.pts_ms );
+			drain_events( &warm );
+		}
+		mock_heap_get_stat( &hs );
+		CHECK( hs.calls == heap_calls, "%lu heap calls decoding a steady GOP", hs.calls - heap_calls );
+
+		// a frame not shown goes straight back to the VPU : the batch result must not point into it
+		for( c = 0, n = 0; c < STRESS_GOP; c++ )
+		{
+			VdecAU au;
+			VdecAUResult r;
+
+			gen_next( &gen );
+			au.data = gen.au;
+			au.size = gen.size;
+			au.pts_ms = gen.pts_ms;
+			au.flags = VDEC_AU_FLAG_NO_DISPLAY;
+			tcc_vdec_process_batch( &au, &r, 1 );
+			drain_events( &warm );
+			if( r.ret == 0 )
+			{
+				n++;
+				CHECK( r.y == NULL && r.uv == NULL, "batch result of a frame not shown points into its buffer" );
+			}
+		}
+		CHECK( n > 0, "no frame out of a batch" );
+
+		// hidden and shown again : the hold must pin the frame on screen, not the last one out of the VPU (not shown above)
+		mock_disp_get_stat( &ds );
+		pushes = ds.pushes;
+		tcc_vdec_SetViewFlag( 0 );
+		for( c = 0; c < 4; c++ )
+		{
+			gen_next( &gen );
+			tcc_vdec_process_pts( gen.au, gen.size, gen.pts_ms );
+			drain_events( &warm );
+		}
+		tcc_vdec_SetViewFlag( 1 );
+		mock_disp_get_stat( &ds );
+		CHECK( ds.pushes == pushes + 1, "last frame not presented again with the view" );
+		// once the display has latched past it, the next frame gives back what it no longer scans
+		usleep( 3 * MOCK_VSYNC_US );
+		gen_next( &gen );
+		tcc_vdec_process_pts( gen.au, gen.size, gen.pts_ms );
+		drain_events( &warm );
+		mock_vpu_get_stat( &vs );
+		CHECK( vs.busy_clears == 0, "frame on screen given back to the VPU : pinned index is not the presented one" );
+
+		// slow pictures are used, fewer than WATCHDOG_MAX_OVERRUNS in a row never restore
+		tcc_vdec_GetWatchdogStat( &ws );
+		restores = ws.restores;
+		stalls = ws.stalls;
+		frames = warm.frames;
+		deadline = tcc_vpu_watchdog_deadline( 320, 240 );
+		for( c = 0; c < 2 * WATCHDOG_MAX_OVERRUNS - 1; c++ )
+		{
+			// one picture in time between two runs
+			mock_vpu_set_decode_us( (c == WATCHDOG_MAX_OVERRUNS - 1) ? 0 : 2 * deadline * 1000 );
+			gen_next( &gen );
+			tcc_vdec_process_pts( gen.au, gen.size, gen.pts_ms );
+			drain_events( &warm );
+		}
+		mock_vpu_set_decode_us( 0 );
+		tcc_vdec_GetWatchdogStat( &ws );
+		CHECK( ws.stalls - stalls == 2 * WATCHDOG_MAX_OVERRUNS - 2, "%u stalls of %d slow pictures", ws.stalls - stalls, 2 * WATCHDOG_MAX_OVERRUNS - 2 );
+		CHECK( ws.restores == restores, "slow pictures restored the decoder" );
+		CHECK( warm.frames - frames == 2 * WATCHDOG_MAX_OVERRUNS - 1, "%u frames of %d slow or in time pictures", warm.frames - frames, 2 * WATCHDOG_MAX_OVERRUNS - 1 );
+
+		// a VPU that stays slow, then one command past the hard cap : each one is restored, video comes back with the next IDR
+		for( n = 0; n < 2; n++ )
+		{
+			mock_vpu_set_decode_us( (n == 0 ? 2 : WATCHDOG_HARD_FACTOR + 1) * deadline * 1000 );
+			for( c = 0; c < (n == 0 ? WATCHDOG_MAX_OVERRUNS : 1); c++ )
+			{
+				gen_next( &gen );
+				tcc_vdec_process_pts( gen.au, gen.size, gen.pts_ms );
+				drain_events( &warm );
+			}
+			mock_vpu_set_decode_us( 0 );
+			tcc_vdec_GetWatchdogStat( &ws );
+			CHECK( ws.restores == restores + n + 1, "%s : %u restores", n == 0 ? "slow in a row" : "past the hard cap", ws.restores - restores );
+			frames = warm.frames;
+			gen_force_idr( &gen );
+			gen_next( &gen );
+			tcc_vdec_process_pts( gen.au, gen.size, gen.pts_ms );
+			drain_events( &warm );
+			CHECK( warm.frames > frames, "%s : no frame out of the IDR after the restore", n == 0 ? "slow in a row" : "past the hard cap" );
+		}
+		gen_free( &gen );
+	}
+	tcc_vdec_close();
+	drain_events( &warm );
+	CHECK( warm.frames > 0, "no frame out without faults" );
+	// without faults the display never holds more buffers than the VPU keeps for it, and never sees one rewritten
+	mock_vpu_get_stat( &vs );
+	CHECK( vs.buf_full == 0, "%u buffer full without faults", vs.buf_full );
+	CHECK( vs.tears == 0, "%u frames decoded into a buffer on screen without faults", vs.tears );
+
+	check_switch( seed, &warm );
+	check_idle( seed, &warm );
+	check_sanitize( seed, &warm );
+
+	check_stall( -1, 0, &warm );
+	res.stalls = warm.stalls;
+	res.stall_recoveries = warm.stall_recoveries;
+
+	mock_heap_get_stat( &hs );
+	heap_blocks = hs.live_blocks;
+	fds = mock_fd_count();
+
+	for( c = 0; c < cycles; c++ )
+	{
+		run_cycle( c, &seed, &res );
+		snprintf( when, sizeof(when), "after cycle %d", c );
+		check_released( when, heap_blocks, fds );
+	}
+
+	mock_vpu_get_stat( &vs );
+	fprintf( stderr, "  %u AUs, %u frames ready, %u faults injected, %u recoveries\n", res.aus, res.frames, res.injected, res.recoveries );
+	fprintf( stderr, "  recovery : max %u ms, mean %u ms (bound %d ms)\n", res.max_recovery_ms,
+			res.recoveries ? res.sum_recovery_ms / res.recoveries : 0, STRESS_MAX_RECOVERY_MS );
+	fprintf( stderr, "  AUs lost per recovery : max %u, mean %u.%u (bound %d)\n", res.max_lost,
+			res.recoveries ? res.sum_lost / res.recoveries : 0, res.recoveries ? (res.sum_lost * 10 / res.recoveries) % 10 : 0, STRESS_MAX_LOST_AUS );
+	fprintf( stderr, "  stalls : %u, %u ended by a frame, max %u ms, mean %u ms (bound %d ms)\n", res.stall_new, res.stall_ended,
+			res.max_stall_ms, res.stall_ended ? res.sum_stall_ms / res.stall_ended : 0, STRESS_MAX_STALL_MS );
+	fprintf( stderr, "  VPU : %u sequence headers, %u decodes, %u buffer full, %u bad clears, %u tears\n", vs.seq_headers, vs.decodes, vs.buf_full, vs.bad_clears, vs.tears );
+
+	CHECK( res.frames > res.aus / 2, "%u frames ready of %u AUs", res.frames, res.aus );
+	CHECK( vs.bad_clears == 0, "%u clears of buffers the VPU did not hand out", vs.bad_clears );
+
+	fprintf( stderr, "vdec_stress : %s\n", g_CheckFail ? "FAIL" : "ok" );
+	return g_CheckFail ? 1 : 0;
+}
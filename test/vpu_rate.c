@@ -0,0 +1,63 @@
+//********************************************************************************************
+/**
+ * @file        vpu_rate.c
+ * @brief		Frame rate estimate of tcc_vpu_rate.c on time stamps in decode order, with and without B pictures.
+ *
+ * @author      Yusuf.Sha, Telechips Shenzhen Rep.
+ * @date        2016/11/08
+ */
+//********************************************************************************************
+#include <stdio.h>
+
+#include <vdec_v1.h>
+
+#include "tcc_vpu_rate.h"
+#include "vdec_mock.h"
+
+#define RATE_TEST_PICTURES		120
+
+static unsigned int estimate(int fps, int bframes)
+{
+	StreamGen gen;
+	int i;
+
+	tcc_vpu_rate_reset();
+	gen_init( &gen, 176, 144, 30, bframes, 1 );
+	gen.frame_ms = 1000 / fps;
+	for( i = 0; i < RATE_TEST_PICTURES; i++ )
+	{
+		gen_next( &gen );
+		tcc_vpu_rate_au( gen.size, gen.pts_ms, 1 );
+	}
+	gen_free( &gen );
+	return tcc_vpu_rate_fps();
+}
+
+int main(void)
+{
+	static const int fps[] = { 25, 30, 60 };
+	unsigned int i, b, got;
+
+	mock_init();
+	for( i = 0; i < sizeof(fps) / sizeof(fps[0]); i++ )
+	{
+		for( b = 0; b <= 3; b++ )
+		{
+			got = estimate( fps[i], b );
+			fprintf( stderr, "  %d fps, %u B pictures : %u fps\n", fps[i], b, got );
+			CHECK( got * 100 >= (unsigned int)fps[i] * (100 - RATE_FPS_TOLERANCE) && got * 100 <= (unsigned int)fps[i] * (100 + RATE_FPS_TOLERANCE),
+					"%d fps with %u B pictures read as %u fps", fps[i], b, got );
+		}
+	}
+
+	// a stream pre-rolled on the other slot leaves the estimate of the one on screen alone
+	got = estimate( 25, 0 );
+	tcc_vpu_rate_select( 1 );
+	estimate( 60, 2 );
+	tcc_vpu_rate_select( 0 );
+	CHECK( tcc_vpu_rate_fps() == got, "slot 0 reads %u fps after slot 1 was fed, %u before", tcc_vpu_rate_fps(), got );
+	fprintf( stderr, "  slot 0 after a 60 fps pre-roll on slot 1 : %u fps\n", tcc_vpu_rate_fps() );
+
+	fprintf( stderr, "vpu_rate : %s\n", g_CheckFail ? "FAIL" : "ok" );
+	return g_CheckFail ? 1 : 0;
+}